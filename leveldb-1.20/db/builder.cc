@@ -6,11 +6,13 @@
 
 #include "db/filename.h"
 #include "db/dbformat.h"
+#include "db/range_tombstones.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "util/rate_limiter.h"
 
 namespace leveldb {
 
@@ -19,26 +21,54 @@ Status BuildTable(const std::string& dbname,
                   const Options& options,
                   TableCache* table_cache,
                   Iterator* iter,
-                  FileMetaData* meta) {
+                  const RangeTombstones* range_deletions,
+                  FileMetaData* meta,
+                  ThreadPool* compression_pool) {
   Status s;
   meta->file_size = 0;
+  meta->has_range_deletions = false;
   iter->SeekToFirst();
 
+  std::vector<RangeTombstones::Fragment> fragments;
+  if (range_deletions != nullptr) {
+    range_deletions->GetFragments(nullptr, nullptr, &fragments);
+  }
+
   std::string fname = TableFileName(dbname, meta->number);
-  if (iter->Valid()) {
+  if (iter->Valid() || !fragments.empty()) {
     WritableFile* file;
-    s = env->NewWritableFile(fname, &file);
+    if (options.use_direct_io_for_flush_and_compaction) {
+      s = env->NewDirectWritableFile(fname, &file);
+    } else {
+      s = env->NewWritableFile(fname, &file);
+    }
     if (!s.ok()) {
       return s;
     }
+    if (options.rate_limiter != nullptr) {
+      file = NewRateLimitedWritableFile(file, options.rate_limiter,
+                                        RateLimiter::kHigh);
+    }
 
-    TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
+    Options table_options = options;
+    table_options.compression = CompressionForLevel(options, 0);
+    TableBuilder* builder = new TableBuilder(table_options, file,
+                                             compression_pool);
+    if (iter->Valid()) {
+      meta->smallest.DecodeFrom(iter->key());
+    }
     for (; iter->Valid(); iter->Next()) {
       Slice key = iter->key();
       meta->largest.DecodeFrom(key);
       builder->Add(key, iter->value());
     }
+    if (!fragments.empty()) {
+      const InternalKeyComparator* icmp =
+          static_cast<const InternalKeyComparator*>(options.comparator);
+      AddRangeDeletionsToTable(*icmp, fragments, builder,
+                               &meta->smallest, &meta->largest);
+      meta->has_range_deletions = true;
+    }
 
     // Finish and check for builder errors
     s = builder->Finish();
@@ -62,7 +92,9 @@ Status BuildTable(const std::string& dbname,
       // Verify that the table is usable
       Iterator* it = table_cache->NewIterator(ReadOptions(),
                                               meta->number,
-                                              meta->file_size);
+                                              meta->file_size,
+                                              0,
+                                              0);
       s = it->status();
       delete it;
     }
@@ -81,4 +113,14 @@ Status BuildTable(const std::string& dbname,
   return s;
 }
 
+CompressionType CompressionForLevel(const Options& options, int level) {
+  const std::vector<CompressionType>& per_level =
+      options.compression_per_level;
+  if (per_level.empty()) {
+    return options.compression;
+  }
+  const size_t index = static_cast<size_t>(level);
+  return per_level[index < per_level.size() ? index : per_level.size() - 1];
+}
+
 }  // namespace leveldb
@@ -5,29 +5,40 @@
 #ifndef STORAGE_LEVELDB_DB_BUILDER_H_
 #define STORAGE_LEVELDB_DB_BUILDER_H_
 
+#include "leveldb/options.h"
 #include "leveldb/status.h"
 
 namespace leveldb {
 
-struct Options;
 struct FileMetaData;
 
 class Env;
 class Iterator;
+class RangeTombstones;
 class TableCache;
+class ThreadPool;
 class VersionEdit;
 
-// Build a Table file from the contents of *iter.  The generated file
+// Build a Table file from the contents of *iter and the range deletions
+// of *range_deletions, which may be nullptr.  The generated file
 // will be named according to meta->number.  On success, the rest of
 // *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// If no data is present in *iter and there are no range deletions,
+// meta->file_size will be set to zero, and no Table file will be
+// produced.  The table is compressed as a table of level 0, on the
+// threads of *compression_pool if it is non-null (see TableBuilder).
 Status BuildTable(const std::string& dbname,
                   Env* env,
                   const Options& options,
                   TableCache* table_cache,
                   Iterator* iter,
-                  FileMetaData* meta);
+                  const RangeTombstones* range_deletions,
+                  FileMetaData* meta,
+                  ThreadPool* compression_pool);
+
+// Return the compression to use for the tables of "level", as configured
+// by options.compression_per_level and options.compression.
+CompressionType CompressionForLevel(const Options& options, int level);
 
 }  // namespace leveldb
 
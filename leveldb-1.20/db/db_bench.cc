@@ -3,12 +3,18 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include <sys/types.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/io_uring_env.h"
+#include "leveldb/memtable_factory.h"
+#include "leveldb/rate_limiter.h"
+#include "leveldb/sst_file_writer.h"
 #include "leveldb/write_batch.h"
 #include "port/port.h"
 #include "util/crc32c.h"
@@ -20,21 +26,47 @@
 // Comma-separated list of operations to run in the specified order
 //   Actual benchmarks:
 //      fillseq       -- write N values in sequential key order in async mode
+//      bulkload      -- the same N values, written into tables of
+//                        --max_file_size bytes by an SstFileWriter and
+//                        ingested with DB::IngestExternalFile()
 //      fillrandom    -- write N values in random key order in async mode
 //      overwrite     -- overwrite N values in random key order in async mode
 //      fillsync      -- write N/100 values in random key order in sync mode
 //      fill100K      -- write N/1000 100K values in random order in async mode
 //      deleteseq     -- delete N keys in sequential order
 //      deleterandom  -- delete N keys in random order
+//      deleterange   -- delete N keys in sequential order, 1000 keys per
+//                        DeleteRange() call
 //      readseq       -- read N times sequentially
+//      readseq_cold  -- readseq after dropping the OS page cache of the DB
+//                        files, first without and then with readahead
 //      readreverse   -- read N times in reverse order
 //      readrandom    -- read N times in random order
+//      multireadrandom -- read N times in random order, using MultiGet
+//                        batches of --multiget_batch_size keys
 //      readmissing   -- read N missing keys in random order
 //      readhot       -- read N times in random order from 1% section of DB
 //      seekrandom    -- N random seeks
 //      open          -- cost of opening a DB
 //      crc32c        -- repeated crc32c of 4K of data
+//      crc32c1M      -- repeated crc32c of 1MB of data
+//      snappycomp    -- repeated snappy compression of 4K of data
+//      snappyuncomp  -- repeated snappy uncompression of 4K of data
+//      zstdcomp, zstduncomp -- the same for zstd, at
+//                        --zstd_compression_level
+//      lz4comp, lz4uncomp -- the same for LZ4
 //      acquireload   -- load N*1000 times
+//      subcompactions -- fillrandom with 1, 2, 4 and 8 subcompaction threads,
+//                        reporting the time writes spent stalled
+//      fillrandom_concurrent -- fillrandom with pipelined writes, first with
+//                        serial and then with concurrent memtable inserts
+//      readrandom_blockhash -- readrandom from a compacted DB, first without
+//                        and then with data block hash indexes
+//      readrandom_partitioned -- readrandom from a compacted DB, first with
+//                        whole and then with partitioned index and filters
+//      readwhilewriting_ratelimited -- readwhilewriting on a fresh DB, first
+//                        without and then with --rate_limit_mb_per_sec
+//                        (8 if unset), reporting read latency percentiles
 //   Meta operations:
 //      compact     -- Compact the entire DB
 //      stats       -- Print DB stats
@@ -55,8 +87,13 @@ static const char* FLAGS_benchmarks =
     "readreverse,"
     "fill100K,"
     "crc32c,"
+    "crc32c1M,"
     "snappycomp,"
     "snappyuncomp,"
+    "zstdcomp,"
+    "zstduncomp,"
+    "lz4comp,"
+    "lz4uncomp,"
     "acquireload,"
     ;
 
@@ -76,6 +113,24 @@ static int FLAGS_value_size = 100;
 // their original size after compression
 static double FLAGS_compression_ratio = 0.5;
 
+// Compression of table blocks: none, snappy, zstd or lz4.
+static const char* FLAGS_compression = "snappy";
+
+// If non-empty, a comma-separated list of the compression of each level
+// (see Options::compression_per_level), e.g. "lz4,lz4,lz4,zstd".
+static const char* FLAGS_compression_per_level = "";
+
+// Compression level of zstd.
+// (initialized to default value by "main")
+static int FLAGS_zstd_compression_level = 0;
+
+// If positive, the size of the zstd dictionary of every table.
+static int FLAGS_zstd_max_dictionary_bytes = 0;
+
+// Number of threads that compress the data blocks of each table written.
+// (initialized to default value by "main")
+static int FLAGS_parallel_compression_threads = 0;
+
 // Print histogram of operation timings
 static bool FLAGS_histogram = false;
 
@@ -95,13 +150,82 @@ static int FLAGS_block_size = 0;
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
 
+// Number of bytes to use as a cache of compressed blocks.
+// Negative means no compressed block cache.
+static int FLAGS_compressed_cache_size = -1;
+
+// Fraction of the cache reserved for index and filter blocks and for
+// blocks that were read more than once (see NewLRUCache).
+static double FLAGS_cache_high_pri_pool_ratio = 0;
+
+// If true, the cache is a NewClockCache() instead of a NewLRUCache().
+static bool FLAGS_clock_cache = false;
+
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
+// Maximum number of threads working on a single compaction.
+// (initialized to default value by "main")
+static int FLAGS_max_subcompactions = 0;
+
+// Maximum number of compactions running at the same time.
+// (initialized to default value by "main")
+static int FLAGS_max_background_compactions = 0;
+
+// If true, overlap log writes with memtable inserts.
+static bool FLAGS_enable_pipelined_write = false;
+
+// If true, let pipelined writers insert into the memtable in parallel.
+static bool FLAGS_allow_concurrent_memtable_write = false;
+
 // Bloom filter bits per key.
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// If true, use a blocked bloom filter, which keeps the bits of each key
+// in one cache line.
+static bool FLAGS_blocked_bloom = false;
+
+// If true, build one filter per table instead of one per 2KB of data.
+static bool FLAGS_whole_table_filter = false;
+
+// Number of buckets of a hash-indexed memtable.
+// Zero means use the default skiplist memtable.
+static int FLAGS_hash_memtable_buckets = 0;
+
+// If true, add a hash index to every data block.
+static bool FLAGS_data_block_hash_index = false;
+
+// If true, split the index and filter of every table into partitions.
+static bool FLAGS_partition_index_and_filters = false;
+
+// If true, keep the top-level index of partitioned level-0 and level-1
+// tables in memory.
+static bool FLAGS_pin_top_level_index = false;
+
+// If true, read table files with direct I/O.
+static bool FLAGS_use_direct_reads = false;
+
+// If true, write the table files of flushes and compactions with direct I/O.
+static bool FLAGS_use_direct_io_for_flush_and_compaction = false;
+
+// If positive, limit flush and compaction writes to this many MB/s.
+static int FLAGS_rate_limit_mb_per_sec = 0;
+
+// If true, read table files through NewIoUringEnv(), which lets a
+// MultiGet() batch read its data blocks in parallel.
+static bool FLAGS_io_uring = false;
+
+// Bytes that iterators prefetch ahead of a sequential scan.
+// Zero means no readahead (readseq_cold then compares against 256KB).
+static int FLAGS_readahead_size = 0;
+
+// Number of keys per MultiGet() call in multireadrandom.
+static int FLAGS_multiget_batch_size = 32;
+
+// Number of threads each MultiGet() call may read table files with.
+static int FLAGS_multiget_threads = 1;
+
 // If true, do not destroy the existing database.  If you set this
 // flag and also specify a benchmark that wants a fresh database, that
 // benchmark will fail.
@@ -312,19 +436,56 @@ struct ThreadState {
   }
 };
 
+// Parse "names", a comma-separated list of compression types, into
+// *types.
+static bool ParseCompressionTypes(const char* names,
+                                  std::vector<CompressionType>* types) {
+  types->clear();
+  while (*names != '\0') {
+    const char* sep = strchr(names, ',');
+    Slice name = (sep == nullptr) ? Slice(names) : Slice(names, sep - names);
+    if (name == Slice("none")) {
+      types->push_back(kNoCompression);
+    } else if (name == Slice("snappy")) {
+      types->push_back(kSnappyCompression);
+    } else if (name == Slice("zstd")) {
+      types->push_back(kZstdCompression);
+    } else if (name == Slice("lz4")) {
+      types->push_back(kLZ4Compression);
+    } else {
+      return false;
+    }
+    if (sep == nullptr) {
+      break;
+    }
+    names = sep + 1;
+  }
+  return true;
+}
+
 }  // namespace
 
 class Benchmark {
  private:
   Cache* cache_;
+  Cache* compressed_cache_;
   const FilterPolicy* filter_policy_;
+  const MemTableFactory* memtable_factory_;
+  RateLimiter* rate_limiter_;
   DB* db_;
+  Options options_;  // Options db_ was opened with
   int num_;
   int value_size_;
   int entries_per_batch_;
   WriteOptions write_options_;
   int reads_;
   int heap_counter_;
+  int max_subcompactions_;
+  bool enable_pipelined_write_;
+  bool allow_concurrent_memtable_write_;
+  bool data_block_hash_index_;
+  bool partition_index_and_filters_;
+  size_t readahead_size_;
 
   void PrintHeader() {
     const int kKeySize = 16;
@@ -402,16 +563,37 @@ class Benchmark {
 
  public:
   Benchmark()
-  : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : nullptr),
+  : cache_(FLAGS_cache_size < 0 ? nullptr :
+           FLAGS_clock_cache ?
+           NewClockCache(FLAGS_cache_size, FLAGS_block_size, -1) :
+           NewLRUCache(FLAGS_cache_size, FLAGS_cache_high_pri_pool_ratio)),
+    compressed_cache_(FLAGS_compressed_cache_size >= 0
+                      ? NewLRUCache(FLAGS_compressed_cache_size)
+                      : nullptr),
     filter_policy_(FLAGS_bloom_bits >= 0
-                   ? NewBloomFilterPolicy(FLAGS_bloom_bits)
+                   ? (FLAGS_blocked_bloom
+                      ? NewBlockedBloomFilterPolicy(FLAGS_bloom_bits)
+                      : NewBloomFilterPolicy(FLAGS_bloom_bits))
                    : nullptr),
+    memtable_factory_(FLAGS_hash_memtable_buckets > 0
+                      ? NewHashMemTableFactory(FLAGS_hash_memtable_buckets)
+                      : nullptr),
+    rate_limiter_(FLAGS_rate_limit_mb_per_sec > 0
+                  ? NewRateLimiter(
+                        static_cast<int64_t>(FLAGS_rate_limit_mb_per_sec) << 20)
+                  : nullptr),
     db_(nullptr),
     num_(FLAGS_num),
     value_size_(FLAGS_value_size),
     entries_per_batch_(1),
     reads_(FLAGS_reads < 0 ? FLAGS_num : FLAGS_reads),
-    heap_counter_(0) {
+    heap_counter_(0),
+    max_subcompactions_(FLAGS_max_subcompactions),
+    enable_pipelined_write_(FLAGS_enable_pipelined_write),
+    allow_concurrent_memtable_write_(FLAGS_allow_concurrent_memtable_write),
+    data_block_hash_index_(FLAGS_data_block_hash_index),
+    partition_index_and_filters_(FLAGS_partition_index_and_filters),
+    readahead_size_(FLAGS_readahead_size) {
     std::vector<std::string> files;
     g_env->GetChildren(FLAGS_db, &files);
     for (size_t i = 0; i < files.size(); i++) {
@@ -427,7 +609,10 @@ class Benchmark {
   ~Benchmark() {
     delete db_;
     delete cache_;
+    delete compressed_cache_;
     delete filter_policy_;
+    delete memtable_factory_;
+    delete rate_limiter_;
   }
 
   void Run() {
@@ -464,6 +649,9 @@ class Benchmark {
       } else if (name == Slice("fillseq")) {
         fresh_db = true;
         method = &Benchmark::WriteSeq;
+      } else if (name == Slice("bulkload")) {
+        fresh_db = true;
+        method = &Benchmark::BulkLoad;
       } else if (name == Slice("fillbatch")) {
         fresh_db = true;
         entries_per_batch_ = 1000;
@@ -490,6 +678,8 @@ class Benchmark {
         method = &Benchmark::ReadReverse;
       } else if (name == Slice("readrandom")) {
         method = &Benchmark::ReadRandom;
+      } else if (name == Slice("multireadrandom")) {
+        method = &Benchmark::MultiReadRandom;
       } else if (name == Slice("readmissing")) {
         method = &Benchmark::ReadMissing;
       } else if (name == Slice("seekrandom")) {
@@ -503,6 +693,8 @@ class Benchmark {
         method = &Benchmark::DeleteSeq;
       } else if (name == Slice("deleterandom")) {
         method = &Benchmark::DeleteRandom;
+      } else if (name == Slice("deleterange")) {
+        method = &Benchmark::DeleteRange;
       } else if (name == Slice("readwhilewriting")) {
         num_threads++;  // Add extra thread for writing
         method = &Benchmark::ReadWhileWriting;
@@ -510,12 +702,34 @@ class Benchmark {
         method = &Benchmark::Compact;
       } else if (name == Slice("crc32c")) {
         method = &Benchmark::Crc32c;
+      } else if (name == Slice("crc32c1M")) {
+        method = &Benchmark::Crc32c1M;
       } else if (name == Slice("acquireload")) {
         method = &Benchmark::AcquireLoad;
       } else if (name == Slice("snappycomp")) {
         method = &Benchmark::SnappyCompress;
       } else if (name == Slice("snappyuncomp")) {
         method = &Benchmark::SnappyUncompress;
+      } else if (name == Slice("zstdcomp")) {
+        method = &Benchmark::ZstdCompress;
+      } else if (name == Slice("zstduncomp")) {
+        method = &Benchmark::ZstdUncompress;
+      } else if (name == Slice("lz4comp")) {
+        method = &Benchmark::LZ4Compress;
+      } else if (name == Slice("lz4uncomp")) {
+        method = &Benchmark::LZ4Uncompress;
+      } else if (name == Slice("subcompactions")) {
+        SubcompactionSweep(num_threads);
+      } else if (name == Slice("fillrandom_concurrent")) {
+        ConcurrentMemtableWriteSweep(num_threads);
+      } else if (name == Slice("readrandom_blockhash")) {
+        BlockHashSweep(num_threads);
+      } else if (name == Slice("readrandom_partitioned")) {
+        PartitionedIndexSweep(num_threads);
+      } else if (name == Slice("readwhilewriting_ratelimited")) {
+        RateLimitSweep(num_threads);
+      } else if (name == Slice("readseq_cold")) {
+        ColdReadSweep(num_threads);
       } else if (name == Slice("heapprofile")) {
         HeapProfile();
       } else if (name == Slice("stats")) {
@@ -621,9 +835,15 @@ class Benchmark {
   }
 
   void Crc32c(ThreadState* thread) {
+    Crc32c(thread, 4096, "(4K per op)");
+  }
+
+  void Crc32c1M(ThreadState* thread) {
+    Crc32c(thread, 1048576, "(1MB per op)");
+  }
+
+  void Crc32c(ThreadState* thread, int size, const char* label) {
     // Checksum about 500MB of data total
-    const int size = 4096;
-    const char* label = "(4K per op)";
     std::string data(size, 'x');
     int64_t bytes = 0;
     uint32_t crc = 0;
@@ -655,7 +875,62 @@ class Benchmark {
     if (ptr == nullptr) exit(1); // Disable unused variable warning.
   }
 
+  static bool Compress(CompressionType type, const Slice& input,
+                       std::string* output) {
+    switch (type) {
+      case kSnappyCompression:
+        return port::Snappy_Compress(input.data(), input.size(), output);
+      case kZstdCompression:
+        return port::Zstd_Compress(FLAGS_zstd_compression_level,
+                                   input.data(), input.size(), output);
+      case kLZ4Compression:
+        return port::LZ4_Compress(input.data(), input.size(), output);
+      default:
+        return false;
+    }
+  }
+
+  static bool Uncompress(CompressionType type, const std::string& input,
+                         char* output) {
+    switch (type) {
+      case kSnappyCompression:
+        return port::Snappy_Uncompress(input.data(), input.size(), output);
+      case kZstdCompression:
+        return port::Zstd_Uncompress(nullptr, input.data(), input.size(),
+                                     output);
+      case kLZ4Compression:
+        return port::LZ4_Uncompress(input.data(), input.size(), output);
+      default:
+        return false;
+    }
+  }
+
   void SnappyCompress(ThreadState* thread) {
+    CompressBlocks(thread, kSnappyCompression, "snappy");
+  }
+
+  void SnappyUncompress(ThreadState* thread) {
+    UncompressBlocks(thread, kSnappyCompression, "snappy");
+  }
+
+  void ZstdCompress(ThreadState* thread) {
+    CompressBlocks(thread, kZstdCompression, "zstd");
+  }
+
+  void ZstdUncompress(ThreadState* thread) {
+    UncompressBlocks(thread, kZstdCompression, "zstd");
+  }
+
+  void LZ4Compress(ThreadState* thread) {
+    CompressBlocks(thread, kLZ4Compression, "lz4");
+  }
+
+  void LZ4Uncompress(ThreadState* thread) {
+    UncompressBlocks(thread, kLZ4Compression, "lz4");
+  }
+
+  void CompressBlocks(ThreadState* thread, CompressionType type,
+                      const char* name) {
     RandomGenerator gen;
     Slice input = gen.Generate(Options().block_size);
     int64_t bytes = 0;
@@ -663,14 +938,16 @@ class Benchmark {
     bool ok = true;
     std::string compressed;
     while (ok && bytes < 1024 * 1048576) {  // Compress 1G
-      ok = port::Snappy_Compress(input.data(), input.size(), &compressed);
+      ok = Compress(type, input, &compressed);
       produced += compressed.size();
       bytes += input.size();
       thread->stats.FinishedSingleOp();
     }
 
     if (!ok) {
-      thread->stats.AddMessage("(snappy failure)");
+      char buf[100];
+      snprintf(buf, sizeof(buf), "(%s failure)", name);
+      thread->stats.AddMessage(buf);
     } else {
       char buf[100];
       snprintf(buf, sizeof(buf), "(output: %.1f%%)",
@@ -680,23 +957,25 @@ class Benchmark {
     }
   }
 
-  void SnappyUncompress(ThreadState* thread) {
+  void UncompressBlocks(ThreadState* thread, CompressionType type,
+                        const char* name) {
     RandomGenerator gen;
     Slice input = gen.Generate(Options().block_size);
     std::string compressed;
-    bool ok = port::Snappy_Compress(input.data(), input.size(), &compressed);
+    bool ok = Compress(type, input, &compressed);
     int64_t bytes = 0;
     char* uncompressed = new char[input.size()];
     while (ok && bytes < 1024 * 1048576) {  // Compress 1G
-      ok =  port::Snappy_Uncompress(compressed.data(), compressed.size(),
-                                    uncompressed);
+      ok = Uncompress(type, compressed, uncompressed);
       bytes += input.size();
       thread->stats.FinishedSingleOp();
     }
     delete[] uncompressed;
 
     if (!ok) {
-      thread->stats.AddMessage("(snappy failure)");
+      char buf[100];
+      snprintf(buf, sizeof(buf), "(%s failure)", name);
+      thread->stats.AddMessage(buf);
     } else {
       thread->stats.AddBytes(bytes);
     }
@@ -708,12 +987,35 @@ class Benchmark {
     options.env = g_env;
     options.create_if_missing = !FLAGS_use_existing_db;
     options.block_cache = cache_;
+    options.block_cache_compressed = compressed_cache_;
     options.write_buffer_size = FLAGS_write_buffer_size;
     options.max_file_size = FLAGS_max_file_size;
     options.block_size = FLAGS_block_size;
     options.max_open_files = FLAGS_open_files;
     options.filter_policy = filter_policy_;
+    options.whole_table_filter = FLAGS_whole_table_filter;
+    options.memtable_factory = memtable_factory_;
     options.reuse_logs = FLAGS_reuse_logs;
+    options.max_subcompactions = max_subcompactions_;
+    options.max_background_compactions = FLAGS_max_background_compactions;
+    options.enable_pipelined_write = enable_pipelined_write_;
+    options.allow_concurrent_memtable_write = allow_concurrent_memtable_write_;
+    options.data_block_hash_index = data_block_hash_index_;
+    options.partition_index_and_filters = partition_index_and_filters_;
+    options.pin_top_level_index = FLAGS_pin_top_level_index;
+    options.use_direct_reads = FLAGS_use_direct_reads;
+    options.use_direct_io_for_flush_and_compaction =
+        FLAGS_use_direct_io_for_flush_and_compaction;
+    options.rate_limiter = rate_limiter_;
+    std::vector<CompressionType> types;
+    ParseCompressionTypes(FLAGS_compression, &types);
+    options.compression = types[0];
+    ParseCompressionTypes(FLAGS_compression_per_level,
+                          &options.compression_per_level);
+    options.zstd_compression_level = FLAGS_zstd_compression_level;
+    options.zstd_max_dictionary_bytes = FLAGS_zstd_max_dictionary_bytes;
+    options.parallel_compression_threads = FLAGS_parallel_compression_threads;
+    options_ = options;
     Status s = DB::Open(options, FLAGS_db, &db_);
     if (!s.ok()) {
       fprintf(stderr, "open error: %s\n", s.ToString().c_str());
@@ -767,8 +1069,54 @@ class Benchmark {
     thread->stats.AddBytes(bytes);
   }
 
+  void BulkLoad(ThreadState* thread) {
+    if (num_ != FLAGS_num) {
+      char msg[100];
+      snprintf(msg, sizeof(msg), "(%d ops)", num_);
+      thread->stats.AddMessage(msg);
+    }
+
+    // The tables are built next to the DB so that they can be moved in.
+    const std::string fname = std::string(FLAGS_db) + ".bulkload";
+    IngestExternalFileOptions ingest_options;
+    ingest_options.move_files = true;
+    RandomGenerator gen;
+    SstFileWriter* writer = nullptr;
+    Status s;
+    int64_t bytes = 0;
+    for (int i = 0; i < num_; i++) {
+      if (writer == nullptr) {
+        writer = new SstFileWriter(options_);
+        s = writer->Open(fname);
+      }
+      char key[100];
+      snprintf(key, sizeof(key), "%016d", i);
+      if (s.ok()) {
+        s = writer->Put(key, gen.Generate(value_size_));
+      }
+      bytes += value_size_ + strlen(key);
+      thread->stats.FinishedSingleOp();
+      if (s.ok() && (i == num_ - 1 ||
+                     writer->FileSize() >= options_.max_file_size)) {
+        s = writer->Finish();
+        delete writer;
+        writer = nullptr;
+        if (s.ok()) {
+          s = db_->IngestExternalFile(ingest_options, fname);
+        }
+      }
+      if (!s.ok()) {
+        fprintf(stderr, "bulkload error: %s\n", s.ToString().c_str());
+        exit(1);
+      }
+    }
+    thread->stats.AddBytes(bytes);
+  }
+
   void ReadSequential(ThreadState* thread) {
-    Iterator* iter = db_->NewIterator(ReadOptions());
+    ReadOptions options;
+    options.readahead_size = readahead_size_;
+    Iterator* iter = db_->NewIterator(options);
     int i = 0;
     int64_t bytes = 0;
     for (iter->SeekToFirst(); i < reads_ && iter->Valid(); iter->Next()) {
@@ -811,6 +1159,37 @@ class Benchmark {
     thread->stats.AddMessage(msg);
   }
 
+  void MultiReadRandom(ThreadState* thread) {
+    ReadOptions options;
+    options.multiget_threads = FLAGS_multiget_threads;
+    const int batch_size = std::max(FLAGS_multiget_batch_size, 1);
+    std::vector<std::string> key_data(batch_size);
+    std::vector<Slice> keys;
+    std::vector<std::string> values;
+    int found = 0;
+    for (int i = 0; i < reads_; i += batch_size) {
+      const int n = std::min(batch_size, reads_ - i);
+      keys.clear();
+      for (int j = 0; j < n; j++) {
+        char key[100];
+        const int k = thread->rand.Next() % FLAGS_num;
+        snprintf(key, sizeof(key), "%016d", k);
+        key_data[j] = key;
+        keys.push_back(key_data[j]);
+      }
+      std::vector<Status> s = db_->MultiGet(options, keys, &values);
+      for (int j = 0; j < n; j++) {
+        if (s[j].ok()) {
+          found++;
+        }
+        thread->stats.FinishedSingleOp();
+      }
+    }
+    char msg[100];
+    snprintf(msg, sizeof(msg), "(%d of %d found)", found, num_);
+    thread->stats.AddMessage(msg);
+  }
+
   void ReadMissing(ThreadState* thread) {
     ReadOptions options;
     std::string value;
@@ -883,6 +1262,24 @@ class Benchmark {
     DoDelete(thread, false);
   }
 
+  void DeleteRange(ThreadState* thread) {
+    static const int kKeysPerRange = 1000;
+    Status s;
+    for (int i = 0; i < num_; i += kKeysPerRange) {
+      char begin[100], end[100];
+      snprintf(begin, sizeof(begin), "%016d", i);
+      snprintf(end, sizeof(end), "%016d", i + kKeysPerRange);
+      s = db_->DeleteRange(write_options_, begin, end);
+      if (!s.ok()) {
+        fprintf(stderr, "delrange error: %s\n", s.ToString().c_str());
+        exit(1);
+      }
+      for (int j = i; j < i + kKeysPerRange && j < num_; j++) {
+        thread->stats.FinishedSingleOp();
+      }
+    }
+  }
+
   void ReadWhileWriting(ThreadState* thread) {
     if (thread->tid > 0) {
       ReadRandom(thread);
@@ -917,6 +1314,199 @@ class Benchmark {
     db_->CompactRange(nullptr, nullptr);
   }
 
+  // Run fillrandom on a fresh database for each subcompaction thread count
+  // and report how long writes were stalled waiting for compactions.
+  void SubcompactionSweep(int num_threads) {
+    if (FLAGS_use_existing_db) {
+      fprintf(stdout, "%-12s : skipped (--use_existing_db is true)\n",
+              "subcompactions");
+      return;
+    }
+    static const int kSubcompactions[] = { 1, 2, 4, 8 };
+    for (size_t i = 0; i < sizeof(kSubcompactions) / sizeof(int); i++) {
+      delete db_;
+      db_ = nullptr;
+      DestroyDB(FLAGS_db, Options());
+      max_subcompactions_ = kSubcompactions[i];
+      Open();
+
+      char name[100];
+      snprintf(name, sizeof(name), "fillrandom/%d", max_subcompactions_);
+      RunBenchmark(num_threads, name, &Benchmark::WriteRandom);
+
+      std::string stall;
+      if (!db_->GetProperty("leveldb.write-stall-micros", &stall)) {
+        stall = "0";
+      }
+      fprintf(stdout, "%-12s : %11.3f seconds of write stalls\n",
+              name, strtoull(stall.c_str(), nullptr, 10) * 1e-6);
+    }
+    max_subcompactions_ = FLAGS_max_subcompactions;
+  }
+
+  // Run fillrandom with pipelined writes on a fresh database, once with
+  // the group leader inserting every batch into the memtable and once
+  // with every writer inserting its own batch.  Use --threads to set the
+  // number of writers.
+  void ConcurrentMemtableWriteSweep(int num_threads) {
+    if (FLAGS_use_existing_db) {
+      fprintf(stdout, "%-12s : skipped (--use_existing_db is true)\n",
+              "fillrandom_concurrent");
+      return;
+    }
+    for (int concurrent = 0; concurrent <= 1; concurrent++) {
+      delete db_;
+      db_ = nullptr;
+      DestroyDB(FLAGS_db, Options());
+      enable_pipelined_write_ = true;
+      allow_concurrent_memtable_write_ = concurrent;
+      Open();
+
+      RunBenchmark(num_threads,
+                   concurrent ? "fillrandom/concurrent" : "fillrandom/serial",
+                   &Benchmark::WriteRandom);
+    }
+    enable_pipelined_write_ = FLAGS_enable_pipelined_write;
+    allow_concurrent_memtable_write_ = FLAGS_allow_concurrent_memtable_write;
+  }
+
+  // Load a fresh database and compact it, once without and once with
+  // data block hash indexes, and run readrandom against each.
+  void BlockHashSweep(int num_threads) {
+    if (FLAGS_use_existing_db) {
+      fprintf(stdout, "%-12s : skipped (--use_existing_db is true)\n",
+              "readrandom_blockhash");
+      return;
+    }
+    for (int hash_index = 0; hash_index <= 1; hash_index++) {
+      delete db_;
+      db_ = nullptr;
+      DestroyDB(FLAGS_db, Options());
+      data_block_hash_index_ = hash_index;
+      Open();
+
+      RunBenchmark(1, hash_index ? "fillrandom/hash" : "fillrandom/plain",
+                   &Benchmark::WriteRandom);
+      db_->CompactRange(nullptr, nullptr);
+      RunBenchmark(num_threads,
+                   hash_index ? "readrandom/hash" : "readrandom/plain",
+                   &Benchmark::ReadRandom);
+    }
+    data_block_hash_index_ = FLAGS_data_block_hash_index;
+  }
+
+  // Load a fresh database and compact it, once with whole and once with
+  // partitioned index and filter blocks, and run readrandom against each.
+  void PartitionedIndexSweep(int num_threads) {
+    if (FLAGS_use_existing_db) {
+      fprintf(stdout, "%-12s : skipped (--use_existing_db is true)\n",
+              "readrandom_partitioned");
+      return;
+    }
+    for (int partitioned = 0; partitioned <= 1; partitioned++) {
+      delete db_;
+      db_ = nullptr;
+      DestroyDB(FLAGS_db, Options());
+      partition_index_and_filters_ = partitioned;
+      Open();
+
+      RunBenchmark(1, partitioned ? "fillrandom/partitioned"
+                                  : "fillrandom/whole",
+                   &Benchmark::WriteRandom);
+      db_->CompactRange(nullptr, nullptr);
+      RunBenchmark(num_threads,
+                   partitioned ? "readrandom/partitioned" : "readrandom/whole",
+                   &Benchmark::ReadRandom);
+    }
+    partition_index_and_filters_ = FLAGS_partition_index_and_filters;
+  }
+
+  // Load a fresh database and run readwhilewriting against it, once
+  // without and once with a rate limit on flush and compaction writes.
+  // Reads are always reported with their latency percentiles.
+  void RateLimitSweep(int num_threads) {
+    if (FLAGS_use_existing_db) {
+      fprintf(stdout, "%-12s : skipped (--use_existing_db is true)\n",
+              "readwhilewriting_ratelimited");
+      return;
+    }
+    const int mb_per_sec =
+        FLAGS_rate_limit_mb_per_sec > 0 ? FLAGS_rate_limit_mb_per_sec : 8;
+    RateLimiter* limiter =
+        NewRateLimiter(static_cast<int64_t>(mb_per_sec) << 20);
+    RateLimiter* const saved_limiter = rate_limiter_;
+    const bool saved_histogram = FLAGS_histogram;
+    FLAGS_histogram = true;
+    for (int limited = 0; limited <= 1; limited++) {
+      delete db_;
+      db_ = nullptr;
+      DestroyDB(FLAGS_db, Options());
+      rate_limiter_ = limited ? limiter : nullptr;
+      Open();
+
+      RunBenchmark(1, limited ? "fillrandom/limited" : "fillrandom/unlimited",
+                   &Benchmark::WriteRandom);
+      // One extra thread for writing, as in readwhilewriting.
+      const char* name = limited ? "readwhilewriting/limited"
+                                 : "readwhilewriting/unlimited";
+      RunBenchmark(num_threads + 1, name, &Benchmark::ReadWhileWriting);
+
+      std::string stall;
+      if (!db_->GetProperty("leveldb.write-stall-micros", &stall)) {
+        stall = "0";
+      }
+      fprintf(stdout, "%-12s : %11.3f seconds of write stalls\n",
+              name, strtoull(stall.c_str(), nullptr, 10) * 1e-6);
+      if (limited) {
+        PrintStats("leveldb.rate-limiter");
+      }
+    }
+    FLAGS_histogram = saved_histogram;
+    delete db_;
+    db_ = nullptr;
+    delete limiter;
+    rate_limiter_ = saved_limiter;
+    Open();
+  }
+
+  // Ask the OS to drop its cached pages of every file in the database
+  // directory.  Pages that are mapped into memory are kept, so the
+  // database must be closed.
+  void DropOsCache() {
+    std::vector<std::string> files;
+    g_env->GetChildren(FLAGS_db, &files);
+    for (size_t i = 0; i < files.size(); i++) {
+      std::string fname = std::string(FLAGS_db) + "/" + files[i];
+      int fd = open(fname.c_str(), O_RDONLY);
+      if (fd >= 0) {
+#if defined(POSIX_FADV_DONTNEED)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+        close(fd);
+      }
+    }
+  }
+
+  // Reopen the database with a cold OS cache and run readseq, once
+  // without and once with readahead.
+  void ColdReadSweep(int num_threads) {
+    const size_t readahead =
+        FLAGS_readahead_size > 0 ? FLAGS_readahead_size : 256 * 1024;
+    for (int use_readahead = 0; use_readahead <= 1; use_readahead++) {
+      delete db_;
+      db_ = nullptr;
+      DropOsCache();
+      Open();
+
+      readahead_size_ = use_readahead ? readahead : 0;
+      RunBenchmark(num_threads,
+                   use_readahead ? "readseq_cold/readahead"
+                                 : "readseq_cold/plain",
+                   &Benchmark::ReadSequential);
+    }
+    readahead_size_ = FLAGS_readahead_size;
+  }
+
   void PrintStats(const char* key) {
     std::string stats;
     if (!db_->GetProperty(key, &stats)) {
@@ -954,6 +1544,12 @@ int main(int argc, char** argv) {
   FLAGS_max_file_size = leveldb::Options().max_file_size;
   FLAGS_block_size = leveldb::Options().block_size;
   FLAGS_open_files = leveldb::Options().max_open_files;
+  FLAGS_max_subcompactions = leveldb::Options().max_subcompactions;
+  FLAGS_max_background_compactions =
+      leveldb::Options().max_background_compactions;
+  FLAGS_zstd_compression_level = leveldb::Options().zstd_compression_level;
+  FLAGS_parallel_compression_threads =
+      leveldb::Options().parallel_compression_threads;
   std::string default_db_path;
 
   for (int i = 1; i < argc; i++) {
@@ -962,14 +1558,43 @@ int main(int argc, char** argv) {
     char junk;
     if (leveldb::Slice(argv[i]).starts_with("--benchmarks=")) {
       FLAGS_benchmarks = argv[i] + strlen("--benchmarks=");
+    } else if (sscanf(argv[i], "--cache_high_pri_pool_ratio=%lf%c",
+                      &d, &junk) == 1) {
+      FLAGS_cache_high_pri_pool_ratio = d;
+    } else if (sscanf(argv[i], "--clock_cache=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_clock_cache = n;
     } else if (sscanf(argv[i], "--compression_ratio=%lf%c", &d, &junk) == 1) {
       FLAGS_compression_ratio = d;
+    } else if (leveldb::Slice(argv[i]).starts_with("--compression=")) {
+      FLAGS_compression = argv[i] + strlen("--compression=");
+    } else if (leveldb::Slice(argv[i]).starts_with(
+                   "--compression_per_level=")) {
+      FLAGS_compression_per_level =
+          argv[i] + strlen("--compression_per_level=");
+    } else if (sscanf(argv[i], "--zstd_compression_level=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_zstd_compression_level = n;
+    } else if (sscanf(argv[i], "--zstd_max_dictionary_bytes=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_zstd_max_dictionary_bytes = n;
+    } else if (sscanf(argv[i], "--parallel_compression_threads=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_parallel_compression_threads = n;
     } else if (sscanf(argv[i], "--histogram=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_histogram = n;
     } else if (sscanf(argv[i], "--use_existing_db=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_use_existing_db = n;
+    } else if (sscanf(argv[i], "--enable_pipelined_write=%d%c",
+                      &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_enable_pipelined_write = n;
+    } else if (sscanf(argv[i], "--allow_concurrent_memtable_write=%d%c",
+                      &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_allow_concurrent_memtable_write = n;
     } else if (sscanf(argv[i], "--reuse_logs=%d%c", &n, &junk) == 1 &&
                (n == 0 || n == 1)) {
       FLAGS_reuse_logs = n;
@@ -989,10 +1614,60 @@ int main(int argc, char** argv) {
       FLAGS_block_size = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
+    } else if (sscanf(argv[i], "--compressed_cache_size=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_compressed_cache_size = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
+    } else if (sscanf(argv[i], "--blocked_bloom=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_blocked_bloom = n;
+    } else if (sscanf(argv[i], "--whole_table_filter=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_whole_table_filter = n;
+    } else if (sscanf(argv[i], "--hash_memtable_buckets=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_hash_memtable_buckets = n;
+    } else if (sscanf(argv[i], "--data_block_hash_index=%d%c",
+                      &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_data_block_hash_index = n;
+    } else if (sscanf(argv[i], "--partition_index_and_filters=%d%c",
+                      &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_partition_index_and_filters = n;
+    } else if (sscanf(argv[i], "--pin_top_level_index=%d%c",
+                      &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_pin_top_level_index = n;
+    } else if (sscanf(argv[i], "--use_direct_reads=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_use_direct_reads = n;
+    } else if (sscanf(argv[i], "--use_direct_io_for_flush_and_compaction=%d%c",
+                      &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_use_direct_io_for_flush_and_compaction = n;
+    } else if (sscanf(argv[i], "--rate_limit_mb_per_sec=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_rate_limit_mb_per_sec = n;
+    } else if (sscanf(argv[i], "--io_uring=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_io_uring = n;
+    } else if (sscanf(argv[i], "--readahead_size=%d%c", &n, &junk) == 1) {
+      FLAGS_readahead_size = n;
+    } else if (sscanf(argv[i], "--multiget_batch_size=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_multiget_batch_size = n;
+    } else if (sscanf(argv[i], "--multiget_threads=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_multiget_threads = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
+    } else if (sscanf(argv[i], "--max_subcompactions=%d%c", &n, &junk) == 1) {
+      FLAGS_max_subcompactions = n;
+    } else if (sscanf(argv[i], "--max_background_compactions=%d%c",
+                      &n, &junk) == 1) {
+      FLAGS_max_background_compactions = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
       FLAGS_db = argv[i] + 5;
     } else {
@@ -1001,7 +1676,22 @@ int main(int argc, char** argv) {
     }
   }
 
+  std::vector<leveldb::CompressionType> types;
+  if (!leveldb::ParseCompressionTypes(FLAGS_compression, &types) ||
+      types.size() != 1) {
+    fprintf(stderr, "Invalid --compression '%s'\n", FLAGS_compression);
+    exit(1);
+  }
+  if (!leveldb::ParseCompressionTypes(FLAGS_compression_per_level, &types)) {
+    fprintf(stderr, "Invalid --compression_per_level '%s'\n",
+            FLAGS_compression_per_level);
+    exit(1);
+  }
+
   leveldb::g_env = leveldb::Env::Default();
+  if (FLAGS_io_uring) {
+    leveldb::g_env = leveldb::NewIoUringEnv(leveldb::g_env);
+  }
 
   // Choose a location for the test database if none given with --db=<path>
   if (FLAGS_db == nullptr) {
@@ -19,6 +19,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstones.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
@@ -34,6 +35,8 @@
 #include "util/coding.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/rate_limiter.h"
+#include "util/thread_pool.h"
 
 namespace leveldb {
 
@@ -47,7 +50,29 @@ struct DBImpl::Writer {
   bool done;
   port::CondVar cv;
 
-  explicit Writer(port::Mutex* mu) : cv(mu) { }
+  // Set by IngestExternalFile(), which needs the front of the queue to
+  // itself instead of joining a write group.
+  bool exclusive;
+
+  // Used by pipelined writes.  The leader of a write group keeps the
+  // writers of its group and the last sequence number they were assigned
+  // while the group waits for its turn to update the memtable.  "grouped"
+  // is set on the other writers of the group once the leader has taken
+  // them off writers_.
+  std::vector<Writer*> group;
+  SequenceNumber last_sequence;
+  bool grouped;
+
+  // Used by concurrent memtable writes.  The leader hands each follower
+  // the memtable to insert its own batch into, and counts the inserts
+  // that have not finished yet.
+  MemTable* memtable;
+  Writer* leader;
+  int pending_inserts;
+
+  explicit Writer(port::Mutex* mu)
+      : cv(mu), exclusive(false), last_sequence(0), grouped(false),
+        memtable(nullptr), leader(nullptr), pending_inserts(0) { }
 };
 
 struct DBImpl::CompactionState {
@@ -64,6 +89,7 @@ struct DBImpl::CompactionState {
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    bool has_range_deletions;
   };
   std::vector<Output> outputs;
 
@@ -73,16 +99,45 @@ struct DBImpl::CompactionState {
 
   uint64_t total_bytes;
 
+  // Only user keys in [start, limit) are compacted by this state.  A
+  // compaction that is split into subcompactions uses one state per
+  // disjoint key range.  has_start/has_limit are false for a range that
+  // is unbounded on that side.
+  bool has_start;
+  bool has_limit;
+  std::string start;
+  std::string limit;
+
+  // The range deletions of the compaction inputs, shared by all the key
+  // ranges of the compaction, or nullptr if there are none.
+  const RangeTombstones* range_deletions;
+
+  // Position of this key range in the grandparent and base level files
+  Compaction::Progress progress;
+
+  // Set when a subcompaction running on its own thread has finished
+  bool done;
+  Status status;
+
   Output* current_output() { return &outputs[outputs.size()-1]; }
 
   explicit CompactionState(Compaction* c)
       : compaction(c),
         outfile(nullptr),
         builder(nullptr),
-        total_bytes(0) {
+        total_bytes(0),
+        has_start(false),
+        has_limit(false),
+        range_deletions(nullptr),
+        done(false) {
   }
 };
 
+struct DBImpl::SubcompactionArg {
+  DBImpl* db;
+  CompactionState* state;
+};
+
 // Fix user-supplied options to be reasonable
 template <class T, class V>
 static void ClipToRange(T* ptr, V minvalue, V maxvalue) {
@@ -100,6 +155,9 @@ Options SanitizeOptions(const std::string& dbname,
   ClipToRange(&result.write_buffer_size, 64<<10,                      1<<30);
   ClipToRange(&result.max_file_size,     1<<20,                       1<<30);
   ClipToRange(&result.block_size,        1<<10,                       4<<20);
+  ClipToRange(&result.max_subcompactions, 1,                          64);
+  ClipToRange(&result.max_background_compactions, 1,                  64);
+  ClipToRange(&result.parallel_compression_threads, 1,                64);
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -124,13 +182,18 @@ static int TableCacheSize(const Options& sanitized_options) {
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
-      internal_filter_policy_(raw_options.filter_policy),
+      internal_filter_policy_(raw_options.filter_policy,
+                              raw_options.prefix_extractor),
       options_(SanitizeOptions(dbname, &internal_comparator_,
                                &internal_filter_policy_, raw_options)),
       owns_info_log_(options_.info_log != raw_options.info_log),
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
       table_cache_(new TableCache(dbname_, options_, TableCacheSize(options_))),
+      compaction_pool_(new ThreadPool(env_)),
+      subcompaction_pool_(new ThreadPool(env_)),
+      multiget_pool_(new ThreadPool(env_)),
+      compression_pool_(new ThreadPool(env_)),
       db_lock_(nullptr),
       shutting_down_(nullptr),
       background_work_finished_signal_(&mutex_),
@@ -141,10 +204,15 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       log_(nullptr),
       seed_(0),
       tmp_batch_(new WriteBatch),
-      background_compaction_scheduled_(false),
+      compacting_memtable_(false),
+      writing_manifest_(false),
+      pending_manifest_writes_(0),
+      background_compactions_scheduled_(0),
       manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
-                               &internal_comparator_)) {
+                               &internal_comparator_)),
+      write_stall_micros_(0),
+      subcompactions_run_(0) {
   has_imm_.Release_Store(nullptr);
 }
 
@@ -152,10 +220,11 @@ DBImpl::~DBImpl() {
   // Wait for background work to finish
   mutex_.Lock();
   shutting_down_.Release_Store(this);  // Any non-null value is ok
-  while (background_compaction_scheduled_) {
+  while (background_compactions_scheduled_ > 0) {
     background_work_finished_signal_.Wait();
   }
   mutex_.Unlock();
+  delete compaction_pool_;  // Joins the threads of the finished compactions
 
   if (db_lock_ != nullptr) {
     env_->UnlockFile(db_lock_);
@@ -168,6 +237,9 @@ DBImpl::~DBImpl() {
   delete log_;
   delete logfile_;
   delete table_cache_;
+  delete subcompaction_pool_;
+  delete multiget_pool_;
+  delete compression_pool_;
 
   if (owns_info_log_) {
     delete options_.info_log;
@@ -226,6 +298,11 @@ void DBImpl::DeleteObsoleteFiles() {
     // or may not have been committed, so we cannot safely garbage collect.
     return;
   }
+  if (pending_manifest_writes_ > 0) {
+    // An edit waiting in LogAndApply() may add files that are not part
+    // of any version yet.  The thread applying it collects garbage later.
+    return;
+  }
 
   // Make a set of all of the live files
   std::set<uint64_t> live = pending_outputs_;
@@ -425,7 +502,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     WriteBatchInternal::SetContents(&batch, record);
 
     if (mem == nullptr) {
-      mem = new MemTable(internal_comparator_);
+      mem = new MemTable(internal_comparator_, options_.memtable_factory);
       mem->Ref();
     }
     status = WriteBatchInternal::InsertInto(&batch, mem);
@@ -472,7 +549,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
         mem = nullptr;
       } else {
         // mem can be nullptr if lognum exists but was empty.
-        mem_ = new MemTable(internal_comparator_);
+        mem_ = new MemTable(internal_comparator_, options_.memtable_factory);
         mem_->Ref();
       }
     }
@@ -504,7 +581,10 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   Status s;
   {
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    RangeTombstones range_deletions(user_comparator());
+    mem->GetRangeTombstones(&range_deletions);
+    s = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                   &range_deletions, &meta, compression_pool_);
     mutex_.Lock();
   }
 
@@ -524,9 +604,15 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     const Slice max_user_key = meta.largest.user_key();
     if (base != nullptr) {
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
+      // Keep out of levels that a running compaction writes to.  The
+      // table does not overlap any level it was pushed past, so moving
+      // it back up is always safe.
+      while (level > 0 && versions_->LevelBeingCompacted(level)) {
+        level--;
+      }
     }
     edit->AddFile(level, meta.number, meta.file_size,
-                  meta.smallest, meta.largest);
+                  meta.smallest, meta.largest, 0, meta.has_range_deletions);
   }
 
   CompactionStats stats;
@@ -539,6 +625,8 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
 void DBImpl::CompactMemTable() {
   mutex_.AssertHeld();
   assert(imm_ != nullptr);
+  assert(!compacting_memtable_);
+  compacting_memtable_ = true;
 
   // Save the contents of the memtable as a new Table
   VersionEdit edit;
@@ -555,7 +643,7 @@ void DBImpl::CompactMemTable() {
   if (s.ok()) {
     edit.SetPrevLogNumber(0);
     edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
-    s = versions_->LogAndApply(&edit, &mutex_);
+    s = LogAndApply(&edit);
   }
 
   if (s.ok()) {
@@ -567,6 +655,23 @@ void DBImpl::CompactMemTable() {
   } else {
     RecordBackgroundError(s);
   }
+  compacting_memtable_ = false;
+}
+
+Status DBImpl::LogAndApply(VersionEdit* edit) {
+  mutex_.AssertHeld();
+  // VersionSet::LogAndApply() releases mutex_ while it writes to the
+  // MANIFEST, so concurrent compactions have to take turns.
+  pending_manifest_writes_++;
+  while (writing_manifest_) {
+    background_work_finished_signal_.Wait();
+  }
+  writing_manifest_ = true;
+  Status s = versions_->LogAndApply(edit, &mutex_);
+  writing_manifest_ = false;
+  pending_manifest_writes_--;
+  background_work_finished_signal_.SignalAll();
+  return s;
 }
 
 void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
@@ -596,6 +701,7 @@ void DBImpl::TEST_CompactRange(int level, const Slice* begin,
   ManualCompaction manual;
   manual.level = level;
   manual.done = false;
+  manual.in_progress = false;
   if (begin == nullptr) {
     manual.begin = nullptr;
   } else {
@@ -618,6 +724,10 @@ void DBImpl::TEST_CompactRange(int level, const Slice* begin,
       background_work_finished_signal_.Wait();
     }
   }
+  while (manual.in_progress) {
+    // A background thread is still working on my compaction.
+    background_work_finished_signal_.Wait();
+  }
   if (manual_compaction_ == &manual) {
     // Cancel my manual compaction since we aborted early for some reason.
     manual_compaction_ = nullptr;
@@ -648,21 +758,42 @@ void DBImpl::RecordBackgroundError(const Status& s) {
   }
 }
 
+bool DBImpl::HasBackgroundWork() {
+  mutex_.AssertHeld();
+  if (imm_ != nullptr && !compacting_memtable_) {
+    return true;
+  }
+  const ManualCompaction* m = manual_compaction_;
+  if (m != nullptr && !m->in_progress) {
+    // No automatic compactions are started while a manual compaction
+    // is waiting for its levels to become free.
+    return (!versions_->LevelBeingCompacted(m->level) &&
+            !versions_->LevelBeingCompacted(m->level + 1));
+  }
+  return versions_->NeedsCompaction();
+}
+
 void DBImpl::MaybeScheduleCompaction() {
   mutex_.AssertHeld();
-  if (background_compaction_scheduled_) {
-    // Already scheduled
+  if (background_compactions_scheduled_ >=
+      options_.max_background_compactions) {
+    // Already scheduled as many as allowed
   } else if (shutting_down_.Acquire_Load()) {
     // DB is being deleted; no more background compactions
   } else if (!bg_error_.ok()) {
     // Already got an error; no more changes
-  } else if (imm_ == nullptr &&
-             manual_compaction_ == nullptr &&
-             !versions_->NeedsCompaction()) {
+  } else if (!HasBackgroundWork()) {
     // No work to be done
   } else {
-    background_compaction_scheduled_ = true;
-    env_->Schedule(&DBImpl::BGWork, this);
+    background_compactions_scheduled_++;
+    if (background_compactions_scheduled_ == 1) {
+      env_->Schedule(&DBImpl::BGWork, this);
+    } else {
+      // Env::Schedule() may run its work items one at a time, so the
+      // concurrent compactions run on compaction_pool_ instead.
+      compaction_pool_->EnsureThreads(options_.max_background_compactions - 1);
+      compaction_pool_->Schedule(&DBImpl::BGWork, this);
+    }
   }
 }
 
@@ -672,7 +803,7 @@ void DBImpl::BGWork(void* db) {
 
 void DBImpl::BackgroundCall() {
   MutexLock l(&mutex_);
-  assert(background_compaction_scheduled_);
+  assert(background_compactions_scheduled_ > 0);
   if (shutting_down_.Acquire_Load()) {
     // No more background work when shutting down.
   } else if (!bg_error_.ok()) {
@@ -681,7 +812,7 @@ void DBImpl::BackgroundCall() {
     BackgroundCompaction();
   }
 
-  background_compaction_scheduled_ = false;
+  background_compactions_scheduled_--;
 
   // Previous compaction may have produced too many files in a level,
   // so reschedule another compaction if needed.
@@ -692,16 +823,22 @@ void DBImpl::BackgroundCall() {
 void DBImpl::BackgroundCompaction() {
   mutex_.AssertHeld();
 
-  if (imm_ != nullptr) {
+  if (imm_ != nullptr && !compacting_memtable_) {
     CompactMemTable();
     return;
   }
 
   Compaction* c;
-  bool is_manual = (manual_compaction_ != nullptr);
+  ManualCompaction* m = manual_compaction_;
+  bool is_manual = (m != nullptr && !m->in_progress);
   InternalKey manual_end;
   if (is_manual) {
-    ManualCompaction* m = manual_compaction_;
+    if (versions_->LevelBeingCompacted(m->level) ||
+        versions_->LevelBeingCompacted(m->level + 1)) {
+      // Rescheduled once the conflicting compaction has finished
+      return;
+    }
+    m->in_progress = true;
     c = versions_->CompactRange(m->level, m->begin, m->end);
     m->done = (c == nullptr);
     if (c != nullptr) {
@@ -717,6 +854,12 @@ void DBImpl::BackgroundCompaction() {
     c = versions_->PickCompaction();
   }
 
+  if (c != nullptr) {
+    // The levels of "c" are now reserved; other levels may be compacted
+    // by another thread at the same time.
+    MaybeScheduleCompaction();
+  }
+
   Status status;
   if (c == nullptr) {
     // Nothing to do
@@ -726,8 +869,9 @@ void DBImpl::BackgroundCompaction() {
     FileMetaData* f = c->input(0, 0);
     c->edit()->DeleteFile(c->level(), f->number);
     c->edit()->AddFile(c->level() + 1, f->number, f->file_size,
-                       f->smallest, f->largest);
-    status = versions_->LogAndApply(c->edit(), &mutex_);
+                       f->smallest, f->largest, f->global_sequence,
+                       f->has_range_deletions);
+    status = LogAndApply(c->edit());
     if (!status.ok()) {
       RecordBackgroundError(status);
     }
@@ -760,7 +904,7 @@ void DBImpl::BackgroundCompaction() {
   }
 
   if (is_manual) {
-    ManualCompaction* m = manual_compaction_;
+    m->in_progress = false;
     if (!status.ok()) {
       m->done = true;
     }
@@ -803,15 +947,32 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
     out.number = file_number;
     out.smallest.Clear();
     out.largest.Clear();
+    out.has_range_deletions = false;
     compact->outputs.push_back(out);
     mutex_.Unlock();
   }
 
   // Make the output file
   std::string fname = TableFileName(dbname_, file_number);
-  Status s = env_->NewWritableFile(fname, &compact->outfile);
+  Status s;
+  if (options_.use_direct_io_for_flush_and_compaction) {
+    s = env_->NewDirectWritableFile(fname, &compact->outfile);
+  } else {
+    s = env_->NewWritableFile(fname, &compact->outfile);
+  }
+  if (s.ok() && options_.rate_limiter != nullptr) {
+    // Level-0 compactions are what writes stall on.
+    compact->outfile = NewRateLimitedWritableFile(
+        compact->outfile, options_.rate_limiter,
+        compact->compaction->level() == 0 ? RateLimiter::kHigh
+                                          : RateLimiter::kLow);
+  }
   if (s.ok()) {
-    compact->builder = new TableBuilder(options_, compact->outfile);
+    Options table_options = options_;
+    table_options.compression =
+        CompressionForLevel(options_, compact->compaction->level() + 1);
+    compact->builder = new TableBuilder(table_options, compact->outfile,
+                                        compression_pool_);
   }
   return s;
 }
@@ -849,11 +1010,12 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   delete compact->outfile;
   compact->outfile = nullptr;
 
-  if (s.ok() && current_entries > 0) {
+  if (s.ok() &&
+      (current_entries > 0 || compact->current_output()->has_range_deletions)) {
     // Verify that the table is usable
-    Iterator* iter = table_cache_->NewIterator(ReadOptions(),
-                                               output_number,
-                                               current_bytes);
+    Iterator* iter = table_cache_->NewIterator(
+        ReadOptions(), output_number, current_bytes,
+        compact->compaction->level() + 1, 0);
     s = iter->status();
     delete iter;
     if (s.ok()) {
@@ -868,6 +1030,53 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   return s;
 }
 
+Status DBImpl::AddRangeDeletionsToOutput(CompactionState* compact,
+                                         const Slice* lower,
+                                         const Slice* upper) {
+  std::vector<RangeTombstones::Fragment> fragments;
+  compact->range_deletions->GetFragments(lower, upper, &fragments);
+
+  // Of the deletions that every snapshot sees, only the newest matters,
+  // and not even that one if no older data can exist below the output.
+  size_t kept = 0;
+  for (size_t i = 0; i < fragments.size(); i++) {
+    RangeTombstones::Fragment* f = &fragments[i];
+    size_t n = 0;
+    while (n < f->sequences.size() &&
+           f->sequences[n] > compact->smallest_snapshot) {
+      n++;
+    }
+    if (n < f->sequences.size() &&
+        !compact->compaction->IsBaseLevelForRange(f->start, f->end)) {
+      n++;
+    }
+    f->sequences.resize(n);
+    if (n > 0) {
+      if (kept != i) {
+        fragments[kept].start.swap(f->start);
+        fragments[kept].end.swap(f->end);
+        fragments[kept].sequences.swap(f->sequences);
+      }
+      kept++;
+    }
+  }
+  fragments.resize(kept);
+  if (fragments.empty()) {
+    return Status::OK();
+  }
+
+  if (compact->builder == nullptr) {
+    Status s = OpenCompactionOutputFile(compact);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  CompactionState::Output* out = compact->current_output();
+  AddRangeDeletionsToTable(internal_comparator_, fragments, compact->builder,
+                           &out->smallest, &out->largest);
+  out->has_range_deletions = true;
+  return Status::OK();
+}
 
 Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   mutex_.AssertHeld();
@@ -885,9 +1094,10 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
     const CompactionState::Output& out = compact->outputs[i];
     compact->compaction->edit()->AddFile(
         level + 1,
-        out.number, out.file_size, out.smallest, out.largest);
+        out.number, out.file_size, out.smallest, out.largest, 0,
+        out.has_range_deletions);
   }
-  return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+  return LogAndApply(compact->compaction->edit());
 }
 
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
@@ -909,37 +1119,176 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
   }
 
+  // Split the compaction into disjoint key ranges.  This thread handles
+  // the first range; the others go to subcompaction_pool_, which has a
+  // thread for each of them even when every background compaction is
+  // split at the same time.
+  std::vector<std::string> boundaries;
+  compact->compaction->GetSubcompactionBoundaries(options_.max_subcompactions,
+                                                  &boundaries);
+  std::vector<CompactionState*> subcompactions;
+  for (size_t i = 0; i < boundaries.size(); i++) {
+    CompactionState* sub = new CompactionState(compact->compaction);
+    sub->smallest_snapshot = compact->smallest_snapshot;
+    sub->has_start = true;
+    sub->start = boundaries[i];
+    if (i + 1 < boundaries.size()) {
+      sub->has_limit = true;
+      sub->limit = boundaries[i + 1];
+    }
+    subcompactions.push_back(sub);
+  }
+  if (!boundaries.empty()) {
+    compact->has_limit = true;
+    compact->limit = boundaries[0];
+    Log(options_.info_log, "Compaction split into %d subcompactions",
+        static_cast<int>(boundaries.size() + 1));
+    subcompaction_pool_->EnsureThreads(
+        (options_.max_subcompactions - 1) *
+        options_.max_background_compactions);
+    subcompactions_run_ += boundaries.size();
+  }
+
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
+  // Every key range needs the range deletions of all the inputs, since
+  // the inputs are not split at the range boundaries.
+  RangeTombstones range_deletions(user_comparator());
+  Status status = versions_->AddInputRangeDeletions(compact->compaction,
+                                                    &range_deletions);
+  if (status.ok() && !range_deletions.empty()) {
+    compact->range_deletions = &range_deletions;
+    for (size_t i = 0; i < subcompactions.size(); i++) {
+      subcompactions[i]->range_deletions = &range_deletions;
+    }
+  }
+
+  std::vector<SubcompactionArg> args(subcompactions.size());
+  for (size_t i = 0; i < subcompactions.size(); i++) {
+    if (status.ok()) {
+      args[i].db = this;
+      args[i].state = subcompactions[i];
+      subcompaction_pool_->Schedule(&DBImpl::BGSubcompaction, &args[i]);
+    } else {
+      subcompactions[i]->done = true;
+    }
+  }
+
+  if (status.ok()) {
+    status = CompactRangeOfInputs(compact, &imm_micros);
+  }
+
+  mutex_.Lock();
+  for (size_t i = 0; i < subcompactions.size(); i++) {
+    CompactionState* sub = subcompactions[i];
+    while (!sub->done) {
+      background_work_finished_signal_.Wait();
+    }
+    if (status.ok()) {
+      status = sub->status;
+    }
+
+    // Hand the subcompaction's files over to the main state, which
+    // installs them (or releases them from pending_outputs_ on failure).
+    if (sub->builder != nullptr) {
+      sub->builder->Abandon();
+      delete sub->builder;
+    }
+    delete sub->outfile;
+    compact->outputs.insert(compact->outputs.end(),
+                            sub->outputs.begin(), sub->outputs.end());
+    compact->total_bytes += sub->total_bytes;
+    delete sub;
+  }
+
+  CompactionStats stats;
+  stats.micros = env_->NowMicros() - start_micros - imm_micros;
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+      stats.bytes_read += compact->compaction->input(which, i)->file_size;
+    }
+  }
+  for (size_t i = 0; i < compact->outputs.size(); i++) {
+    stats.bytes_written += compact->outputs[i].file_size;
+  }
+
+  stats_[compact->compaction->level() + 1].Add(stats);
+
+  if (status.ok()) {
+    status = InstallCompactionResults(compact);
+  }
+  if (!status.ok()) {
+    RecordBackgroundError(status);
+  }
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log,
+      "compacted to: %s", versions_->LevelSummary(&tmp));
+  return status;
+}
+
+void DBImpl::BGSubcompaction(void* arg) {
+  SubcompactionArg* sub = reinterpret_cast<SubcompactionArg*>(arg);
+  DBImpl* db = sub->db;
+  CompactionState* compact = sub->state;
+  Status s = db->CompactRangeOfInputs(compact, nullptr);
+
+  MutexLock l(&db->mutex_);
+  compact->status = s;
+  compact->done = true;
+  db->background_work_finished_signal_.SignalAll();
+}
+
+Status DBImpl::CompactRangeOfInputs(CompactionState* compact,
+                                    int64_t* imm_micros) {
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
-  input->SeekToFirst();
+  if (compact->has_start) {
+    InternalKey start(compact->start, kMaxSequenceNumber, kValueTypeForSeek);
+    input->Seek(start.Encode());
+  } else {
+    input->SeekToFirst();
+  }
   Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
+  const RangeTombstones* range_deletions = compact->range_deletions;
+
+  // The current output is closed before the next key that is kept, so
+  // that it gets the range deletions up to that key.  With range
+  // deletions, all the entries of a user key go to the same output.
+  bool close_output = false;
+  std::string output_lower;  // Where the range deletions of the output start
+  bool has_output_lower = compact->has_start;
+  if (compact->has_start) {
+    output_lower = compact->start;
+  }
   for (; input->Valid() && !shutting_down_.Acquire_Load(); ) {
     // Prioritize immutable compaction work
-    if (has_imm_.NoBarrier_Load() != nullptr) {
+    if (imm_micros != nullptr && has_imm_.NoBarrier_Load() != nullptr) {
       const uint64_t imm_start = env_->NowMicros();
       mutex_.Lock();
-      if (imm_ != nullptr) {
+      if (imm_ != nullptr && !compacting_memtable_) {
         CompactMemTable();
         // Wake up MakeRoomForWrite() if necessary.
         background_work_finished_signal_.SignalAll();
       }
       mutex_.Unlock();
-      imm_micros += (env_->NowMicros() - imm_start);
+      *imm_micros += (env_->NowMicros() - imm_start);
     }
 
     Slice key = input->key();
-    if (compact->compaction->ShouldStopBefore(key) &&
+    if (compact->has_limit && ParseInternalKey(key, &ikey) &&
+        user_comparator()->Compare(ikey.user_key,
+                                   Slice(compact->limit)) >= 0) {
+      // The rest of the input belongs to another subcompaction
+      break;
+    }
+
+    if (compact->compaction->ShouldStopBefore(key, &compact->progress) &&
         compact->builder != nullptr) {
-      status = FinishCompactionOutputFile(compact, input);
-      if (!status.ok()) {
-        break;
-      }
+      close_output = true;
     }
 
     // Handle key/value, add to state, etc.
@@ -964,7 +1313,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         drop = true;    // (A)
       } else if (ikey.type == kTypeDeletion &&
                  ikey.sequence <= compact->smallest_snapshot &&
-                 compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+                 compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                                        &compact->progress)) {
         // For this user key:
         // (1) there is no data in higher levels
         // (2) data in lower levels will have larger sequence numbers
@@ -973,6 +1323,12 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         //     few iterations of this loop (by rule (A) above).
         // Therefore this deletion marker is obsolete and can be dropped.
         drop = true;
+      } else if (range_deletions != nullptr &&
+                 range_deletions->MaxCoveringSequence(
+                     ikey.user_key, compact->smallest_snapshot) >
+                     ikey.sequence) {
+        // Hidden by a range deletion that every snapshot sees
+        drop = true;
       }
 
       last_sequence_for_key = ikey.sequence;
@@ -983,11 +1339,35 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         "%d smallest_snapshot: %d",
         ikey.user_key.ToString().c_str(),
         (int)ikey.sequence, ikey.type, kTypeValue, drop,
-        compact->compaction->IsBaseLevelForKey(ikey.user_key),
+        compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                               &compact->progress),
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
     if (!drop) {
+      if (close_output &&
+          (range_deletions == nullptr ||
+           (has_current_user_key &&
+            user_comparator()->Compare(
+                current_user_key,
+                compact->current_output()->largest.user_key()) != 0))) {
+        if (range_deletions != nullptr) {
+          Slice upper(current_user_key);
+          Slice lower(output_lower);
+          status = AddRangeDeletionsToOutput(
+              compact, has_output_lower ? &lower : nullptr, &upper);
+          output_lower = current_user_key;
+          has_output_lower = true;
+        }
+        if (status.ok()) {
+          status = FinishCompactionOutputFile(compact, input);
+        }
+        close_output = false;
+        if (!status.ok()) {
+          break;
+        }
+      }
+
       // Open output file if necessary
       if (compact->builder == nullptr) {
         status = OpenCompactionOutputFile(compact);
@@ -1004,10 +1384,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
       // Close output file if it is big enough
       if (compact->builder->FileSize() >=
           compact->compaction->MaxOutputFileSize()) {
-        status = FinishCompactionOutputFile(compact, input);
-        if (!status.ok()) {
-          break;
-        }
+        close_output = true;
       }
     }
 
@@ -1017,6 +1394,13 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   if (status.ok() && shutting_down_.Acquire_Load()) {
     status = Status::IOError("Deleting DB during compaction");
   }
+  if (status.ok() && range_deletions != nullptr) {
+    Slice lower(output_lower);
+    Slice upper(compact->limit);
+    status = AddRangeDeletionsToOutput(
+        compact, has_output_lower ? &lower : nullptr,
+        compact->has_limit ? &upper : nullptr);
+  }
   if (status.ok() && compact->builder != nullptr) {
     status = FinishCompactionOutputFile(compact, input);
   }
@@ -1024,31 +1408,6 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     status = input->status();
   }
   delete input;
-  input = nullptr;
-
-  CompactionStats stats;
-  stats.micros = env_->NowMicros() - start_micros - imm_micros;
-  for (int which = 0; which < 2; which++) {
-    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
-      stats.bytes_read += compact->compaction->input(which, i)->file_size;
-    }
-  }
-  for (size_t i = 0; i < compact->outputs.size(); i++) {
-    stats.bytes_written += compact->outputs[i].file_size;
-  }
-
-  mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
-
-  if (status.ok()) {
-    status = InstallCompactionResults(compact);
-  }
-  if (!status.ok()) {
-    RecordBackgroundError(status);
-  }
-  VersionSet::LevelSummaryStorage tmp;
-  Log(options_.info_log,
-      "compacted to: %s", versions_->LevelSummary(&tmp));
   return status;
 }
 
@@ -1060,6 +1419,13 @@ struct IterState {
   MemTable* const mem GUARDED_BY(mu);
   MemTable* const imm GUARDED_BY(mu);
 
+  // The iterate bounds as internal keys, which is what the tables
+  // compare them with
+  InternalKey lower_bound;
+  InternalKey upper_bound;
+  Slice lower_bound_key;
+  Slice upper_bound_key;
+
   IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
       : mu(mutex), version(version), mem(mem), imm(imm) { }
 };
@@ -1076,9 +1442,10 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 
 }  // anonymous namespace
 
-Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
-                                      SequenceNumber* latest_snapshot,
-                                      uint32_t* seed) {
+Iterator* DBImpl::NewInternalIterator(
+    const ReadOptions& options, SequenceNumber* latest_snapshot,
+    uint32_t* seed, RangeTombstones** memtable_range_deletions,
+    const RangeTombstones** table_range_deletions) {
   mutex_.Lock();
   *latest_snapshot = versions_->LastSequence();
 
@@ -1090,23 +1457,62 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
     list.push_back(imm_->NewIterator());
     imm_->Ref();
   }
-  versions_->current()->AddIterators(options, &list);
+  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
+  ReadOptions table_options = options;
+  if (options.iterate_lower_bound != nullptr) {
+    // The first internal key of the bound's user key
+    cleanup->lower_bound = InternalKey(*options.iterate_lower_bound,
+                                       kMaxSequenceNumber, kValueTypeForSeek);
+    cleanup->lower_bound_key = cleanup->lower_bound.Encode();
+    table_options.iterate_lower_bound = &cleanup->lower_bound_key;
+  }
+  if (options.iterate_upper_bound != nullptr) {
+    cleanup->upper_bound = InternalKey(*options.iterate_upper_bound,
+                                       kMaxSequenceNumber, kValueTypeForSeek);
+    cleanup->upper_bound_key = cleanup->upper_bound.Encode();
+    table_options.iterate_upper_bound = &cleanup->upper_bound_key;
+  }
+  versions_->current()->AddIterators(table_options, &list);
   Iterator* internal_iter =
       NewMergingIterator(&internal_comparator_, &list[0], list.size());
   versions_->current()->Ref();
-
-  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
   internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
 
   *seed = ++seed_;
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
   mutex_.Unlock();
+
+  if (memtable_range_deletions != nullptr) {
+    // The references taken above keep the sources alive.  The deletions
+    // of the table files are read once per Version and shared by all its
+    // iterators; those of the memtables change with every write.
+    Status s = current->GetRangeDeletions(table_range_deletions);
+    if (!s.ok()) {
+      delete internal_iter;
+      *memtable_range_deletions = nullptr;
+      return NewErrorIterator(s);
+    }
+    RangeTombstones* result = new RangeTombstones(user_comparator());
+    mem->GetRangeTombstones(result);
+    if (imm != nullptr) {
+      imm->GetRangeTombstones(result);
+    }
+    if (result->empty()) {
+      delete result;
+      result = nullptr;
+    }
+    *memtable_range_deletions = result;
+  }
   return internal_iter;
 }
 
 Iterator* DBImpl::TEST_NewInternalIterator() {
   SequenceNumber ignored;
   uint32_t ignored_seed;
-  return NewInternalIterator(ReadOptions(), &ignored, &ignored_seed);
+  return NewInternalIterator(ReadOptions(), &ignored, &ignored_seed, nullptr,
+                             nullptr);
 }
 
 int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
@@ -1114,6 +1520,11 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
   return versions_->MaxNextLevelOverlappingBytes();
 }
 
+int64_t DBImpl::TEST_SubcompactionsRun() {
+  MutexLock l(&mutex_);
+  return subcompactions_run_;
+}
+
 Status DBImpl::Get(const ReadOptions& options,
                    const Slice& key,
                    std::string* value) {
@@ -1162,12 +1573,119 @@ Status DBImpl::Get(const ReadOptions& options,
   return s;
 }
 
+namespace {
+struct UserKeyLess {
+  const Comparator* ucmp;
+  const std::vector<Slice>* keys;
+  bool operator()(size_t a, size_t b) const {
+    return ucmp->Compare((*keys)[a], (*keys)[b]) < 0;
+  }
+};
+}  // namespace
+
+std::vector<Status> DBImpl::MultiGet(const ReadOptions& options,
+                                     const std::vector<Slice>& keys,
+                                     std::vector<std::string>* values) {
+  const size_t n = keys.size();
+  values->resize(n);
+  std::vector<Status> statuses(n);
+  MutexLock l(&mutex_);
+  SequenceNumber snapshot;
+  if (options.snapshot != nullptr) {
+    snapshot =
+        static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
+  } else {
+    snapshot = versions_->LastSequence();
+  }
+
+  MemTable* mem = mem_;
+  MemTable* imm = imm_;
+  Version* current = versions_->current();
+  mem->Ref();
+  if (imm != nullptr) imm->Ref();
+  current->Ref();
+
+  // Keys that are not in either memtable, sorted by user key so that
+  // lookups walk each table file front to back.
+  std::vector<Version::MultiGetKey> table_keys;
+
+  // Unlock while reading from files and memtables
+  {
+    mutex_.Unlock();
+    std::vector<size_t> order(n);
+    for (size_t i = 0; i < n; i++) {
+      order[i] = i;
+    }
+    UserKeyLess less;
+    less.ucmp = user_comparator();
+    less.keys = &keys;
+    std::sort(order.begin(), order.end(), less);
+
+    std::vector<LookupKey*> lkeys(n);
+    std::vector<size_t> table_key_index;  // Index in "keys" of table_keys[j]
+    for (size_t j = 0; j < n; j++) {
+      const size_t i = order[j];
+      lkeys[i] = new LookupKey(keys[i], snapshot);
+      // First look in the memtable, then in the immutable memtable (if any).
+      if (mem->Get(*lkeys[i], &(*values)[i], &statuses[i])) {
+        // Done
+      } else if (imm != nullptr &&
+                 imm->Get(*lkeys[i], &(*values)[i], &statuses[i])) {
+        // Done
+      } else {
+        Version::MultiGetKey k;
+        k.key = lkeys[i];
+        k.value = &(*values)[i];
+        table_keys.push_back(k);
+        table_key_index.push_back(i);
+      }
+    }
+    if (!table_keys.empty()) {
+      ThreadPool* pool = nullptr;
+      if (options.multiget_threads > 1) {
+        pool = multiget_pool_;
+        pool->EnsureThreads(options.multiget_threads - 1);
+      }
+      current->MultiGet(options, &table_keys[0], table_keys.size(), pool);
+    }
+    for (size_t j = 0; j < table_keys.size(); j++) {
+      statuses[table_key_index[j]] = table_keys[j].status;
+    }
+    for (size_t i = 0; i < n; i++) {
+      delete lkeys[i];
+    }
+    mutex_.Lock();
+  }
+
+  bool need_compaction = false;
+  for (size_t j = 0; j < table_keys.size(); j++) {
+    if (current->UpdateStats(table_keys[j].stats)) {
+      need_compaction = true;
+    }
+  }
+  if (need_compaction) {
+    MaybeScheduleCompaction();
+  }
+  mem->Unref();
+  if (imm != nullptr) imm->Unref();
+  current->Unref();
+  return statuses;
+}
+
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
-  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
+  RangeTombstones* memtable_range_deletions;
+  const RangeTombstones* table_range_deletions;
+  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed,
+                                       &memtable_range_deletions,
+                                       &table_range_deletions);
+  const SliceTransform* prefix_extractor =
+      options.prefix_same_as_start ? options_.prefix_extractor : nullptr;
   return NewDBIterator(
-      this, user_comparator(), iter,
+      this, user_comparator(), iter, memtable_range_deletions,
+      table_range_deletions, prefix_extractor,
+      options.iterate_lower_bound, options.iterate_upper_bound,
       (options.snapshot != nullptr
        ? static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number()
        : latest_snapshot),
@@ -1201,6 +1719,10 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
 }
 
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
+  if (options_.enable_pipelined_write) {
+    return PipelinedWrite(options, my_batch);
+  }
+
   Writer w(&mutex_);
   w.batch = my_batch;
   w.sync = options.sync;
@@ -1273,6 +1795,166 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* my_batch) {
   return status;
 }
 
+Status DBImpl::PipelinedWrite(const WriteOptions& options,
+                              WriteBatch* my_batch) {
+  Writer w(&mutex_);
+  w.batch = my_batch;
+  w.sync = options.sync;
+  w.done = false;
+
+  MutexLock l(&mutex_);
+  writers_.push_back(&w);
+  // A grouped writer has left writers_, and only waits for its leader.
+  while (!w.done && w.memtable == nullptr &&
+         (w.grouped || &w != writers_.front())) {
+    w.cv.Wait();
+  }
+  if (w.memtable != nullptr) {
+    // The leader of our group wants us to insert our own batch.
+    MemTable* mem = w.memtable;
+    Writer* leader = w.leader;
+    w.memtable = nullptr;
+    mutex_.Unlock();
+    Status s = WriteBatchInternal::InsertIntoConcurrently(my_batch, mem);
+    mutex_.Lock();
+    if (!s.ok() && leader->status.ok()) {
+      leader->status = s;
+    }
+    if (--leader->pending_inserts == 0) {
+      leader->cv.Signal();
+    }
+    while (!w.done) {
+      w.cv.Wait();
+    }
+  }
+  if (w.done) {
+    return w.status;
+  }
+
+  // Stage 1: append the group to the log.  Groups that have been logged
+  // but not yet applied to the memtable have already used up sequence
+  // numbers beyond versions_->LastSequence().
+  Status status = MakeRoomForWrite(my_batch == nullptr);
+  uint64_t last_sequence = memtable_writers_.empty()
+      ? versions_->LastSequence()
+      : memtable_writers_.back()->last_sequence;
+  Writer* last_writer = &w;
+  if (status.ok() && my_batch != nullptr) {
+    WriteBatch* updates = BuildBatchGroup(&last_writer);
+    WriteBatchInternal::SetSequence(updates, last_sequence + 1);
+
+    // Every writer of the group inserts its own batch into the
+    // memtable, so give each batch its part of the sequence range.
+    for (std::deque<Writer*>::iterator iter = writers_.begin(); ;
+         ++iter) {
+      Writer* writer = *iter;
+      if (writer->batch != nullptr) {
+        WriteBatchInternal::SetSequence(writer->batch, last_sequence + 1);
+        last_sequence += WriteBatchInternal::Count(writer->batch);
+      }
+      if (writer == last_writer) break;
+    }
+
+    // &w is responsible for logging, so nobody else touches log_
+    // while the lock is released.
+    {
+      mutex_.Unlock();
+      status = log_->AddRecord(WriteBatchInternal::Contents(updates));
+      bool sync_error = false;
+      if (status.ok() && options.sync) {
+        status = logfile_->Sync();
+        if (!status.ok()) {
+          sync_error = true;
+        }
+      }
+      mutex_.Lock();
+      if (sync_error) {
+        RecordBackgroundError(status);
+      }
+    }
+    if (updates == tmp_batch_) tmp_batch_->Clear();
+  }
+
+  // Hand the group over to the memtable stage and let the next group
+  // start logging.
+  w.last_sequence = last_sequence;
+  w.group.clear();
+  while (true) {
+    Writer* ready = writers_.front();
+    writers_.pop_front();
+    if (ready != &w) {
+      ready->grouped = true;
+    }
+    w.group.push_back(ready);
+    if (ready == last_writer) break;
+  }
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+
+  // Stage 2: apply the group to the memtable, in log order.  mem_ is not
+  // switched while memtable_writers_ is non-empty.
+  memtable_writers_.push_back(&w);
+  while (&w != memtable_writers_.front()) {
+    w.cv.Wait();
+  }
+  if (status.ok() && my_batch != nullptr) {
+    MemTable* mem = mem_;
+    if (options_.allow_concurrent_memtable_write && w.group.size() > 1) {
+      // Let every follower insert its own batch while we insert ours.
+      // Followers report failures through w.status.
+      w.status = Status::OK();
+      w.pending_inserts = 0;
+      for (size_t i = 0; i < w.group.size(); i++) {
+        Writer* follower = w.group[i];
+        if (follower != &w && follower->batch != nullptr) {
+          follower->memtable = mem;
+          follower->leader = &w;
+          w.pending_inserts++;
+          follower->cv.Signal();
+        }
+      }
+      mutex_.Unlock();
+      status = WriteBatchInternal::InsertIntoConcurrently(my_batch, mem);
+      mutex_.Lock();
+      while (w.pending_inserts > 0) {
+        w.cv.Wait();
+      }
+      if (status.ok()) {
+        status = w.status;
+      }
+    } else {
+      mutex_.Unlock();
+      for (size_t i = 0; i < w.group.size() && status.ok(); i++) {
+        if (w.group[i]->batch != nullptr) {
+          status = WriteBatchInternal::InsertInto(w.group[i]->batch, mem);
+        }
+      }
+      mutex_.Lock();
+    }
+  }
+  versions_->SetLastSequence(last_sequence);
+
+  memtable_writers_.pop_front();
+  for (size_t i = 0; i < w.group.size(); i++) {
+    Writer* ready = w.group[i];
+    if (ready != &w) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv.Signal();
+    }
+  }
+  if (!memtable_writers_.empty()) {
+    memtable_writers_.front()->cv.Signal();
+  } else if (!writers_.empty()) {
+    // The head of the log stage may be waiting for the memtable stage
+    // to drain before it switches to a new memtable.
+    writers_.front()->cv.Signal();
+  }
+
+  return status;
+}
+
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-null batch
 WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
@@ -1302,6 +1984,11 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
       break;
     }
 
+    if (w->exclusive) {
+      // Do not let a group run ahead of an ingested file.
+      break;
+    }
+
     if (w->batch != nullptr) {
       size += WriteBatchInternal::ByteSize(w->batch);
       if (size > max_size) {
@@ -1323,6 +2010,237 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
   return result;
 }
 
+// Store the smallest and largest keys of the table file "fname" in
+// *smallest and *largest.  The keys of a table built by SstFileWriter
+// all have sequence number zero.
+static Status ReadExternalFileRange(const Options& options,
+                                    const std::string& fname,
+                                    uint64_t file_size,
+                                    InternalKey* smallest,
+                                    InternalKey* largest) {
+  RandomAccessFile* file = nullptr;
+  Status s = options.env->NewRandomAccessFile(fname, &file);
+  if (!s.ok()) {
+    return s;
+  }
+  Table* table = nullptr;
+  s = Table::Open(options, file, file_size, &table);
+  if (s.ok()) {
+    Iterator* iter = table->NewIterator(ReadOptions());
+    ParsedInternalKey first, last;
+    iter->SeekToFirst();
+    bool ok = iter->Valid() && ParseInternalKey(iter->key(), &first);
+    if (ok) {
+      smallest->DecodeFrom(iter->key());
+      iter->SeekToLast();
+      ok = iter->Valid() && ParseInternalKey(iter->key(), &last);
+    }
+    if (ok) {
+      largest->DecodeFrom(iter->key());
+    }
+    s = iter->status();
+    if (s.ok() && !ok) {
+      s = Status::InvalidArgument("no valid keys in external file", fname);
+    } else if (s.ok() && (first.sequence != 0 || last.sequence != 0)) {
+      s = Status::InvalidArgument("external file has sequence numbers",
+                                  fname);
+    }
+    delete iter;
+    delete table;
+  }
+  delete file;
+  return s;
+}
+
+static Status CopyFile(Env* env, const std::string& src,
+                       const std::string& dst) {
+  SequentialFile* in = nullptr;
+  Status s = env->NewSequentialFile(src, &in);
+  if (!s.ok()) {
+    return s;
+  }
+  WritableFile* out = nullptr;
+  s = env->NewWritableFile(dst, &out);
+  if (s.ok()) {
+    static const size_t kBufferSize = 1 << 20;
+    char* buffer = new char[kBufferSize];
+    while (s.ok()) {
+      Slice chunk;
+      s = in->Read(kBufferSize, &chunk, buffer);
+      if (!s.ok() || chunk.empty()) {
+        break;
+      }
+      s = out->Append(chunk);
+    }
+    delete[] buffer;
+    if (s.ok()) {
+      s = out->Sync();
+    }
+    if (s.ok()) {
+      s = out->Close();
+    }
+    delete out;
+    if (!s.ok()) {
+      env->DeleteFile(dst);
+    }
+  }
+  delete in;
+  return s;
+}
+
+// Returns true iff "mem" holds an entry for some user key in
+// [smallest_user_key,largest_user_key].
+static bool MemTableOverlaps(MemTable* mem, const Comparator* ucmp,
+                             const Slice& smallest_user_key,
+                             const Slice& largest_user_key) {
+  Iterator* iter = mem->NewIterator();
+  LookupKey start(smallest_user_key, kMaxSequenceNumber);
+  iter->Seek(start.internal_key());
+  bool overlaps = iter->Valid() &&
+      ucmp->Compare(ExtractUserKey(iter->key()), largest_user_key) <= 0;
+  delete iter;
+  if (!overlaps && mem->HasRangeDeletions()) {
+    RangeTombstones range_deletions(ucmp);
+    mem->GetRangeTombstones(&range_deletions);
+    overlaps = range_deletions.Overlaps(smallest_user_key, largest_user_key);
+  }
+  return overlaps;
+}
+
+// Returns "key" with its sequence number replaced by "sequence".
+static InternalKey WithSequence(const InternalKey& key,
+                                SequenceNumber sequence) {
+  ParsedInternalKey parsed;
+  ParseInternalKey(key.Encode(), &parsed);
+  return InternalKey(parsed.user_key, sequence, parsed.type);
+}
+
+Status DBImpl::IngestExternalFile(const IngestExternalFileOptions& options,
+                                  const std::string& fname) {
+  uint64_t file_size = 0;
+  InternalKey smallest, largest;
+  Status s = env_->GetFileSize(fname, &file_size);
+  if (s.ok()) {
+    s = ReadExternalFileRange(options_, fname, file_size, &smallest,
+                              &largest);
+  }
+  if (!s.ok()) {
+    return s;
+  }
+
+  // Bring the file into the database under a new file number, which
+  // DeleteObsoleteFiles() leaves alone until the file is in a version.
+  uint64_t number;
+  {
+    MutexLock l(&mutex_);
+    number = versions_->NewFileNumber();
+    pending_outputs_.insert(number);
+  }
+  const std::string table_fname = TableFileName(dbname_, number);
+  if (options.move_files) {
+    s = env_->RenameFile(fname, table_fname);
+  } else {
+    s = CopyFile(env_, fname, table_fname);
+  }
+  if (!s.ok()) {
+    MutexLock l(&mutex_);
+    pending_outputs_.erase(number);
+    return s;
+  }
+
+  // Keep writers out while the file is added, so that every write is
+  // either older than all of its keys or newer.
+  MutexLock l(&mutex_);
+  Writer w(&mutex_);
+  w.batch = nullptr;
+  w.sync = false;
+  w.done = false;
+  w.exclusive = true;
+  writers_.push_back(&w);
+  while (&w != writers_.front()) {
+    w.cv.Wait();
+  }
+  while (!memtable_writers_.empty()) {
+    // Pipelined writes have sequence numbers but are not in mem_ yet.
+    w.cv.Wait();
+  }
+
+  const Slice smallest_user_key = smallest.user_key();
+  const Slice largest_user_key = largest.user_key();
+  s = bg_error_;
+  if (s.ok() && MemTableOverlaps(mem_, user_comparator(), smallest_user_key,
+                                 largest_user_key)) {
+    // Memtable entries are looked up before any file, so they must be
+    // moved to a file first.
+    s = MakeRoomForWrite(true);
+  }
+  // A memtable that is being compacted could be placed into any of the
+  // levels considered below, so wait for it in any case.
+  while (s.ok() && imm_ != nullptr && bg_error_.ok()) {
+    background_work_finished_signal_.Wait();
+  }
+  if (s.ok()) {
+    s = bg_error_;
+  }
+
+  int level = 0;
+  SequenceNumber sequence = 0;
+  if (s.ok()) {
+    // Place the file into the deepest level that neither it nor any level
+    // above overlaps, keeping out of levels that a running compaction
+    // writes to.  Level-0 files may overlap each other, so level 0 always
+    // works.
+    Version* base = versions_->current();
+    bool overlaps = false;
+    bool blocked = false;
+    for (int l = 0; l < config::kNumLevels; l++) {
+      if (base->OverlapInLevel(l, &smallest_user_key, &largest_user_key)) {
+        overlaps = true;
+        break;
+      }
+      if (l > 0 && versions_->LevelBeingCompacted(l)) {
+        blocked = true;
+      }
+      if (!blocked) {
+        level = l;
+      }
+    }
+
+    // The stored sequence number zero is older than everything, which is
+    // only correct if nothing else holds the keys of the file and no
+    // snapshot must be kept from seeing them.  Otherwise the file gets
+    // a sequence number of its own, like a write would.
+    if (overlaps || !snapshots_.empty()) {
+      sequence = versions_->LastSequence() + 1;
+      versions_->SetLastSequence(sequence);
+    }
+
+    VersionEdit edit;
+    edit.AddFile(level, number, file_size, WithSequence(smallest, sequence),
+                 WithSequence(largest, sequence), sequence);
+    s = LogAndApply(&edit);
+  }
+  pending_outputs_.erase(number);
+
+  if (s.ok()) {
+    Log(options_.info_log, "Ingested table #%llu@%d: %lld bytes, seq %llu",
+        (unsigned long long) number, level,
+        (unsigned long long) file_size,
+        (unsigned long long) sequence);
+    MaybeScheduleCompaction();
+  } else if (options.move_files) {
+    env_->RenameFile(table_fname, fname);
+  } else {
+    env_->DeleteFile(table_fname);
+  }
+
+  writers_.pop_front();
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+  return s;
+}
+
 // REQUIRES: mutex_ is held
 // REQUIRES: this thread is currently at the front of the writer queue
 Status DBImpl::MakeRoomForWrite(bool force) {
@@ -1344,10 +2262,12 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // individual write by 1ms to reduce latency variance.  Also,
       // this delay hands over some CPU to the compaction thread in
       // case it is sharing the same core as the writer.
+      const uint64_t stall_start = env_->NowMicros();
       mutex_.Unlock();
       env_->SleepForMicroseconds(1000);
       allow_delay = false;  // Do not delay a single write more than once
       mutex_.Lock();
+      write_stall_micros_ += env_->NowMicros() - stall_start;
     } else if (!force &&
                (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
       // There is room in current memtable
@@ -1356,11 +2276,18 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // We have filled up the current memtable, but the previous
       // one is still being compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
+      const uint64_t stall_start = env_->NowMicros();
       background_work_finished_signal_.Wait();
+      write_stall_micros_ += env_->NowMicros() - stall_start;
     } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
+      const uint64_t stall_start = env_->NowMicros();
       background_work_finished_signal_.Wait();
+      write_stall_micros_ += env_->NowMicros() - stall_start;
+    } else if (!memtable_writers_.empty()) {
+      // Pipelined writes are still being applied to mem_.
+      writers_.front()->cv.Wait();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
@@ -1379,7 +2306,7 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       log_ = new log::Writer(lfile);
       imm_ = mem_;
       has_imm_.Release_Store(imm_);
-      mem_ = new MemTable(internal_comparator_);
+      mem_ = new MemTable(internal_comparator_, options_.memtable_factory);
       mem_->Ref();
       force = false;   // Do not force another compaction if have room
       MaybeScheduleCompaction();
@@ -1437,6 +2364,33 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
+  } else if (in == "write-stall-micros") {
+    char buf[50];
+    snprintf(buf, sizeof(buf), "%llu",
+             static_cast<unsigned long long>(write_stall_micros_));
+    value->append(buf);
+    return true;
+  } else if (in == "rate-limiter") {
+    RateLimiter* limiter = options_.rate_limiter;
+    if (limiter == nullptr) {
+      return false;
+    }
+    char buf[200];
+    snprintf(buf, sizeof(buf), "Rate limit: %.1f MB/s\n",
+             limiter->GetBytesPerSecond() / 1048576.0);
+    value->append(buf);
+    static const char* kPriorityNames[] = { "low", "high" };
+    for (int pri = RateLimiter::kNumPriorities - 1; pri >= 0; pri--) {
+      const RateLimiter::Priority p = static_cast<RateLimiter::Priority>(pri);
+      snprintf(buf, sizeof(buf),
+               "%-4s: %.1f MB in %lld requests, %.3f sec waiting\n",
+               kPriorityNames[pri],
+               limiter->GetTotalBytesThrough(p) / 1048576.0,
+               static_cast<long long>(limiter->GetTotalRequests(p)),
+               limiter->GetTotalWaitMicros(p) / 1e6);
+      value->append(buf);
+    }
+    return true;
   } else if (in == "approximate-memory-usage") {
     size_t total_usage = options_.block_cache->TotalCharge();
     if (mem_) {
@@ -1495,6 +2449,39 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+Status DB::DeleteRange(const WriteOptions& opt,
+                       const Slice& begin, const Slice& end) {
+  WriteBatch batch;
+  batch.DeleteRange(begin, end);
+  return Write(opt, &batch);
+}
+
+std::vector<Status> DB::MultiGet(const ReadOptions& options,
+                                 const std::vector<Slice>& keys,
+                                 std::vector<std::string>* values) {
+  // Without a snapshot, separate Get() calls could see different states.
+  ReadOptions read_options = options;
+  const Snapshot* snapshot = nullptr;
+  if (read_options.snapshot == nullptr) {
+    snapshot = GetSnapshot();
+    read_options.snapshot = snapshot;
+  }
+  values->resize(keys.size());
+  std::vector<Status> statuses(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    statuses[i] = Get(read_options, keys[i], &(*values)[i]);
+  }
+  if (snapshot != nullptr) {
+    ReleaseSnapshot(snapshot);
+  }
+  return statuses;
+}
+
+Status DB::IngestExternalFile(const IngestExternalFileOptions& options,
+                              const std::string& fname) {
+  return Status::NotSupported("IngestExternalFile", fname);
+}
+
 DB::~DB() { }
 
 // 打开一个leveldb数据库
@@ -1519,14 +2506,15 @@ Status DB::Open(const Options& options, const std::string& dbname,
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
       impl->log_ = new log::Writer(lfile);
-      impl->mem_ = new MemTable(impl->internal_comparator_);
+      impl->mem_ = new MemTable(impl->internal_comparator_,
+                                options.memtable_factory);
       impl->mem_->Ref();
     }
   }
   if (s.ok() && save_manifest) {
     edit.SetPrevLogNumber(0);  // No older logs needed after recovery.
     edit.SetLogNumber(impl->logfile_number_);
-    s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
+    s = impl->LogAndApply(&edit);
   }
   if (s.ok()) {
     impl->DeleteObsoleteFiles();
@@ -18,7 +18,9 @@
 namespace leveldb {
 
 class MemTable;
+class RangeTombstones;
 class TableCache;
+class ThreadPool;
 class Version;
 class VersionEdit;
 class VersionSet;
@@ -32,9 +34,14 @@ class DBImpl : public DB {
   virtual Status Put(const WriteOptions&, const Slice& key, const Slice& value);
   virtual Status Delete(const WriteOptions&, const Slice& key);
   virtual Status Write(const WriteOptions& options, WriteBatch* updates);
+  virtual Status IngestExternalFile(const IngestExternalFileOptions& options,
+                                    const std::string& fname);
   virtual Status Get(const ReadOptions& options,
                      const Slice& key,
                      std::string* value);
+  virtual std::vector<Status> MultiGet(const ReadOptions& options,
+                                       const std::vector<Slice>& keys,
+                                       std::vector<std::string>* values);
   virtual Iterator* NewIterator(const ReadOptions&);
   virtual const Snapshot* GetSnapshot();
   virtual void ReleaseSnapshot(const Snapshot* snapshot);
@@ -59,6 +66,10 @@ class DBImpl : public DB {
   // file at a level >= 1.
   int64_t TEST_MaxNextLevelOverlappingBytes();
 
+  // Return the number of key ranges that compactions have handed to
+  // subcompaction threads since the DB was opened.
+  int64_t TEST_SubcompactionsRun();
+
   // Record a sample of bytes read at the specified internal key.
   // Samples are taken approximately once every config::kReadBytesPeriod
   // bytes.
@@ -67,11 +78,18 @@ class DBImpl : public DB {
  private:
   friend class DB;
   struct CompactionState;
+  struct SubcompactionArg;
   struct Writer;
 
-  Iterator* NewInternalIterator(const ReadOptions&,
-                                SequenceNumber* latest_snapshot,
-                                uint32_t* seed);
+  // If "memtable_range_deletions" is non-null, also sets
+  // *memtable_range_deletions to the range deletions of the memtables,
+  // which the caller owns, and *table_range_deletions to those of the
+  // table files, which live as long as the returned iterator.  Either
+  // is set to nullptr if there are no such deletions.
+  Iterator* NewInternalIterator(
+      const ReadOptions&, SequenceNumber* latest_snapshot, uint32_t* seed,
+      RangeTombstones** memtable_range_deletions,
+      const RangeTombstones** table_range_deletions);
 
   Status NewDB();
 
@@ -103,8 +121,21 @@ class DBImpl : public DB {
   WriteBatch* BuildBatchGroup(Writer** last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Write() for options_.enable_pipelined_write.  A write group is
+  // appended to the log while the previous groups are still being
+  // applied to the memtable.
+  Status PipelinedWrite(const WriteOptions& options, WriteBatch* my_batch)
+      LOCKS_EXCLUDED(mutex_);
+
   void RecordBackgroundError(const Status& s);
 
+  // Apply *edit to the current version and save it to the MANIFEST.
+  // Waits for any other thread that is writing to the MANIFEST.
+  Status LogAndApply(VersionEdit* edit) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns true iff there is background work that no background
+  // thread has picked up yet.
+  bool HasBackgroundWork() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   static void BGWork(void* db);
   void BackgroundCall();
@@ -114,8 +145,24 @@ class DBImpl : public DB {
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Merge the compaction inputs whose user keys fall in the key range of
+  // *compact into new output files.  Runs on the background thread for
+  // the first key range of a compaction and on a BGSubcompaction() thread
+  // for the others.  imm_micros is null on subcompaction threads; the
+  // background thread adds the time spent compacting imm_ to it.
+  Status CompactRangeOfInputs(CompactionState* compact, int64_t* imm_micros)
+      LOCKS_EXCLUDED(mutex_);
+  static void BGSubcompaction(void* arg);
+
   Status OpenCompactionOutputFile(CompactionState* compact);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+
+  // Add to the current output of *compact, opening one if needed, the
+  // range deletions of the compaction inputs that cover keys in
+  // [*lower,*upper) and that some snapshot may still need.  A null bound
+  // is unbounded.
+  Status AddRangeDeletionsToOutput(CompactionState* compact,
+                                   const Slice* lower, const Slice* upper);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -131,6 +178,22 @@ class DBImpl : public DB {
   // table_cache_ provides its own synchronization
   TableCache* const table_cache_;
 
+  // Runs the compactions beyond the first of those that run at the same
+  // time; provides its own synchronization
+  ThreadPool* const compaction_pool_;
+
+  // Runs the key ranges of compactions beyond the first; provides its
+  // own synchronization
+  ThreadPool* const subcompaction_pool_;
+
+  // Reads table files for MultiGet() calls alongside the calling threads;
+  // provides its own synchronization
+  ThreadPool* const multiget_pool_;
+
+  // Compresses the data blocks of the tables being written with
+  // options.parallel_compression_threads; provides its own synchronization
+  ThreadPool* const compression_pool_;
+
   // Lock over the persistent DB state.  Non-null iff successfully acquired.
   FileLock* db_lock_;
 
@@ -148,6 +211,10 @@ class DBImpl : public DB {
 
   // Queue of writers.
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
+
+  // Leaders of the pipelined write groups that have been logged and are
+  // waiting to be applied to mem_, in log order.
+  std::deque<Writer*> memtable_writers_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
 
   SnapshotList snapshots_ GUARDED_BY(mutex_);
@@ -156,13 +223,24 @@ class DBImpl : public DB {
   // part of ongoing compactions.
   std::set<uint64_t> pending_outputs_ GUARDED_BY(mutex_);
 
-  // Has a background compaction been scheduled or is running?
-  bool background_compaction_scheduled_ GUARDED_BY(mutex_);
+  // Is some thread writing imm_ to a level-0 table?
+  bool compacting_memtable_ GUARDED_BY(mutex_);
+
+  // Is some thread inside VersionSet::LogAndApply()?
+  bool writing_manifest_ GUARDED_BY(mutex_);
+
+  // Number of threads inside LogAndApply(), including those waiting
+  // for their turn to write to the MANIFEST
+  int pending_manifest_writes_ GUARDED_BY(mutex_);
+
+  // Number of background compactions that are scheduled or running
+  int background_compactions_scheduled_ GUARDED_BY(mutex_);
 
   // Information for a manual compaction
   struct ManualCompaction {
     int level;
     bool done;
+    bool in_progress;           // Being compacted by a background thread
     const InternalKey* begin;   // null means beginning of key range
     const InternalKey* end;     // null means end of key range
     InternalKey tmp_storage;    // Used to keep track of compaction progress
@@ -171,6 +249,12 @@ class DBImpl : public DB {
 
   VersionSet* const versions_;
 
+  // Total time writers spent delayed or blocked in MakeRoomForWrite()
+  uint64_t write_stall_micros_ GUARDED_BY(mutex_);
+
+  // Key ranges handed to subcompaction_pool_
+  int64_t subcompactions_run_ GUARDED_BY(mutex_);
+
   // Have we encountered a background error in paranoid mode?
   Status bg_error_ GUARDED_BY(mutex_);
 
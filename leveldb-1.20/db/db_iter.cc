@@ -7,8 +7,10 @@
 #include "db/filename.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
+#include "db/range_tombstones.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "leveldb/slice_transform.h"
 #include "port/port.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -48,19 +50,36 @@ class DBIter: public Iterator {
     kReverse
   };
 
-  DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+  DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter,
+         RangeTombstones* memtable_range_deletions,
+         const RangeTombstones* table_range_deletions,
+         const SliceTransform* prefix_extractor,
+         const Slice* lower_bound, const Slice* upper_bound,
+         SequenceNumber s, uint32_t seed)
       : db_(db),
         user_comparator_(cmp),
         iter_(iter),
+        memtable_range_deletions_(memtable_range_deletions),
+        table_range_deletions_(table_range_deletions),
+        prefix_extractor_(prefix_extractor),
+        has_lower_bound_(lower_bound != nullptr),
+        has_upper_bound_(upper_bound != nullptr),
         sequence_(s),
         direction_(kForward),
         valid_(false),
+        prefix_same_as_start_(false),
         rnd_(seed),
         bytes_counter_(RandomPeriod()) {
+    if (has_lower_bound_) {
+      lower_bound_.assign(lower_bound->data(), lower_bound->size());
+    }
+    if (has_upper_bound_) {
+      upper_bound_.assign(upper_bound->data(), upper_bound->size());
+    }
   }
   virtual ~DBIter() {
     delete iter_;
+    delete memtable_range_deletions_;
   }
   virtual bool Valid() const { return valid_; }
   virtual Slice key() const {
@@ -86,10 +105,51 @@ class DBIter: public Iterator {
   virtual void SeekToLast();
 
  private:
+  void SeekForward(const Slice& target, SequenceNumber seek_sequence);
   void FindNextUserEntry(bool skipping, std::string* skip);
   void FindPrevUserEntry();
   bool ParseKey(ParsedInternalKey* key);
 
+  // Return true iff a range deletion visible at sequence_ hides "ikey".
+  bool IsRangeDeleted(const ParsedInternalKey& ikey) const {
+    return IsDeletedBy(memtable_range_deletions_, ikey) ||
+           IsDeletedBy(table_range_deletions_, ikey);
+  }
+  bool IsDeletedBy(const RangeTombstones* deletions,
+                   const ParsedInternalKey& ikey) const {
+    return deletions != nullptr &&
+           deletions->MaxCoveringSequence(ikey.user_key, sequence_) >
+               ikey.sequence;
+  }
+
+  // Return true iff "user_key" lies outside the prefix of the last Seek(),
+  // when that is what limits the iteration.
+  bool IsPastPrefix(const Slice& user_key) const {
+    return prefix_same_as_start_ &&
+           (!prefix_extractor_->InDomain(user_key) ||
+            prefix_extractor_->Transform(user_key) != Slice(prefix_));
+  }
+
+  bool IsBeforeLowerBound(const Slice& user_key) const {
+    return has_lower_bound_ &&
+           user_comparator_->Compare(user_key, lower_bound_) < 0;
+  }
+  bool IsAtOrAfterUpperBound(const Slice& user_key) const {
+    return has_upper_bound_ &&
+           user_comparator_->Compare(user_key, upper_bound_) >= 0;
+  }
+
+  // Going backwards is not supported after a Seek() that confined the
+  // iterator to a prefix: the tables that the Seek() skipped were left
+  // unpositioned, and going back would need them.
+  void SetNotSupported(const char* operation) {
+    valid_ = false;
+    saved_key_.clear();
+    ClearSavedValue();
+    status_ = Status::NotSupported(operation,
+                                   "iterator is confined to a prefix");
+  }
+
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
   }
@@ -111,6 +171,13 @@ class DBIter: public Iterator {
   DBImpl* db_;
   const Comparator* const user_comparator_;
   Iterator* const iter_;
+  RangeTombstones* const memtable_range_deletions_;
+  const RangeTombstones* const table_range_deletions_;
+  const SliceTransform* const prefix_extractor_;
+  const bool has_lower_bound_;
+  const bool has_upper_bound_;
+  std::string lower_bound_;   // ReadOptions::iterate_lower_bound
+  std::string upper_bound_;   // ReadOptions::iterate_upper_bound
   SequenceNumber const sequence_;
 
   Status status_;
@@ -118,6 +185,8 @@ class DBIter: public Iterator {
   std::string saved_value_;   // == current raw value when direction_==kReverse
   Direction direction_;
   bool valid_;
+  bool prefix_same_as_start_;  // Only yield keys with prefix prefix_
+  std::string prefix_;
 
   Random rnd_;
   ssize_t bytes_counter_;
@@ -176,7 +245,13 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   assert(direction_ == kForward);
   do {
     ParsedInternalKey ikey;
-    if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+    if (!ParseKey(&ikey)) {
+      // Skip corrupted entries
+    } else if (IsPastPrefix(ikey.user_key) ||
+               IsAtOrAfterUpperBound(ikey.user_key)) {
+      // Nothing beyond here is wanted, deleted or not
+      break;
+    } else if (ikey.sequence <= sequence_) {
       switch (ikey.type) {
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
@@ -188,12 +263,18 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
+          } else if (IsRangeDeleted(ikey)) {
+            // Like a deletion, hides the older entries for this key too
+            SaveKey(ikey.user_key, skip);
+            skipping = true;
           } else {
             valid_ = true;
             saved_key_.clear();
             return;
           }
           break;
+        case kTypeRangeDeletion:
+          break;  // Not yielded by internal iterators
       }
     }
     iter_->Next();
@@ -205,6 +286,11 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
 void DBIter::Prev() {
   assert(valid_);
 
+  if (prefix_same_as_start_) {
+    SetNotSupported("Prev()");
+    return;
+  }
+
   if (direction_ == kForward) {  // Switch directions?
     // iter_ is pointing at the current entry.  Scan backwards until
     // the key changes so we can use the normal reverse scanning code.
@@ -236,13 +322,24 @@ void DBIter::FindPrevUserEntry() {
   if (iter_->Valid()) {
     do {
       ParsedInternalKey ikey;
-      if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+      if (!ParseKey(&ikey)) {
+        // Skip corrupted entries
+      } else if (IsBeforeLowerBound(ikey.user_key)) {
+        break;
+      } else if (IsAtOrAfterUpperBound(ikey.user_key)) {
+        // Skip entries past the upper bound.  The bounded table iterators
+        // do not return them, but SeekToLast() and a change of direction
+        // can still land on them.
+      } else if (ikey.sequence <= sequence_) {
         if ((value_type != kTypeDeletion) &&
             user_comparator_->Compare(ikey.user_key, saved_key_) < 0) {
           // We encountered a non-deleted value in entries for previous keys,
           break;
         }
         value_type = ikey.type;
+        if (value_type == kTypeValue && IsRangeDeleted(ikey)) {
+          value_type = kTypeDeletion;
+        }
         if (value_type == kTypeDeletion) {
           saved_key_.clear();
           ClearSavedValue();
@@ -272,11 +369,31 @@ void DBIter::FindPrevUserEntry() {
 }
 
 void DBIter::Seek(const Slice& target) {
+  prefix_same_as_start_ =
+      prefix_extractor_ != nullptr && prefix_extractor_->InDomain(target);
+  if (prefix_same_as_start_) {
+    Slice prefix = prefix_extractor_->Transform(target);
+    prefix_.assign(prefix.data(), prefix.size());
+  }
+  SeekForward(target, sequence_);
+}
+
+// Position at the first entry at or after "target" (but not before the
+// lower bound), seeking the internal iterator with "seek_sequence".
+void DBIter::SeekForward(const Slice& target, SequenceNumber seek_sequence) {
   direction_ = kForward;
   ClearSavedValue();
+  Slice start = target;
+  if (IsBeforeLowerBound(start)) {
+    start = lower_bound_;
+  } else if (IsAtOrAfterUpperBound(start)) {
+    valid_ = false;
+    saved_key_.clear();
+    return;
+  }
   saved_key_.clear();
   AppendInternalKey(
-      &saved_key_, ParsedInternalKey(target, sequence_, kValueTypeForSeek));
+      &saved_key_, ParsedInternalKey(start, seek_sequence, kValueTypeForSeek));
   iter_->Seek(saved_key_);
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
@@ -286,6 +403,15 @@ void DBIter::Seek(const Slice& target) {
 }
 
 void DBIter::SeekToFirst() {
+  prefix_same_as_start_ = false;
+  if (has_lower_bound_) {
+    // Seeking at kMaxSequenceNumber positions every table, instead of
+    // skipping those whose filters rule out the bound's prefix (see
+    // PrefixFilterIterator in table_cache.cc).  The entries newer than
+    // sequence_ are skipped as usual.
+    SeekForward(lower_bound_, kMaxSequenceNumber);
+    return;
+  }
   direction_ = kForward;
   ClearSavedValue();
   iter_->SeekToFirst();
@@ -297,9 +423,28 @@ void DBIter::SeekToFirst() {
 }
 
 void DBIter::SeekToLast() {
+  prefix_same_as_start_ = false;
   direction_ = kReverse;
   ClearSavedValue();
-  iter_->SeekToLast();
+  if (has_upper_bound_) {
+    // Start at the last entry before all those of the bound's user key.
+    // The bounded table iterators may stop short of the entries at or
+    // past the bound, so Seek() can fail even though some exist; the
+    // scan from the very last entry then skips them.  As in SeekToFirst(),
+    // kMaxSequenceNumber positions every table.
+    saved_key_.clear();
+    AppendInternalKey(&saved_key_, ParsedInternalKey(
+        upper_bound_, kMaxSequenceNumber, kValueTypeForSeek));
+    iter_->Seek(saved_key_);
+    saved_key_.clear();
+    if (iter_->Valid()) {
+      iter_->Prev();
+    } else {
+      iter_->SeekToLast();
+    }
+  } else {
+    iter_->SeekToLast();
+  }
   FindPrevUserEntry();
 }
 
@@ -309,9 +454,17 @@ Iterator* NewDBIterator(
     DBImpl* db,
     const Comparator* user_key_comparator,
     Iterator* internal_iter,
+    RangeTombstones* memtable_range_deletions,
+    const RangeTombstones* table_range_deletions,
+    const SliceTransform* prefix_extractor,
+    const Slice* lower_bound,
+    const Slice* upper_bound,
     SequenceNumber sequence,
     uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+  return new DBIter(db, user_key_comparator, internal_iter,
+                    memtable_range_deletions, table_range_deletions,
+                    prefix_extractor, lower_bound, upper_bound, sequence,
+                    seed);
 }
 
 }  // namespace leveldb
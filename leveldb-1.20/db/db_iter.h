@@ -12,13 +12,28 @@
 namespace leveldb {
 
 class DBImpl;
+class RangeTombstones;
+class SliceTransform;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys.  Entries hidden by the range deletions of
+// "*memtable_range_deletions" or "*table_range_deletions", either of
+// which may be nullptr, are skipped.  The iterator takes ownership of
+// "memtable_range_deletions"; "*table_range_deletions" must outlive
+// "*internal_iter".  If "prefix_extractor" is
+// non-null, a Seek() to a key that has a prefix confines the iterator
+// to the keys with that prefix, and the iterator cannot go backwards
+// (see ReadOptions::prefix_same_as_start).  The keys yielded are limited
+// to [*lower_bound,*upper_bound); either bound may be nullptr.
 Iterator* NewDBIterator(DBImpl* db,
                         const Comparator* user_key_comparator,
                         Iterator* internal_iter,
+                        RangeTombstones* memtable_range_deletions,
+                        const RangeTombstones* table_range_deletions,
+                        const SliceTransform* prefix_extractor,
+                        const Slice* lower_bound,
+                        const Slice* upper_bound,
                         SequenceNumber sequence,
                         uint32_t seed);
 
@@ -4,6 +4,11 @@
 
 #include "leveldb/db.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/io_uring_env.h"
+#include "leveldb/memtable_factory.h"
+#include "leveldb/rate_limiter.h"
+#include "leveldb/slice_transform.h"
+#include "leveldb/sst_file_writer.h"
 #include "db/db_impl.h"
 #include "db/filename.h"
 #include "db/version_set.h"
@@ -128,6 +133,26 @@ class SpecialEnv : public EnvWrapper {
   }
 
   Status NewWritableFile(const std::string& f, WritableFile** r) {
+    return NewSpecialWritableFile(f, false, r);
+  }
+
+  Status NewDirectWritableFile(const std::string& f, WritableFile** r) {
+    return NewSpecialWritableFile(f, true, r);
+  }
+
+  Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r) {
+    return NewSpecialRandomAccessFile(f, false, r);
+  }
+
+  Status NewDirectRandomAccessFile(const std::string& f,
+                                   RandomAccessFile** r) {
+    return NewSpecialRandomAccessFile(f, true, r);
+  }
+
+  // Wrap a file from the base Env's NewWritableFile(), or from its
+  // NewDirectWritableFile() if "direct", to simulate the errors above.
+  Status NewSpecialWritableFile(const std::string& f, bool direct,
+                                WritableFile** r) {
     class DataFile : public WritableFile {
      private:
       SpecialEnv* env_;
@@ -188,7 +213,8 @@ class SpecialEnv : public EnvWrapper {
       return Status::IOError("simulated write error");
     }
 
-    Status s = target()->NewWritableFile(f, r);
+    Status s = direct ? target()->NewDirectWritableFile(f, r)
+                      : target()->NewWritableFile(f, r);
     if (s.ok()) {
       if (strstr(f.c_str(), ".ldb") != nullptr ||
           strstr(f.c_str(), ".log") != nullptr) {
@@ -200,7 +226,10 @@ class SpecialEnv : public EnvWrapper {
     return s;
   }
 
-  Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r) {
+  // Wrap a file from the base Env's NewRandomAccessFile(), or from its
+  // NewDirectRandomAccessFile() if "direct", to count reads.
+  Status NewSpecialRandomAccessFile(const std::string& f, bool direct,
+                                    RandomAccessFile** r) {
     class CountingFile : public RandomAccessFile {
      private:
       RandomAccessFile* target_;
@@ -215,9 +244,13 @@ class SpecialEnv : public EnvWrapper {
         counter_->Increment();
         return target_->Read(offset, n, result, scratch);
       }
+      virtual void Prefetch(uint64_t offset, size_t n) const {
+        target_->Prefetch(offset, n);
+      }
     };
 
-    Status s = target()->NewRandomAccessFile(f, r);
+    Status s = direct ? target()->NewDirectRandomAccessFile(f, r)
+                      : target()->NewRandomAccessFile(f, r);
     if (s.ok() && count_random_reads_) {
       *r = new CountingFile(*r, &random_read_counter_);
     }
@@ -228,6 +261,9 @@ class SpecialEnv : public EnvWrapper {
 class DBTest {
  private:
   const FilterPolicy* filter_policy_;
+  const MemTableFactory* memtable_factory_;
+  RateLimiter* rate_limiter_;
+  Cache* clock_cache_;
 
   // Sequence of option configurations to try
   enum OptionConfig {
@@ -235,6 +271,18 @@ class DBTest {
     kReuse,
     kFilter,
     kUncompressed,
+    kSubcompactions,
+    kConcurrentCompactions,
+    kPipelinedWrite,
+    kConcurrentMemtableWrite,
+    kHashMemTable,
+    kBlockHashIndex,
+    kPartitionedIndex,
+    kWholeTableFilter,
+    kDirectIO,
+    kRateLimited,
+    kClockCache,
+    kParallelCompression,
     kEnd
   };
   int option_config_;
@@ -249,6 +297,9 @@ class DBTest {
   DBTest() : option_config_(kDefault),
              env_(new SpecialEnv(Env::Default())) {
     filter_policy_ = NewBloomFilterPolicy(10);
+    memtable_factory_ = NewHashMemTableFactory(1000);
+    rate_limiter_ = NewRateLimiter(100 << 20);
+    clock_cache_ = NewClockCache(8 << 20, 4096, -1);
     dbname_ = test::TmpDir() + "/db_test";
     DestroyDB(dbname_, Options());
     db_ = nullptr;
@@ -260,6 +311,9 @@ class DBTest {
     DestroyDB(dbname_, Options());
     delete env_;
     delete filter_policy_;
+    delete memtable_factory_;
+    delete rate_limiter_;
+    delete clock_cache_;
   }
 
   // Switch to a fresh database with the next option configuration to
@@ -288,6 +342,48 @@ class DBTest {
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kSubcompactions:
+        options.max_subcompactions = 4;
+        break;
+      case kConcurrentCompactions:
+        options.max_background_compactions = 4;
+        break;
+      case kPipelinedWrite:
+        options.enable_pipelined_write = true;
+        break;
+      case kConcurrentMemtableWrite:
+        options.enable_pipelined_write = true;
+        options.allow_concurrent_memtable_write = true;
+        break;
+      case kHashMemTable:
+        options.memtable_factory = memtable_factory_;
+        break;
+      case kBlockHashIndex:
+        options.data_block_hash_index = true;
+        break;
+      case kPartitionedIndex:
+        options.filter_policy = filter_policy_;
+        options.partition_index_and_filters = true;
+        options.pin_top_level_index = true;
+        break;
+      case kWholeTableFilter:
+        options.filter_policy = filter_policy_;
+        options.whole_table_filter = true;
+        break;
+      case kDirectIO:
+        options.use_direct_reads = true;
+        options.use_direct_io_for_flush_and_compaction = true;
+        break;
+      case kRateLimited:
+        options.rate_limiter = rate_limiter_;
+        break;
+      case kClockCache:
+        options.block_cache = clock_cache_;
+        break;
+      case kParallelCompression:
+        options.filter_policy = filter_policy_;
+        options.parallel_compression_threads = 4;
+        break;
       default:
         break;
     }
@@ -350,6 +446,27 @@ class DBTest {
     return result;
   }
 
+  // Look up "keys" with a single MultiGet() call and return one result
+  // per key, formatted like the result of Get().
+  std::vector<std::string> MultiGet(const std::vector<std::string>& keys,
+                                    const Snapshot* snapshot = nullptr,
+                                    int threads = 1) {
+    ReadOptions options;
+    options.snapshot = snapshot;
+    options.multiget_threads = threads;
+    std::vector<Slice> key_slices(keys.begin(), keys.end());
+    std::vector<std::string> values;
+    std::vector<Status> s = db_->MultiGet(options, key_slices, &values);
+    for (size_t i = 0; i < keys.size(); i++) {
+      if (s[i].IsNotFound()) {
+        values[i] = "NOT_FOUND";
+      } else if (!s[i].ok()) {
+        values[i] = s[i].ToString();
+      }
+    }
+    return values;
+  }
+
   // Return a string that contains all key,value pairs in order,
   // formatted like "(k1->v1)(k2->v2)".
   std::string Contents() {
@@ -406,6 +523,9 @@ class DBTest {
             case kTypeDeletion:
               result += "DEL";
               break;
+            case kTypeRangeDeletion:
+              result += "RANGEDEL";
+              break;
           }
         }
         iter->Next();
@@ -761,6 +881,58 @@ TEST(DBTest, GetEncountersEmptyLevel) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, MultiGet) {
+  do {
+    // Spread versions of the keys over a non-level-0 level, two level-0
+    // files and the memtable.
+    char buf[100];
+    std::vector<std::string> keys;
+    for (int i = 0; i < 200; i++) {
+      snprintf(buf, sizeof(buf), "key%06d", i);
+      keys.push_back(buf);
+      ASSERT_OK(Put(keys.back(), std::string(100, 'a') + buf));
+    }
+    Compact(keys.front(), keys.back());
+    for (int i = 0; i < 200; i += 2) {
+      ASSERT_OK(Put(keys[i], "level0"));
+    }
+    dbfull()->TEST_CompactMemTable();
+    for (int i = 0; i < 200; i += 5) {
+      ASSERT_OK(Delete(keys[i]));
+    }
+    dbfull()->TEST_CompactMemTable();
+    const Snapshot* snapshot = db_->GetSnapshot();
+    for (int i = 0; i < 200; i += 3) {
+      ASSERT_OK(Put(keys[i], "mem"));
+    }
+
+    // Ask in a shuffled order, with missing keys and a duplicate.
+    keys.push_back("a");
+    keys.push_back("key000100x");
+    keys.push_back("z");
+    keys.push_back(keys[7]);
+    Random rnd(301);
+    for (size_t i = keys.size() - 1; i > 0; i--) {
+      std::swap(keys[i], keys[rnd.Uniform(i + 1)]);
+    }
+    for (int threads = 1; threads <= 4; threads += 3) {
+      std::vector<std::string> values = MultiGet(keys, nullptr, threads);
+      std::vector<std::string> snapshot_values =
+          MultiGet(keys, snapshot, threads);
+      ASSERT_EQ(keys.size(), values.size());
+      ASSERT_EQ(keys.size(), snapshot_values.size());
+      for (size_t i = 0; i < keys.size(); i++) {
+        ASSERT_EQ(Get(keys[i]), values[i]) << keys[i];
+        ASSERT_EQ(Get(keys[i], snapshot), snapshot_values[i]) << keys[i];
+      }
+    }
+
+    // An empty batch is fine too.
+    ASSERT_TRUE(MultiGet(std::vector<std::string>()).empty());
+    db_->ReleaseSnapshot(snapshot);
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, IterEmpty) {
   Iterator* iter = db_->NewIterator(ReadOptions());
 
@@ -952,6 +1124,139 @@ TEST(DBTest, IterMultiWithDelete) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, IterBounds) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("b", "vb"));
+    ASSERT_OK(Put("c", "vc"));
+    Compact("a", "c");
+    ASSERT_OK(Put("d", "vd"));
+    ASSERT_OK(Put("e", "ve"));
+    ASSERT_OK(Delete("c"));
+
+    Slice lower("b");
+    Slice upper("e");
+    ReadOptions options;
+    options.iterate_lower_bound = &lower;
+    options.iterate_upper_bound = &upper;
+    Iterator* iter = db_->NewIterator(options);
+
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    iter->Seek("a");
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Seek("c");
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Seek("e");
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    ASSERT_OK(iter->status());
+    delete iter;
+
+    // An empty range
+    upper = "b";
+    iter = db_->NewIterator(options);
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    delete iter;
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, IterUpperBoundAtIndexSeparator) {
+  // Values larger than a block, so that every key gets a block of its own
+  // and the index entry of the block that holds "d000" is the separator
+  // "e", at or past both bounds below even though the block itself only
+  // holds keys before them.
+  Options options = CurrentOptions();
+  options.block_size = 1024;
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  const char* keys[] = { "a000", "b000", "c000", "d000",
+                         "f000", "g000", "h000", "i000" };
+  const std::string value(2000, 'v');
+  for (int i = 0; i < 8; i++) {
+    ASSERT_OK(Put(keys[i], value));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ(TotalTableFiles(), 1);
+
+  const char* bounds[] = { "e", "dd" };
+  for (int b = 0; b < 2; b++) {
+    Slice upper(bounds[b]);
+    ReadOptions read_options;
+    read_options.iterate_upper_bound = &upper;
+    Iterator* iter = db_->NewIterator(read_options);
+    iter->SeekToLast();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(iter->key().ToString(), "d000");
+    iter->Prev();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(iter->key().ToString(), "c000");
+    iter->Next();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(iter->key().ToString(), "d000");
+    iter->Next();
+    ASSERT_TRUE(!iter->Valid());
+    iter->Seek("d000");
+    iter->Prev();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(iter->key().ToString(), "c000");
+    ASSERT_OK(iter->status());
+    delete iter;
+  }
+}
+
+TEST(DBTest, IterReadahead) {
+  do {
+    // Enough data for several blocks in each of a few tables.
+    Random rnd(301);
+    for (int i = 0; i < 1000; i++) {
+      char key[100];
+      snprintf(key, sizeof(key), "key%06d", i);
+      ASSERT_OK(Put(key, RandomString(&rnd, 300)));
+    }
+    Compact("a", "z");
+
+    ReadOptions options;
+    options.readahead_size = 16384;
+    Iterator* plain = db_->NewIterator(ReadOptions());
+    Iterator* iter = db_->NewIterator(options);
+    for (plain->SeekToFirst(), iter->SeekToFirst(); plain->Valid();
+         plain->Next(), iter->Next()) {
+      ASSERT_EQ(IterStatus(plain), IterStatus(iter));
+    }
+    ASSERT_TRUE(!iter->Valid());
+    ASSERT_OK(iter->status());
+
+    // Reverse scans and seeks do not prefetch, but still work.
+    iter->SeekToLast();
+    ASSERT_EQ("key000999", iter->key().ToString());
+    iter->Prev();
+    ASSERT_EQ("key000998", iter->key().ToString());
+    iter->Seek("key000500");
+    ASSERT_EQ("key000500", iter->key().ToString());
+    delete plain;
+    delete iter;
+  } while (ChangeOptions());
+}
+
 TEST(DBTest, Recover) {
   do {
     ASSERT_OK(Put("foo", "v1"));
@@ -1064,6 +1369,46 @@ TEST(DBTest, RecoverWithLargeLog) {
   ASSERT_GT(NumTableFilesAtLevel(0), 1);
 }
 
+TEST(DBTest, RateLimiter) {
+  RateLimiter* limiter = NewRateLimiter(4 << 20);
+  Options options = CurrentOptions();
+  options.rate_limiter = limiter;
+  Reopen(&options);
+  std::string property;
+  ASSERT_TRUE(db_->GetProperty("leveldb.rate-limiter", &property));
+
+  // Write 1MB and push it through a flush, a level-0 compaction and a
+  // level-1 compaction, which is 3MB of table files at 4MB/s.
+  Random rnd(301);
+  const uint64_t start = env_->NowMicros();
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 100000)));
+  }
+  Reopen(&options);  // Moves the updates to level-0
+  ASSERT_EQ(1, NumTableFilesAtLevel(0));
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(1));
+  ASSERT_GT(NumTableFilesAtLevel(2), 0);
+  const uint64_t elapsed = env_->NowMicros() - start;
+
+  // Flushes and level-0 compactions are high priority.
+  ASSERT_GE(limiter->GetTotalBytesThrough(RateLimiter::kHigh), 2000000);
+  ASSERT_GE(limiter->GetTotalBytesThrough(RateLimiter::kLow), 1000000);
+  ASSERT_GE(elapsed, 500000);
+
+  ASSERT_TRUE(db_->GetProperty("leveldb.rate-limiter", &property));
+  ASSERT_TRUE(Slice(property).starts_with("Rate limit: 4.0 MB/s\nhigh: ")) <<
+      property;
+  ASSERT_NE(property.find("\nlow : "), std::string::npos) << property;
+
+  Close();
+  delete limiter;
+  options.rate_limiter = nullptr;
+  Reopen(&options);
+  ASSERT_TRUE(!db_->GetProperty("leveldb.rate-limiter", &property));
+}
+
 TEST(DBTest, CompactionsGenerateMultipleFiles) {
   Options options = CurrentOptions();
   options.write_buffer_size = 100000000;        // Large write buffer
@@ -1090,6 +1435,87 @@ TEST(DBTest, CompactionsGenerateMultipleFiles) {
   }
 }
 
+TEST(DBTest, SubcompactionsPreserveData) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000000;        // Large write buffer
+  options.max_subcompactions = 4;
+  Reopen(&options);
+
+  Random rnd(301);
+
+  // Write 8MB (80 values, each 100K) and push it to level-1, where it is
+  // split over several files.
+  std::vector<std::string> values;
+  for (int i = 0; i < 80; i++) {
+    values.push_back(RandomString(&rnd, 100000));
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  Reopen(&options);
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  ASSERT_GT(NumTableFilesAtLevel(1), 1);
+
+  // Overwrite and delete keys all over the key range so that the next
+  // level-0 compaction has several input files to split between threads.
+  for (int i = 0; i < 80; i += 3) {
+    values[i] = RandomString(&rnd, 100000);
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+  for (int i = 1; i < 80; i += 7) {
+    values[i] = "NOT_FOUND";
+    ASSERT_OK(Delete(Key(i)));
+  }
+  Reopen(&options);
+  ASSERT_EQ(0, dbfull()->TEST_SubcompactionsRun());
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  ASSERT_GT(dbfull()->TEST_SubcompactionsRun(), 0);
+
+  ASSERT_EQ(NumTableFilesAtLevel(0), 0);
+  ASSERT_GT(NumTableFilesAtLevel(1), 1);
+  for (int i = 0; i < 80; i++) {
+    ASSERT_EQ(Get(Key(i)), values[i]);
+  }
+  Reopen(&options);
+  for (int i = 0; i < 80; i++) {
+    ASSERT_EQ(Get(Key(i)), values[i]);
+  }
+}
+
+TEST(DBTest, ConcurrentCompactionsPreserveData) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  options.max_background_compactions = 4;
+  Reopen(&options);
+
+  Random rnd(301);
+
+  // Overwrite a key range many times so that compactions are needed at
+  // several levels at once.
+  const int kNumKeys = 2000;
+  std::vector<std::string> values(kNumKeys);
+  for (int round = 0; round < 5; round++) {
+    for (int i = 0; i < kNumKeys; i++) {
+      values[i] = RandomString(&rnd, 1000);
+      ASSERT_OK(Put(Key(i), values[i]));
+    }
+    for (int i = round; i < kNumKeys; i += 11) {
+      values[i] = "NOT_FOUND";
+      ASSERT_OK(Delete(Key(i)));
+    }
+  }
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ(Get(Key(i)), values[i]);
+  }
+
+  Reopen(&options);
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ(Get(Key(i)), values[i]);
+  }
+  db_->CompactRange(nullptr, nullptr);
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ(Get(Key(i)), values[i]);
+  }
+}
+
 TEST(DBTest, RepeatedWritesToSameKey) {
   Options options = CurrentOptions();
   options.env = env_;
@@ -1316,6 +1742,9 @@ TEST(DBTest, HiddenValuesAreRemoved) {
   do {
     Random rnd(301);
     FillLevels("a", "z");
+    // Compact the level-0 files of FillLevels() now, so that no automatic
+    // compaction starts while the snapshot below is held.
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
 
     std::string big = RandomString(&rnd, 50000);
     Put("foo", big);
@@ -1904,73 +2333,574 @@ TEST(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
-// Multi-threaded test:
-namespace {
-
-static const int kNumThreads = 4;
-static const int kTestSeconds = 10;
-static const int kNumKeys = 1000;
+TEST(DBTest, PartitionedIndexAndFilters) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_size = 256;  // Many index and filter partitions per table
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.partition_index_and_filters = true;
+  Reopen(&options);
 
-struct MTState {
-  DBTest* test;
-  port::AtomicPointer stop;
-  port::AtomicPointer counter[kNumThreads];
-  port::AtomicPointer thread_done[kNumThreads];
-};
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
 
-struct MTThread {
-  MTState* state;
-  int id;
-};
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
 
-static void MTThreadBody(void* arg) {
-  MTThread* t = reinterpret_cast<MTThread*>(arg);
-  int id = t->id;
-  DB* db = t->state->test->db_;
-  uintptr_t counter = 0;
-  fprintf(stderr, "... starting thread %d\n", id);
-  Random rnd(1000 + id);
-  std::string value;
-  char valbuf[1500];
-  while (t->state->stop.Acquire_Load() == nullptr) {
-    t->state->counter[id].Release_Store(reinterpret_cast<void*>(counter));
+  // Every lookup reads index and filter partitions, and one data block
+  // if the key is present.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+  const int present_reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d present => %d reads\n", N, present_reads);
 
-    int key = rnd.Uniform(kNumKeys);
-    char keybuf[20];
-    snprintf(keybuf, sizeof(keybuf), "%016d", key);
+  // Missing keys only read a data block when a filter partition gives a
+  // false positive.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  const int missing_reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d missing => %d reads\n", N, missing_reads);
+  ASSERT_LE(missing_reads, present_reads - N + 5*N/100);
 
-    if (rnd.OneIn(2)) {
-      // Write values of the form <key, my id, counter>.
-      // We add some padding for force compactions.
-      snprintf(valbuf, sizeof(valbuf), "%d.%d.%-1000d",
-               key, id, static_cast<int>(counter));
-      ASSERT_OK(db->Put(WriteOptions(), Slice(keybuf), Slice(valbuf)));
-    } else {
-      // Read a value and verify that it matches the pattern written above.
-      Status s = db->Get(ReadOptions(), Slice(keybuf), &value);
-      if (s.IsNotFound()) {
-        // Key has not yet been written
-      } else {
-        // Check that the writer thread counter is >= the counter in the value
-        ASSERT_OK(s);
-        int k, w, c;
-        ASSERT_EQ(3, sscanf(value.c_str(), "%d.%d.%d", &k, &w, &c)) << value;
-        ASSERT_EQ(k, key);
-        ASSERT_GE(w, 0);
-        ASSERT_LT(w, kNumThreads);
-        ASSERT_LE(static_cast<uintptr_t>(c), reinterpret_cast<uintptr_t>(
-            t->state->counter[w].Acquire_Load()));
-      }
-    }
-    counter++;
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(Key(count), iter->key().ToString());
+    count++;
   }
-  t->state->thread_done[id].Release_Store(t);
-  fprintf(stderr, "... stopping thread %d after %d ops\n", id, int(counter));
+  ASSERT_OK(iter->status());
+  ASSERT_EQ(N, count);
+  delete iter;
+
+  env_->delay_data_sync_.Release_Store(nullptr);
+  Close();
+  delete options.filter_policy;
 }
 
-}  // namespace
+TEST(DBTest, WholeTableFilter) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.filter_policy = NewBloomFilterPolicy(10);
+  options.whole_table_filter = true;
+  options.partition_index_and_filters = true;  // Index reads are visible
+  Reopen(&options);
 
-TEST(DBTest, MultiThreaded) {
+  // Populate multiple layers
+  const int N = 10000;
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < N; i += 100) {
+    ASSERT_OK(Put(Key(i), Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
+
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+
+  // Missing keys are ruled out before the index is read, so only false
+  // positives cost any reads: the top-level index, an index partition and
+  // a data block for each.  Without the filter, every lookup would read
+  // at least the index of both tables.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ("NOT_FOUND", Get(Key(i) + ".missing"));
+  }
+  int reads = env_->random_read_counter_.Read();
+  fprintf(stderr, "%d missing => %d reads\n", N, reads);
+  ASSERT_LE(reads, 3 * (3*N/100));
+
+  env_->delay_data_sync_.Release_Store(nullptr);
+  Close();
+  delete options.block_cache;
+  delete options.filter_policy;
+}
+
+TEST(DBTest, IterUpperBoundSkipsDeletedBlocks) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  Reopen(&options);
+
+  // Keys 500 and later are deleted, by tombstones in a newer table
+  const int N = 1000;
+  Random rnd(301);
+  for (int i = 0; i < N; i++) {
+    ASSERT_OK(Put(Key(i), RandomString(&rnd, 100)));
+  }
+  Compact("a", "z");
+  for (int i = N/2; i < N; i++) {
+    ASSERT_OK(Delete(Key(i)));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
+
+  std::string limit = Key(N/2);
+  Slice upper(limit);
+  for (int bounded = 0; bounded < 2; bounded++) {
+    ReadOptions read_options;
+    if (bounded) {
+      read_options.iterate_upper_bound = &upper;
+    }
+    env_->random_read_counter_.Reset();
+    Iterator* iter = db_->NewIterator(read_options);
+    int count = 0;
+    for (iter->Seek(Key(N/2 - 10)); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    ASSERT_OK(iter->status());
+    ASSERT_EQ(10, count);
+    delete iter;
+    const int reads = env_->random_read_counter_.Read();
+    if (bounded) {
+      ASSERT_LE(reads, 4);
+    } else {
+      ASSERT_GE(reads, 10);
+    }
+  }
+
+  env_->delay_data_sync_.Release_Store(nullptr);
+  Close();
+  delete options.block_cache;
+}
+
+static std::string TenantKey(int tenant, int object) {
+  char buf[100];
+  snprintf(buf, sizeof(buf), "t%03d|%05d", tenant, object);
+  return std::string(buf);
+}
+
+TEST(DBTest, PrefixSeek) {
+  const SliceTransform* prefix_extractor = NewFixedPrefixTransform(4);
+  for (int whole_table_filter = 0; whole_table_filter < 2;
+       whole_table_filter++) {
+    env_->count_random_reads_ = true;
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.create_if_missing = true;
+    options.block_cache = NewLRUCache(0);  // Prevent cache hits
+    options.filter_policy = NewBloomFilterPolicy(16);
+    options.whole_table_filter = (whole_table_filter != 0);
+    options.prefix_extractor = prefix_extractor;
+    DestroyAndReopen(&options);
+
+    // Only even tenants have keys
+    const int kTenants = 100;
+    const int kObjects = 50;
+    for (int t = 0; t < kTenants; t += 2) {
+      for (int i = 0; i < kObjects; i++) {
+        ASSERT_OK(Put(TenantKey(t, i), "v"));
+      }
+    }
+    Compact("a", "z");
+    ASSERT_OK(Put(TenantKey(4, kObjects), "v"));  // In the memtable
+
+    // Prevent auto compactions triggered by seeks
+    env_->delay_data_sync_.Release_Store(env_);
+
+    ReadOptions prefix_options;
+    prefix_options.prefix_same_as_start = true;
+    Iterator* iter = db_->NewIterator(prefix_options);
+
+    // Only the keys of the target's tenant are yielded
+    int count = 0;
+    for (iter->Seek("t004|"); iter->Valid(); iter->Next()) {
+      ASSERT_EQ(TenantKey(4, count), iter->key().ToString());
+      count++;
+    }
+    ASSERT_OK(iter->status());
+    ASSERT_EQ(kObjects + 1, count);
+    iter->Seek(TenantKey(6, 10));
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(TenantKey(6, 10), iter->key().ToString());
+
+    // The table is never read for tenants it does not hold
+    env_->random_read_counter_.Reset();
+    for (int t = 1; t < kTenants; t += 2) {
+      iter->Seek(TenantKey(t, 0));
+      ASSERT_TRUE(!iter->Valid());
+      ASSERT_OK(iter->status());
+    }
+    ASSERT_LE(env_->random_read_counter_.Read(), kTenants/20);
+
+    // A target without a prefix does not confine the iterator
+    iter->Seek("t00");
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(TenantKey(0, 0), iter->key().ToString());
+    iter->Seek(TenantKey(2, kObjects - 1));
+    iter->Next();
+    ASSERT_TRUE(!iter->Valid());
+
+    // Without prefix_same_as_start the table is read every time
+    env_->random_read_counter_.Reset();
+    for (int t = 1; t < kTenants - 1; t += 2) {
+      Iterator* plain = db_->NewIterator(ReadOptions());
+      plain->Seek(TenantKey(t, 0));
+      ASSERT_TRUE(plain->Valid());
+      ASSERT_EQ(TenantKey(t + 1, 0), plain->key().ToString());
+      delete plain;
+    }
+    ASSERT_GE(env_->random_read_counter_.Read(), kTenants/2 - 1);
+
+    // Going backwards is not supported after a Seek() to a prefix
+    iter->Seek(TenantKey(8, 1));
+    ASSERT_TRUE(iter->Valid());
+    iter->Prev();
+    ASSERT_TRUE(!iter->Valid());
+    ASSERT_TRUE(iter->status().IsNotSupportedError());
+    delete iter;
+
+    // but is after the other ways of positioning the iterator
+    iter = db_->NewIterator(prefix_options);
+    iter->SeekToLast();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(TenantKey(kTenants - 2, kObjects - 1), iter->key().ToString());
+    iter->Prev();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(TenantKey(kTenants - 2, kObjects - 2), iter->key().ToString());
+    iter->SeekToFirst();
+    iter->Next();
+    iter->Prev();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(TenantKey(0, 0), iter->key().ToString());
+    iter->Seek("t00");
+    iter->Next();
+    iter->Prev();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(TenantKey(0, 0), iter->key().ToString());
+    ASSERT_OK(iter->status());
+    delete iter;
+
+    // SeekToFirst() is not confined to a prefix
+    iter = db_->NewIterator(prefix_options);
+    count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    ASSERT_OK(iter->status());
+    ASSERT_EQ(kTenants/2 * kObjects + 1, count);
+    delete iter;
+
+    // Nor is SeekToFirst() with a lower bound, even one whose prefix the
+    // filters rule out
+    const std::string lower = TenantKey(9, 0);
+    Slice lower_slice(lower);
+    ReadOptions bounded_options = prefix_options;
+    bounded_options.iterate_lower_bound = &lower_slice;
+    iter = db_->NewIterator(bounded_options);
+    count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_GE(iter->key().ToString(), lower);
+      count++;
+    }
+    ASSERT_OK(iter->status());
+    ASSERT_EQ((kTenants/2 - 5) * kObjects, count);
+    delete iter;
+    env_->delay_data_sync_.Release_Store(nullptr);
+
+    // Reopening without the extractor ignores the prefixes in the filters,
+    // which still rule out the missing keys
+    options.prefix_extractor = nullptr;
+    Reopen(&options);
+    env_->delay_data_sync_.Release_Store(env_);
+    ASSERT_EQ("v", Get(TenantKey(2, 3)));  // Opens the table
+    env_->random_read_counter_.Reset();
+    for (int t = 1; t < kTenants; t += 2) {
+      ASSERT_EQ("NOT_FOUND", Get(TenantKey(t, 3)));
+    }
+    ASSERT_LE(env_->random_read_counter_.Read(), kTenants/20);
+    iter = db_->NewIterator(prefix_options);
+    iter->Seek(TenantKey(3, 0));
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(TenantKey(4, 0), iter->key().ToString());
+    delete iter;
+    env_->delay_data_sync_.Release_Store(nullptr);
+
+    // Tables built without the extractor are not searched for prefixes
+    // once it is set, but their filters still serve point lookups
+    DestroyAndReopen(&options);
+    for (int t = 0; t < kTenants; t += 2) {
+      for (int i = 0; i < kObjects; i++) {
+        ASSERT_OK(Put(TenantKey(t, i), "v"));
+      }
+    }
+    Compact("a", "z");
+    options.prefix_extractor = prefix_extractor;
+    Reopen(&options);
+    env_->delay_data_sync_.Release_Store(env_);
+    ASSERT_EQ("v", Get(TenantKey(2, 3)));  // Opens the table
+    env_->random_read_counter_.Reset();
+    for (int t = 1; t < kTenants; t += 2) {
+      ASSERT_EQ("NOT_FOUND", Get(TenantKey(t, 3)));
+    }
+    ASSERT_LE(env_->random_read_counter_.Read(), kTenants/20);
+    iter = db_->NewIterator(prefix_options);
+    iter->Seek(TenantKey(4, 0));
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(TenantKey(4, 0), iter->key().ToString());
+    delete iter;
+    env_->delay_data_sync_.Release_Store(nullptr);
+
+    Close();
+    delete options.block_cache;
+    delete options.filter_policy;
+  }
+  delete prefix_extractor;
+}
+
+TEST(DBTest, MultiGetReadsBlocksOnce) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  Reopen(&options);
+
+  const int N = 10000;
+  std::vector<std::string> keys;
+  for (int i = 0; i < N; i++) {
+    keys.push_back(Key(i));
+    ASSERT_OK(Put(keys.back(), keys.back()));
+  }
+  Compact("a", "z");
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
+
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(keys[i], Get(keys[i]));
+  }
+  int get_reads = env_->random_read_counter_.Read();
+
+  // Adjacent keys share their data block, which a batch reads only once.
+  env_->random_read_counter_.Reset();
+  std::vector<std::string> values = MultiGet(keys);
+  int multiget_reads = env_->random_read_counter_.Read();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(keys[i], values[i]);
+  }
+  ASSERT_GE(get_reads, N);
+  ASSERT_LE(multiget_reads, N/10);
+
+  env_->delay_data_sync_.Release_Store(nullptr);
+  Close();
+  delete options.block_cache;
+}
+
+TEST(DBTest, CompressedBlockCache) {
+  if (!test::SnappyCompressionSupported()) {
+    fprintf(stderr, "skipping compression tests\n");
+    return;
+  }
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.compression = kSnappyCompression;
+  options.block_cache = NewLRUCache(0);  // Every block misses this cache
+  options.block_cache_compressed = NewLRUCache(8 << 20);
+  Reopen(&options);
+
+  const int N = 1000;
+  std::vector<std::string> keys;
+  for (int i = 0; i < N; i++) {
+    keys.push_back(Key(i));
+    ASSERT_OK(Put(keys.back(), keys.back() + std::string(1000, 'x')));
+  }
+  Compact("a", "z");
+
+  // Prevent auto compactions triggered by seeks
+  env_->delay_data_sync_.Release_Store(env_);
+
+  // The first read of every block goes to disk, and leaves the block in
+  // the compressed cache for all later reads.
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(keys[i] + std::string(1000, 'x'), Get(keys[i]));
+  }
+  const int first_reads = env_->random_read_counter_.Read();
+  env_->random_read_counter_.Reset();
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(keys[i] + std::string(1000, 'x'), Get(keys[i]));
+  }
+  std::vector<std::string> values = MultiGet(keys);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(keys[i] + std::string(1000, 'x'), values[i]);
+  }
+  const int second_reads = env_->random_read_counter_.Read();
+  const size_t charge = options.block_cache_compressed->TotalCharge();
+  ASSERT_GT(first_reads, 0);
+  ASSERT_LT(first_reads, N);
+  ASSERT_EQ(0, second_reads);
+  ASSERT_LT(charge, N * 1000 / 4);
+
+  env_->delay_data_sync_.Release_Store(nullptr);
+  Close();
+  delete options.block_cache;
+  delete options.block_cache_compressed;
+}
+
+TEST(DBTest, CompressionPerLevel) {
+  if (!test::ZstdCompressionSupported()) {
+    fprintf(stderr, "skipping compression tests\n");
+    return;
+  }
+  Options options = CurrentOptions();
+  options.compression_per_level.push_back(kNoCompression);
+  options.compression_per_level.push_back(kZstdCompression);
+  Reopen(&options);
+
+  Random rnd(301);
+  std::vector<std::string> values;
+  std::string tmp;
+  for (int i = 0; i < 100; i++) {
+    values.push_back(test::CompressibleString(&rnd, 0.25, 10000, &tmp)
+                     .ToString());
+    ASSERT_OK(Put(Key(i), values[i]));
+  }
+
+  // Flushed tables are not compressed, whatever level they end up in.
+  dbfull()->TEST_CompactMemTable();
+  const uint64_t flushed_size = Size("", Key(100));
+  ASSERT_GE(flushed_size, 100 * 10000);
+
+  // Compactions into levels 1 and up use zstd.
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    if (NumTableFilesAtLevel(level) > 0) {
+      dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+      break;
+    }
+  }
+  const uint64_t compacted_size = Size("", Key(100));
+  ASSERT_LT(compacted_size, flushed_size / 2);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
+TEST(DBTest, MultiGetIoUring) {
+  Env* io_uring_env = NewIoUringEnv(env_);
+  Options options = CurrentOptions();
+  options.env = io_uring_env;
+  options.block_cache = NewLRUCache(0);  // Read every block from the file
+  Reopen(&options);
+
+  const int N = 5000;
+  for (int i = 0; i < N; i += 2) {
+    ASSERT_OK(Put(Key(i), std::string(200, 'v') + Key(i)));
+  }
+  Compact("a", "z");
+  for (int i = 0; i < N; i += 10) {
+    ASSERT_OK(Put(Key(i), "overwritten"));
+  }
+  dbfull()->TEST_CompactMemTable();
+
+  // Batches that span many data blocks, including absent keys.
+  Random rnd(301);
+  for (int batch = 0; batch < 10; batch++) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 300; i++) {
+      keys.push_back(Key(rnd.Uniform(N + 10)));
+    }
+    std::vector<std::string> values = MultiGet(keys, nullptr, 1 + batch % 3);
+    for (size_t i = 0; i < keys.size(); i++) {
+      ASSERT_EQ(Get(keys[i]), values[i]) << keys[i];
+    }
+  }
+
+  Close();
+  delete options.block_cache;
+  delete io_uring_env;
+}
+
+// Multi-threaded test:
+namespace {
+
+static const int kNumThreads = 4;
+static const int kTestSeconds = 10;
+static const int kNumKeys = 1000;
+
+struct MTState {
+  DBTest* test;
+  port::AtomicPointer stop;
+  port::AtomicPointer counter[kNumThreads];
+  port::AtomicPointer thread_done[kNumThreads];
+};
+
+struct MTThread {
+  MTState* state;
+  int id;
+};
+
+static void MTThreadBody(void* arg) {
+  MTThread* t = reinterpret_cast<MTThread*>(arg);
+  int id = t->id;
+  DB* db = t->state->test->db_;
+  uintptr_t counter = 0;
+  fprintf(stderr, "... starting thread %d\n", id);
+  Random rnd(1000 + id);
+  std::string value;
+  char valbuf[1500];
+  while (t->state->stop.Acquire_Load() == nullptr) {
+    t->state->counter[id].Release_Store(reinterpret_cast<void*>(counter));
+
+    int key = rnd.Uniform(kNumKeys);
+    char keybuf[20];
+    snprintf(keybuf, sizeof(keybuf), "%016d", key);
+
+    if (rnd.OneIn(2)) {
+      // Write values of the form <key, my id, counter>.
+      // We add some padding for force compactions.
+      snprintf(valbuf, sizeof(valbuf), "%d.%d.%-1000d",
+               key, id, static_cast<int>(counter));
+      ASSERT_OK(db->Put(WriteOptions(), Slice(keybuf), Slice(valbuf)));
+    } else {
+      // Read a value and verify that it matches the pattern written above.
+      Status s = db->Get(ReadOptions(), Slice(keybuf), &value);
+      if (s.IsNotFound()) {
+        // Key has not yet been written
+      } else {
+        // Check that the writer thread counter is >= the counter in the value
+        ASSERT_OK(s);
+        int k, w, c;
+        ASSERT_EQ(3, sscanf(value.c_str(), "%d.%d.%d", &k, &w, &c)) << value;
+        ASSERT_EQ(k, key);
+        ASSERT_GE(w, 0);
+        ASSERT_LT(w, kNumThreads);
+        ASSERT_LE(static_cast<uintptr_t>(c), reinterpret_cast<uintptr_t>(
+            t->state->counter[w].Acquire_Load()));
+      }
+    }
+    counter++;
+  }
+  t->state->thread_done[id].Release_Store(t);
+  fprintf(stderr, "... stopping thread %d after %d ops\n", id, int(counter));
+}
+
+}  // namespace
+
+TEST(DBTest, MultiThreaded) {
   do {
     // Initialize state
     MTState mt;
@@ -2002,6 +2932,295 @@ TEST(DBTest, MultiThreaded) {
   } while (ChangeOptions());
 }
 
+static SequenceNumber LastSequence(DB* db) {
+  const Snapshot* snapshot = db->GetSnapshot();
+  const SequenceNumber sequence =
+      reinterpret_cast<const SnapshotImpl*>(snapshot)->sequence_number();
+  db->ReleaseSnapshot(snapshot);
+  return sequence;
+}
+
+// Build an external table at "fname" that maps Key(i) to "value" for
+// every i in [from,to) and deletes the keys in "deleted".
+static Status BuildExternalFile(const Options& options,
+                                const std::string& fname, int from, int to,
+                                const std::string& value,
+                                const std::set<int>& deleted) {
+  SstFileWriter writer(options);
+  Status s = writer.Open(fname);
+  for (int i = from; s.ok() && i < to; i++) {
+    if (deleted.count(i) > 0) {
+      s = writer.Delete(Key(i));
+    } else {
+      s = writer.Put(Key(i), value);
+    }
+  }
+  if (s.ok()) {
+    s = writer.Finish();
+  }
+  return s;
+}
+
+TEST(DBTest, IngestExternalFileNonOverlapping) {
+  const std::string fname = dbname_ + ".external";
+  do {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_OK(Put(Key(i), "old"));
+    }
+    dbfull()->TEST_CompactMemTable();
+
+    // Nothing holds the keys of the file, so it goes to the last level
+    // and keeps its keys' sequence number.
+    ASSERT_OK(BuildExternalFile(CurrentOptions(), fname, 200, 300, "new",
+                                std::set<int>()));
+    const SequenceNumber before = LastSequence(db_);
+    ASSERT_OK(db_->IngestExternalFile(IngestExternalFileOptions(), fname));
+    ASSERT_EQ(before, LastSequence(db_));
+    ASSERT_EQ(1, NumTableFilesAtLevel(config::kNumLevels - 1));
+    ASSERT_TRUE(env_->FileExists(fname));
+
+    for (int i = 0; i < 300; i++) {
+      ASSERT_EQ(i < 100 ? "old" : (i < 200 ? "NOT_FOUND" : "new"),
+                Get(Key(i)));
+    }
+    Reopen();
+    ASSERT_EQ("new", Get(Key(250)));
+    ASSERT_EQ("old", Get(Key(50)));
+
+    // Writes after the ingestion win over it.
+    ASSERT_OK(Put(Key(250), "later"));
+    Compact(Key(0), Key(300));
+    ASSERT_EQ("later", Get(Key(250)));
+    ASSERT_EQ("new", Get(Key(251)));
+  } while (ChangeOptions());
+  env_->DeleteFile(fname);
+}
+
+TEST(DBTest, IngestExternalFileOverlapping) {
+  const std::string fname = dbname_ + ".external";
+  do {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_OK(Put(Key(i), "old"));
+    }
+    Compact(Key(0), Key(100));
+    ASSERT_OK(Put(Key(50), "mem"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+
+    std::set<int> deleted;
+    deleted.insert(45);
+    ASSERT_OK(BuildExternalFile(CurrentOptions(), fname, 40, 60, "new",
+                                deleted));
+    ASSERT_OK(db_->IngestExternalFile(IngestExternalFileOptions(), fname));
+
+    // The ingested keys hide the memtable and the older tables, but not
+    // from the earlier snapshot.
+    ASSERT_EQ("old", Get(Key(39)));
+    ASSERT_EQ("new", Get(Key(40)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(45)));
+    ASSERT_EQ("new", Get(Key(50)));
+    ASSERT_EQ("old", Get(Key(60)));
+    ASSERT_EQ("old", Get(Key(40), snapshot));
+    ASSERT_EQ("old", Get(Key(45), snapshot));
+    ASSERT_EQ("mem", Get(Key(50), snapshot));
+    std::vector<std::string> keys;
+    keys.push_back(Key(40));
+    keys.push_back(Key(45));
+    keys.push_back(Key(50));
+    std::vector<std::string> values = MultiGet(keys);
+    ASSERT_EQ("new", values[0]);
+    ASSERT_EQ("NOT_FOUND", values[1]);
+    ASSERT_EQ("new", values[2]);
+    values = MultiGet(keys, snapshot);
+    ASSERT_EQ("old", values[0]);
+    ASSERT_EQ("old", values[1]);
+    ASSERT_EQ("mem", values[2]);
+
+    ASSERT_OK(Put(Key(41), "later"));
+    std::string expected;
+    for (int i = 0; i < 100; i++) {
+      if (i == 45) continue;
+      expected += "(" + Key(i) + "->" +
+          (i == 41 ? "later" : (i >= 40 && i < 60 ? "new" : "old")) + ")";
+    }
+    ASSERT_EQ(expected, Contents());
+
+    // Compactions rewrite the ingested keys with their sequence number,
+    // which survives reopening the database.
+    Compact(Key(0), Key(100));
+    ASSERT_EQ(expected, Contents());
+    ASSERT_EQ("mem", Get(Key(50), snapshot));
+    db_->ReleaseSnapshot(snapshot);
+    Reopen();
+    ASSERT_EQ(expected, Contents());
+  } while (ChangeOptions());
+  env_->DeleteFile(fname);
+}
+
+TEST(DBTest, IngestExternalFileReopen) {
+  // An ingested file keeps its sequence number in the MANIFEST until a
+  // compaction rewrites it.
+  const std::string fname = dbname_ + ".external";
+  ASSERT_OK(Put(Key(1), "old"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_OK(BuildExternalFile(CurrentOptions(), fname, 0, 10, "new",
+                              std::set<int>()));
+  IngestExternalFileOptions ingest_options;
+  ingest_options.move_files = true;
+  ASSERT_OK(db_->IngestExternalFile(ingest_options, fname));
+  ASSERT_TRUE(!env_->FileExists(fname));
+  Reopen();
+
+  // Without its sequence number, the file would lose to the older value
+  // of Key(1) once they are merged.
+  Compact(Key(0), Key(10));
+  ASSERT_EQ("new", Get(Key(1)));
+  ASSERT_EQ("new", Get(Key(9)));
+}
+
+TEST(DBTest, IngestExternalFileErrors) {
+  const std::string fname = dbname_ + ".external";
+  Options options = CurrentOptions();
+  {
+    SstFileWriter writer(options);
+    ASSERT_TRUE(writer.Put("a", "v").IsInvalidArgument());
+    ASSERT_OK(writer.Open(fname));
+    ASSERT_TRUE(writer.Finish().IsInvalidArgument());
+    ASSERT_OK(writer.Put("b", "v"));
+    ASSERT_TRUE(writer.Put("b", "v").IsInvalidArgument());
+    ASSERT_TRUE(writer.Put("a", "v").IsInvalidArgument());
+    ASSERT_OK(writer.Put("c", "v"));
+    ASSERT_EQ(2, writer.NumEntries());
+  }
+  // An abandoned writer removes its file.
+  ASSERT_TRUE(!env_->FileExists(fname));
+  ASSERT_TRUE(!db_->IngestExternalFile(IngestExternalFileOptions(),
+                                       fname).ok());
+
+  // A file that is not a table is rejected and leaves nothing behind.
+  ASSERT_OK(WriteStringToFile(env_, "not a table", fname));
+  ASSERT_TRUE(!db_->IngestExternalFile(IngestExternalFileOptions(),
+                                       fname).ok());
+  ASSERT_EQ("", FilesPerLevel());
+  env_->DeleteFile(fname);
+}
+
+TEST(DBTest, DeleteRange) {
+  do {
+    ASSERT_OK(Put("a", "va"));
+    ASSERT_OK(Put("b", "vb"));
+    ASSERT_OK(Put("c", "vc"));
+    ASSERT_OK(Put("d", "vd"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), "b", "d"));
+    ASSERT_OK(Put("c", "vc2"));
+
+    for (int i = 0; i < 3; i++) {
+      // In the memtable, then in a table, then after reopening
+      ASSERT_EQ("va", Get("a"));
+      ASSERT_EQ("NOT_FOUND", Get("b"));
+      ASSERT_EQ("vc2", Get("c"));
+      ASSERT_EQ("vd", Get("d"));
+      ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+      if (i < 2) {
+        ASSERT_EQ("vb", Get("b", snapshot));
+        ASSERT_EQ("vc", Get("c", snapshot));
+      }
+      if (i == 0) {
+        dbfull()->TEST_CompactMemTable();
+      } else if (i == 1) {
+        db_->ReleaseSnapshot(snapshot);
+        Reopen();
+      }
+    }
+
+    // Empty and inverted ranges delete nothing
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), "a", "a"));
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), "d", "a"));
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, DeleteRangeCompaction) {
+  do {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_OK(Put(Key(i), "v" + Key(i)));
+    }
+    db_->CompactRange(nullptr, nullptr);
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(10), Key(20)));
+    ASSERT_EQ("v" + Key(9), Get(Key(9)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(10)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(19)));
+    ASSERT_EQ("v" + Key(20), Get(Key(20)));
+
+    // The range deletion stays in the table it is flushed to...
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("[ v" + Key(15) + " ]", AllEntriesFor(Key(15)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(15)));
+
+    // ...until a compaction drops the entries it hides, as long as no
+    // snapshot still sees them.
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(30), Key(40)));
+    db_->CompactRange(nullptr, nullptr);
+    ASSERT_EQ("[ ]", AllEntriesFor(Key(15)));
+    ASSERT_EQ("[ v" + Key(35) + " ]", AllEntriesFor(Key(35)));
+    ASSERT_EQ("v" + Key(35), Get(Key(35), snapshot));
+    ASSERT_EQ("NOT_FOUND", Get(Key(35)));
+    db_->ReleaseSnapshot(snapshot);
+    for (int level = 0; level < config::kNumLevels - 1; level++) {
+      dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+    }
+    ASSERT_EQ("[ ]", AllEntriesFor(Key(35)));
+
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    int count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      count++;
+    }
+    ASSERT_OK(iter->status());
+    delete iter;
+    ASSERT_EQ(80, count);
+    ASSERT_EQ("v" + Key(29), Get(Key(29)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(30)));
+    ASSERT_EQ("v" + Key(40), Get(Key(40)));
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, DeleteRangeMultiGet) {
+  do {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 20; i++) {
+      keys.push_back(Key(i));
+      ASSERT_OK(Put(Key(i), "v"));
+    }
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(2), Key(5)));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_OK(db_->DeleteRange(WriteOptions(), Key(8), Key(10)));
+    std::vector<std::string> values = MultiGet(keys);
+    for (int i = 0; i < 20; i++) {
+      const bool deleted = (i >= 2 && i < 5) || (i >= 8 && i < 10);
+      ASSERT_EQ(deleted ? "NOT_FOUND" : "v", values[i]);
+    }
+  } while (ChangeOptions());
+}
+
+TEST(DBTest, DeleteRangeThenIngest) {
+  const std::string fname = dbname_ + ".external";
+  ASSERT_OK(Put("a", "va"));
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), "k", "q"));
+  {
+    SstFileWriter writer(CurrentOptions());
+    ASSERT_OK(writer.Open(fname));
+    ASSERT_OK(writer.Put("m", "vm"));
+    ASSERT_OK(writer.Finish());
+  }
+  // The ingested file is newer than the range deletion
+  ASSERT_OK(db_->IngestExternalFile(IngestExternalFileOptions(), fname));
+  ASSERT_EQ("vm", Get("m"));
+  ASSERT_EQ("(a->va)(m->vm)", Contents());
+  env_->DeleteFile(fname);
+}
+
 namespace {
 typedef std::map<std::string, std::string> KVMap;
 }
@@ -2056,6 +3275,12 @@ class ModelDB: public DB {
       virtual void Delete(const Slice& key) {
         map_->erase(key.ToString());
       }
+      virtual void DeleteRange(const Slice& begin, const Slice& end) {
+        if (begin.compare(end) < 0) {
+          map_->erase(map_->lower_bound(begin.ToString()),
+                      map_->lower_bound(end.ToString()));
+        }
+      }
     };
     Handler handler;
     handler.map_ = &map_;
@@ -2227,6 +3452,63 @@ TEST(DBTest, Randomized) {
   } while (ChangeOptions());
 }
 
+TEST(DBTest, RandomizedRangeDeletions) {
+  Random rnd(test::RandomSeed());
+  do {
+    ModelDB model(CurrentOptions());
+    const int N = 2000;
+    const Snapshot* model_snap = nullptr;
+    const Snapshot* db_snap = nullptr;
+    std::string k, k2, v;
+    for (int step = 0; step < N; step++) {
+      int p = rnd.Uniform(100);
+      if (p < 60) {                               // Put
+        k = RandomKey(&rnd);
+        v = RandomString(&rnd, rnd.Uniform(8));
+        ASSERT_OK(model.Put(WriteOptions(), k, v));
+        ASSERT_OK(db_->Put(WriteOptions(), k, v));
+      } else if (p < 75) {                        // Delete
+        k = RandomKey(&rnd);
+        ASSERT_OK(model.Delete(WriteOptions(), k));
+        ASSERT_OK(db_->Delete(WriteOptions(), k));
+      } else if (p < 85) {                        // DeleteRange
+        k = RandomKey(&rnd);
+        k2 = RandomKey(&rnd);
+        ASSERT_OK(model.DeleteRange(WriteOptions(), k, k2));
+        ASSERT_OK(db_->DeleteRange(WriteOptions(), k, k2));
+      } else if (p < 90) {                        // Flush or compact
+        if (rnd.OneIn(3)) {
+          db_->CompactRange(nullptr, nullptr);
+        } else {
+          dbfull()->TEST_CompactMemTable();
+        }
+      } else {                                    // Check a key
+        k = RandomKey(&rnd);
+        Iterator* miter = model.NewIterator(ReadOptions());
+        miter->Seek(k);
+        const bool found = miter->Valid() && miter->key() == k;
+        ASSERT_EQ(found ? miter->value().ToString() : "NOT_FOUND", Get(k));
+        delete miter;
+      }
+
+      if ((step % 100) == 0) {
+        ASSERT_TRUE(CompareIterators(step, &model, db_, nullptr, nullptr));
+        ASSERT_TRUE(CompareIterators(step, &model, db_, model_snap, db_snap));
+        if (model_snap != nullptr) model.ReleaseSnapshot(model_snap);
+        if (db_snap != nullptr) db_->ReleaseSnapshot(db_snap);
+
+        Reopen();
+        ASSERT_TRUE(CompareIterators(step, &model, db_, nullptr, nullptr));
+
+        model_snap = model.GetSnapshot();
+        db_snap = db_->GetSnapshot();
+      }
+    }
+    if (model_snap != nullptr) model.ReleaseSnapshot(model_snap);
+    if (db_snap != nullptr) db_->ReleaseSnapshot(db_snap);
+  } while (ChangeOptions());
+}
+
 std::string MakeKey(unsigned int num) {
   char buf[30];
   snprintf(buf, sizeof(buf), "%016u", num);
@@ -3,6 +3,7 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include <stdio.h>
+#include <vector>
 #include "db/dbformat.h"
 #include "port/port.h"
 #include "util/coding.h"
@@ -98,6 +99,12 @@ void InternalKeyComparator::FindShortSuccessor(std::string* key) const {
   }
 }
 
+InternalFilterPolicy::InternalFilterPolicy(
+    const FilterPolicy* p, const SliceTransform* prefix_extractor)
+    : user_policy_(p),
+      prefix_extractor_(prefix_extractor) {
+}
+
 const char* InternalFilterPolicy::Name() const {
   return user_policy_->Name();
 }
@@ -111,7 +118,27 @@ void InternalFilterPolicy::CreateFilter(const Slice* keys, int n,
     mkey[i] = ExtractUserKey(keys[i]);
     // TODO(sanjay): Suppress dups?
   }
-  user_policy_->CreateFilter(keys, n, dst);
+  if (prefix_extractor_ == nullptr || n == 0) {
+    user_policy_->CreateFilter(keys, n, dst);
+    return;
+  }
+
+  // The keys that share a prefix are adjacent, so each prefix only needs
+  // to be compared with the last one added.
+  std::vector<Slice> all(keys, keys + n);
+  Slice last_prefix;
+  bool has_prefix = false;
+  for (int i = 0; i < n; i++) {
+    if (prefix_extractor_->InDomain(keys[i])) {
+      Slice prefix = prefix_extractor_->Transform(keys[i]);
+      if (!has_prefix || prefix != last_prefix) {
+        all.push_back(prefix);
+        last_prefix = prefix;
+        has_prefix = true;
+      }
+    }
+  }
+  user_policy_->CreateFilter(&all[0], static_cast<int>(all.size()), dst);
 }
 
 bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const {
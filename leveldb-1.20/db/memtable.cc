@@ -7,7 +7,9 @@
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "leveldb/memtable_factory.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -21,21 +23,32 @@ static Slice GetLengthPrefixedSlice(const char* data) {
 MemTable::MemTable(const InternalKeyComparator& cmp)
     : comparator_(cmp),
       refs_(0),
-      table_(comparator_, &arena_) {
+      table_(NewSkipListRep(comparator_, &arena_)),
+      range_deletions_(cmp.user_comparator()),
+      has_range_deletions_(false),
+      range_deletion_bytes_(0) {
+}
+
+MemTable::MemTable(const InternalKeyComparator& cmp,
+                   const MemTableFactory* factory)
+    : comparator_(cmp),
+      refs_(0),
+      table_(factory == nullptr
+             ? NewSkipListRep(comparator_, &arena_)
+             : factory->NewRep(comparator_, &arena_)),
+      range_deletions_(cmp.user_comparator()),
+      has_range_deletions_(false),
+      range_deletion_bytes_(0) {
 }
 
 MemTable::~MemTable() {
   assert(refs_ == 0);
+  delete table_;
 }
 
-size_t MemTable::ApproximateMemoryUsage() { return arena_.MemoryUsage(); }
-
-int MemTable::KeyComparator::operator()(const char* aptr, const char* bptr)
-    const {
-  // Internal keys are encoded as length-prefixed strings.
-  Slice a = GetLengthPrefixedSlice(aptr);
-  Slice b = GetLengthPrefixedSlice(bptr);
-  return comparator.Compare(a, b);
+size_t MemTable::ApproximateMemoryUsage() {
+  return arena_.MemoryUsage() +
+         range_deletion_bytes_.load(std::memory_order_relaxed);
 }
 
 // Encode a suitable internal key target for "target" and return it.
@@ -50,24 +63,26 @@ static const char* EncodeKey(std::string* scratch, const Slice& target) {
 
 class MemTableIterator: public Iterator {
  public:
-  explicit MemTableIterator(MemTable::Table* table) : iter_(table) { }
-
-  virtual bool Valid() const { return iter_.Valid(); }
-  virtual void Seek(const Slice& k) { iter_.Seek(EncodeKey(&tmp_, k)); }
-  virtual void SeekToFirst() { iter_.SeekToFirst(); }
-  virtual void SeekToLast() { iter_.SeekToLast(); }
-  virtual void Next() { iter_.Next(); }
-  virtual void Prev() { iter_.Prev(); }
-  virtual Slice key() const { return GetLengthPrefixedSlice(iter_.key()); }
+  explicit MemTableIterator(MemTableRep* table)
+      : iter_(table->NewIterator()) { }
+  virtual ~MemTableIterator() { delete iter_; }
+
+  virtual bool Valid() const { return iter_->Valid(); }
+  virtual void Seek(const Slice& k) { iter_->Seek(EncodeKey(&tmp_, k)); }
+  virtual void SeekToFirst() { iter_->SeekToFirst(); }
+  virtual void SeekToLast() { iter_->SeekToLast(); }
+  virtual void Next() { iter_->Next(); }
+  virtual void Prev() { iter_->Prev(); }
+  virtual Slice key() const { return GetLengthPrefixedSlice(iter_->key()); }
   virtual Slice value() const {
-    Slice key_slice = GetLengthPrefixedSlice(iter_.key());
+    Slice key_slice = GetLengthPrefixedSlice(iter_->key());
     return GetLengthPrefixedSlice(key_slice.data() + key_slice.size());
   }
 
   virtual Status status() const { return Status::OK(); }
 
  private:
-  MemTable::Table::Iterator iter_;
+  MemTableRep::Iterator* iter_;
   std::string tmp_;       // For passing to EncodeKey
 
   // No copying allowed
@@ -76,12 +91,17 @@ class MemTableIterator: public Iterator {
 };
 
 Iterator* MemTable::NewIterator() {
-  return new MemTableIterator(&table_);
+  return new MemTableIterator(table_);
 }
 
-void MemTable::Add(SequenceNumber s, ValueType type,
-                   const Slice& key,
-                   const Slice& value) {
+size_t MemTable::EncodedLength(const Slice& key, const Slice& value) {
+  size_t internal_key_size = key.size() + 8;
+  return VarintLength(internal_key_size) + internal_key_size +
+         VarintLength(value.size()) + value.size();
+}
+
+void MemTable::EncodeEntry(char* buf, SequenceNumber s, ValueType type,
+                           const Slice& key, const Slice& value) {
   // Format of an entry is concatenation of:
   //  key_size     : varint32 of internal_key.size()
   //  key bytes    : char[internal_key.size()]
@@ -90,10 +110,6 @@ void MemTable::Add(SequenceNumber s, ValueType type,
   size_t key_size = key.size();
   size_t val_size = value.size();
   size_t internal_key_size = key_size + 8;
-  const size_t encoded_len =
-      VarintLength(internal_key_size) + internal_key_size +
-      VarintLength(val_size) + val_size;
-  char* buf = arena_.Allocate(encoded_len);
   char* p = EncodeVarint32(buf, internal_key_size);
   memcpy(p, key.data(), key_size);
   p += key_size;
@@ -101,15 +117,63 @@ void MemTable::Add(SequenceNumber s, ValueType type,
   p += 8;
   p = EncodeVarint32(p, val_size);
   memcpy(p, value.data(), val_size);
-  assert(p + val_size == buf + encoded_len);
-  table_.Insert(buf);
+  assert(p + val_size == buf + EncodedLength(key, value));
+}
+
+void MemTable::AddRangeDeletion(SequenceNumber s, const Slice& start,
+                                const Slice& end) {
+  MutexLock l(&range_mutex_);
+  range_deletions_.Add(start, end, s);
+  // Rough cost of the map nodes the deletion may add
+  range_deletion_bytes_.fetch_add(2 * (start.size() + end.size() + 64),
+                                  std::memory_order_relaxed);
+  has_range_deletions_.store(true, std::memory_order_release);
+}
+
+void MemTable::GetRangeTombstones(RangeTombstones* result) {
+  if (HasRangeDeletions()) {
+    MutexLock l(&range_mutex_);
+    result->AddAll(range_deletions_);
+  }
+}
+
+void MemTable::Add(SequenceNumber s, ValueType type,
+                   const Slice& key,
+                   const Slice& value) {
+  if (type == kTypeRangeDeletion) {
+    AddRangeDeletion(s, key, value);
+    return;
+  }
+  char* buf = arena_.Allocate(EncodedLength(key, value));
+  EncodeEntry(buf, s, type, key, value);
+  table_->Insert(buf);
+}
+
+void MemTable::AddConcurrently(SequenceNumber s, ValueType type,
+                               const Slice& key,
+                               const Slice& value) {
+  if (type == kTypeRangeDeletion) {
+    AddRangeDeletion(s, key, value);
+    return;
+  }
+  char* buf = arena_.AllocateConcurrently(EncodedLength(key, value));
+  EncodeEntry(buf, s, type, key, value);
+  table_->InsertConcurrently(buf);
 }
 
 bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+  // Entries older than "covering" are hidden by a range deletion
+  SequenceNumber covering = 0;
+  if (HasRangeDeletions()) {
+    Slice ikey = key.internal_key();
+    SequenceNumber snapshot = DecodeFixed64(ikey.data() + ikey.size() - 8) >> 8;
+    MutexLock l(&range_mutex_);
+    covering = range_deletions_.MaxCoveringSequence(key.user_key(), snapshot);
+  }
+
   Slice memkey = key.memtable_key();
-  Table::Iterator iter(&table_);
-  iter.Seek(memkey.data());
-  if (iter.Valid()) {
+  const char* entry = table_->Lookup(memkey.data());
+  if (entry != nullptr) {
     // entry format is:
     //    klength  varint32
     //    userkey  char[klength]
@@ -117,9 +181,8 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
     //    vlength  varint32
     //    value    char[vlength]
     // Check that it belongs to same user key.  We do not check the
-    // sequence number since the Seek() call above should have skipped
+    // sequence number since the Lookup() call above should have skipped
     // all entries with overly large sequence numbers.
-    const char* entry = iter.key();
     uint32_t key_length;
     const char* key_ptr = GetVarint32Ptr(entry, entry+5, &key_length);
     if (comparator_.comparator.user_comparator()->Compare(
@@ -127,6 +190,10 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
             key.user_key()) == 0) {
       // Correct user key
       const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+      if ((tag >> 8) < covering) {
+        *s = Status::NotFound(Slice());
+        return true;
+      }
       switch (static_cast<ValueType>(tag & 0xff)) {
         case kTypeValue: {
           Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
@@ -136,9 +203,15 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
         case kTypeDeletion:
           *s = Status::NotFound(Slice());
           return true;
+        case kTypeRangeDeletion:
+          break;  // Not stored in table_
       }
     }
   }
+  if (covering > 0) {
+    *s = Status::NotFound(Slice());
+    return true;
+  }
   return false;
 }
 
@@ -5,15 +5,20 @@
 #ifndef STORAGE_LEVELDB_DB_MEMTABLE_H_
 #define STORAGE_LEVELDB_DB_MEMTABLE_H_
 
+#include <atomic>
 #include <string>
 #include "leveldb/db.h"
 #include "db/dbformat.h"
-#include "db/skiplist.h"
+#include "db/memtable_rep.h"
+#include "db/range_tombstones.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "util/arena.h"
 
 namespace leveldb {
 
 class InternalKeyComparator;
+class MemTableFactory;
 class MemTableIterator;
 
 class MemTable {
@@ -22,6 +27,12 @@ class MemTable {
   // is zero and the caller must call Ref() at least once.
   explicit MemTable(const InternalKeyComparator& comparator);
 
+  // Like MemTable(comparator), but store the entries in the data
+  // structure created by "factory".  A null factory selects the default
+  // skiplist.
+  MemTable(const InternalKeyComparator& comparator,
+           const MemTableFactory* factory);
+
   // Increase reference count.
   void Ref() { ++refs_; }
 
@@ -49,33 +60,62 @@ class MemTable {
   // Add an entry into memtable that maps key to value at the
   // specified sequence number and with the specified type.
   // Typically value will be empty if type==kTypeDeletion.
+  // If type==kTypeRangeDeletion, the user keys in [key,value) are
+  // deleted; the deletion is not yielded by NewIterator() but by
+  // GetRangeTombstones().
   void Add(SequenceNumber seq, ValueType type,
            const Slice& key,
            const Slice& value);
 
+  // Like Add(), but may be called by several threads at once.
+  // REQUIRES: no concurrent call to Add().
+  void AddConcurrently(SequenceNumber seq, ValueType type,
+                       const Slice& key,
+                       const Slice& value);
+
   // If memtable contains a value for key, store it in *value and return true.
-  // If memtable contains a deletion for key, store a NotFound() error
-  // in *status and return true.
+  // If memtable contains a deletion for key, or a range deletion that
+  // covers key and is newer than any value for it, store a NotFound()
+  // error in *status and return true.
   // Else, return false.
   bool Get(const LookupKey& key, std::string* value, Status* s);
 
+  // Return true iff a range deletion has been added.
+  bool HasRangeDeletions() const {
+    return has_range_deletions_.load(std::memory_order_acquire);
+  }
+
+  // Add the range deletions of this memtable to *result.
+  void GetRangeTombstones(RangeTombstones* result);
+
  private:
   ~MemTable();  // Private since only Unref() should be used to delete it
 
-  struct KeyComparator {
-    const InternalKeyComparator comparator;
-    explicit KeyComparator(const InternalKeyComparator& c) : comparator(c) { }
-    int operator()(const char* a, const char* b) const;
-  };
   friend class MemTableIterator;
   friend class MemTableBackwardIterator;
 
-  typedef SkipList<const char*, KeyComparator> Table;
+  // Return the number of bytes needed to encode an entry.
+  static size_t EncodedLength(const Slice& key, const Slice& value);
+
+  // Encode an entry into buf[0,EncodedLength(key,value)-1].
+  static void EncodeEntry(char* buf, SequenceNumber seq, ValueType type,
+                          const Slice& key, const Slice& value);
 
-  KeyComparator comparator_;
+  MemTableKeyComparator comparator_;
   int refs_;
   Arena arena_;
-  Table table_;
+  MemTableRep* table_;
+
+  // Range deletions are kept out of table_, as they cover keys other
+  // than the one they are stored under.  Writers may add them while
+  // readers look them up, so they are guarded by range_mutex_.
+  port::Mutex range_mutex_;
+  RangeTombstones range_deletions_ GUARDED_BY(range_mutex_);
+  std::atomic<bool> has_range_deletions_;
+  std::atomic<size_t> range_deletion_bytes_;  // Counted as memory usage
+
+  void AddRangeDeletion(SequenceNumber seq, const Slice& start,
+                        const Slice& end);
 
   // No copying allowed
   MemTable(const MemTable&);
@@ -0,0 +1,263 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/memtable_rep.h"
+
+#include <algorithm>
+#include <vector>
+#include "db/skiplist.h"
+#include "leveldb/memtable_factory.h"
+#include "port/port.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+static Slice GetLengthPrefixedSlice(const char* data) {
+  uint32_t len;
+  const char* p = data;
+  p = GetVarint32Ptr(p, p + 5, &len);  // +5: we assume "p" is not corrupted
+  return Slice(p, len);
+}
+
+int MemTableKeyComparator::operator()(const char* aptr, const char* bptr)
+    const {
+  // Internal keys are encoded as length-prefixed strings.
+  Slice a = GetLengthPrefixedSlice(aptr);
+  Slice b = GetLengthPrefixedSlice(bptr);
+  return comparator.Compare(a, b);
+}
+
+MemTableRep::~MemTableRep() { }
+
+MemTableRep::Iterator::~Iterator() { }
+
+MemTableFactory::~MemTableFactory() { }
+
+namespace {
+
+class SkipListRep : public MemTableRep {
+ public:
+  SkipListRep(const MemTableKeyComparator& cmp, Arena* arena)
+      : list_(cmp, arena) { }
+
+  virtual void Insert(const char* entry) { list_.Insert(entry); }
+
+  virtual void InsertConcurrently(const char* entry) {
+    list_.InsertConcurrently(entry);
+  }
+
+  virtual const char* Lookup(const char* key) const {
+    Table::Iterator iter(&list_);
+    iter.Seek(key);
+    return iter.Valid() ? iter.key() : nullptr;
+  }
+
+  virtual MemTableRep::Iterator* NewIterator() const {
+    return new Iter(&list_);
+  }
+
+ private:
+  typedef SkipList<const char*, MemTableKeyComparator> Table;
+
+  class Iter : public MemTableRep::Iterator {
+   public:
+    explicit Iter(const Table* list) : iter_(list) { }
+
+    virtual bool Valid() const { return iter_.Valid(); }
+    virtual const char* key() const { return iter_.key(); }
+    virtual void Next() { iter_.Next(); }
+    virtual void Prev() { iter_.Prev(); }
+    virtual void Seek(const char* target) { iter_.Seek(target); }
+    virtual void SeekToFirst() { iter_.SeekToFirst(); }
+    virtual void SeekToLast() { iter_.SeekToLast(); }
+
+   private:
+    Table::Iterator iter_;
+  };
+
+  Table list_;
+};
+
+// Entries are spread over a fixed array of buckets by a hash of their
+// user key.  Each bucket is a sorted singly linked list, so all versions
+// of a user key live in the same list in internal key order.  Lists are
+// published with release stores (or compare-and-swap for concurrent
+// inserts), which lets readers walk them without locking, as in SkipList.
+class HashLinkListRep : public MemTableRep {
+ public:
+  HashLinkListRep(const MemTableKeyComparator& cmp, Arena* arena,
+                  size_t bucket_count)
+      : compare_(cmp),
+        arena_(arena),
+        bucket_count_(bucket_count),
+        buckets_(new port::AtomicPointer[bucket_count]) {
+    for (size_t i = 0; i < bucket_count_; i++) {
+      buckets_[i].NoBarrier_Store(nullptr);
+    }
+  }
+
+  virtual ~HashLinkListRep() { delete[] buckets_; }
+
+  virtual void Insert(const char* entry) {
+    Node* x = NewNode(entry, arena_->AllocateAligned(sizeof(Node)));
+    port::AtomicPointer* link;
+    Node* next;
+    FindInsertPosition(entry, &link, &next);
+    x->next.NoBarrier_Store(next);
+    link->Release_Store(x);
+  }
+
+  virtual void InsertConcurrently(const char* entry) {
+    Node* x = NewNode(entry, arena_->AllocateConcurrently(sizeof(Node)));
+    while (true) {
+      port::AtomicPointer* link;
+      Node* next;
+      FindInsertPosition(entry, &link, &next);
+      x->next.NoBarrier_Store(next);
+      if (link->CompareAndSwap(next, x)) {
+        break;
+      }
+    }
+  }
+
+  virtual const char* Lookup(const char* key) const {
+    Node* x = static_cast<Node*>(Bucket(key)->Acquire_Load());
+    while (x != nullptr && compare_(x->key, key) < 0) {
+      x = static_cast<Node*>(x->next.Acquire_Load());
+    }
+    return x == nullptr ? nullptr : x->key;
+  }
+
+  virtual MemTableRep::Iterator* NewIterator() const {
+    // Buckets are not ordered relative to each other, so take a sorted
+    // snapshot of every entry.  Entries added later are not visible
+    // through the iterator, which is fine since they carry sequence
+    // numbers newer than any the iterator's user may read at.
+    std::vector<const char*>* entries = new std::vector<const char*>;
+    for (size_t i = 0; i < bucket_count_; i++) {
+      Node* x = static_cast<Node*>(buckets_[i].Acquire_Load());
+      while (x != nullptr) {
+        entries->push_back(x->key);
+        x = static_cast<Node*>(x->next.Acquire_Load());
+      }
+    }
+    std::sort(entries->begin(), entries->end(), EntryLess(compare_));
+    return new Iter(compare_, entries);
+  }
+
+ private:
+  struct Node {
+    const char* key;
+    port::AtomicPointer next;
+  };
+
+  struct EntryLess {
+    const MemTableKeyComparator& compare;
+    explicit EntryLess(const MemTableKeyComparator& c) : compare(c) { }
+    bool operator()(const char* a, const char* b) const {
+      return compare(a, b) < 0;
+    }
+  };
+
+  // Iterates over a sorted vector of entries, which it owns.
+  class Iter : public MemTableRep::Iterator {
+   public:
+    Iter(const MemTableKeyComparator& cmp, std::vector<const char*>* entries)
+        : compare_(cmp), entries_(entries), index_(entries->size()) { }
+
+    virtual ~Iter() { delete entries_; }
+
+    virtual bool Valid() const { return index_ < entries_->size(); }
+    virtual const char* key() const {
+      assert(Valid());
+      return (*entries_)[index_];
+    }
+    virtual void Next() {
+      assert(Valid());
+      index_++;
+    }
+    virtual void Prev() {
+      assert(Valid());
+      // Wraps around to entries_->size(), i.e. becomes invalid, at the
+      // first entry.
+      index_ = (index_ == 0) ? entries_->size() : index_ - 1;
+    }
+    virtual void Seek(const char* target) {
+      index_ = std::lower_bound(entries_->begin(), entries_->end(), target,
+                                EntryLess(compare_)) - entries_->begin();
+    }
+    virtual void SeekToFirst() { index_ = 0; }
+    virtual void SeekToLast() {
+      index_ = entries_->empty() ? 0 : entries_->size() - 1;
+    }
+
+   private:
+    const MemTableKeyComparator& compare_;
+    std::vector<const char*>* entries_;
+    size_t index_;
+  };
+
+  static Node* NewNode(const char* entry, char* mem) {
+    Node* x = new (mem) Node;
+    x->key = entry;
+    return x;
+  }
+
+  port::AtomicPointer* Bucket(const char* entry) const {
+    Slice user_key = ExtractUserKey(GetLengthPrefixedSlice(entry));
+    return &buckets_[Hash(user_key.data(), user_key.size(), 0xbc9f1d34) %
+                     bucket_count_];
+  }
+
+  // Find the link after which entry belongs in its bucket, and the node
+  // that link currently points to.
+  void FindInsertPosition(const char* entry, port::AtomicPointer** link,
+                          Node** next) const {
+    port::AtomicPointer* l = Bucket(entry);
+    Node* x = static_cast<Node*>(l->Acquire_Load());
+    while (x != nullptr && compare_(x->key, entry) < 0) {
+      l = &x->next;
+      x = static_cast<Node*>(l->Acquire_Load());
+    }
+    // Our data structure does not allow duplicate insertion
+    assert(x == nullptr || compare_(x->key, entry) != 0);
+    *link = l;
+    *next = x;
+  }
+
+  const MemTableKeyComparator compare_;
+  Arena* const arena_;
+  const size_t bucket_count_;
+  port::AtomicPointer* const buckets_;
+};
+
+class HashMemTableFactory : public MemTableFactory {
+ public:
+  explicit HashMemTableFactory(size_t bucket_count)
+      : bucket_count_(bucket_count > 0 ? bucket_count : 1) { }
+
+  virtual const char* Name() const { return "leveldb.HashLinkList"; }
+
+  virtual MemTableRep* NewRep(const MemTableKeyComparator& cmp,
+                              Arena* arena) const {
+    return new HashLinkListRep(cmp, arena, bucket_count_);
+  }
+
+ private:
+  const size_t bucket_count_;
+};
+
+}  // namespace
+
+MemTableRep* NewSkipListRep(const MemTableKeyComparator& cmp, Arena* arena) {
+  return new SkipListRep(cmp, arena);
+}
+
+const MemTableFactory* NewHashMemTableFactory(size_t bucket_count) {
+  return new HashMemTableFactory(bucket_count);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,96 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A MemTableRep is the data structure that stores the entries of a
+// MemTable.  Each entry is a single arena-allocated buffer laid out as
+//    key_size     : varint32 of internal_key.size()
+//    key bytes    : char[internal_key.size()]
+//    value_size   : varint32 of value.size()
+//    value bytes  : char[value.size()]
+// and entries are ordered by their internal keys.
+//
+// Thread safety: writes require external synchronization, except for
+// InsertConcurrently() which may be called by several threads at once.
+// Reads may run concurrently with writes as long as the rep is not
+// destroyed while the read is in progress.
+
+#ifndef STORAGE_LEVELDB_DB_MEMTABLE_REP_H_
+#define STORAGE_LEVELDB_DB_MEMTABLE_REP_H_
+
+#include "db/dbformat.h"
+
+namespace leveldb {
+
+class Arena;
+
+// Orders memtable entries by their length-prefixed internal keys.
+struct MemTableKeyComparator {
+  const InternalKeyComparator comparator;
+  explicit MemTableKeyComparator(const InternalKeyComparator& c)
+      : comparator(c) { }
+  int operator()(const char* a, const char* b) const;
+};
+
+class MemTableRep {
+ public:
+  MemTableRep() { }
+  virtual ~MemTableRep();
+
+  // Insert entry into the rep.
+  // REQUIRES: nothing that compares equal to entry is currently in the rep.
+  virtual void Insert(const char* entry) = 0;
+
+  // Like Insert(), but safe to call from several threads at once.
+  // REQUIRES: no concurrent call to Insert().
+  virtual void InsertConcurrently(const char* entry) = 0;
+
+  // Return the first entry at or after "key" among the entries that have
+  // the same user key as "key".  If there is no such entry, the result
+  // is either nullptr or an entry with a different user key.
+  virtual const char* Lookup(const char* key) const = 0;
+
+  // Iteration over the entries of a rep, in order.
+  class Iterator {
+   public:
+    Iterator() { }
+    virtual ~Iterator();
+
+    virtual bool Valid() const = 0;
+
+    // Returns the entry at the current position.
+    // REQUIRES: Valid()
+    virtual const char* key() const = 0;
+
+    virtual void Next() = 0;
+    virtual void Prev() = 0;
+
+    // Advance to the first entry at or after "target", which is encoded
+    // as a length-prefixed internal key.
+    virtual void Seek(const char* target) = 0;
+
+    virtual void SeekToFirst() = 0;
+    virtual void SeekToLast() = 0;
+
+   private:
+    // No copying allowed
+    Iterator(const Iterator&);
+    void operator=(const Iterator&);
+  };
+
+  // Return a new iterator over the rep.  The caller must delete it.
+  virtual Iterator* NewIterator() const = 0;
+
+ private:
+  // No copying allowed
+  MemTableRep(const MemTableRep&);
+  void operator=(const MemTableRep&);
+};
+
+// Return a new skiplist-based rep.  This is what MemTable uses unless
+// Options::memtable_factory is set.
+MemTableRep* NewSkipListRep(const MemTableKeyComparator& cmp, Arena* arena);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_MEMTABLE_REP_H_
@@ -0,0 +1,216 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_tombstones.h"
+
+#include <algorithm>
+#include <functional>
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "leveldb/table_builder.h"
+
+namespace leveldb {
+
+RangeTombstones::RangeTombstones(const Comparator* user_comparator)
+    : user_comparator_(user_comparator),
+      fragments_(KeyLess{user_comparator}) {
+}
+
+RangeTombstones::FragmentMap::iterator RangeTombstones::SplitAt(
+    const Slice& key) {
+  std::string k = key.ToString();
+  FragmentMap::iterator iter = fragments_.lower_bound(k);
+  if (iter != fragments_.end() &&
+      user_comparator_->Compare(iter->first, key) == 0) {
+    return iter;
+  }
+  // The new fragment starts out covered by the same deletions as the
+  // fragment it is cut from.
+  std::vector<SequenceNumber> sequences;
+  if (iter != fragments_.begin()) {
+    FragmentMap::iterator prev = iter;
+    --prev;
+    sequences = prev->second;
+  }
+  return fragments_.insert(iter, std::make_pair(k, sequences));
+}
+
+void RangeTombstones::MergeWithPrevious(FragmentMap::iterator iter) {
+  if (iter == fragments_.begin()) {
+    if (iter->second.empty()) {
+      fragments_.erase(iter);  // A leading gap
+    }
+  } else {
+    FragmentMap::iterator prev = iter;
+    --prev;
+    if (prev->second == iter->second) {
+      fragments_.erase(iter);
+    }
+  }
+}
+
+void RangeTombstones::Add(const Slice& start, const Slice& end,
+                          SequenceNumber sequence) {
+  if (user_comparator_->Compare(start, end) >= 0) {
+    return;
+  }
+  FragmentMap::iterator first = SplitAt(start);
+  FragmentMap::iterator last = SplitAt(end);
+  for (FragmentMap::iterator iter = first; iter != last; ++iter) {
+    std::vector<SequenceNumber>* sequences = &iter->second;
+    std::vector<SequenceNumber>::iterator pos = std::lower_bound(
+        sequences->begin(), sequences->end(), sequence,
+        std::greater<SequenceNumber>());
+    if (pos == sequences->end() || *pos != sequence) {
+      sequences->insert(pos, sequence);
+    }
+  }
+  MergeWithPrevious(last);
+  MergeWithPrevious(first);
+}
+
+void RangeTombstones::AddAll(const RangeTombstones& other) {
+  FragmentMap::const_iterator iter = other.fragments_.begin();
+  while (iter != other.fragments_.end()) {
+    FragmentMap::const_iterator next = iter;
+    ++next;
+    if (next == other.fragments_.end()) {
+      break;  // The trailing gap
+    }
+    for (size_t i = 0; i < iter->second.size(); i++) {
+      Add(iter->first, next->first, iter->second[i]);
+    }
+    iter = next;
+  }
+}
+
+Status RangeTombstones::AddFrom(Iterator* iter) {
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey start;
+    if (!ParseInternalKey(iter->key(), &start) ||
+        start.type != kTypeRangeDeletion) {
+      return Status::Corruption("bad range deletion entry");
+    }
+    Add(start.user_key, iter->value(), start.sequence);
+  }
+  return iter->status();
+}
+
+SequenceNumber RangeTombstones::MaxCoveringSequence(
+    const Slice& user_key, SequenceNumber snapshot) const {
+  FragmentMap::const_iterator iter =
+      fragments_.upper_bound(user_key.ToString());
+  if (iter == fragments_.begin()) {
+    return 0;
+  }
+  --iter;
+  const std::vector<SequenceNumber>& sequences = iter->second;
+  for (size_t i = 0; i < sequences.size(); i++) {
+    if (sequences[i] <= snapshot) {
+      return sequences[i];
+    }
+  }
+  return 0;
+}
+
+bool RangeTombstones::Overlaps(const Slice& smallest_user_key,
+                               const Slice& largest_user_key) const {
+  FragmentMap::const_iterator iter =
+      fragments_.upper_bound(smallest_user_key.ToString());
+  if (iter != fragments_.begin()) {
+    --iter;  // The fragment that holds smallest_user_key
+  }
+  for (; iter != fragments_.end() &&
+         user_comparator_->Compare(iter->first, largest_user_key) <= 0;
+       ++iter) {
+    if (!iter->second.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void RangeTombstones::GetFragments(const Slice* lower, const Slice* upper,
+                                   std::vector<Fragment>* result) const {
+  FragmentMap::const_iterator iter = fragments_.begin();
+  if (lower != nullptr) {
+    iter = fragments_.upper_bound(lower->ToString());
+    if (iter != fragments_.begin()) {
+      --iter;
+    }
+  }
+  while (iter != fragments_.end()) {
+    if (upper != nullptr &&
+        user_comparator_->Compare(iter->first, *upper) >= 0) {
+      break;
+    }
+    FragmentMap::const_iterator next = iter;
+    ++next;
+    if (next == fragments_.end()) {
+      break;  // The trailing gap
+    }
+    if (!iter->second.empty()) {
+      Fragment f;
+      f.start = iter->first;
+      if (lower != nullptr && user_comparator_->Compare(f.start, *lower) < 0) {
+        f.start = lower->ToString();
+      }
+      f.end = next->first;
+      if (upper != nullptr && user_comparator_->Compare(f.end, *upper) > 0) {
+        f.end = upper->ToString();
+      }
+      if (user_comparator_->Compare(f.start, f.end) < 0) {
+        f.sequences = iter->second;
+        result->push_back(f);
+      }
+    }
+    iter = next;
+  }
+}
+
+void AddRangeDeletionBounds(const InternalKeyComparator& icmp,
+                            const std::vector<RangeTombstones::Fragment>&
+                                fragments,
+                            bool has_bounds,
+                            InternalKey* smallest,
+                            InternalKey* largest) {
+  for (size_t i = 0; i < fragments.size(); i++) {
+    const RangeTombstones::Fragment& f = fragments[i];
+    if (f.sequences.empty()) {
+      continue;
+    }
+    // The newest deletion sorts first among those with the same start.
+    // Nothing in the table has the end's user key unless it is also
+    // the user key of an entry, so the end bound sorts before all of
+    // that user key's entries.
+    InternalKey lo(f.start, f.sequences[0], kTypeRangeDeletion);
+    InternalKey hi(f.end, kMaxSequenceNumber, kTypeRangeDeletion);
+    if (!has_bounds || icmp.Compare(lo, *smallest) < 0) {
+      *smallest = lo;
+    }
+    if (!has_bounds || icmp.Compare(hi, *largest) > 0) {
+      *largest = hi;
+    }
+    has_bounds = true;
+  }
+}
+
+void AddRangeDeletionsToTable(const InternalKeyComparator& icmp,
+                              const std::vector<RangeTombstones::Fragment>&
+                                  fragments,
+                              TableBuilder* builder,
+                              InternalKey* smallest,
+                              InternalKey* largest) {
+  const bool has_bounds = builder->NumEntries() > 0;
+  for (size_t i = 0; i < fragments.size(); i++) {
+    const RangeTombstones::Fragment& f = fragments[i];
+    for (size_t j = 0; j < f.sequences.size(); j++) {
+      InternalKey start(f.start, f.sequences[j], kTypeRangeDeletion);
+      builder->AddRangeDeletion(start.Encode(), f.end);
+    }
+  }
+  AddRangeDeletionBounds(icmp, fragments, has_bounds, smallest, largest);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,129 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// RangeTombstones holds the range deletions of a memtable, a table or a
+// set of tables.  A range deletion [start,end) with sequence number s
+// hides every entry for a user key in [start,end) that is older than s.
+//
+// The deletions are kept cut into disjoint fragments, each with the
+// sequence numbers of the deletions that cover it, so that finding the
+// deletions that cover a key is a single binary search no matter how
+// many deletions overlap.
+//
+// Thread safety: const methods may be called concurrently; any call to
+// a non-const method requires external synchronization.
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_TOMBSTONES_H_
+#define STORAGE_LEVELDB_DB_RANGE_TOMBSTONES_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "db/dbformat.h"
+
+namespace leveldb {
+
+class Iterator;
+class TableBuilder;
+
+class RangeTombstones {
+ public:
+  // The keys in [start,end) are covered by the deletions with the
+  // given sequence numbers, which are sorted newest first.
+  struct Fragment {
+    std::string start;
+    std::string end;
+    std::vector<SequenceNumber> sequences;
+  };
+
+  explicit RangeTombstones(const Comparator* user_comparator);
+
+  RangeTombstones(const RangeTombstones&) = delete;
+  void operator=(const RangeTombstones&) = delete;
+
+  // Return true iff no deletions have been added.
+  bool empty() const { return fragments_.empty(); }
+
+  // Delete the user keys in [start,end) as of "sequence".  Does nothing
+  // if "start" is not before "end".
+  void Add(const Slice& start, const Slice& end, SequenceNumber sequence);
+
+  // Add all the deletions of "other", which must use the same comparator.
+  void AddAll(const RangeTombstones& other);
+
+  // Add the deletions yielded by "iter", an iterator returned by
+  // Table::NewRangeDeletionIterator(): its keys are internal keys of
+  // type kTypeRangeDeletion for the start of each deletion, and its
+  // values are the ends.  Returns a non-OK status if an entry is
+  // malformed or if "iter" reports an error.
+  Status AddFrom(Iterator* iter);
+
+  // Return the sequence number of the newest deletion that covers
+  // "user_key" and is no newer than "snapshot", or zero if there is
+  // none.  An entry for "user_key" that is older than the result is
+  // deleted as seen from "snapshot".
+  SequenceNumber MaxCoveringSequence(const Slice& user_key,
+                                     SequenceNumber snapshot) const;
+
+  // Return true iff some deletion covers a key in
+  // [smallest_user_key,largest_user_key].
+  bool Overlaps(const Slice& smallest_user_key,
+                const Slice& largest_user_key) const;
+
+  // Append to *result, in key order, the fragments covering keys in
+  // [*lower,*upper), cut to fit.  A null bound is unbounded.
+  void GetFragments(const Slice* lower, const Slice* upper,
+                    std::vector<Fragment>* result) const;
+
+ private:
+  struct KeyLess {
+    const Comparator* cmp;
+    bool operator()(const std::string& a, const std::string& b) const {
+      return cmp->Compare(a, b) < 0;
+    }
+  };
+
+  // Maps the start of each fragment to the sequence numbers of the
+  // deletions covering it, newest first.  A fragment ends where the next
+  // one starts; fragments with no sequence numbers are gaps, and the
+  // last fragment is always one.
+  typedef std::map<std::string, std::vector<SequenceNumber>, KeyLess>
+      FragmentMap;
+
+  // Return the fragment that starts at "key", splitting the fragment
+  // that covers it if necessary.
+  FragmentMap::iterator SplitAt(const Slice& key);
+
+  // Remove the fragment at "iter" if it adds nothing to its predecessor.
+  void MergeWithPrevious(FragmentMap::iterator iter);
+
+  const Comparator* const user_comparator_;
+  FragmentMap fragments_;
+};
+
+// Widen [*smallest,*largest] to cover the deletions of "fragments".  The
+// bounds are only read if "has_bounds" is true.  The end of a deletion
+// is exclusive, so "*largest" may become a key of the end's user key
+// that sorts before all its real entries.
+void AddRangeDeletionBounds(const InternalKeyComparator& icmp,
+                            const std::vector<RangeTombstones::Fragment>&
+                                fragments,
+                            bool has_bounds,
+                            InternalKey* smallest,
+                            InternalKey* largest);
+
+// Add the deletions of "fragments" to "builder" with
+// TableBuilder::AddRangeDeletion(), and widen [*smallest,*largest] to
+// cover them.  The bounds are only read if "builder" already holds other
+// entries.
+void AddRangeDeletionsToTable(const InternalKeyComparator& icmp,
+                              const std::vector<RangeTombstones::Fragment>&
+                                  fragments,
+                              TableBuilder* builder,
+                              InternalKey* smallest,
+                              InternalKey* largest);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_TOMBSTONES_H_
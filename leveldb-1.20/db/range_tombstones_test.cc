@@ -0,0 +1,166 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_tombstones.h"
+
+#include "leveldb/comparator.h"
+#include "util/logging.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+class RangeTombstonesTest {
+ public:
+  RangeTombstones tombstones_;
+
+  RangeTombstonesTest() : tombstones_(BytewiseComparator()) { }
+
+  SequenceNumber Covering(const char* key,
+                          SequenceNumber snapshot = kMaxSequenceNumber) {
+    return tombstones_.MaxCoveringSequence(key, snapshot);
+  }
+
+  // Returns the fragments in [lower,upper) as "start-end:seq,seq ...".
+  std::string Fragments(const char* lower = nullptr,
+                        const char* upper = nullptr) {
+    Slice lower_slice(lower != nullptr ? lower : "");
+    Slice upper_slice(upper != nullptr ? upper : "");
+    std::vector<RangeTombstones::Fragment> fragments;
+    tombstones_.GetFragments(lower != nullptr ? &lower_slice : nullptr,
+                             upper != nullptr ? &upper_slice : nullptr,
+                             &fragments);
+    std::string result;
+    for (size_t i = 0; i < fragments.size(); i++) {
+      if (i > 0) {
+        result.push_back(' ');
+      }
+      result.append(fragments[i].start);
+      result.push_back('-');
+      result.append(fragments[i].end);
+      for (size_t j = 0; j < fragments[i].sequences.size(); j++) {
+        result.push_back(j == 0 ? ':' : ',');
+        AppendNumberTo(&result, fragments[i].sequences[j]);
+      }
+    }
+    return result;
+  }
+};
+
+TEST(RangeTombstonesTest, Empty) {
+  ASSERT_TRUE(tombstones_.empty());
+  ASSERT_EQ(0, Covering("a"));
+  ASSERT_TRUE(!tombstones_.Overlaps("a", "z"));
+  ASSERT_EQ("", Fragments());
+
+  // Ranges that hold no keys are ignored
+  tombstones_.Add("c", "c", 5);
+  tombstones_.Add("d", "a", 5);
+  ASSERT_TRUE(tombstones_.empty());
+}
+
+TEST(RangeTombstonesTest, Single) {
+  tombstones_.Add("b", "d", 5);
+  ASSERT_TRUE(!tombstones_.empty());
+  ASSERT_EQ(0, Covering("a"));
+  ASSERT_EQ(5, Covering("b"));
+  ASSERT_EQ(5, Covering("c"));
+  ASSERT_EQ(5, Covering("czzz"));
+  ASSERT_EQ(0, Covering("d"));
+  ASSERT_EQ(0, Covering("e"));
+
+  // Not visible from older snapshots
+  ASSERT_EQ(5, Covering("c", 5));
+  ASSERT_EQ(0, Covering("c", 4));
+
+  ASSERT_EQ("b-d:5", Fragments());
+}
+
+TEST(RangeTombstonesTest, Overlapping) {
+  tombstones_.Add("a", "c", 3);
+  tombstones_.Add("b", "e", 7);
+  tombstones_.Add("c", "d", 2);
+  ASSERT_EQ("a-b:3 b-c:7,3 c-d:7,2 d-e:7", Fragments());
+
+  ASSERT_EQ(3, Covering("a"));
+  ASSERT_EQ(7, Covering("b"));
+  ASSERT_EQ(3, Covering("b", 6));
+  ASSERT_EQ(7, Covering("c"));
+  ASSERT_EQ(2, Covering("c", 6));
+  ASSERT_EQ(0, Covering("c", 1));
+  ASSERT_EQ(0, Covering("d", 6));
+  ASSERT_EQ(0, Covering("e"));
+
+  // Adding the same deletion again changes nothing
+  tombstones_.Add("b", "e", 7);
+  ASSERT_EQ("a-b:3 b-c:7,3 c-d:7,2 d-e:7", Fragments());
+}
+
+TEST(RangeTombstonesTest, AdjacentRangesMerge) {
+  tombstones_.Add("a", "b", 1);
+  tombstones_.Add("c", "d", 1);
+  ASSERT_EQ("a-b:1 c-d:1", Fragments());
+  tombstones_.Add("b", "c", 1);
+  ASSERT_EQ("a-d:1", Fragments());
+}
+
+TEST(RangeTombstonesTest, Overlaps) {
+  tombstones_.Add("b", "d", 1);
+  tombstones_.Add("f", "h", 2);
+  ASSERT_TRUE(tombstones_.Overlaps("a", "b"));
+  ASSERT_TRUE(tombstones_.Overlaps("c", "c"));
+  ASSERT_TRUE(tombstones_.Overlaps("a", "z"));
+  ASSERT_TRUE(tombstones_.Overlaps("e", "f"));
+  ASSERT_TRUE(!tombstones_.Overlaps("a", "a"));
+  ASSERT_TRUE(!tombstones_.Overlaps("d", "e"));  // End is exclusive
+  ASSERT_TRUE(!tombstones_.Overlaps("h", "z"));
+}
+
+TEST(RangeTombstonesTest, GetFragmentsClips) {
+  tombstones_.Add("b", "d", 1);
+  tombstones_.Add("c", "f", 2);
+  ASSERT_EQ("b-c:1 c-d:2,1 d-f:2", Fragments());
+  ASSERT_EQ("bb-c:1 c-cc:2,1", Fragments("bb", "cc"));
+  ASSERT_EQ("c-d:2,1 d-f:2", Fragments("c", nullptr));
+  ASSERT_EQ("b-c:1", Fragments(nullptr, "c"));
+  ASSERT_EQ("", Fragments("a", "b"));
+  ASSERT_EQ("", Fragments("f", "z"));
+}
+
+TEST(RangeTombstonesTest, AddAll) {
+  tombstones_.Add("a", "c", 3);
+  RangeTombstones other(BytewiseComparator());
+  other.Add("b", "d", 5);
+  other.Add("x", "y", 1);
+  tombstones_.AddAll(other);
+  ASSERT_EQ("a-b:3 b-c:5,3 c-d:5 x-y:1", Fragments());
+}
+
+TEST(RangeTombstonesTest, Bounds) {
+  InternalKeyComparator icmp(BytewiseComparator());
+  tombstones_.Add("b", "d", 4);
+  tombstones_.Add("c", "f", 7);
+  std::vector<RangeTombstones::Fragment> fragments;
+  tombstones_.GetFragments(nullptr, nullptr, &fragments);
+
+  InternalKey smallest, largest;
+  AddRangeDeletionBounds(icmp, fragments, false, &smallest, &largest);
+  ASSERT_EQ(InternalKey("b", 4, kTypeRangeDeletion).Encode().ToString(),
+            smallest.Encode().ToString());
+  ASSERT_EQ(InternalKey("f", kMaxSequenceNumber,
+                        kTypeRangeDeletion).Encode().ToString(),
+            largest.Encode().ToString());
+
+  // Existing bounds that already cover the deletions are kept
+  smallest = InternalKey("a", 1, kTypeValue);
+  largest = InternalKey("z", 1, kTypeValue);
+  AddRangeDeletionBounds(icmp, fragments, true, &smallest, &largest);
+  ASSERT_EQ("a", smallest.user_key().ToString());
+  ASSERT_EQ("z", largest.user_key().ToString());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
@@ -31,6 +31,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstones.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "db/write_batch_internal.h"
@@ -48,7 +49,7 @@ class Repairer {
       : dbname_(dbname),
         env_(options.env),
         icmp_(options.comparator),
-        ipolicy_(options.filter_policy),
+        ipolicy_(options.filter_policy, options.prefix_extractor),
         options_(SanitizeOptions(dbname, &icmp_, &ipolicy_, options)),
         owns_info_log_(options_.info_log != options.info_log),
         owns_cache_(options_.block_cache != options.block_cache),
@@ -197,7 +198,7 @@ class Repairer {
     std::string scratch;
     Slice record;
     WriteBatch batch;
-    MemTable* mem = new MemTable(icmp_);
+    MemTable* mem = new MemTable(icmp_, options_.memtable_factory);
     mem->Ref();
     int counter = 0;
     while (reader.ReadRecord(&record, &scratch)) {
@@ -224,7 +225,10 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    RangeTombstones range_deletions(icmp_.user_comparator());
+    mem->GetRangeTombstones(&range_deletions);
+    status = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                        &range_deletions, &meta, nullptr);
     delete iter;
     mem->Unref();
     mem = nullptr;
@@ -252,7 +256,16 @@ class Repairer {
     // on checksum verification.
     ReadOptions r;
     r.verify_checksums = options_.paranoid_checks;
-    return table_cache_->NewIterator(r, meta.number, meta.file_size);
+    return table_cache_->NewIterator(r, meta.number, meta.file_size, -1, 0);
+  }
+
+  Status GetRangeDeletions(const FileMetaData& meta,
+                           std::vector<RangeTombstones::Fragment>* result) {
+    RangeTombstones range_deletions(icmp_.user_comparator());
+    Status s = table_cache_->AddRangeDeletions(meta.number, meta.file_size,
+                                               -1, &range_deletions);
+    range_deletions.GetFragments(nullptr, nullptr, result);
+    return s;
   }
 
   void ScanTable(uint64_t number) {
@@ -306,6 +319,22 @@ class Repairer {
       status = iter->status();
     }
     delete iter;
+
+    // The range deletions of the table are part of its range
+    std::vector<RangeTombstones::Fragment> fragments;
+    if (status.ok()) {
+      status = GetRangeDeletions(t.meta, &fragments);
+    }
+    if (!fragments.empty()) {
+      AddRangeDeletionBounds(icmp_, fragments, !empty,
+                             &t.meta.smallest, &t.meta.largest);
+      for (size_t i = 0; i < fragments.size(); i++) {
+        if (fragments[i].sequences[0] > t.max_sequence) {
+          t.max_sequence = fragments[i].sequences[0];
+        }
+      }
+      t.meta.has_range_deletions = true;
+    }
     Log(options_.info_log, "Table #%llu: %d entries %s",
         (unsigned long long) t.meta.number,
         counter,
@@ -329,7 +358,10 @@ class Repairer {
     if (!s.ok()) {
       return;
     }
-    TableBuilder* builder = new TableBuilder(options_, file);
+    // Repaired tables all end up in level 0.
+    Options table_options = options_;
+    table_options.compression = CompressionForLevel(options_, 0);
+    TableBuilder* builder = new TableBuilder(table_options, file);
 
     // Copy data.
     Iterator* iter = NewTableIterator(t.meta);
@@ -339,6 +371,15 @@ class Repairer {
       counter++;
     }
     delete iter;
+    std::vector<RangeTombstones::Fragment> fragments;
+    if (GetRangeDeletions(t.meta, &fragments).ok() && !fragments.empty()) {
+      AddRangeDeletionsToTable(icmp_, fragments, builder,
+                               &t.meta.smallest, &t.meta.largest);
+      t.meta.has_range_deletions = true;
+      counter++;
+    } else {
+      t.meta.has_range_deletions = false;
+    }
 
     ArchiveFile(src);
     if (counter == 0) {
@@ -396,7 +437,8 @@ class Repairer {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
       edit_.AddFile(0, t.meta.number, t.meta.file_size,
-                    t.meta.smallest, t.meta.largest);
+                    t.meta.smallest, t.meta.largest, 0,
+                    t.meta.has_range_deletions);
     }
 
     //fprintf(stderr, "NewDescriptor:\n%s\n", edit_.DebugString().c_str());
@@ -4,11 +4,13 @@
 
 #include "db/skiplist.h"
 #include <set>
+#include <vector>
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
 #include "util/arena.h"
 #include "util/hash.h"
+#include "util/mutexlock.h"
 #include "util/random.h"
 #include "util/testharness.h"
 
@@ -373,6 +375,90 @@ TEST(SkipTest, Concurrent3) { RunConcurrent(3); }
 TEST(SkipTest, Concurrent4) { RunConcurrent(4); }
 TEST(SkipTest, Concurrent5) { RunConcurrent(5); }
 
+// Several threads call InsertConcurrently() on the same list.  Thread t
+// inserts the keys that are congruent to t modulo kThreads, in a random
+// order, so no two threads ever insert the same key.
+class ConcurrentInsertState {
+ public:
+  static const int kThreads = 4;
+  static const int kKeysPerThread = 20000;
+
+  Arena arena_;
+  SkipList<Key, Comparator> list_;
+
+  ConcurrentInsertState()
+      : list_(Comparator(), &arena_),
+        next_thread_(0),
+        done_(0),
+        done_cv_(&mu_) {}
+
+  int NextThread() LOCKS_EXCLUDED(mu_) {
+    MutexLock l(&mu_);
+    return next_thread_++;
+  }
+
+  void Done() LOCKS_EXCLUDED(mu_) {
+    MutexLock l(&mu_);
+    done_++;
+    done_cv_.Signal();
+  }
+
+  void WaitForAll() LOCKS_EXCLUDED(mu_) {
+    MutexLock l(&mu_);
+    while (done_ < kThreads) {
+      done_cv_.Wait();
+    }
+  }
+
+ private:
+  port::Mutex mu_;
+  int next_thread_ GUARDED_BY(mu_);
+  int done_ GUARDED_BY(mu_);
+  port::CondVar done_cv_ GUARDED_BY(mu_);
+};
+
+static void ConcurrentInserter(void* arg) {
+  ConcurrentInsertState* state = reinterpret_cast<ConcurrentInsertState*>(arg);
+  const int t = state->NextThread();
+  std::vector<Key> keys;
+  for (int i = 0; i < ConcurrentInsertState::kKeysPerThread; i++) {
+    keys.push_back(static_cast<Key>(i) * ConcurrentInsertState::kThreads + t);
+  }
+  Random rnd(test::RandomSeed() + t);
+  for (size_t i = keys.size() - 1; i > 0; i--) {
+    std::swap(keys[i], keys[rnd.Uniform(i + 1)]);
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    state->list_.InsertConcurrently(keys[i]);
+  }
+  state->Done();
+}
+
+TEST(SkipTest, ConcurrentInsert) {
+  for (int run = 0; run < 10; run++) {
+    ConcurrentInsertState state;
+    for (int t = 0; t < ConcurrentInsertState::kThreads; t++) {
+      Env::Default()->StartThread(ConcurrentInserter, &state);
+    }
+    state.WaitForAll();
+
+    // Every key must be present exactly once and in order.
+    const Key kTotal = static_cast<Key>(ConcurrentInsertState::kThreads) *
+                       ConcurrentInsertState::kKeysPerThread;
+    SkipList<Key, Comparator>::Iterator iter(&state.list_);
+    iter.SeekToFirst();
+    for (Key k = 0; k < kTotal; k++) {
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(k, iter.key());
+      iter.Next();
+    }
+    ASSERT_TRUE(!iter.Valid());
+    for (Key k = 0; k < kTotal; k += 97) {
+      ASSERT_TRUE(state.list_.Contains(k));
+    }
+  }
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
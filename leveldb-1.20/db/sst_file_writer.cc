@@ -0,0 +1,141 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/sst_file_writer.h"
+
+#include "db/builder.h"
+#include "db/dbformat.h"
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/table_builder.h"
+
+namespace leveldb {
+
+struct SstFileWriter::Rep {
+  // Like a DB, the table stores internal keys, so it is built with the
+  // internal versions of the user's comparator and filter policy.
+  const InternalKeyComparator internal_comparator;
+  const InternalFilterPolicy internal_filter_policy;
+  Options options;
+  std::string fname;
+  WritableFile* file;
+  TableBuilder* builder;
+  std::string last_user_key;
+  std::string internal_key;   // Scratch space for Add()
+  uint64_t num_entries;       // Valid after Finish()
+  uint64_t file_size;         // Valid after Finish()
+
+  explicit Rep(const Options& opt)
+      : internal_comparator(opt.comparator),
+        internal_filter_policy(opt.filter_policy, opt.prefix_extractor),
+        options(opt),
+        file(nullptr),
+        builder(nullptr),
+        num_entries(0),
+        file_size(0) {
+    options.comparator = &internal_comparator;
+    options.filter_policy =
+        (opt.filter_policy != nullptr) ? &internal_filter_policy : nullptr;
+    options.compression = CompressionForLevel(opt, config::kNumLevels - 1);
+  }
+};
+
+SstFileWriter::SstFileWriter(const Options& options)
+    : rep_(new Rep(options)) {
+}
+
+SstFileWriter::~SstFileWriter() {
+  if (rep_->builder != nullptr) {
+    // Not finished: drop the partial file
+    rep_->builder->Abandon();
+    delete rep_->builder;
+    delete rep_->file;
+    rep_->options.env->DeleteFile(rep_->fname);
+  }
+  delete rep_;
+}
+
+Status SstFileWriter::Open(const std::string& fname) {
+  Rep* r = rep_;
+  if (r->builder != nullptr || !r->fname.empty()) {
+    return Status::InvalidArgument("SstFileWriter already opened", fname);
+  }
+  Status s = r->options.env->NewWritableFile(fname, &r->file);
+  if (s.ok()) {
+    r->fname = fname;
+    r->builder = new TableBuilder(r->options, r->file);
+  }
+  return s;
+}
+
+Status SstFileWriter::Put(const Slice& key, const Slice& value) {
+  return Add(key, value, false);
+}
+
+Status SstFileWriter::Delete(const Slice& key) {
+  return Add(key, Slice(), true);
+}
+
+Status SstFileWriter::Add(const Slice& key, const Slice& value,
+                          bool deletion) {
+  Rep* r = rep_;
+  if (r->builder == nullptr) {
+    return Status::InvalidArgument("SstFileWriter is not open");
+  }
+  if (r->builder->NumEntries() > 0 &&
+      r->internal_comparator.user_comparator()->Compare(
+          key, r->last_user_key) <= 0) {
+    return Status::InvalidArgument(
+        "keys must be added in strictly increasing order", key);
+  }
+
+  // Every key is stored with sequence number zero.  The DB assigns the
+  // table a sequence number when it ingests it.
+  r->internal_key.clear();
+  AppendInternalKey(&r->internal_key, ParsedInternalKey(
+      key, 0, deletion ? kTypeDeletion : kTypeValue));
+  r->builder->Add(r->internal_key, value);
+  r->last_user_key.assign(key.data(), key.size());
+  return r->builder->status();
+}
+
+Status SstFileWriter::Finish() {
+  Rep* r = rep_;
+  if (r->builder == nullptr) {
+    return Status::InvalidArgument("SstFileWriter is not open");
+  }
+  if (r->builder->NumEntries() == 0) {
+    return Status::InvalidArgument("cannot create an empty table", r->fname);
+  }
+
+  Status s = r->builder->Finish();
+  r->num_entries = r->builder->NumEntries();
+  r->file_size = r->builder->FileSize();
+  if (s.ok()) {
+    s = r->file->Sync();
+  }
+  if (s.ok()) {
+    s = r->file->Close();
+  }
+  delete r->builder;
+  delete r->file;
+  r->builder = nullptr;
+  r->file = nullptr;
+  if (!s.ok()) {
+    r->options.env->DeleteFile(r->fname);
+  }
+  return s;
+}
+
+uint64_t SstFileWriter::NumEntries() const {
+  return (rep_->builder != nullptr) ? rep_->builder->NumEntries()
+                                    : rep_->num_entries;
+}
+
+uint64_t SstFileWriter::FileSize() const {
+  return (rep_->builder != nullptr) ? rep_->builder->FileSize()
+                                    : rep_->file_size;
+}
+
+}  // namespace leveldb
@@ -4,8 +4,12 @@
 
 #include "db/table_cache.h"
 
+#include <vector>
 #include "db/filename.h"
+#include "db/range_tombstones.h"
+#include "leveldb/comparator.h"
 #include "leveldb/env.h"
+#include "leveldb/slice_transform.h"
 #include "leveldb/table.h"
 #include "util/coding.h"
 
@@ -14,10 +18,12 @@ namespace leveldb {
 struct TableAndFile {
   RandomAccessFile* file;
   Table* table;
+  RangeTombstones* range_deletions;  // nullptr if the table has none
 };
 
 static void DeleteEntry(const Slice& key, void* value) {
   TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+  delete tf->range_deletions;
   delete tf->table;
   delete tf->file;
   delete tf;
@@ -29,6 +35,207 @@ static void UnrefEntry(void* arg1, void* arg2) {
   cache->Release(h);
 }
 
+// Rewrites "key", an internal key of an ingested table, to carry
+// "sequence" instead of the sequence number zero it was stored with.
+static void SetGlobalSequence(const Slice& key, SequenceNumber sequence,
+                              std::string* result) {
+  result->clear();
+  ParsedInternalKey parsed;
+  if (ParseInternalKey(key, &parsed)) {
+    parsed.sequence = sequence;
+    AppendInternalKey(result, parsed);
+  } else {
+    // Leave corrupted keys for the caller to detect
+    result->assign(key.data(), key.size());
+  }
+}
+
+namespace {
+
+// Iterates over an ingested table as if every key had been stored with
+// the sequence number the table was ingested with.
+class GlobalSequenceIterator : public Iterator {
+ public:
+  GlobalSequenceIterator(const Comparator* icmp, Iterator* iter,
+                         SequenceNumber sequence)
+      : icmp_(icmp), iter_(iter), sequence_(sequence) { }
+  virtual ~GlobalSequenceIterator() { delete iter_; }
+
+  virtual bool Valid() const { return iter_->Valid(); }
+  virtual void SeekToFirst() { iter_->SeekToFirst(); Update(); }
+  virtual void SeekToLast() { iter_->SeekToLast(); Update(); }
+  virtual void Seek(const Slice& target) {
+    // A stored key is never before "target" when their user keys are
+    // equal, but its rewritten form is if "target" is older.
+    iter_->Seek(target);
+    Update();
+    while (iter_->Valid() && icmp_->Compare(key_, target) < 0) {
+      Next();
+    }
+  }
+  virtual void Next() { iter_->Next(); Update(); }
+  virtual void Prev() { iter_->Prev(); Update(); }
+  virtual Slice key() const { return key_; }
+  virtual Slice value() const { return iter_->value(); }
+  virtual Status status() const { return iter_->status(); }
+
+ private:
+  void Update() {
+    if (iter_->Valid()) {
+      SetGlobalSequence(iter_->key(), sequence_, &key_);
+    }
+  }
+
+  const Comparator* const icmp_;
+  Iterator* const iter_;
+  const SequenceNumber sequence_;
+  std::string key_;
+};
+
+// Iterates over a table for an iterator that reads with
+// ReadOptions::prefix_same_as_start: a Seek() to a key whose prefix the
+// table's filters rule out leaves the iterator invalid without reading
+// the table's index or data blocks.  The caller stops at the first key
+// with another prefix and never goes back, so the keys it misses this way
+// do not matter.  A target at kMaxSequenceNumber is not checked against
+// the filters, for the callers that need every table positioned.
+class PrefixFilterIterator : public Iterator {
+ public:
+  PrefixFilterIterator(const SliceTransform* prefix_extractor,
+                       const Table* table, Iterator* iter)
+      : prefix_extractor_(prefix_extractor),
+        table_(table),
+        iter_(iter),
+        filtered_(false) { }
+  virtual ~PrefixFilterIterator() { delete iter_; }
+
+  virtual bool Valid() const { return !filtered_ && iter_->Valid(); }
+  virtual void SeekToFirst() { filtered_ = false; iter_->SeekToFirst(); }
+  virtual void SeekToLast() { filtered_ = false; iter_->SeekToLast(); }
+  virtual void Seek(const Slice& target) {
+    ParsedInternalKey ikey;
+    if (ParseInternalKey(target, &ikey) &&
+        ikey.sequence != kMaxSequenceNumber &&
+        prefix_extractor_->InDomain(ikey.user_key)) {
+      InternalKey prefix(prefix_extractor_->Transform(ikey.user_key),
+                         kMaxSequenceNumber, kValueTypeForSeek);
+      if (!table_->KeyMayMatch(prefix.Encode())) {
+        filtered_ = true;
+        return;
+      }
+    }
+    filtered_ = false;
+    iter_->Seek(target);
+  }
+  virtual void Next() { assert(Valid()); iter_->Next(); }
+  virtual void Prev() { assert(Valid()); iter_->Prev(); }
+  virtual Slice key() const { return iter_->key(); }
+  virtual Slice value() const { return iter_->value(); }
+  virtual Status status() const { return iter_->status(); }
+
+ private:
+  const SliceTransform* const prefix_extractor_;
+  const Table* const table_;
+  Iterator* const iter_;
+  bool filtered_;  // The last Seek() was ruled out by the filters
+};
+
+// Passes the entries found in an ingested table on to the original
+// handle_result function with their keys rewritten, unless they are
+// newer than the key that was looked up.
+struct GlobalSequenceSaver {
+  SequenceNumber sequence;
+  SequenceNumber snapshot;
+  void* arg;
+  void (*saver)(void*, const Slice&, const Slice&);
+  std::string key;
+};
+
+void SaveWithGlobalSequence(void* arg, const Slice& k, const Slice& v) {
+  GlobalSequenceSaver* s = reinterpret_cast<GlobalSequenceSaver*>(arg);
+  if (s->sequence > s->snapshot) {
+    return;
+  }
+  SetGlobalSequence(k, s->sequence, &s->key);
+  (*s->saver)(s->arg, s->key, v);
+}
+
+void InitGlobalSequenceSaver(SequenceNumber sequence, const Slice& k,
+                             void* arg,
+                             void (*saver)(void*, const Slice&, const Slice&),
+                             GlobalSequenceSaver* s) {
+  s->sequence = sequence;
+  s->snapshot = (k.size() >= 8)
+      ? (DecodeFixed64(k.data() + k.size() - 8) >> 8)
+      : kMaxSequenceNumber;
+  s->arg = arg;
+  s->saver = saver;
+}
+
+// Passes the entries found in a table with range deletions on to the
+// original handle_result function, turning those hidden by a deletion
+// into deletions.
+struct RangeDeletionSaver {
+  const Comparator* user_comparator;
+  Slice user_key;
+  SequenceNumber covering;  // Newest deletion of user_key, or zero
+  bool found;               // An entry for user_key was passed on
+  void* arg;
+  void (*saver)(void*, const Slice&, const Slice&);
+  std::string key;
+};
+
+void SaveWithRangeDeletions(void* arg, const Slice& k, const Slice& v) {
+  RangeDeletionSaver* s = reinterpret_cast<RangeDeletionSaver*>(arg);
+  ParsedInternalKey parsed;
+  if (ParseInternalKey(k, &parsed) &&
+      s->user_comparator->Compare(parsed.user_key, s->user_key) == 0) {
+    s->found = true;
+    if (parsed.sequence < s->covering) {
+      s->key.clear();
+      AppendInternalKey(&s->key, ParsedInternalKey(s->user_key, s->covering,
+                                                   kTypeDeletion));
+      (*s->saver)(s->arg, s->key, Slice());
+      return;
+    }
+  }
+  (*s->saver)(s->arg, k, v);
+}
+
+void InitRangeDeletionSaver(const Comparator* user_comparator,
+                            const RangeTombstones& range_deletions,
+                            const Slice& k, void* arg,
+                            void (*saver)(void*, const Slice&, const Slice&),
+                            RangeDeletionSaver* s) {
+  s->user_comparator = user_comparator;
+  s->user_key = ExtractUserKey(k);
+  s->covering = range_deletions.MaxCoveringSequence(
+      s->user_key, DecodeFixed64(k.data() + k.size() - 8) >> 8);
+  s->found = false;
+  s->arg = arg;
+  s->saver = saver;
+}
+
+// Report the deletion of a key that no entry was found for.
+void FinishRangeDeletionSaver(RangeDeletionSaver* s) {
+  if (!s->found && s->covering > 0) {
+    s->key.clear();
+    AppendInternalKey(&s->key, ParsedInternalKey(s->user_key, s->covering,
+                                                 kTypeDeletion));
+    (*s->saver)(s->arg, s->key, Slice());
+  }
+}
+
+}  // namespace
+
+static Status OpenTableFile(const Options& options, const std::string& fname,
+                            RandomAccessFile** file) {
+  if (options.use_direct_reads) {
+    return options.env->NewDirectRandomAccessFile(fname, file);
+  }
+  return options.env->NewRandomAccessFile(fname, file);
+}
+
 TableCache::TableCache(const std::string& dbname,
                        const Options& options,
                        int entries)
@@ -43,7 +250,7 @@ TableCache::~TableCache() {
 }
 
 Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
-                             Cache::Handle** handle) {
+                             int level, Cache::Handle** handle) {
   Status s;
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number);
@@ -53,15 +260,37 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
     std::string fname = TableFileName(dbname_, file_number);
     RandomAccessFile* file = nullptr;
     Table* table = nullptr;
-    s = env_->NewRandomAccessFile(fname, &file);
+    s = OpenTableFile(options_, fname, &file);
     if (!s.ok()) {
       std::string old_fname = SSTTableFileName(dbname_, file_number);
-      if (env_->NewRandomAccessFile(old_fname, &file).ok()) {
+      if (OpenTableFile(options_, old_fname, &file).ok()) {
         s = Status::OK();
       }
     }
     if (s.ok()) {
-      s = Table::Open(options_, file, file_size, &table);
+      // Only the small, frequently read levels pin their top-level index
+      Options table_options = options_;
+      table_options.pin_top_level_index =
+          options_.pin_top_level_index && level >= 0 && level <= 1;
+      s = Table::Open(table_options, file, file_size, &table);
+    }
+    RangeTombstones* range_deletions = nullptr;
+    if (s.ok()) {
+      // The deletions are needed by every lookup, so they are read once
+      // and kept with the table.
+      Iterator* iter = table->NewRangeDeletionIterator();
+      if (iter != nullptr) {
+        range_deletions = new RangeTombstones(
+            static_cast<const InternalKeyComparator*>(
+                options_.comparator)->user_comparator());
+        s = range_deletions->AddFrom(iter);
+        delete iter;
+        if (!s.ok()) {
+          delete range_deletions;
+          delete table;
+          table = nullptr;
+        }
+      }
     }
 
     if (!s.ok()) {
@@ -73,6 +302,7 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       TableAndFile* tf = new TableAndFile;
       tf->file = file;
       tf->table = table;
+      tf->range_deletions = range_deletions;
       *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
     }
   }
@@ -82,13 +312,15 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number,
                                   uint64_t file_size,
+                                  int level,
+                                  SequenceNumber global_sequence,
                                   Table** tableptr) {
   if (tableptr != nullptr) {
     *tableptr = nullptr;
   }
 
   Cache::Handle* handle = nullptr;
-  Status s = FindTable(file_number, file_size, &handle);
+  Status s = FindTable(file_number, file_size, level, &handle);
   if (!s.ok()) {
     return NewErrorIterator(s);
   }
@@ -96,6 +328,14 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
   Iterator* result = table->NewIterator(options);
   result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  if (global_sequence != 0) {
+    result = new GlobalSequenceIterator(options_.comparator, result,
+                                        global_sequence);
+  }
+  if (options.prefix_same_as_start && table->HasPrefixFilters()) {
+    result = new PrefixFilterIterator(options_.prefix_extractor, table,
+                                      result);
+  }
   if (tableptr != nullptr) {
     *tableptr = table;
   }
@@ -105,14 +345,103 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
 Status TableCache::Get(const ReadOptions& options,
                        uint64_t file_number,
                        uint64_t file_size,
+                       int level,
+                       SequenceNumber global_sequence,
                        const Slice& k,
                        void* arg,
                        void (*saver)(void*, const Slice&, const Slice&)) {
   Cache::Handle* handle = nullptr;
-  Status s = FindTable(file_number, file_size, &handle);
+  Status s = FindTable(file_number, file_size, level, &handle);
   if (s.ok()) {
-    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, saver);
+    TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+    Table* t = tf->table;
+    RangeDeletionSaver rs;
+    if (tf->range_deletions != nullptr) {
+      InitRangeDeletionSaver(
+          static_cast<const InternalKeyComparator*>(
+              options_.comparator)->user_comparator(),
+          *tf->range_deletions, k, arg, saver, &rs);
+      arg = &rs;
+      saver = &SaveWithRangeDeletions;
+    }
+    if (global_sequence != 0) {
+      GlobalSequenceSaver gs;
+      InitGlobalSequenceSaver(global_sequence, k, arg, saver, &gs);
+      s = t->InternalGet(options, k, &gs, &SaveWithGlobalSequence);
+    } else {
+      s = t->InternalGet(options, k, arg, saver);
+    }
+    if (s.ok() && tf->range_deletions != nullptr) {
+      FinishRangeDeletionSaver(&rs);
+    }
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+Status TableCache::MultiGet(const ReadOptions& options,
+                            uint64_t file_number,
+                            uint64_t file_size,
+                            int level,
+                            SequenceNumber global_sequence,
+                            int n,
+                            const Slice* keys,
+                            void* const* args,
+                            void (*saver)(void*, const Slice&, const Slice&)) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, level, &handle);
+  if (s.ok()) {
+    TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+    Table* t = tf->table;
+    std::vector<RangeDeletionSaver> range_savers;
+    std::vector<void*> range_args;
+    if (tf->range_deletions != nullptr) {
+      range_savers.resize(n);
+      range_args.resize(n);
+      for (int i = 0; i < n; i++) {
+        InitRangeDeletionSaver(
+            static_cast<const InternalKeyComparator*>(
+                options_.comparator)->user_comparator(),
+            *tf->range_deletions, keys[i], args[i], saver, &range_savers[i]);
+        range_args[i] = &range_savers[i];
+      }
+      args = range_args.data();
+      saver = &SaveWithRangeDeletions;
+    }
+    if (global_sequence != 0) {
+      std::vector<GlobalSequenceSaver> savers(n);
+      std::vector<void*> saver_args(n);
+      for (int i = 0; i < n; i++) {
+        InitGlobalSequenceSaver(global_sequence, keys[i], args[i], saver,
+                                &savers[i]);
+        saver_args[i] = &savers[i];
+      }
+      s = t->InternalMultiGet(options, n, keys, saver_args.data(),
+                              &SaveWithGlobalSequence);
+    } else {
+      s = t->InternalMultiGet(options, n, keys, args, saver);
+    }
+    if (s.ok()) {
+      for (size_t i = 0; i < range_savers.size(); i++) {
+        FinishRangeDeletionSaver(&range_savers[i]);
+      }
+    }
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+Status TableCache::AddRangeDeletions(uint64_t file_number,
+                                     uint64_t file_size,
+                                     int level,
+                                     RangeTombstones* result) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, level, &handle);
+  if (s.ok()) {
+    TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+    if (tf->range_deletions != nullptr) {
+      result->AddAll(*tf->range_deletions);
+    }
     cache_->Release(handle);
   }
   return s;
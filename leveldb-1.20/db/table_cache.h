@@ -17,6 +17,7 @@
 namespace leveldb {
 
 class Env;
+class RangeTombstones;
 
 class TableCache {
  public:
@@ -30,20 +31,56 @@ class TableCache {
   // underlies the returned iterator.  The returned "*tableptr" object is owned
   // by the cache and should not be deleted, and is valid for as long as the
   // returned iterator is live.
+  //
+  // "level" is the level the file belongs to, or -1 if it is not known.
+  // It decides whether the table pins its top-level index (see
+  // Options::pin_top_level_index) if this call is the one that opens it.
+  //
+  // If "global_sequence" is non-zero, the file was ingested with that
+  // sequence number (see FileMetaData::global_sequence) and the keys
+  // of the returned iterator carry it instead of the stored zero.
   Iterator* NewIterator(const ReadOptions& options,
                         uint64_t file_number,
                         uint64_t file_size,
+                        int level,
+                        SequenceNumber global_sequence,
                         Table** tableptr = nullptr);
 
   // If a seek to internal key "k" in specified file finds an entry,
-  // call (*handle_result)(arg, found_key, found_value).
+  // call (*handle_result)(arg, found_key, found_value).  An entry of an
+  // ingested file whose "global_sequence" is newer than the sequence
+  // number of "k" is not passed on.  If a range deletion of the file
+  // that is no newer than "k" covers its user key, an entry for that
+  // user key that is older than the deletion is passed on as a deletion,
+  // and so is the absence of such an entry.
   Status Get(const ReadOptions& options,
              uint64_t file_number,
              uint64_t file_size,
+             int level,
+             SequenceNumber global_sequence,
              const Slice& k,
              void* arg,
              void (*handle_result)(void*, const Slice&, const Slice&));
 
+  // Like Get() for the internal keys keys[0,n-1], which must be sorted,
+  // calling (*handle_result)(args[i], found_key, found_value) for the
+  // entries found for keys[i].
+  Status MultiGet(const ReadOptions& options,
+                  uint64_t file_number,
+                  uint64_t file_size,
+                  int level,
+                  SequenceNumber global_sequence,
+                  int n,
+                  const Slice* keys,
+                  void* const* args,
+                  void (*handle_result)(void*, const Slice&, const Slice&));
+
+  // Add the range deletions of the specified file to *result.
+  Status AddRangeDeletions(uint64_t file_number,
+                           uint64_t file_size,
+                           int level,
+                           RangeTombstones* result);
+
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
@@ -53,7 +90,8 @@ class TableCache {
   const Options& options_;
   Cache* cache_;
 
-  Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+  Status FindTable(uint64_t file_number, uint64_t file_size, int level,
+                   Cache::Handle**);
 };
 
 }  // namespace leveldb
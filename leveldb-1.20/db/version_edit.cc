@@ -20,7 +20,9 @@ enum Tag {
   kDeletedFile          = 6,
   kNewFile              = 7,
   // 8 was used for large value refs
-  kPrevLogNumber        = 9
+  kPrevLogNumber        = 9,
+  kNewIngestedFile      = 10,
+  kNewRangeDeletionFile = 11
 };
 
 void VersionEdit::Clear() {
@@ -76,12 +78,25 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
   for (size_t i = 0; i < new_files_.size(); i++) {
     const FileMetaData& f = new_files_[i].second;
-    PutVarint32(dst, kNewFile);
+    // Files without a global sequence number or range deletions keep the
+    // old encoding so that older versions can still read the MANIFEST.
+    // Ingested files never have range deletions.
+    assert(f.global_sequence == 0 || !f.has_range_deletions);
+    if (f.global_sequence != 0) {
+      PutVarint32(dst, kNewIngestedFile);
+    } else if (f.has_range_deletions) {
+      PutVarint32(dst, kNewRangeDeletionFile);
+    } else {
+      PutVarint32(dst, kNewFile);
+    }
     PutVarint32(dst, new_files_[i].first);  // level
     PutVarint64(dst, f.number);
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (f.global_sequence != 0) {
+      PutVarint64(dst, f.global_sequence);
+    }
   }
 }
 
@@ -181,6 +196,9 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         break;
 
       case kNewFile:
+      case kNewRangeDeletionFile:
+        f.global_sequence = 0;
+        f.has_range_deletions = (tag == kNewRangeDeletionFile);
         if (GetLevel(&input, &level) &&
             GetVarint64(&input, &f.number) &&
             GetVarint64(&input, &f.file_size) &&
@@ -192,6 +210,20 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kNewIngestedFile:
+        f.has_range_deletions = false;
+        if (GetLevel(&input, &level) &&
+            GetVarint64(&input, &f.number) &&
+            GetVarint64(&input, &f.file_size) &&
+            GetInternalKey(&input, &f.smallest) &&
+            GetInternalKey(&input, &f.largest) &&
+            GetVarint64(&input, &f.global_sequence)) {
+          new_files_.push_back(std::make_pair(level, f));
+        } else {
+          msg = "ingested-file entry";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -258,6 +290,13 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.global_sequence != 0) {
+      r.append(" @ ");
+      AppendNumberTo(&r, f.global_sequence);
+    }
+    if (f.has_range_deletions) {
+      r.append(" (range deletions)");
+    }
   }
   r.append("\n}\n");
   return r;
@@ -22,7 +22,19 @@ struct FileMetaData {
   InternalKey smallest;       // Smallest internal key served by table
   InternalKey largest;        // Largest internal key served by table
 
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) { }
+  // Zero, or the sequence number that DB::IngestExternalFile() assigned
+  // to every key of the file.  The file itself stores its keys with
+  // sequence number zero and TableCache substitutes this one when it
+  // reads them; "smallest" and "largest" already carry it.
+  SequenceNumber global_sequence;
+
+  // The file has a range deletion block (see RangeTombstones), which
+  // "smallest" and "largest" take into account.
+  bool has_range_deletions;
+
+  FileMetaData()
+      : refs(0), allowed_seeks(1 << 30), file_size(0),
+        global_sequence(0), has_range_deletions(false) { }
 };
 
 class VersionEdit {
@@ -62,12 +74,16 @@ class VersionEdit {
   void AddFile(int level, uint64_t file,
                uint64_t file_size,
                const InternalKey& smallest,
-               const InternalKey& largest) {
+               const InternalKey& largest,
+               SequenceNumber global_sequence = 0,
+               bool has_range_deletions = false) {
     FileMetaData f;
     f.number = file;
     f.file_size = file_size;
     f.smallest = smallest;
     f.largest = largest;
+    f.global_sequence = global_sequence;
+    f.has_range_deletions = has_range_deletions;
     new_files_.push_back(std::make_pair(level, f));
   }
 
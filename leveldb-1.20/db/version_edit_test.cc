@@ -39,6 +39,34 @@ TEST(VersionEditTest, EncodeDecode) {
   TestEncodeDecode(edit);
 }
 
+TEST(VersionEditTest, EncodeDecodeIngestedFiles) {
+  static const uint64_t kBig = 1ull << 50;
+
+  // Files with and without a global sequence number alternate, so that a
+  // decoder that carried one file's over to the next would not round-trip.
+  VersionEdit edit;
+  for (int i = 0; i < 4; i++) {
+    edit.AddFile(3, kBig + 300 + i, kBig + 400 + i,
+                 InternalKey("foo", kBig + 500 + i, kTypeValue),
+                 InternalKey("zoo", kBig + 500 + i, kTypeDeletion),
+                 (i % 2 == 0) ? kBig + 500 + i : 0);
+    TestEncodeDecode(edit);
+  }
+}
+
+TEST(VersionEditTest, EncodeDecodeRangeDeletionFiles) {
+  static const uint64_t kBig = 1ull << 50;
+
+  VersionEdit edit;
+  for (int i = 0; i < 4; i++) {
+    edit.AddFile(3, kBig + 300 + i, kBig + 400 + i,
+                 InternalKey("foo", kBig + 500 + i, kTypeRangeDeletion),
+                 InternalKey("zoo", kMaxSequenceNumber, kTypeRangeDeletion),
+                 0, i % 2 == 0);
+    TestEncodeDecode(edit);
+  }
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
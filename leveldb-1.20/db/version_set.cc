@@ -10,6 +10,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstones.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
 #include "leveldb/table_builder.h"
@@ -17,6 +18,8 @@
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
 #include "util/logging.h"
+#include "util/mutexlock.h"
+#include "util/thread_pool.h"
 
 namespace leveldb {
 
@@ -81,6 +84,7 @@ Version::~Version() {
       }
     }
   }
+  delete range_deletions_;
 }
 
 int FindFile(const InternalKeyComparator& icmp,
@@ -157,15 +161,18 @@ bool SomeFileOverlapsRange(
 
 // An internal iterator.  For a given version/level pair, yields
 // information about the files in the level.  For a given entry, key()
-// is the largest key that occurs in the file, and value() is an
-// 16-byte value containing the file number and file size, both
-// encoded using EncodeFixed64.
+// is the largest key that occurs in the file, and value() is a
+// 28-byte value containing the file number, file size and global
+// sequence number, all encoded using EncodeFixed64, followed by the
+// level encoded using EncodeFixed32.
 class Version::LevelFileNumIterator : public Iterator {
  public:
   LevelFileNumIterator(const InternalKeyComparator& icmp,
-                       const std::vector<FileMetaData*>* flist)
+                       const std::vector<FileMetaData*>* flist,
+                       int level)
       : icmp_(icmp),
         flist_(flist),
+        level_(level),
         index_(flist->size()) {        // Marks as invalid
   }
   virtual bool Valid() const {
@@ -198,37 +205,43 @@ class Version::LevelFileNumIterator : public Iterator {
     assert(Valid());
     EncodeFixed64(value_buf_, (*flist_)[index_]->number);
     EncodeFixed64(value_buf_+8, (*flist_)[index_]->file_size);
+    EncodeFixed64(value_buf_+16, (*flist_)[index_]->global_sequence);
+    EncodeFixed32(value_buf_+24, level_);
     return Slice(value_buf_, sizeof(value_buf_));
   }
   virtual Status status() const { return Status::OK(); }
  private:
   const InternalKeyComparator icmp_;
   const std::vector<FileMetaData*>* const flist_;
+  const int level_;
   uint32_t index_;
 
-  // Backing store for value().  Holds the file number and size.
-  mutable char value_buf_[16];
+  // Backing store for value().  Holds the file number, size, global
+  // sequence number and level.
+  mutable char value_buf_[28];
 };
 
 static Iterator* GetFileIterator(void* arg,
                                  const ReadOptions& options,
                                  const Slice& file_value) {
   TableCache* cache = reinterpret_cast<TableCache*>(arg);
-  if (file_value.size() != 16) {
+  if (file_value.size() != 28) {
     return NewErrorIterator(
         Status::Corruption("FileReader invoked with unexpected value"));
   } else {
     return cache->NewIterator(options,
                               DecodeFixed64(file_value.data()),
-                              DecodeFixed64(file_value.data() + 8));
+                              DecodeFixed64(file_value.data() + 8),
+                              DecodeFixed32(file_value.data() + 24),
+                              DecodeFixed64(file_value.data() + 16));
   }
 }
 
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
                                             int level) const {
   return NewTwoLevelIterator(
-      new LevelFileNumIterator(vset_->icmp_, &files_[level]),
-      &GetFileIterator, vset_->table_cache_, options);
+      new LevelFileNumIterator(vset_->icmp_, &files_[level], level),
+      &GetFileIterator, vset_->table_cache_, options, &vset_->icmp_);
 }
 
 void Version::AddIterators(const ReadOptions& options,
@@ -237,7 +250,8 @@ void Version::AddIterators(const ReadOptions& options,
   for (size_t i = 0; i < files_[0].size(); i++) {
     iters->push_back(
         vset_->table_cache_->NewIterator(
-            options, files_[0][i]->number, files_[0][i]->file_size));
+            options, files_[0][i]->number, files_[0][i]->file_size, 0,
+            files_[0][i]->global_sequence));
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
@@ -250,6 +264,37 @@ void Version::AddIterators(const ReadOptions& options,
   }
 }
 
+Status Version::GetRangeDeletions(const RangeTombstones** result) {
+  MutexLock l(&range_deletions_mu_);
+  if (!range_deletions_loaded_) {
+    RangeTombstones* deletions =
+        new RangeTombstones(vset_->icmp_.user_comparator());
+    for (int level = 0; level < config::kNumLevels; level++) {
+      for (size_t i = 0; i < files_[level].size(); i++) {
+        const FileMetaData* f = files_[level][i];
+        if (f->has_range_deletions) {
+          Status s = vset_->table_cache_->AddRangeDeletions(
+              f->number, f->file_size, level, deletions);
+          if (!s.ok()) {
+            // Try again on the next call
+            delete deletions;
+            *result = nullptr;
+            return s;
+          }
+        }
+      }
+    }
+    if (deletions->empty()) {
+      delete deletions;
+      deletions = nullptr;
+    }
+    range_deletions_ = deletions;
+    range_deletions_loaded_ = true;
+  }
+  *result = range_deletions_;
+  return Status::OK();
+}
+
 // Callback from TableCache::Get()
 namespace {
 enum SaverState {
@@ -284,6 +329,184 @@ static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
   return a->number > b->number;
 }
 
+namespace {
+// The keys of a Version::MultiGet() batch that one table file may hold.
+struct FileLookup {
+  FileMetaData* file;
+  int level;
+  std::vector<size_t> keys;  // Indexes into the batch, in key order
+  Status status;
+};
+
+// The state of a Version::MultiGet() call: one Saver per key, plus what
+// is needed to charge seeks the way Version::Get() does.
+class MultiGetBatch {
+ public:
+  MultiGetBatch(TableCache* table_cache, ThreadPool* pool,
+                const ReadOptions& options, const Comparator* ucmp,
+                Version::MultiGetKey* keys, size_t n)
+      : table_cache_(table_cache),
+        pool_(pool),
+        options_(options),
+        keys_(keys),
+        savers_(n),
+        last_file_read_(n, nullptr),
+        last_file_read_level_(n, -1),
+        done_(n, false),
+        cv_(&mu_),
+        lookups_(nullptr),
+        next_lookup_(0),
+        running_threads_(0) {
+    for (size_t i = 0; i < n; i++) {
+      savers_[i].state = kNotFound;
+      savers_[i].ucmp = ucmp;
+      savers_[i].user_key = keys[i].key->user_key();
+      savers_[i].value = keys[i].value;
+      keys[i].status = Status::NotFound(Slice());
+      keys[i].stats.seek_file = nullptr;
+      keys[i].stats.seek_file_level = -1;
+    }
+  }
+
+  // Run every element of "*lookups", which must name distinct files, and
+  // remove the keys that get resolved from "*pending".
+  void Run(std::vector<FileLookup>* lookups, std::vector<size_t>* pending) {
+    for (size_t j = 0; j < lookups->size(); j++) {
+      const FileLookup& lookup = (*lookups)[j];
+      for (size_t k = 0; k < lookup.keys.size(); k++) {
+        const size_t i = lookup.keys[k];
+        if (last_file_read_[i] != nullptr &&
+            keys_[i].stats.seek_file == nullptr) {
+          // More than one seek for this key.  Charge the 1st file.
+          keys_[i].stats.seek_file = last_file_read_[i];
+          keys_[i].stats.seek_file_level = last_file_read_level_[i];
+        }
+        last_file_read_[i] = lookup.file;
+        last_file_read_level_[i] = lookup.level;
+      }
+    }
+
+    lookups_ = lookups;
+    next_lookup_ = 0;
+    int threads = (pool_ != nullptr) ? options_.multiget_threads : 1;
+    if (threads > static_cast<int>(lookups->size())) {
+      threads = static_cast<int>(lookups->size());
+    }
+    if (threads > 1) {
+      // The helpers only take the lookups this thread has not got to yet,
+      // so one that starts late, because the pool is busy with other
+      // batches, finds nothing left and returns at once.
+      running_threads_ = threads - 1;
+      for (int t = 1; t < threads; t++) {
+        pool_->Schedule(&MultiGetBatch::LookupThread, this);
+      }
+    }
+    RunLookups();
+    if (threads > 1) {
+      MutexLock l(&mu_);
+      while (running_threads_ > 0) {
+        cv_.Wait();
+      }
+    }
+
+    for (size_t j = 0; j < lookups->size(); j++) {
+      const FileLookup& lookup = (*lookups)[j];
+      for (size_t k = 0; k < lookup.keys.size(); k++) {
+        Resolve(lookup.keys[k], lookup.status);
+      }
+    }
+    size_t remaining = 0;
+    for (size_t j = 0; j < pending->size(); j++) {
+      if (!done_[(*pending)[j]]) {
+        (*pending)[remaining++] = (*pending)[j];
+      }
+    }
+    pending->resize(remaining);
+  }
+
+ private:
+  // Run lookups until there are none left.
+  void RunLookups() {
+    while (true) {
+      size_t j;
+      {
+        MutexLock l(&mu_);
+        j = next_lookup_++;
+      }
+      if (j >= lookups_->size()) {
+        break;
+      }
+      RunLookup(&(*lookups_)[j]);
+    }
+  }
+
+  static void LookupThread(void* arg) {
+    MultiGetBatch* batch = reinterpret_cast<MultiGetBatch*>(arg);
+    batch->RunLookups();
+    MutexLock l(&batch->mu_);
+    batch->running_threads_--;
+    batch->cv_.SignalAll();
+  }
+
+  void RunLookup(FileLookup* lookup) {
+    const size_t n = lookup->keys.size();
+    std::vector<Slice> ikeys(n);
+    std::vector<void*> args(n);
+    for (size_t k = 0; k < n; k++) {
+      const size_t i = lookup->keys[k];
+      ikeys[k] = keys_[i].key->internal_key();
+      args[k] = &savers_[i];
+    }
+    lookup->status = table_cache_->MultiGet(
+        options_, lookup->file->number, lookup->file->file_size,
+        lookup->level, lookup->file->global_sequence, static_cast<int>(n),
+        &ikeys[0], &args[0], SaveValue);
+  }
+
+  // Record the outcome of looking up key "i" in a file.
+  void Resolve(size_t i, const Status& s) {
+    if (!s.ok()) {
+      keys_[i].status = s;
+      done_[i] = true;
+      return;
+    }
+    switch (savers_[i].state) {
+      case kNotFound:
+        break;      // Keep searching in other files
+      case kFound:
+        keys_[i].status = Status::OK();
+        done_[i] = true;
+        break;
+      case kDeleted:
+        keys_[i].status = Status::NotFound(Slice());
+        done_[i] = true;
+        break;
+      case kCorrupt:
+        keys_[i].status = Status::Corruption("corrupted key for ",
+                                             savers_[i].user_key);
+        done_[i] = true;
+        break;
+    }
+  }
+
+  TableCache* const table_cache_;
+  ThreadPool* const pool_;
+  const ReadOptions& options_;
+  Version::MultiGetKey* const keys_;
+  std::vector<Saver> savers_;
+  std::vector<FileMetaData*> last_file_read_;
+  std::vector<int> last_file_read_level_;
+  std::vector<bool> done_;
+
+  // Lets threads take turns at the lookups of a Run() call
+  port::Mutex mu_;
+  port::CondVar cv_;
+  std::vector<FileLookup>* lookups_;
+  size_t next_lookup_ GUARDED_BY(mu_);
+  int running_threads_ GUARDED_BY(mu_);  // Helpers scheduled on pool_
+};
+}  // namespace
+
 void Version::ForEachOverlapping(Slice user_key, Slice internal_key,
                                  void* arg,
                                  bool (*func)(void*, int, FileMetaData*)) {
@@ -405,8 +628,9 @@ Status Version::Get(const ReadOptions& options,
       saver.ucmp = ucmp;
       saver.user_key = user_key;
       saver.value = value;
-      s = vset_->table_cache_->Get(options, f->number, f->file_size,
-                                   ikey, &saver, SaveValue);
+      s = vset_->table_cache_->Get(options, f->number, f->file_size, level,
+                                   f->global_sequence, ikey, &saver,
+                                   SaveValue);
       if (!s.ok()) {
         return s;
       }
@@ -428,6 +652,75 @@ Status Version::Get(const ReadOptions& options,
   return Status::NotFound(Slice());  // Use an empty error message for speed
 }
 
+void Version::MultiGet(const ReadOptions& options, MultiGetKey* keys,
+                       size_t n, ThreadPool* pool) {
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  MultiGetBatch batch(vset_->table_cache_, pool, options, ucmp, keys, n);
+  std::vector<size_t> pending(n);  // Keys not resolved yet, in key order
+  for (size_t i = 0; i < n; i++) {
+    pending[i] = i;
+  }
+
+  // As in Get(), search level-by-level.  A key that is resolved in a
+  // level is not looked for in later ones.
+  std::vector<FileLookup> lookups;
+  for (int level = 0; level < config::kNumLevels && !pending.empty();
+       level++) {
+    size_t num_files = files_[level].size();
+    if (num_files == 0) continue;
+
+    if (level == 0) {
+      // Level-0 files may overlap each other.  Look in them one at a time,
+      // from newest to oldest.
+      std::vector<FileMetaData*> tmp(files_[0]);
+      std::sort(tmp.begin(), tmp.end(), NewestFirst);
+      for (size_t f = 0; f < tmp.size() && !pending.empty(); f++) {
+        lookups.resize(1);
+        FileLookup* lookup = &lookups[0];
+        lookup->file = tmp[f];
+        lookup->level = 0;
+        lookup->keys.clear();
+        for (size_t j = 0; j < pending.size(); j++) {
+          const Slice user_key = keys[pending[j]].key->user_key();
+          if (ucmp->Compare(user_key, tmp[f]->smallest.user_key()) >= 0 &&
+              ucmp->Compare(user_key, tmp[f]->largest.user_key()) <= 0) {
+            lookup->keys.push_back(pending[j]);
+          }
+        }
+        if (!lookup->keys.empty()) {
+          batch.Run(&lookups, &pending);
+        }
+      }
+      continue;
+    }
+
+    // Files of other levels are disjoint and sorted, and so are the keys,
+    // so each file gets a run of consecutive keys.
+    lookups.clear();
+    for (size_t j = 0; j < pending.size(); j++) {
+      const LookupKey* k = keys[pending[j]].key;
+      uint32_t index = FindFile(vset_->icmp_, files_[level],
+                                k->internal_key());
+      if (index >= num_files) {
+        break;  // All later keys are past the end of the level
+      }
+      FileMetaData* f = files_[level][index];
+      if (ucmp->Compare(k->user_key(), f->smallest.user_key()) < 0) {
+        continue;  // All of "f" is past any data for this key
+      }
+      if (lookups.empty() || lookups.back().file != f) {
+        lookups.resize(lookups.size() + 1);
+        lookups.back().file = f;
+        lookups.back().level = level;
+      }
+      lookups.back().keys.push_back(pending[j]);
+    }
+    if (!lookups.empty()) {
+      batch.Run(&lookups, &pending);
+    }
+  }
+}
+
 bool Version::UpdateStats(const GetStats& stats) {
   FileMetaData* f = stats.seek_file;
   if (f != nullptr) {
@@ -791,6 +1084,9 @@ VersionSet::VersionSet(const std::string& dbname,
       descriptor_log_(nullptr),
       dummy_versions_(this),
       current_(nullptr) {
+  for (int level = 0; level < config::kNumLevels; level++) {
+    level_being_compacted_[level] = false;
+  }
   AppendVersion(new Version(this));
 }
 
@@ -1067,10 +1363,7 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
 }
 
 void VersionSet::Finalize(Version* v) {
-  // Precomputed best level for next compaction
-  int best_level = -1;
-  double best_score = -1;
-
+  // Precomputed compaction score of every level
   for (int level = 0; level < config::kNumLevels-1; level++) {
     double score;
     if (level == 0) {
@@ -1094,14 +1387,8 @@ void VersionSet::Finalize(Version* v) {
           static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
     }
 
-    if (score > best_score) {
-      best_level = level;
-      best_score = score;
-    }
+    v->compaction_scores_[level] = score;
   }
-
-  v->compaction_level_ = best_level;
-  v->compaction_score_ = best_score;
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log) {
@@ -1125,7 +1412,8 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest,
+                   f->global_sequence, f->has_range_deletions);
     }
   }
 
@@ -1176,7 +1464,8 @@ uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey) {
         // approximate offset of "ikey" within the table.
         Table* tableptr;
         Iterator* iter = table_cache_->NewIterator(
-            ReadOptions(), files[i]->number, files[i]->file_size, &tableptr);
+            ReadOptions(), files[i]->number, files[i]->file_size, level,
+            files[i]->global_sequence, &tableptr);
         if (tableptr != nullptr) {
           result += tableptr->ApproximateOffsetOf(ikey.Encode());
         }
@@ -1277,13 +1566,15 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
         for (size_t i = 0; i < files.size(); i++) {
           list[num++] = table_cache_->NewIterator(
-              options, files[i]->number, files[i]->file_size);
+              options, files[i]->number, files[i]->file_size, 0,
+              files[i]->global_sequence);
         }
       } else {
         // Create concatenating iterator for the files from this level
         list[num++] = NewTwoLevelIterator(
-            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
-            &GetFileIterator, table_cache_, options);
+            new Version::LevelFileNumIterator(icmp_, &c->inputs_[which],
+                                              c->level() + which),
+            &GetFileIterator, table_cache_, options, &icmp_);
       }
     }
   }
@@ -1293,17 +1584,63 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   return result;
 }
 
+Status VersionSet::AddInputRangeDeletions(Compaction* c,
+                                          RangeTombstones* result) {
+  for (int which = 0; which < 2; which++) {
+    for (size_t i = 0; i < c->inputs_[which].size(); i++) {
+      const FileMetaData* f = c->inputs_[which][i];
+      if (f->has_range_deletions) {
+        Status s = table_cache_->AddRangeDeletions(
+            f->number, f->file_size, c->level() + which, result);
+        if (!s.ok()) {
+          return s;
+        }
+      }
+    }
+  }
+  return Status::OK();
+}
+
+bool VersionSet::NeedsCompaction() const {
+  Version* v = current_;
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    if (v->compaction_scores_[level] >= 1 && CanCompactLevel(level)) {
+      return true;
+    }
+  }
+  return (v->file_to_compact_ != nullptr &&
+          CanCompactLevel(v->file_to_compact_level_));
+}
+
+void VersionSet::MarkBeingCompacted(Compaction* c, bool value) {
+  for (int which = 0; which < 2; which++) {
+    assert(level_being_compacted_[c->level() + which] != value);
+    level_being_compacted_[c->level() + which] = value;
+  }
+  c->vset_ = (value ? this : nullptr);
+}
+
 Compaction* VersionSet::PickCompaction() {
   Compaction* c;
-  int level;
+
+  // Pick the level with the highest score among the levels that can be
+  // compacted without conflicting with a running compaction.
+  const double* scores = current_->compaction_scores_;
+  int level = -1;
+  for (int l = 0; l < config::kNumLevels - 1; l++) {
+    if (scores[l] >= 1 && CanCompactLevel(l) &&
+        (level < 0 || scores[l] > scores[level])) {
+      level = l;
+    }
+  }
 
   // We prefer compactions triggered by too much data in a level over
   // the compactions triggered by seeks.
-  const bool size_compaction = (current_->compaction_score_ >= 1);
-  const bool seek_compaction = (current_->file_to_compact_ != nullptr);
+  const bool size_compaction = (level >= 0);
+  const bool seek_compaction =
+      (current_->file_to_compact_ != nullptr &&
+       CanCompactLevel(current_->file_to_compact_level_));
   if (size_compaction) {
-    level = current_->compaction_level_;
-    assert(level >= 0);
     assert(level+1 < config::kNumLevels);
     c = new Compaction(options_, level);
 
@@ -1343,6 +1680,7 @@ Compaction* VersionSet::PickCompaction() {
   }
 
   SetupOtherInputs(c);
+  MarkBeingCompacted(c, true);
 
   return c;
 }
@@ -1440,22 +1778,30 @@ Compaction* VersionSet::CompactRange(
   c->input_version_->Ref();
   c->inputs_[0] = inputs;
   SetupOtherInputs(c);
+  MarkBeingCompacted(c, true);
   return c;
 }
 
 Compaction::Compaction(const Options* options, int level)
-    : level_(level),
+    : vset_(nullptr),
+      level_(level),
       max_output_file_size_(MaxFileSizeForLevel(options, level)),
-      input_version_(nullptr),
-      grandparent_index_(0),
-      seen_key_(false),
-      overlapped_bytes_(0) {
+      input_version_(nullptr) {
+}
+
+Compaction::Progress::Progress()
+    : grandparent_index(0),
+      seen_key(false),
+      overlapped_bytes(0) {
   for (int i = 0; i < config::kNumLevels; i++) {
-    level_ptrs_[i] = 0;
+    level_ptrs[i] = 0;
   }
 }
 
 Compaction::~Compaction() {
+  if (vset_ != nullptr) {
+    vset_->MarkBeingCompacted(this, false);
+  }
   if (input_version_ != nullptr) {
     input_version_->Unref();
   }
@@ -1479,13 +1825,15 @@ void Compaction::AddInputDeletions(VersionEdit* edit) {
   }
 }
 
-bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
+bool Compaction::IsBaseLevelForKey(const Slice& user_key,
+                                   Progress* progress) {
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
+  size_t* level_ptrs = progress->level_ptrs;
   for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
-    for (; level_ptrs_[lvl] < files.size(); ) {
-      FileMetaData* f = files[level_ptrs_[lvl]];
+    for (; level_ptrs[lvl] < files.size(); ) {
+      FileMetaData* f = files[level_ptrs[lvl]];
       if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
         // We've advanced far enough
         if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0) {
@@ -1494,36 +1842,109 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
         }
         break;
       }
-      level_ptrs_[lvl]++;
+      level_ptrs[lvl]++;
+    }
+  }
+  return true;
+}
+
+bool Compaction::IsBaseLevelForRange(const Slice& start, const Slice& end) {
+  // Treating "end" as included errs on the safe side
+  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+    if (input_version_->OverlapInLevel(lvl, &start, &end)) {
+      return false;
     }
   }
   return true;
 }
 
-bool Compaction::ShouldStopBefore(const Slice& internal_key) {
+bool Compaction::ShouldStopBefore(const Slice& internal_key,
+                                  Progress* progress) {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
   const InternalKeyComparator* icmp = &vset->icmp_;
-  while (grandparent_index_ < grandparents_.size() &&
+  while (progress->grandparent_index < grandparents_.size() &&
       icmp->Compare(internal_key,
-                    grandparents_[grandparent_index_]->largest.Encode()) > 0) {
-    if (seen_key_) {
-      overlapped_bytes_ += grandparents_[grandparent_index_]->file_size;
+                    grandparents_[progress->grandparent_index]->largest.Encode())
+          > 0) {
+    if (progress->seen_key) {
+      progress->overlapped_bytes +=
+          grandparents_[progress->grandparent_index]->file_size;
     }
-    grandparent_index_++;
+    progress->grandparent_index++;
   }
-  seen_key_ = true;
+  progress->seen_key = true;
 
-  if (overlapped_bytes_ > MaxGrandParentOverlapBytes(vset->options_)) {
+  if (progress->overlapped_bytes > MaxGrandParentOverlapBytes(vset->options_)) {
     // Too much overlap for current output; start new output
-    overlapped_bytes_ = 0;
+    progress->overlapped_bytes = 0;
     return true;
   } else {
     return false;
   }
 }
 
+namespace {
+struct FileLargestUserKeyLess {
+  const Comparator* user_cmp;
+  bool operator()(const FileMetaData* a, const FileMetaData* b) const {
+    return user_cmp->Compare(a->largest.user_key(), b->largest.user_key()) < 0;
+  }
+};
+}  // namespace
+
+void Compaction::GetSubcompactionBoundaries(
+    int n, std::vector<std::string>* boundaries) const {
+  boundaries->clear();
+  if (n <= 1) {
+    return;
+  }
+
+  // Every input file ends at a candidate boundary.  Weigh each candidate
+  // by the size of the file that ends there and cut whenever another 1/n
+  // of the input bytes has been passed.
+  std::vector<FileMetaData*> files;
+  for (int which = 0; which < 2; which++) {
+    files.insert(files.end(), inputs_[which].begin(), inputs_[which].end());
+  }
+  if (files.size() < 2) {
+    return;
+  }
+  FileLargestUserKeyLess cmp;
+  cmp.user_cmp = input_version_->vset_->icmp_.user_comparator();
+  std::sort(files.begin(), files.end(), cmp);
+
+  const int64_t total = TotalFileSize(files);
+  int64_t sum = 0;
+  int pieces = 1;
+  // The last file ends at the largest input key, which is never a useful
+  // boundary, so it is not considered.
+  for (size_t i = 0; i + 1 < files.size() && pieces < n; i++) {
+    sum += files[i]->file_size;
+    if (sum * n < total * pieces) {
+      continue;
+    }
+    // Each user key must be handled by exactly one piece, and a
+    // boundary equal to the previous one would produce an empty piece.
+    Slice key = files[i]->largest.user_key();
+    if (!boundaries->empty() &&
+        cmp.user_cmp->Compare(key, Slice(boundaries->back())) <= 0) {
+      continue;
+    }
+    if (cmp.user_cmp->Compare(key,
+                              files.back()->largest.user_key()) >= 0) {
+      break;
+    }
+    boundaries->push_back(key.ToString());
+    pieces++;
+  }
+}
+
 void Compaction::ReleaseInputs() {
+  // The input files may be freed along with input_version_.
+  if (vset_ != nullptr) {
+    vset_->MarkBeingCompacted(this, false);
+  }
   if (input_version_ != nullptr) {
     input_version_->Unref();
     input_version_ = nullptr;
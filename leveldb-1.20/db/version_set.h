@@ -30,8 +30,10 @@ namespace log { class Writer; }
 class Compaction;
 class Iterator;
 class MemTable;
+class RangeTombstones;
 class TableBuilder;
 class TableCache;
+class ThreadPool;
 class Version;
 class VersionSet;
 class WritableFile;
@@ -62,16 +64,48 @@ class Version {
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
   void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
+  // Set *result to the range deletions of the files of this Version, or
+  // to nullptr if there are none.  The first call reads them from the
+  // files; the result is kept until the Version is deleted, so the
+  // caller must hold a reference for as long as it uses *result.
+  // REQUIRES: lock is not held
+  Status GetRangeDeletions(const RangeTombstones** result);
+
   // Lookup the value for key.  If found, store it in *val and
   // return OK.  Else return a non-OK status.  Fills *stats.
   // REQUIRES: lock is not held
   struct GetStats {
     FileMetaData* seek_file;
     int seek_file_level;
+
+    GetStats() : seek_file(nullptr), seek_file_level(-1) { }
   };
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
              GetStats* stats);
 
+  // A key of a MultiGet() batch.  "key" and "value" are inputs; the
+  // other fields are filled in by MultiGet().
+  struct MultiGetKey {
+    const LookupKey* key;
+    std::string* value;
+    Status status;   // What Get() would have returned for "key"
+    GetStats stats;  // What Get() would have filled in for "key"
+
+    MultiGetKey() : key(nullptr), value(nullptr) { }
+  };
+
+  // Look up keys[0,n-1], which must be sorted by user key, as if by
+  // calling Get() for each.  Keys that fall in the same table file are
+  // looked up together, and if options.multiget_threads > 1, different
+  // files of a level are read concurrently by up to that many threads,
+  // the calling one plus threads of "*pool".  A null "pool" means that
+  // the calling thread does all the reads.
+  // REQUIRES: lock is not held
+  // REQUIRES: pool is null or has at least options.multiget_threads-1
+  //           threads
+  void MultiGet(const ReadOptions&, MultiGetKey* keys, size_t n,
+                ThreadPool* pool);
+
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
   // REQUIRES: lock is held
@@ -140,18 +174,26 @@ class Version {
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
 
-  // Level that should be compacted next and its compaction score.
-  // Score < 1 means compaction is not strictly needed.  These fields
-  // are initialized by Finalize().
-  double compaction_score_;
-  int compaction_level_;
+  // Compaction score of every level.  Score < 1 means compaction of
+  // that level is not strictly needed.  Every level is scored so that
+  // another level can be picked while the best one is already being
+  // compacted.  Initialized by Finalize().
+  double compaction_scores_[config::kNumLevels];
+
+  // The range deletions of files_, once GetRangeDeletions() has read them
+  port::Mutex range_deletions_mu_;
+  bool range_deletions_loaded_ GUARDED_BY(range_deletions_mu_);
+  RangeTombstones* range_deletions_ GUARDED_BY(range_deletions_mu_);
 
   explicit Version(VersionSet* vset)
       : vset_(vset), next_(this), prev_(this), refs_(0),
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
-        compaction_score_(-1),
-        compaction_level_(-1) {
+        range_deletions_loaded_(false),
+        range_deletions_(nullptr) {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      compaction_scores_[level] = -1;
+    }
   }
 
   ~Version();
@@ -223,16 +265,20 @@ class VersionSet {
   // being compacted, or zero if there is no such log file.
   uint64_t PrevLogNumber() const { return prev_log_number_; }
 
-  // Pick level and inputs for a new compaction.
+  // Pick level and inputs for a new compaction.  Levels that are already
+  // being compacted are skipped.
   // Returns nullptr if there is no compaction to be done.
   // Otherwise returns a pointer to a heap-allocated object that
-  // describes the compaction.  Caller should delete the result.
+  // describes the compaction.  The levels and input files of the
+  // compaction are marked as being compacted until the result is
+  // deleted.  Caller should delete the result.
   Compaction* PickCompaction();
 
   // Return a compaction object for compacting the range [begin,end] in
   // the specified level.  Returns nullptr if there is nothing in that
   // level that overlaps the specified range.  Caller should delete
   // the result.
+  // REQUIRES: !LevelBeingCompacted(level) && !LevelBeingCompacted(level+1)
   Compaction* CompactRange(
       int level,
       const InternalKey* begin,
@@ -246,10 +292,16 @@ class VersionSet {
   // The caller should delete the iterator when no longer needed.
   Iterator* MakeInputIterator(Compaction* c);
 
-  // Returns true iff some level needs a compaction.
-  bool NeedsCompaction() const {
-    Version* v = current_;
-    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr);
+  // Add the range deletions of the input files of "*c" to *result.
+  Status AddInputRangeDeletions(Compaction* c, RangeTombstones* result);
+
+  // Returns true iff some level needs a compaction that does not conflict
+  // with the compactions that are already running.
+  bool NeedsCompaction() const;
+
+  // Returns true iff a running compaction reads from or writes to "level".
+  bool LevelBeingCompacted(int level) const {
+    return level_being_compacted_[level];
   }
 
   // Add all files listed in any live version to *live.
@@ -288,6 +340,15 @@ class VersionSet {
 
   void SetupOtherInputs(Compaction* c);
 
+  // Returns true iff a compaction from "level" into "level+1" would not
+  // conflict with the compactions that are already running.
+  bool CanCompactLevel(int level) const {
+    return !level_being_compacted_[level] && !level_being_compacted_[level+1];
+  }
+
+  // Mark (or unmark) the levels of *c as being compacted.
+  void MarkBeingCompacted(Compaction* c, bool value);
+
   // Save current contents to *log
   Status WriteSnapshot(log::Writer* log);
 
@@ -314,6 +375,10 @@ class VersionSet {
   // Either an empty string, or a valid InternalKey.
   std::string compact_pointer_[config::kNumLevels];
 
+  // Per-level flag that is set while a compaction reads from or writes
+  // to that level.
+  bool level_being_compacted_[config::kNumLevels];
+
   // No copying allowed
   VersionSet(const VersionSet&);
   void operator=(const VersionSet&);
@@ -348,14 +413,48 @@ class Compaction {
   // Add all inputs to this compaction as delete operations to *edit.
   void AddInputDeletions(VersionEdit* edit);
 
+  // State used by IsBaseLevelForKey() and ShouldStopBefore() while
+  // walking over the compaction input.  Keys must be presented to a
+  // Progress in increasing order, so every key range of the compaction
+  // that is processed concurrently needs its own Progress.
+  struct Progress {
+    // State used to check for number of of overlapping grandparent files
+    // (parent == level_ + 1, grandparent == level_ + 2)
+    size_t grandparent_index;  // Index in grandparents_
+    bool seen_key;             // Some output key has been seen
+    int64_t overlapped_bytes;  // Bytes of overlap between current output
+                               // and grandparent files
+
+    // State for implementing IsBaseLevelForKey
+
+    // level_ptrs holds indices into input_version_->levels_: our state
+    // is that we are positioned at one of the file ranges for each
+    // higher level than the ones involved in this compaction (i.e. for
+    // all L >= level_ + 2).
+    size_t level_ptrs[config::kNumLevels];
+
+    Progress();
+  };
+
   // Returns true if the information we have available guarantees that
   // the compaction is producing data in "level+1" for which no data exists
   // in levels greater than "level+1".
-  bool IsBaseLevelForKey(const Slice& user_key);
+  bool IsBaseLevelForKey(const Slice& user_key, Progress* progress);
+
+  // Like IsBaseLevelForKey(), for the user keys in [start,end).
+  bool IsBaseLevelForRange(const Slice& start, const Slice& end);
 
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
-  bool ShouldStopBefore(const Slice& internal_key);
+  bool ShouldStopBefore(const Slice& internal_key, Progress* progress);
+
+  // Split the key range of this compaction into at most "n" disjoint
+  // pieces holding roughly equal amounts of input data.  Stores the user
+  // keys at which the second and later pieces start in *boundaries, in
+  // increasing order.  Leaves *boundaries empty if the compaction should
+  // not be split.
+  void GetSubcompactionBoundaries(int n,
+                                  std::vector<std::string>* boundaries) const;
 
   // Release the input version for the compaction, once the compaction
   // is successful.
@@ -367,6 +466,10 @@ class Compaction {
 
   Compaction(const Options* options, int level);
 
+  // Set while the levels and input files of this compaction are marked
+  // as being compacted in *vset_.
+  VersionSet* vset_;
+
   int level_;
   uint64_t max_output_file_size_;
   Version* input_version_;
@@ -375,21 +478,9 @@ class Compaction {
   // Each compaction reads inputs from "level_" and "level_+1"
   std::vector<FileMetaData*> inputs_[2];      // The two sets of inputs
 
-  // State used to check for number of of overlapping grandparent files
+  // Grandparent files that overlap this compaction
   // (parent == level_ + 1, grandparent == level_ + 2)
   std::vector<FileMetaData*> grandparents_;
-  size_t grandparent_index_;  // Index in grandparent_starts_
-  bool seen_key_;             // Some output key has been seen
-  int64_t overlapped_bytes_;  // Bytes of overlap between current output
-                              // and grandparent files
-
-  // State for implementing IsBaseLevelForKey
-
-  // level_ptrs_ holds indices into input_version_->levels_: our state
-  // is that we are positioned at one of the file ranges for each
-  // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
-  size_t level_ptrs_[config::kNumLevels];
 };
 
 }  // namespace leveldb
@@ -5,6 +5,7 @@
 #include "leveldb/db.h"
 
 #include "db/memtable.h"
+#include "db/range_tombstones.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/env.h"
 #include "util/logging.h"
@@ -38,11 +39,31 @@ static std::string PrintContents(WriteBatch* b) {
         state.append(")");
         count++;
         break;
+      case kTypeRangeDeletion:
+        state.append("Unexpected(");
+        state.append(ikey.user_key.ToString());
+        state.append(")");
+        break;
     }
     state.append("@");
     state.append(NumberToString(ikey.sequence));
   }
   delete iter;
+  RangeTombstones range_deletions(BytewiseComparator());
+  mem->GetRangeTombstones(&range_deletions);
+  std::vector<RangeTombstones::Fragment> fragments;
+  range_deletions.GetFragments(nullptr, nullptr, &fragments);
+  for (size_t i = 0; i < fragments.size(); i++) {
+    for (size_t j = 0; j < fragments[i].sequences.size(); j++) {
+      state.append("DeleteRange(");
+      state.append(fragments[i].start);
+      state.append(", ");
+      state.append(fragments[i].end);
+      state.append(")@");
+      state.append(NumberToString(fragments[i].sequences[j]));
+      count++;
+    }
+  }
   if (!s.ok()) {
     state.append("ParseError()");
   } else if (count != WriteBatchInternal::Count(b)) {
@@ -74,6 +95,31 @@ TEST(WriteBatchTest, Multiple) {
             PrintContents(&batch));
 }
 
+TEST(WriteBatchTest, DeleteRange) {
+  WriteBatch batch;
+  batch.Put(Slice("foo"), Slice("bar"));
+  batch.DeleteRange(Slice("a"), Slice("g"));
+  batch.Put(Slice("baz"), Slice("boo"));
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ(3, WriteBatchInternal::Count(&batch));
+  ASSERT_EQ("Put(baz, boo)@102"
+            "Put(foo, bar)@100"
+            "DeleteRange(a, g)@101",
+            PrintContents(&batch));
+
+  // Handlers that do not know about range deletions ignore them
+  class PutCounter : public WriteBatch::Handler {
+   public:
+    int puts;
+    PutCounter() : puts(0) { }
+    virtual void Put(const Slice& key, const Slice& value) { puts++; }
+    virtual void Delete(const Slice& key) { }
+  };
+  PutCounter counter;
+  ASSERT_OK(batch.Iterate(&counter));
+  ASSERT_EQ(2, counter.puts);
+}
+
 TEST(WriteBatchTest, Corruption) {
   WriteBatch batch;
   batch.Put(Slice("foo"), Slice("bar"));
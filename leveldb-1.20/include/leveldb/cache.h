@@ -30,6 +30,30 @@ class LEVELDB_EXPORT Cache;
 // of Cache uses a least-recently-used eviction policy.
 LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity);
 
+// Create a new cache with a fixed size capacity that resists scans.
+// Up to "high_pri_pool_ratio" of the capacity is a high priority pool
+// that holds the entries inserted with Cache::kHigh priority and the
+// entries that were looked up again after being inserted, in LRU order.
+// All other entries enter the LRU list at the midpoint, the head of the
+// low priority pool, and are evicted first.  A scan that reads each
+// block once then only displaces other blocks that were read once.
+// With a ratio of zero this is the same as NewLRUCache(capacity).
+LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity,
+                                  double high_pri_pool_ratio);
+
+// Create a new cache with a fixed size capacity that evicts entries with
+// the CLOCK algorithm, an approximation of least-recently-used.  Lookup()
+// and Release() take no locks, so many threads can read from the cache
+// without waiting on each other.  The cache is split into
+// 2^num_shard_bits shards (16 if num_shard_bits is negative), each of
+// which holds a number of entries fixed by "estimated_entry_charge", the
+// average charge expected per entry (usually Options::block_size for a
+// block cache).  Entries inserted with Cache::kHigh priority survive one
+// more turn of the clock than others.
+LEVELDB_EXPORT Cache* NewClockCache(size_t capacity,
+                                    size_t estimated_entry_charge,
+                                    int num_shard_bits);
+
 class LEVELDB_EXPORT Cache {
  public:
   Cache() = default;
@@ -44,6 +68,12 @@ class LEVELDB_EXPORT Cache {
   // Opaque handle to an entry stored in the cache.
   struct Handle { };
 
+  // How much an entry is worth keeping, relative to other entries.
+  enum Priority {
+    kHigh,
+    kLow
+  };
+
   // Insert a mapping from key->value into the cache and assign it
   // the specified charge against the total cache capacity.
   //
@@ -56,6 +86,13 @@ class LEVELDB_EXPORT Cache {
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) = 0;
 
+  // Like Insert() above, but the entry has the specified priority.  The
+  // four argument form inserts entries with kLow priority.  The default
+  // implementation ignores the priority.
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority);
+
   // If the cache has no mapping for "key", returns nullptr.
   //
   // Else return a handle that corresponds to the mapping.  The caller
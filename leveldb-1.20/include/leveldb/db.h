@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string>
+#include <vector>
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
@@ -17,6 +19,7 @@ namespace leveldb {
 static const int kMajorVersion = 1;
 static const int kMinorVersion = 20;
 
+struct IngestExternalFileOptions;
 struct Options;
 struct ReadOptions;
 struct WriteOptions;
@@ -73,11 +76,36 @@ class LEVELDB_EXPORT DB {
   // Note: consider setting options.sync = true.
   virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+  // Remove the database entries (if any) for every key in ["begin","end"),
+  // as ordered by the comparator.  The cost of the call does not depend
+  // on the number of keys removed: the range is recorded as a single
+  // deletion that hides the older entries until compactions drop them.
+  // Does nothing if "begin" is not before "end".
+  // Note: consider setting options.sync = true.
+  virtual Status DeleteRange(const WriteOptions& options,
+                             const Slice& begin, const Slice& end);
+
   // Apply the specified updates to the database.
   // Returns OK on success, non-OK on failure.
   // Note: consider setting options.sync = true.
   virtual Status Write(const WriteOptions& options, WriteBatch* updates) = 0;
 
+  // Add the table file "fname", built by an SstFileWriter with the
+  // comparator and filter policy of this database, to the database
+  // without copying its entries through the log and the memtable.  The
+  // entries of the file take effect atomically, as if written by a
+  // single Write() at the time of the call: they hide the older values
+  // of their keys, including from snapshots taken afterwards, and are
+  // hidden by later writes and from earlier snapshots.
+  //
+  // The file is placed into the deepest level that it can go to without
+  // overlapping newer data.  If the memtable holds keys in the range of
+  // the file, it is compacted first.
+  //
+  // The default implementation returns a NotSupported error.
+  virtual Status IngestExternalFile(const IngestExternalFileOptions& options,
+                                    const std::string& fname);
+
   // If the database contains an entry for "key" store the
   // corresponding value in *value and return OK.
   //
@@ -88,6 +116,19 @@ class LEVELDB_EXPORT DB {
   virtual Status Get(const ReadOptions& options,
                      const Slice& key, std::string* value) = 0;
 
+  // Look up several keys at once, as if by calling Get() for each of them
+  // against the same snapshot.  Resizes "*values" to keys.size() and
+  // returns one status per key: on success, (*values)[i] holds the value
+  // of keys[i]; otherwise the status is as Get() would return it and
+  // (*values)[i] is unspecified.
+  //
+  // This is cheaper than separate Get() calls: the DB state is pinned
+  // once for the whole batch, and keys that fall in the same table or
+  // data block share the index and block reads.
+  virtual std::vector<Status> MultiGet(const ReadOptions& options,
+                                       const std::vector<Slice>& keys,
+                                       std::vector<std::string>* values);
+
   // Return a heap-allocated iterator over the contents of the database.
   // The result of NewIterator() is initially invalid (caller must
   // call one of the Seek methods on the iterator before using it).
@@ -122,6 +163,11 @@ class LEVELDB_EXPORT DB {
   //     of the sstables that make up the db contents.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
+  //  "leveldb.write-stall-micros" - returns the total number of microseconds
+  //     writes have been delayed or blocked waiting for compactions.
+  //  "leveldb.rate-limiter" - returns a multi-line string with the bytes
+  //     written and the time spent waiting at each priority of
+  //     options.rate_limiter, if one is set.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
 
   // For each i in [0,n-1], store in "sizes[i]", the approximate
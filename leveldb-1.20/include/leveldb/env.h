@@ -91,6 +91,23 @@ class LEVELDB_EXPORT Env {
   virtual Status NewAppendableFile(const std::string& fname,
                                    WritableFile** result);
 
+  // Like NewRandomAccessFile(), but reads of the returned file bypass the
+  // operating system's page cache where the platform allows it (e.g.
+  // with O_DIRECT).
+  //
+  // The default implementation returns NewRandomAccessFile(fname, result).
+  virtual Status NewDirectRandomAccessFile(const std::string& fname,
+                                           RandomAccessFile** result);
+
+  // Like NewWritableFile(), but the data written bypasses the operating
+  // system's page cache where the platform allows it.  Flush() may keep
+  // data buffered until it fills a whole unit of direct I/O; Sync() and
+  // Close() write everything.
+  //
+  // The default implementation returns NewWritableFile(fname, result).
+  virtual Status NewDirectWritableFile(const std::string& fname,
+                                       WritableFile** result);
+
   // Returns true iff the named file exists.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -219,6 +236,33 @@ class LEVELDB_EXPORT RandomAccessFile {
   // Safe for concurrent use by multiple threads.
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       char* scratch) const = 0;
+
+  // Hint that the bytes in [offset, offset+n) are likely to be read soon.
+  // Implementations may start fetching them in the background, but must
+  // not wait for them to arrive.  The default implementation does
+  // nothing.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual void Prefetch(uint64_t offset, size_t n) const;
+
+  // One read of a MultiRead() batch.  The caller fills in the first three
+  // fields; MultiRead() fills in "result" and "status" exactly as Read()
+  // would.
+  struct ReadRequest {
+    uint64_t offset;
+    size_t n;
+    char* scratch;
+    Slice result;
+    Status status;
+  };
+
+  // Perform the reads reqs[0,n-1], which may overlap, in any order.
+  // Implementations that can keep several reads in flight should do so;
+  // all of them are complete when MultiRead() returns.  The default
+  // implementation calls Read() for each request in turn.
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual void MultiRead(ReadRequest* reqs, size_t n) const;
 };
 
 // A file abstraction for sequential writing.  The implementation
@@ -305,6 +349,14 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
   Status NewAppendableFile(const std::string& f, WritableFile** r) override {
     return target_->NewAppendableFile(f, r);
   }
+  Status NewDirectRandomAccessFile(const std::string& f,
+                                   RandomAccessFile** r) override {
+    return target_->NewDirectRandomAccessFile(f, r);
+  }
+  Status NewDirectWritableFile(const std::string& f,
+                               WritableFile** r) override {
+    return target_->NewDirectWritableFile(f, r);
+  }
   bool FileExists(const std::string& f) override {
     return target_->FileExists(f);
   }
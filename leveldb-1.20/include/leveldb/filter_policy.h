@@ -66,6 +66,18 @@ class LEVELDB_EXPORT FilterPolicy {
 // trailing spaces in keys.
 LEVELDB_EXPORT const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
 
+// Return a new filter policy that uses a blocked bloom filter with
+// approximately the specified number of bits per key.  All the bits of a
+// key lie in one 64-byte cache line, so a lookup costs at most one cache
+// miss where NewBloomFilterPolicy() may take one per probe.  In exchange,
+// the false positive rate is slightly higher for the same bits_per_key.
+// Filters built by the two policies are not interchangeable.
+//
+// The same caveats about callers deleting the result and about custom
+// comparators apply as for NewBloomFilterPolicy().
+LEVELDB_EXPORT const FilterPolicy* NewBlockedBloomFilterPolicy(
+    int bits_per_key);
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
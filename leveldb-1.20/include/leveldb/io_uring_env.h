@@ -0,0 +1,32 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// An Env whose random access files serve RandomAccessFile::MultiRead()
+// with Linux io_uring: a batch of reads is queued on a ring and handed to
+// the kernel with one system call, and the reads then proceed in
+// parallel.  Table lookups that need several data blocks at once, such
+// as DB::MultiGet(), use this to overlap their disk reads.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_IO_URING_ENV_H_
+#define STORAGE_LEVELDB_INCLUDE_IO_URING_ENV_H_
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Env;
+
+// Returns a new environment that delegates everything to base_env, but
+// wraps the random access files that base_env opens so that their
+// MultiRead() batches go through io_uring.  Where io_uring is not
+// available (other platforms, older kernels, or a kernel that refuses
+// it), the result behaves exactly like base_env.  Files opened for direct
+// I/O (see Options::use_direct_reads) also come from base_env.
+// The caller must delete the result when it is no longer needed.
+// *base_env must remain live while the result is in use.
+LEVELDB_EXPORT Env* NewIoUringEnv(Env* base_env);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_IO_URING_ENV_H_
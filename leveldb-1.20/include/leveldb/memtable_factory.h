@@ -0,0 +1,56 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a MemTableFactory, which picks the
+// in-memory data structure that holds recent writes until they are
+// flushed to a table file.  The default is a skiplist, which serves
+// point lookups and range scans equally well.
+//
+// Workloads made up mostly of point lookups may prefer the hash-indexed
+// representation returned by NewHashMemTableFactory().
+
+#ifndef STORAGE_LEVELDB_INCLUDE_MEMTABLE_FACTORY_H_
+#define STORAGE_LEVELDB_INCLUDE_MEMTABLE_FACTORY_H_
+
+#include <stddef.h>
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Arena;
+class MemTableRep;
+struct MemTableKeyComparator;
+
+class LEVELDB_EXPORT MemTableFactory {
+ public:
+  virtual ~MemTableFactory();
+
+  // Return the name of this factory.  Used for logging.
+  virtual const char* Name() const = 0;
+
+  // Create an empty representation whose entries are ordered by "cmp"
+  // and whose nodes are allocated from "arena".  MemTableRep and its
+  // helpers are internal to leveldb (see db/memtable_rep.h), so
+  // applications are expected to use one of the factories below.
+  virtual MemTableRep* NewRep(const MemTableKeyComparator& cmp,
+                              Arena* arena) const = 0;
+};
+
+// Return a new factory for memtables that index entries by a hash of
+// their user key.  Each of the "bucket_count" buckets holds a small
+// sorted list, so a point lookup touches only the entries that share
+// its bucket instead of searching the whole memtable.  Iterators are
+// more expensive: creating one sorts all entries of the memtable, which
+// makes this representation a poor fit for scan-heavy workloads.  The
+// bucket array is allocated outside the memtable's arena and therefore
+// does not count towards write_buffer_size.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const MemTableFactory* NewHashMemTableFactory(
+    size_t bucket_count);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_MEMTABLE_FACTORY_H_
@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <stddef.h>
+#include <vector>
 #include "leveldb/export.h"
 
 namespace leveldb {
@@ -15,6 +16,10 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class MemTableFactory;
+class RateLimiter;
+class Slice;
+class SliceTransform;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -25,7 +30,9 @@ enum CompressionType {
   // NOTE: do not change the values of existing entries, as these are
   // part of the persistent format on disk.
   kNoCompression     = 0x0,
-  kSnappyCompression = 0x1
+  kSnappyCompression = 0x1,
+  kZstdCompression   = 0x2,
+  kLZ4Compression    = 0x3
 };
 
 // Options to control the behavior of a database (passed to DB::Open)
@@ -95,9 +102,23 @@ struct LEVELDB_EXPORT Options {
 
   // If non-null, use the specified cache for blocks.
   // If null, leveldb will automatically create and use an 8MB internal cache.
+  // Index and filter blocks that go through the cache are inserted with
+  // Cache::kHigh priority, which NewLRUCache(capacity, high_pri_pool_ratio)
+  // uses to keep them, and frequently read data blocks, from being
+  // pushed out by scans.
   // Default: nullptr
   Cache* block_cache;
 
+  // If non-null, use the specified cache for blocks as they are stored in
+  // table files, i.e. compressed.  A block that misses block_cache is
+  // looked up here before it is read from disk, and a compressed block
+  // read from disk is added here as well as to block_cache.  Since
+  // compressed blocks are smaller, this cache holds a working set several
+  // times larger than a block_cache of the same capacity, at the cost of
+  // uncompressing the blocks that are found in it.
+  // Default: nullptr
+  Cache* block_cache_compressed;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -139,8 +160,52 @@ struct LEVELDB_EXPORT Options {
   // worth switching to kNoCompression.  Even if the input data is
   // incompressible, the kSnappyCompression implementation will
   // efficiently detect that and will switch to uncompressed mode.
+  //
+  // kLZ4Compression is about as fast as kSnappyCompression, and
+  // kZstdCompression compresses noticeably better at a higher cost,
+  // which makes it a good choice for the bottom levels of a database
+  // (see compression_per_level).  A block whose compression type is not
+  // supported by this build of leveldb is stored uncompressed.
   CompressionType compression;
 
+  // If non-empty, the tables a database writes to level L are compressed
+  // with compression_per_level[L], or with the last element if L is past
+  // the end, instead of with "compression".  Memtables are flushed with
+  // the setting of level 0.  For example {kLZ4Compression,
+  // kLZ4Compression, kLZ4Compression, kZstdCompression} uses LZ4 for
+  // levels 0 to 2, where data is rewritten soon, and zstd for the rest.
+  //
+  // Default: empty
+  std::vector<CompressionType> compression_per_level;
+
+  // Compression level used by kZstdCompression.  Higher levels compress
+  // better and more slowly.
+  //
+  // Default: 3
+  int zstd_compression_level;
+
+  // If non-zero, each table compressed with kZstdCompression trains a
+  // dictionary of up to this many bytes on its first data blocks, stores
+  // it in the table, and compresses the rest of its data blocks with it.
+  // Dictionaries help most with small blocks of similar records.  Tables
+  // written with a dictionary cannot be read by versions of leveldb that
+  // predate this option.
+  //
+  // Default: 0
+  size_t zstd_max_dictionary_bytes;
+
+  // If greater than 1, a table that is being written hands its completed
+  // data blocks to up to this many threads to be compressed while it keeps
+  // accepting keys.  The threads are started through "env" once some
+  // table asks for them, shared by all the tables of the DB, and stopped
+  // when the DB is closed.  The blocks are written to the file in order
+  // once they are compressed, so the table comes out the same as without
+  // this option.  This lets a single flush or compaction use several
+  // cores when compression is what limits it.
+  //
+  // Default: 1 (blocks are compressed by the thread writing the table)
+  int parallel_compression_threads;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
@@ -154,6 +219,126 @@ struct LEVELDB_EXPORT Options {
   // Default: nullptr
   const FilterPolicy* filter_policy;
 
+  // If true and filter_policy is set, each table gets a single filter
+  // over all of its keys instead of one filter per 2KB of data blocks.
+  // Lookups check it before they consult the index, so a key that is not
+  // in the table costs no index or data block reads.  The filter of an
+  // open table is kept in memory in full, even if
+  // partition_index_and_filters is set.
+  //
+  // Default: false
+  bool whole_table_filter;
+
+  // If non-null and filter_policy is set, the filters of each table also
+  // hold the prefix of each key, as computed by the specified transform
+  // (see leveldb/slice_transform.h).  Iterators that read with
+  // ReadOptions::prefix_same_as_start then skip the tables whose filters
+  // rule out the prefix they were positioned at.
+  //
+  // Tables whose filters were built with another transform (or none)
+  // are never skipped that way until compactions rewrite them, but their
+  // filters still serve point lookups.
+  //
+  // Default: nullptr
+  const SliceTransform* prefix_extractor;
+
+  // If true, every data block ends with a small hash index that maps the
+  // keys of the block to their restart points, so that point lookups go
+  // straight to the right restart interval instead of binary searching.
+  // This costs about one byte per key.  Blocks written with this option
+  // cannot be read by versions of leveldb that predate it.  The index
+  // assumes that keys which compare equal are byte-wise identical.
+  //
+  // Default: false
+  bool data_block_hash_index;
+
+  // If true, the index of a table is split into partitions of about
+  // block_size bytes, with a small top-level index that points at the
+  // partitions.  The filter (if filter_policy is set) is split the same
+  // way, one filter partition per index partition.  Partitions are read
+  // on demand through block_cache, so large tables no longer need their
+  // whole index and filter in memory while they are open.  Tables written
+  // with this option cannot be read by versions of leveldb that predate it.
+  //
+  // Default: false
+  bool partition_index_and_filters;
+
+  // If true, the top-level index of a table with a partitioned index is
+  // read when the table is opened and kept in memory for as long as the
+  // table stays open, instead of going through block_cache.  A database
+  // only does this for tables of levels 0 and 1, which are read most
+  // often and make up a small part of the data.
+  //
+  // Default: false
+  bool pin_top_level_index;
+
+  // Maximum number of threads that may work on a single compaction.  A
+  // large compaction is split into this many disjoint key ranges that
+  // are merged concurrently, each producing its own output files.  The
+  // extra threads are started through "env" by the first split compaction
+  // and kept until the DB is closed.
+  //
+  // Default: 1 (every compaction runs on the background thread alone)
+  int max_subcompactions;
+
+  // Maximum number of compactions that may run at the same time.
+  // Compactions only run concurrently if they read and write disjoint
+  // levels, so for example a long level-3 compaction does not hold up
+  // the level-0 compactions that writers are waiting for.  Compactions
+  // beyond the first are run on up to max_background_compactions-1
+  // threads that the DB starts through "env" and stops when closed.
+  //
+  // Default: 1
+  int max_background_compactions;
+
+  // If true, writes go through a two-stage pipeline: while one group of
+  // writers is being applied to the memtable, the next group can already
+  // be appended to the log.  This raises throughput with many concurrent
+  // writers.  Writes still become visible in the order they were logged.
+  //
+  // Default: false
+  bool enable_pipelined_write;
+
+  // If true, the writers in a pipelined write group insert their own
+  // batches into the memtable in parallel instead of having the group
+  // leader insert every batch.  Only takes effect together with
+  // enable_pipelined_write.
+  //
+  // Default: false
+  bool allow_concurrent_memtable_write;
+
+  // If non-null, use the specified factory to create the data structure
+  // that holds the contents of each memtable.  NewHashMemTableFactory()
+  // returns one that speeds up point lookups at the cost of slower
+  // iterators.
+  //
+  // Default: nullptr (a skiplist)
+  const MemTableFactory* memtable_factory;
+
+  // If true, table files are opened with Env::NewDirectRandomAccessFile,
+  // which bypasses the operating system's page cache where possible.
+  // Blocks read from a table are then cached only in block_cache, which
+  // should be sized accordingly.
+  //
+  // Default: false
+  bool use_direct_reads;
+
+  // If true, the table files written by memtable flushes and compactions
+  // are created with Env::NewDirectWritableFile, so that compaction
+  // output does not push other data out of the operating system's page
+  // cache.
+  //
+  // Default: false
+  bool use_direct_io_for_flush_and_compaction;
+
+  // If non-null, the table files written by memtable flushes and
+  // compactions are throttled by the specified limiter (see
+  // leveldb/rate_limiter.h).  Flushes and compactions out of level-0 are
+  // served before other compactions.
+  //
+  // Default: nullptr (no limit)
+  RateLimiter* rate_limiter;
+
   // Create an Options object with default values for all fields.
   Options();
 };
@@ -177,10 +362,66 @@ struct LEVELDB_EXPORT ReadOptions {
   // Default: nullptr
   const Snapshot* snapshot;
 
+  // Maximum number of threads that DB::MultiGet() may use to read keys
+  // from different table files at the same time.  The extra threads are
+  // started through Options::env by the first call that asks for them and
+  // shared by all calls until the DB is closed.  This only pays off when
+  // most reads miss the block cache and go to storage.
+  // Default: 1 (the calling thread does all the reads)
+  int multiget_threads;
+
+  // If non-zero, an iterator that reads the data blocks of a table one
+  // after the other asks the file to prefetch (see
+  // RandomAccessFile::Prefetch) up to this many bytes past the block it
+  // is reading, so that a scan does not wait on every block.  Iterators
+  // that jump around the table do not prefetch anything.
+  // Default: 0
+  size_t readahead_size;
+
+  // If true and the DB has a prefix extractor (see
+  // Options::prefix_extractor), an iterator positioned with Seek() only
+  // yields the keys that have the same prefix as the target, and becomes
+  // invalid after the last of them.  The tables whose filters show that
+  // they hold no key with that prefix are not read at all.  After such a
+  // Seek() the iterator only moves forward: Prev() leaves it invalid with
+  // a NotSupported status.  SeekToFirst(), SeekToLast() and a Seek() to a
+  // key without a prefix iterate over the whole DB as usual, in both
+  // directions.
+  // Default: false
+  bool prefix_same_as_start;
+
+  // If non-null, an iterator only yields keys at or after
+  // *iterate_lower_bound: SeekToFirst() and a Seek() to an earlier key
+  // start at the bound, and going backwards stops before it without
+  // reading the blocks of tables that only hold earlier keys.  The
+  // pointed-to Slice must stay live as long as the iterator.
+  //
+  // Table::NewIterator() compares the bound with the keys of the table,
+  // and its iterators may yield a few keys beyond it.
+  // Default: nullptr
+  const Slice* iterate_lower_bound;
+
+  // If non-null, an iterator only yields keys before *iterate_upper_bound
+  // (which is excluded): it becomes invalid at the first key at or after
+  // the bound, however many deleted entries lie between, without reading
+  // the blocks of tables that only hold later keys.  SeekToLast() starts
+  // before the bound.  The pointed-to Slice must stay live as long as the
+  // iterator.
+  //
+  // Table::NewIterator() compares the bound with the keys of the table,
+  // and its iterators may yield a few keys beyond it.
+  // Default: nullptr
+  const Slice* iterate_upper_bound;
+
   ReadOptions()
       : verify_checksums(false),
         fill_cache(true),
-        snapshot(nullptr) {
+        snapshot(nullptr),
+        multiget_threads(1),
+        readahead_size(0),
+        prefix_same_as_start(false),
+        iterate_lower_bound(nullptr),
+        iterate_upper_bound(nullptr) {
   }
 };
 
@@ -209,6 +450,20 @@ struct LEVELDB_EXPORT WriteOptions {
   }
 };
 
+// Options that control DB::IngestExternalFile()
+struct LEVELDB_EXPORT IngestExternalFileOptions {
+  // If true, the file is renamed into the database directory instead of
+  // being copied there, and no longer exists under its old name if the
+  // call succeeds.  Moving requires the file to be on the same file
+  // system as the database.
+  // Default: false
+  bool move_files;
+
+  IngestExternalFileOptions()
+      : move_files(false) {
+  }
+};
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
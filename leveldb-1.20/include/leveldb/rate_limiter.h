@@ -0,0 +1,69 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A RateLimiter caps the rate at which a database writes table files.
+// Memtable flushes and compactions ask it for permission before each
+// write, and block until the bytes fit into the configured rate.  This
+// smooths out compaction bursts that would otherwise compete with
+// foreground reads for the disk.
+//
+// A RateLimiter may be shared by several databases, in which case the
+// limit applies to their combined writes.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+#define STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT RateLimiter {
+ public:
+  // Writes that hold up foreground work (memtable flushes and compactions
+  // out of level-0) are high priority; all others are low priority.
+  // While high priority requests are waiting, no low priority request is
+  // granted.
+  enum Priority {
+    kLow = 0,
+    kHigh = 1,
+    kNumPriorities = 2
+  };
+
+  RateLimiter() = default;
+
+  RateLimiter(const RateLimiter&) = delete;
+  RateLimiter& operator=(const RateLimiter&) = delete;
+
+  virtual ~RateLimiter();
+
+  // Block until "bytes" more bytes may be written at priority "pri".
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual void Request(size_t bytes, Priority pri) = 0;
+
+  // Return the configured rate.
+  virtual int64_t GetBytesPerSecond() const = 0;
+
+  // Return the number of bytes granted at priority "pri" so far.
+  virtual int64_t GetTotalBytesThrough(Priority pri) const = 0;
+
+  // Return the number of Request() calls made at priority "pri" so far.
+  virtual int64_t GetTotalRequests(Priority pri) const = 0;
+
+  // Return the number of microseconds Request() calls at priority "pri"
+  // have spent waiting for their bytes so far.
+  virtual int64_t GetTotalWaitMicros(Priority pri) const = 0;
+};
+
+// Return a new token bucket rate limiter that grants "bytes_per_second"
+// bytes per second, handed out in ten refills per second.  The caller
+// must delete the result after any database that is using it has been
+// closed.
+LEVELDB_EXPORT RateLimiter* NewRateLimiter(int64_t bytes_per_second);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
@@ -0,0 +1,52 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A SliceTransform maps a key to its prefix.  A database configured with
+// one (see Options::prefix_extractor) adds the prefixes of its keys to
+// the filters of its tables, so that iterators confined to one prefix
+// (see ReadOptions::prefix_same_as_start) can skip the tables that hold
+// no key with that prefix.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+#define STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+
+#include <stddef.h>
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Slice;
+
+class LEVELDB_EXPORT SliceTransform {
+ public:
+  virtual ~SliceTransform();
+
+  // Return the name of this transform.  A table records the name of the
+  // transform its filters were built with, so it must change
+  // whenever Transform() changes the prefix it returns for some key.
+  virtual const char* Name() const = 0;
+
+  // Return true iff "key" has a prefix.  Keys without one are only
+  // added to filters as themselves.
+  virtual bool InDomain(const Slice& key) const = 0;
+
+  // Return the prefix of "key", which must point into "key".
+  // REQUIRES: InDomain(key)
+  virtual Slice Transform(const Slice& key) const = 0;
+};
+
+// Return a new transform whose prefix is the first "prefix_len" bytes of
+// a key.  Keys shorter than that have no prefix.
+//
+// The keys that share a prefix must be adjacent in the order of the
+// database comparator, as they are with BytewiseComparator().
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const SliceTransform* NewFixedPrefixTransform(
+    size_t prefix_len);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
@@ -0,0 +1,72 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// SstFileWriter builds a table file outside of any DB, which can later
+// be added to a DB with DB::IngestExternalFile() without going through
+// the log, the memtable and the compactions that writes go through.
+//
+// An SstFileWriter is not thread-safe; callers that share one must
+// provide their own synchronization.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+#define STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
+
+#include <stdint.h>
+#include <string>
+#include "leveldb/export.h"
+#include "leveldb/options.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT SstFileWriter {
+ public:
+  // Create a writer for tables that will be ingested into a DB opened
+  // with "options".  The comparator and filter policy must be those of
+  // that DB; the table is built with the block and compression settings
+  // of the last level of the DB, where most ingested tables end up.
+  explicit SstFileWriter(const Options& options);
+
+  SstFileWriter(const SstFileWriter&) = delete;
+  void operator=(const SstFileWriter&) = delete;
+
+  // Deletes the file being built if Finish() has not been called.
+  ~SstFileWriter();
+
+  // Start building a table in a new file named "fname".
+  // REQUIRES: Open() has not been called
+  Status Open(const std::string& fname);
+
+  // Store the mapping "key->value" in the table.
+  // REQUIRES: key is after any previously added key according to the
+  // comparator; an InvalidArgument error is returned otherwise.
+  // REQUIRES: Open() has succeeded and Finish() has not been called
+  Status Put(const Slice& key, const Slice& value);
+
+  // Record that "key" is deleted, so that ingesting the table hides the
+  // values the DB has for it.  The same ordering requirements as for
+  // Put() apply.
+  Status Delete(const Slice& key);
+
+  // Finish building the table and sync and close the file.  The table
+  // must hold at least one entry.
+  Status Finish();
+
+  // Number of entries added so far.
+  uint64_t NumEntries() const;
+
+  // Size of the file generated so far.  After a successful Finish(),
+  // the size of the final file.
+  uint64_t FileSize() const;
+
+ private:
+  struct Rep;
+  Rep* rep_;
+
+  Status Add(const Slice& key, const Slice& value, bool deletion);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SST_FILE_WRITER_H_
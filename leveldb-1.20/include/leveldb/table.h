@@ -12,6 +12,7 @@
 namespace leveldb {
 
 class Block;
+struct BlockContents;
 class BlockHandle;
 class Footer;
 struct Options;
@@ -51,6 +52,10 @@ class LEVELDB_EXPORT Table {
   // call one of the Seek methods on the iterator before using it).
   Iterator* NewIterator(const ReadOptions&) const;
 
+  // Returns a new iterator over the entries that were added with
+  // TableBuilder::AddRangeDeletion(), or nullptr if there are none.
+  Iterator* NewRangeDeletionIterator() const;
+
   // Given a key, return an approximate byte offset in the file where
   // the data for that key begins (or would begin if the key were
   // present in the file).  The returned value is in terms of file
@@ -59,12 +64,30 @@ class LEVELDB_EXPORT Table {
   // be close to the file length.
   uint64_t ApproximateOffsetOf(const Slice& key) const;
 
+  // Return false if the filters of the table show that "key" was never
+  // added to it.  Only consults the filters that are kept in memory, so
+  // a table with partitioned filters is never ruled out.
+  bool KeyMayMatch(const Slice& key) const;
+
+  // Return true if the filters of the table also hold the prefixes of its
+  // keys, as taken by Options::prefix_extractor, so that KeyMayMatch() may
+  // be asked about a prefix.
+  bool HasPrefixFilters() const;
+
  private:
   struct Rep;
   Rep* rep_;
 
   explicit Table(Rep* rep) { rep_ = rep; }
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* IndexBlockReader(void*, const ReadOptions&, const Slice&);
+  static Iterator* BlockReader(void*, const ReadOptions&, const Slice&,
+                               bool point_lookup, bool index_block);
+
+  // Like BlockReader(), but "arg" is the readahead state of an iterator
+  // that prefetches blocks once it sees them being read in order.
+  static Iterator* ReadaheadBlockReader(void*, const ReadOptions&,
+                                        const Slice&);
 
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
@@ -75,9 +98,37 @@ class LEVELDB_EXPORT Table {
       void* arg,
       void (*handle_result)(void* arg, const Slice& k, const Slice& v));
 
-
+  // Like InternalGet() for keys[0,n-1], which must be sorted, with
+  // args[i] passed along for keys[i].  Keys that share an index partition
+  // or data block read it only once, and the data blocks that are not in
+  // the block cache are read with a single RandomAccessFile::MultiRead().
+  Status InternalMultiGet(
+      const ReadOptions&, int n, const Slice* keys, void* const* args,
+      void (*handle_result)(void* arg, const Slice& k, const Slice& v));
   void ReadMeta(const Footer& footer);
   void ReadFilter(const Slice& filter_handle_value);
+  void ReadFullFilter(const Slice& filter_handle_value);
+  void ReadDictionary(const Slice& dictionary_handle_value);
+
+  // Read the block at "handle" into *contents, from
+  // options.block_cache_compressed if it holds the block and otherwise
+  // from the file, adding the block to block_cache_compressed if it is
+  // compressed.
+  Status FetchBlock(const ReadOptions&, const BlockHandle& handle,
+                    BlockContents* contents) const;
+  // If options.block_cache_compressed holds the block at "handle", store
+  // the result of uncompressing it in *s and *contents and return true.
+  bool LookupCompressedBlock(const BlockHandle& handle,
+                             BlockContents* contents, Status* s) const;
+  // Add "*compressed", as filled in by ReadBlock(), to
+  // options.block_cache_compressed.  May clear *compressed.
+  void InsertCompressedBlock(const ReadOptions&, const BlockHandle& handle,
+                             std::string* compressed) const;
+
+  Iterator* NewTopLevelIndexIterator(const ReadOptions&) const;
+  Iterator* NewIndexIterator(const ReadOptions&) const;
+  bool PartitionMayMatch(const ReadOptions&, const Slice& partition_value,
+                         uint64_t block_offset, const Slice& key) const;
 };
 
 }  // namespace leveldb
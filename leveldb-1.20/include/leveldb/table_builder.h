@@ -22,6 +22,7 @@ namespace leveldb {
 
 class BlockBuilder;
 class BlockHandle;
+class ThreadPool;
 class WritableFile;
 
 class LEVELDB_EXPORT TableBuilder {
@@ -31,6 +32,13 @@ class LEVELDB_EXPORT TableBuilder {
   // caller to close the file after calling Finish().
   TableBuilder(const Options& options, WritableFile* file);
 
+  // Like the above, but with options.parallel_compression_threads the
+  // data blocks are compressed on the threads of *compression_pool, which
+  // may be shared by many builders and must outlive this one.  If it is
+  // nullptr, the builder starts threads of its own through options.env.
+  TableBuilder(const Options& options, WritableFile* file,
+               ThreadPool* compression_pool);
+
   TableBuilder(const TableBuilder&) = delete;
   void operator=(const TableBuilder&) = delete;
 
@@ -50,6 +58,15 @@ class LEVELDB_EXPORT TableBuilder {
   // REQUIRES: Finish(), Abandon() have not been called
   void Add(const Slice& key, const Slice& value);
 
+  // Add key,value to the range deletion block of the table, which is
+  // kept apart from the entries added with Add() and is read back with
+  // Table::NewRangeDeletionIterator().  Entries added here do not count
+  // in NumEntries().
+  // REQUIRES: key is after any previously added range deletion key
+  // according to comparator.
+  // REQUIRES: Finish(), Abandon() have not been called
+  void AddRangeDeletion(const Slice& key, const Slice& value);
+
   // Advanced operation: flush any buffered key/value pairs to file.
   // Can be used to ensure that two adjacent entries never live in
   // the same data block.  Most clients should not need to use this method.
@@ -75,13 +92,19 @@ class LEVELDB_EXPORT TableBuilder {
   uint64_t NumEntries() const;
 
   // Size of the file generated so far.  If invoked after a successful
-  // Finish() call, returns the size of the final generated file.
+  // Finish() call, returns the size of the final generated file.  With
+  // options.parallel_compression_threads, this does not count the few
+  // data blocks that are still waiting to be compressed.
   uint64_t FileSize() const;
 
  private:
   bool ok() const { return status().ok(); }
   void WriteBlock(BlockBuilder* block, BlockHandle* handle);
   void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
+  void AddDictionarySample(const Slice& raw);
+  void ScheduleDataBlock();
+  void WritePendingBlocks(bool all);
+  void WritePartition(const Slice& last_key);
 
   struct Rep;
   Rep* rep_;
@@ -46,6 +46,10 @@ class LEVELDB_EXPORT WriteBatch {
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Erase the mappings of every key in ["begin","end"), as ordered by the
+  // comparator.  Does nothing if "begin" is not before "end".
+  void DeleteRange(const Slice& begin, const Slice& end);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
@@ -61,6 +65,9 @@ class LEVELDB_EXPORT WriteBatch {
     virtual ~Handler();
     virtual void Put(const Slice& key, const Slice& value) = 0;
     virtual void Delete(const Slice& key) = 0;
+    // The default implementation ignores range deletions, so handlers
+    // written before they existed keep working.
+    virtual void DeleteRange(const Slice& begin, const Slice& end);
   };
   Status Iterate(Handler* handler) const;
 
@@ -137,6 +137,16 @@ class AtomicPointer {
     MemoryBarrier();
     rep_ = v;
   }
+  // Atomically replace the value with "desired" if it is "expected".
+  // Returns true iff the value was replaced.  Acts as a full barrier.
+  inline bool CompareAndSwap(void* expected, void* desired) {
+#if defined(OS_WIN) && defined(COMPILER_MSVC)
+    return InterlockedCompareExchangePointer(&rep_, desired, expected) ==
+           expected;
+#else
+    return __sync_bool_compare_and_swap(&rep_, expected, desired);
+#endif
+  }
 };
 
 // AtomicPointer based on C++11 <atomic>.
@@ -159,6 +169,9 @@ class AtomicPointer {
   inline void NoBarrier_Store(void* v) {
     rep_.store(v, std::memory_order_relaxed);
   }
+  inline bool CompareAndSwap(void* expected, void* desired) {
+    return rep_.compare_exchange_strong(expected, desired);
+  }
 };
 
 #endif
@@ -99,6 +99,10 @@ class AtomicPointer {
 
   // Set va as the stored pointer with no ordering guarantees.
   void NoBarrier_Store(void* v);
+
+  // If the stored pointer equals "expected", replace it with "desired"
+  // and return true.  Else return false.  Acts as a full memory barrier.
+  bool CompareAndSwap(void* expected, void* desired);
 };
 
 // ------------------ Compression -------------------
@@ -124,6 +128,70 @@ bool Snappy_GetUncompressedLength(const char* input, size_t length,
 bool Snappy_Uncompress(const char* input_data, size_t input_length,
                        char* output);
 
+// Store the zstd compression of "input[0,length-1]" at compression
+// level "level" in *output.  Returns false if zstd is not supported by
+// this port.
+bool Zstd_Compress(int level, const char* input, size_t length,
+                   std::string* output);
+
+// Return a zstd compression dictionary made from
+// "dictionary[0,length-1]" for use with Zstd_CompressWithDictionary()
+// at compression level "level", or nullptr if zstd is not supported by
+// this port.  The result must be freed with
+// Zstd_DeleteCompressionDictionary().
+void* Zstd_NewCompressionDictionary(const char* dictionary, size_t length,
+                                    int level);
+void Zstd_DeleteCompressionDictionary(void* dictionary);
+
+// Like Zstd_Compress(), using "dictionary", a result of
+// Zstd_NewCompressionDictionary().
+bool Zstd_CompressWithDictionary(const void* dictionary,
+                                 const char* input, size_t length,
+                                 std::string* output);
+
+// Return a zstd decompression dictionary made from
+// "dictionary[0,length-1]" for use with Zstd_Uncompress(), or nullptr
+// if zstd is not supported by this port.  The result must be freed with
+// Zstd_DeleteDecompressionDictionary().
+void* Zstd_NewDecompressionDictionary(const char* dictionary,
+                                      size_t length);
+void Zstd_DeleteDecompressionDictionary(void* dictionary);
+
+// If input[0,length-1] looks like a valid zstd compressed buffer, store
+// the size of the uncompressed data in *result and return true.  Else
+// return false.
+bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                size_t* result);
+
+// Attempt to zstd uncompress input[0,length-1] into *output.  Input that
+// was compressed with a dictionary needs "dictionary", a result of
+// Zstd_NewDecompressionDictionary() for the same dictionary; other input
+// ignores it, so "dictionary" may be nullptr.  Returns true if
+// successful.
+//
+// REQUIRES: at least the first "n" bytes of output[] must be writable
+// where "n" is the result of a successful call to
+// Zstd_GetUncompressedLength.
+bool Zstd_Uncompress(const void* dictionary, const char* input,
+                     size_t length, char* output);
+
+// Store in *output a zstd dictionary of at most "max_length" bytes that
+// suits data like the "n" samples stored one after the other in
+// "samples", where sample i is sample_lengths[i] bytes long.  Returns
+// false if zstd is not supported by this port or the samples are not
+// enough to train on.
+bool Zstd_TrainDictionary(const char* samples,
+                          const size_t* sample_lengths, size_t n,
+                          size_t max_length, std::string* output);
+
+// Like the Snappy_ functions above, for LZ4.  LZ4 does not record the
+// length of the uncompressed data, so LZ4_Compress() puts it in front
+// of the compressed data.
+bool LZ4_Compress(const char* input, size_t length, std::string* output);
+bool LZ4_GetUncompressedLength(const char* input, size_t length,
+                               size_t* result);
+bool LZ4_Uncompress(const char* input, size_t length, char* output);
+
 // ------------------ Miscellaneous -------------------
 
 // If heap profiling is not supported, returns false.
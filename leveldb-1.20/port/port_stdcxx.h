@@ -28,6 +28,13 @@
 #if HAVE_SNAPPY
 #include <snappy.h>
 #endif  // HAVE_SNAPPY
+#if HAVE_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif  // HAVE_ZSTD
+#if HAVE_LZ4
+#include <lz4.h>
+#endif  // HAVE_LZ4
 
 #include <stddef.h>
 #include <stdint.h>
@@ -122,6 +129,210 @@ inline bool Snappy_Uncompress(const char* input, size_t length, char* output) {
 #endif  // HAVE_SNAPPY
 }
 
+#if HAVE_ZSTD
+// Setting up a zstd context is expensive, so every thread keeps one for
+// compression and one for decompression.
+struct ZstdContexts {
+  ZstdContexts() : cctx(ZSTD_createCCtx()), dctx(ZSTD_createDCtx()) { }
+  ~ZstdContexts() {
+    ZSTD_freeCCtx(cctx);
+    ZSTD_freeDCtx(dctx);
+  }
+
+  ZSTD_CCtx* const cctx;
+  ZSTD_DCtx* const dctx;
+};
+
+inline ZstdContexts* ThreadZstdContexts() {
+  static thread_local ZstdContexts contexts;
+  return &contexts;
+}
+#endif  // HAVE_ZSTD
+
+inline bool Zstd_Compress(int level, const char* input, size_t length,
+                          ::std::string* output) {
+#if HAVE_ZSTD
+  output->resize(ZSTD_compressBound(length));
+  size_t outlen = ZSTD_compressCCtx(ThreadZstdContexts()->cctx, &(*output)[0],
+                                    output->size(), input, length, level);
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  output->resize(outlen);
+  return true;
+#endif  // HAVE_ZSTD
+
+  return false;
+}
+
+inline void* Zstd_NewCompressionDictionary(const char* dictionary,
+                                           size_t length, int level) {
+#if HAVE_ZSTD
+  return ZSTD_createCDict(dictionary, length, level);
+#else
+  return nullptr;
+#endif  // HAVE_ZSTD
+}
+
+inline void Zstd_DeleteCompressionDictionary(void* dictionary) {
+#if HAVE_ZSTD
+  ZSTD_freeCDict(reinterpret_cast<ZSTD_CDict*>(dictionary));
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_CompressWithDictionary(const void* dictionary,
+                                        const char* input, size_t length,
+                                        ::std::string* output) {
+#if HAVE_ZSTD
+  output->resize(ZSTD_compressBound(length));
+  size_t outlen = ZSTD_compress_usingCDict(
+      ThreadZstdContexts()->cctx, &(*output)[0], output->size(), input, length,
+      reinterpret_cast<const ZSTD_CDict*>(dictionary));
+  if (ZSTD_isError(outlen)) {
+    return false;
+  }
+  output->resize(outlen);
+  return true;
+#endif  // HAVE_ZSTD
+
+  return false;
+}
+
+inline void* Zstd_NewDecompressionDictionary(const char* dictionary,
+                                             size_t length) {
+#if HAVE_ZSTD
+  return ZSTD_createDDict(dictionary, length);
+#else
+  return nullptr;
+#endif  // HAVE_ZSTD
+}
+
+inline void Zstd_DeleteDecompressionDictionary(void* dictionary) {
+#if HAVE_ZSTD
+  ZSTD_freeDDict(reinterpret_cast<ZSTD_DDict*>(dictionary));
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_GetUncompressedLength(const char* input, size_t length,
+                                       size_t* result) {
+#if HAVE_ZSTD
+  const unsigned long long size = ZSTD_getFrameContentSize(input, length);
+  if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR) {
+    return false;
+  }
+  *result = static_cast<size_t>(size);
+  return true;
+#else
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_Uncompress(const void* dictionary, const char* input,
+                            size_t length, char* output) {
+#if HAVE_ZSTD
+  size_t ulength;
+  if (!Zstd_GetUncompressedLength(input, length, &ulength)) {
+    return false;
+  }
+  ZSTD_DCtx* dctx = ThreadZstdContexts()->dctx;
+  size_t result;
+  if (ZSTD_getDictID_fromFrame(input, length) == 0) {
+    result = ZSTD_decompressDCtx(dctx, output, ulength, input, length);
+  } else if (dictionary != nullptr) {
+    result = ZSTD_decompress_usingDDict(
+        dctx, output, ulength, input, length,
+        reinterpret_cast<const ZSTD_DDict*>(dictionary));
+  } else {
+    return false;
+  }
+  return !ZSTD_isError(result) && result == ulength;
+#else
+  return false;
+#endif  // HAVE_ZSTD
+}
+
+inline bool Zstd_TrainDictionary(const char* samples,
+                                 const size_t* sample_lengths, size_t n,
+                                 size_t max_length, ::std::string* output) {
+#if HAVE_ZSTD
+  output->resize(max_length);
+  size_t outlen = ZDICT_trainFromBuffer(&(*output)[0], max_length, samples,
+                                        sample_lengths,
+                                        static_cast<unsigned>(n));
+  if (ZDICT_isError(outlen)) {
+    output->clear();
+    return false;
+  }
+  output->resize(outlen);
+  return true;
+#endif  // HAVE_ZSTD
+
+  return false;
+}
+
+// LZ4 block data does not record its uncompressed length, so the output
+// of LZ4_Compress() starts with it, as four little-endian bytes.
+inline bool LZ4_Compress(const char* input, size_t length,
+                         ::std::string* output) {
+#if HAVE_LZ4
+  if (length > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+    return false;
+  }
+  const int n = static_cast<int>(length);
+  output->resize(4 + LZ4_compressBound(n));
+  char* dst = &(*output)[0];
+  for (int i = 0; i < 4; i++) {
+    dst[i] = static_cast<char>((length >> (8 * i)) & 0xff);
+  }
+  int outlen = LZ4_compress_default(input, dst + 4, n,
+                                    static_cast<int>(output->size()) - 4);
+  if (outlen <= 0) {
+    return false;
+  }
+  output->resize(4 + outlen);
+  return true;
+#endif  // HAVE_LZ4
+
+  return false;
+}
+
+inline bool LZ4_GetUncompressedLength(const char* input, size_t length,
+                                      size_t* result) {
+#if HAVE_LZ4
+  if (length < 4) {
+    return false;
+  }
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(input);
+  const uint32_t ulength = static_cast<uint32_t>(p[0]) |
+                           (static_cast<uint32_t>(p[1]) << 8) |
+                           (static_cast<uint32_t>(p[2]) << 16) |
+                           (static_cast<uint32_t>(p[3]) << 24);
+  if (ulength > static_cast<uint32_t>(LZ4_MAX_INPUT_SIZE)) {
+    return false;
+  }
+  *result = ulength;
+  return true;
+#else
+  return false;
+#endif  // HAVE_LZ4
+}
+
+inline bool LZ4_Uncompress(const char* input, size_t length, char* output) {
+#if HAVE_LZ4
+  size_t ulength;
+  if (!LZ4_GetUncompressedLength(input, length, &ulength) ||
+      length - 4 > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+    return false;
+  }
+  const int n = LZ4_decompress_safe(input + 4, output,
+                                    static_cast<int>(length - 4),
+                                    static_cast<int>(ulength));
+  return n >= 0 && static_cast<size_t>(n) == ulength;
+#else
+  return false;
+#endif  // HAVE_LZ4
+}
+
 inline bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg) {
   return false;
 }
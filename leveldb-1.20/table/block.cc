@@ -17,23 +17,41 @@ namespace leveldb {
 
 inline uint32_t Block::NumRestarts() const {
   assert(size_ >= sizeof(uint32_t));
-  return DecodeFixed32(data_ + size_ - sizeof(uint32_t));
+  return DecodeFixed32(data_ + size_ - sizeof(uint32_t)) & ~kBlockHashIndexFlag;
 }
 
 Block::Block(const BlockContents& contents)
     : data_(contents.data.data()),
       size_(contents.data.size()),
+      hash_buckets_(nullptr),
+      num_buckets_(0),
       owned_(contents.heap_allocated) {
   if (size_ < sizeof(uint32_t)) {
     size_ = 0;  // Error marker
-  } else {
-    size_t max_restarts_allowed = (size_-sizeof(uint32_t)) / sizeof(uint32_t);
-    if (NumRestarts() > max_restarts_allowed) {
-      // The size is too small for NumRestarts()
+    return;
+  }
+  // Size of everything after the restart array
+  size_t trailer = sizeof(uint32_t);
+  if (DecodeFixed32(data_ + size_ - sizeof(uint32_t)) & kBlockHashIndexFlag) {
+    trailer += sizeof(uint32_t);
+    if (size_ < trailer) {
       size_ = 0;
-    } else {
-      restart_offset_ = size_ - (1 + NumRestarts()) * sizeof(uint32_t);
+      return;
     }
+    num_buckets_ = DecodeFixed32(data_ + size_ - trailer);
+    if (num_buckets_ == 0 || num_buckets_ > size_ - trailer) {
+      size_ = 0;
+      return;
+    }
+    trailer += num_buckets_;
+    hash_buckets_ = data_ + size_ - trailer;
+  }
+  size_t max_restarts_allowed = (size_ - trailer) / sizeof(uint32_t);
+  if (NumRestarts() > max_restarts_allowed) {
+    // The size is too small for NumRestarts()
+    size_ = 0;
+  } else {
+    restart_offset_ = size_ - trailer - NumRestarts() * sizeof(uint32_t);
   }
 }
 
@@ -79,6 +97,8 @@ class Block::Iter : public Iterator {
   const char* const data_;      // underlying block contents
   uint32_t const restarts_;     // Offset of restart array (list of fixed32)
   uint32_t const num_restarts_; // Number of uint32_t entries in restart array
+  const char* const hash_buckets_;  // Used by Seek() if non-null
+  uint32_t const num_buckets_;
 
   // current_ is offset in data_ of current entry.  >= restarts_ if !Valid
   uint32_t current_;
@@ -115,11 +135,15 @@ class Block::Iter : public Iterator {
   Iter(const Comparator* comparator,
        const char* data,
        uint32_t restarts,
-       uint32_t num_restarts)
+       uint32_t num_restarts,
+       const char* hash_buckets,
+       uint32_t num_buckets)
       : comparator_(comparator),
         data_(data),
         restarts_(restarts),
         num_restarts_(num_restarts),
+        hash_buckets_(hash_buckets),
+        num_buckets_(num_buckets),
         current_(restarts_),
         restart_index_(num_restarts_) {
     assert(num_restarts_ > 0);
@@ -163,6 +187,26 @@ class Block::Iter : public Iterator {
   }
 
   virtual void Seek(const Slice& target) {
+    if (hash_buckets_ != nullptr) {
+      const uint32_t hash = BlockHash(BlockHashKey(target));
+      const uint8_t bucket =
+          static_cast<uint8_t>(hash_buckets_[hash % num_buckets_]);
+      if (bucket == kBlockHashNoEntry) {
+        // The block holds no entry for the target's user key.
+        current_ = restarts_;
+        restart_index_ = num_restarts_;
+        return;
+      }
+      if (bucket != kBlockHashCollision && bucket < num_restarts_) {
+        // Every key before this restart point has a smaller user key.
+        SeekToRestartPoint(bucket);
+        while (ParseNextKey() && Compare(key_, target) < 0) {
+          // Keep skipping
+        }
+        return;
+      }
+    }
+
     // Binary search in restart array to find the last restart point
     // with a key < target
     uint32_t left = 0;
@@ -261,7 +305,20 @@ Iterator* Block::NewIterator(const Comparator* cmp) {
   if (num_restarts == 0) {
     return NewEmptyIterator();
   } else {
-    return new Iter(cmp, data_, restart_offset_, num_restarts);
+    return new Iter(cmp, data_, restart_offset_, num_restarts, nullptr, 0);
+  }
+}
+
+Iterator* Block::NewPointLookupIterator(const Comparator* cmp) {
+  if (size_ < sizeof(uint32_t)) {
+    return NewErrorIterator(Status::Corruption("bad block contents"));
+  }
+  const uint32_t num_restarts = NumRestarts();
+  if (num_restarts == 0) {
+    return NewEmptyIterator();
+  } else {
+    return new Iter(cmp, data_, restart_offset_, num_restarts,
+                    hash_buckets_, num_buckets_);
   }
 }
 
@@ -24,12 +24,20 @@ class Block {
   size_t size() const { return size_; }
   Iterator* NewIterator(const Comparator* comparator);
 
+  // Like NewIterator(), but the result is only meant for point lookups:
+  // if the block holds no entry with the same user key as the target of
+  // Seek(), the iterator may end up anywhere, or be invalid.  Seek() uses
+  // the block's hash index, if it has one, to skip the binary search.
+  Iterator* NewPointLookupIterator(const Comparator* comparator);
+
  private:
   uint32_t NumRestarts() const;
 
   const char* data_;
   size_t size_;
   uint32_t restart_offset_;     // Offset in data_ of restart array
+  const char* hash_buckets_;    // Hash index buckets, or nullptr if none
+  uint32_t num_buckets_;        // Number of hash index buckets
   bool owned_;                  // Block owns data_[]
 
   // No copying allowed
@@ -25,6 +25,18 @@
 //     restarts: uint32[num_restarts]
 //     num_restarts: uint32
 // restarts[i] contains the offset within the block of the ith restart point.
+//
+// If Options::data_block_hash_index is set, the trailer instead has the form:
+//     restarts: uint32[num_restarts]
+//     buckets: uint8[num_buckets]
+//     num_buckets: uint32
+//     num_restarts | kBlockHashIndexFlag: uint32
+// Each key is hashed into one of the buckets, which records the index of
+// the restart point at or before the key's first entry.  Point lookups use
+// it to skip the binary search over the restart array.  Keys are hashed
+// without their last 8 bytes, so that all entries of a user key in a table
+// written by the DB (which stores internal keys) share a bucket.  Readers
+// that do not know about the index see an invalid restart count.
 
 #include "table/block_builder.h"
 
@@ -32,6 +44,7 @@
 #include <assert.h>
 #include "leveldb/comparator.h"
 #include "leveldb/table_builder.h"
+#include "table/format.h"
 #include "util/coding.h"
 
 namespace leveldb {
@@ -40,7 +53,8 @@ BlockBuilder::BlockBuilder(const Options* options)
     : options_(options),
       restarts_(),
       counter_(0),
-      finished_(false) {
+      finished_(false),
+      hash_index_(options->data_block_hash_index) {
   assert(options->block_restart_interval >= 1);
   restarts_.push_back(0);       // First restart point is at offset 0
 }
@@ -52,24 +66,62 @@ void BlockBuilder::Reset() {
   counter_ = 0;
   finished_ = false;
   last_key_.clear();
+  hashed_keys_.clear();
 }
 
 size_t BlockBuilder::CurrentSizeEstimate() const {
   return (buffer_.size() +                        // Raw data buffer
           restarts_.size() * sizeof(uint32_t) +   // Restart array
+          HashIndexSize() +                       // Optional hash index
           sizeof(uint32_t));                      // Restart array length
 }
 
+// Number of buckets used for n hashed keys.  Aim for a load factor of
+// about 0.75 so that few buckets hold more than one restart index.
+static uint32_t NumHashBuckets(size_t n) {
+  return static_cast<uint32_t>(n + n / 3 + 1);
+}
+
+size_t BlockBuilder::HashIndexSize() const {
+  if (!hash_index_) {
+    return 0;
+  }
+  return NumHashBuckets(hashed_keys_.size()) + sizeof(uint32_t);
+}
+
 Slice BlockBuilder::Finish() {
   // Append restart array
   for (size_t i = 0; i < restarts_.size(); i++) {
     PutFixed32(&buffer_, restarts_[i]);
   }
-  PutFixed32(&buffer_, restarts_.size());
+  // A bucket can only name restart points below kBlockHashCollision.
+  if (hash_index_ && restarts_.size() < kBlockHashCollision) {
+    AppendHashIndex();
+    PutFixed32(&buffer_, restarts_.size() | kBlockHashIndexFlag);
+  } else {
+    PutFixed32(&buffer_, restarts_.size());
+  }
   finished_ = true;
   return Slice(buffer_);
 }
 
+void BlockBuilder::AppendHashIndex() {
+  const uint32_t num_buckets = NumHashBuckets(hashed_keys_.size());
+  const size_t start = buffer_.size();
+  buffer_.append(num_buckets, static_cast<char>(kBlockHashNoEntry));
+  char* buckets = &buffer_[start];
+  for (size_t i = 0; i < hashed_keys_.size(); i++) {
+    char* bucket = &buckets[hashed_keys_[i].first % num_buckets];
+    const uint8_t restart = static_cast<uint8_t>(hashed_keys_[i].second);
+    if (static_cast<uint8_t>(*bucket) == kBlockHashNoEntry) {
+      *bucket = static_cast<char>(restart);
+    } else if (static_cast<uint8_t>(*bucket) != restart) {
+      *bucket = static_cast<char>(kBlockHashCollision);
+    }
+  }
+  PutFixed32(&buffer_, num_buckets);
+}
+
 void BlockBuilder::Add(const Slice& key, const Slice& value) {
   Slice last_key_piece(last_key_);
   assert(!finished_);
@@ -90,6 +142,15 @@ void BlockBuilder::Add(const Slice& key, const Slice& value) {
   }
   const size_t non_shared = key.size() - shared;
 
+  if (hash_index_) {
+    // Only the first entry of each user key goes into the index.
+    Slice hash_key = BlockHashKey(key);
+    if (buffer_.empty() || BlockHashKey(last_key_piece) != hash_key) {
+      hashed_keys_.push_back(std::make_pair(BlockHash(hash_key),
+                                            restarts_.size() - 1));
+    }
+  }
+
   // Add "<shared><non_shared><value_size>" to buffer_
   PutVarint32(&buffer_, shared);
   PutVarint32(&buffer_, non_shared);
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include <stdint.h>
+#include <utility>
 #include "leveldb/slice.h"
 
 namespace leveldb {
@@ -47,6 +48,13 @@ class BlockBuilder {
   bool                  finished_;    // Has Finish() been called?
   std::string           last_key_;
 
+  // State of the optional hash index (see block_builder.cc)
+  bool                  hash_index_;  // Build a hash index for this block?
+  std::vector<std::pair<uint32_t, uint32_t> > hashed_keys_;  // (hash, restart)
+
+  size_t HashIndexSize() const;
+  void AppendHashIndex();
+
   // No copying allowed
   BlockBuilder(const BlockBuilder&);
   void operator=(const BlockBuilder&);
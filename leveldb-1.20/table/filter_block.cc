@@ -108,4 +108,58 @@ bool FilterBlockReader::KeyMayMatch(uint64_t block_offset, const Slice& key) {
   return true;  // Errors are treated as potential matches
 }
 
+bool FilterBlockReader::KeyMayMatchAnyBlock(const Slice& key) {
+  for (size_t index = 0; index < num_; index++) {
+    uint32_t start = DecodeFixed32(offset_ + index*4);
+    uint32_t limit = DecodeFixed32(offset_ + index*4 + 4);
+    if (start < limit && limit <= static_cast<size_t>(offset_ - data_)) {
+      Slice filter = Slice(data_ + start, limit - start);
+      if (policy_->KeyMayMatch(key, filter)) {
+        return true;
+      }
+    } else if (start != limit) {
+      return true;  // Errors are treated as potential matches
+    }
+  }
+  return false;
+}
+
+FullFilterBlockBuilder::FullFilterBlockBuilder(const FilterPolicy* policy)
+    : policy_(policy) {
+}
+
+void FullFilterBlockBuilder::AddKey(const Slice& key) {
+  start_.push_back(keys_.size());
+  keys_.append(key.data(), key.size());
+}
+
+Slice FullFilterBlockBuilder::Finish() {
+  const size_t num_keys = start_.size();
+  if (num_keys > 0) {
+    start_.push_back(keys_.size());  // Simplify length computation
+    std::vector<Slice> tmp_keys(num_keys);
+    for (size_t i = 0; i < num_keys; i++) {
+      tmp_keys[i] = Slice(keys_.data() + start_[i], start_[i+1] - start_[i]);
+    }
+    policy_->CreateFilter(&tmp_keys[0], static_cast<int>(num_keys), &result_);
+  }
+  keys_.clear();
+  start_.clear();
+  return Slice(result_);
+}
+
+FullFilterBlockReader::FullFilterBlockReader(const FilterPolicy* policy,
+                                             const Slice& contents)
+    : policy_(policy),
+      contents_(contents) {
+}
+
+bool FullFilterBlockReader::KeyMayMatch(const Slice& key) {
+  if (contents_.empty()) {
+    // Empty filters do not match any keys
+    return false;
+  }
+  return policy_->KeyMayMatch(key, contents_);
+}
+
 }
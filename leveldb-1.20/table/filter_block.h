@@ -55,6 +55,9 @@ class FilterBlockReader {
   FilterBlockReader(const FilterPolicy* policy, const Slice& contents);
   bool KeyMayMatch(uint64_t block_offset, const Slice& key);
 
+  // Return true if the filter of any data block may hold "key".
+  bool KeyMayMatchAnyBlock(const Slice& key);
+
  private:
   const FilterPolicy* policy_;
   const char* data_;    // Pointer to filter data (at block-start)
@@ -63,6 +66,41 @@ class FilterBlockReader {
   size_t base_lg_;      // Encoding parameter (see kFilterBaseLg in .cc file)
 };
 
+// A FullFilterBlockBuilder constructs a single filter over all the keys
+// of a Table, so that readers can rule out a key before they look at the
+// index.  The block holds the filter exactly as the policy built it.
+//
+// The sequence of calls to FullFilterBlockBuilder must match the regexp:
+//      AddKey* Finish
+class FullFilterBlockBuilder {
+ public:
+  explicit FullFilterBlockBuilder(const FilterPolicy*);
+
+  void AddKey(const Slice& key);
+  Slice Finish();
+
+ private:
+  const FilterPolicy* policy_;
+  std::string keys_;              // Flattened key contents
+  std::vector<size_t> start_;     // Starting index in keys_ of each key
+  std::string result_;            // Filter data
+
+  // No copying allowed
+  FullFilterBlockBuilder(const FullFilterBlockBuilder&);
+  void operator=(const FullFilterBlockBuilder&);
+};
+
+class FullFilterBlockReader {
+ public:
+ // REQUIRES: "contents" and *policy must stay live while *this is live.
+  FullFilterBlockReader(const FilterPolicy* policy, const Slice& contents);
+  bool KeyMayMatch(const Slice& key);
+
+ private:
+  const FilterPolicy* policy_;
+  Slice contents_;
+};
+
 }
 
 #endif  // STORAGE_LEVELDB_TABLE_FILTER_BLOCK_H_
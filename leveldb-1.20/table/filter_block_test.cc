@@ -119,6 +119,37 @@ TEST(FilterBlockTest, MultiChunk) {
   ASSERT_TRUE(reader.KeyMayMatch(9000, "hello"));
   ASSERT_TRUE(! reader.KeyMayMatch(9000, "foo"));
   ASSERT_TRUE(! reader.KeyMayMatch(9000, "bar"));
+
+  // Any block
+  ASSERT_TRUE(reader.KeyMayMatchAnyBlock("foo"));
+  ASSERT_TRUE(reader.KeyMayMatchAnyBlock("hello"));
+  ASSERT_TRUE(! reader.KeyMayMatchAnyBlock("missing"));
+}
+
+TEST(FilterBlockTest, FullEmptyBuilder) {
+  FullFilterBlockBuilder builder(&policy_);
+  Slice block = builder.Finish();
+  ASSERT_EQ("", EscapeString(block));
+  FullFilterBlockReader reader(&policy_, block);
+  ASSERT_TRUE(! reader.KeyMayMatch("foo"));
+}
+
+TEST(FilterBlockTest, FullFilter) {
+  FullFilterBlockBuilder builder(&policy_);
+  builder.AddKey("foo");
+  builder.AddKey("bar");
+  builder.AddKey("box");
+  builder.AddKey("box");
+  builder.AddKey("hello");
+  Slice block = builder.Finish();
+  ASSERT_EQ(5 * 4, block.size());  // One hash per key
+  FullFilterBlockReader reader(&policy_, block);
+  ASSERT_TRUE(reader.KeyMayMatch("foo"));
+  ASSERT_TRUE(reader.KeyMayMatch("bar"));
+  ASSERT_TRUE(reader.KeyMayMatch("box"));
+  ASSERT_TRUE(reader.KeyMayMatch("hello"));
+  ASSERT_TRUE(! reader.KeyMayMatch("missing"));
+  ASSERT_TRUE(! reader.KeyMayMatch("other"));
 }
 
 }  // namespace leveldb
@@ -4,6 +4,7 @@
 
 #include "table/format.h"
 
+#include <vector>
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "table/block.h"
@@ -34,8 +35,10 @@ void Footer::EncodeTo(std::string* dst) const {
   metaindex_handle_.EncodeTo(dst);
   index_handle_.EncodeTo(dst);
   dst->resize(2 * BlockHandle::kMaxEncodedLength);  // Padding
-  PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber & 0xffffffffu));
-  PutFixed32(dst, static_cast<uint32_t>(kTableMagicNumber >> 32));
+  const uint64_t magic = partitioned_index_ ? kPartitionedTableMagicNumber
+                                            : kTableMagicNumber;
+  PutFixed32(dst, static_cast<uint32_t>(magic & 0xffffffffu));
+  PutFixed32(dst, static_cast<uint32_t>(magic >> 32));
   assert(dst->size() == original_size + kEncodedLength);
   (void)original_size;  // Disable unused variable warning.
 }
@@ -46,9 +49,10 @@ Status Footer::DecodeFrom(Slice* input) {
   const uint32_t magic_hi = DecodeFixed32(magic_ptr + 4);
   const uint64_t magic = ((static_cast<uint64_t>(magic_hi) << 32) |
                           (static_cast<uint64_t>(magic_lo)));
-  if (magic != kTableMagicNumber) {
+  if (magic != kTableMagicNumber && magic != kPartitionedTableMagicNumber) {
     return Status::Corruption("not an sstable (bad magic number)");
   }
+  partitioned_index_ = (magic == kPartitionedTableMagicNumber);
 
   Status result = metaindex_handle_.DecodeFrom(input);
   if (result.ok()) {
@@ -62,24 +66,65 @@ Status Footer::DecodeFrom(Slice* input) {
   return result;
 }
 
-Status ReadBlock(RandomAccessFile* file,
-                 const ReadOptions& options,
-                 const BlockHandle& handle,
-                 BlockContents* result) {
-  result->data = Slice();
-  result->cachable = false;
-  result->heap_allocated = false;
+// Uncompress the n bytes at "data", a block stored with compression
+// "type", into a new heap allocated *result.  See ReadBlock() for
+// "dictionary".
+static Status Uncompress(const char* data, size_t n, char type,
+                         const void* dictionary, BlockContents* result) {
+  size_t ulength = 0;
+  bool ok;
+  switch (type) {
+    case kSnappyCompression:
+      ok = port::Snappy_GetUncompressedLength(data, n, &ulength);
+      break;
+    case kZstdCompression:
+      ok = port::Zstd_GetUncompressedLength(data, n, &ulength);
+      break;
+    case kLZ4Compression:
+      ok = port::LZ4_GetUncompressedLength(data, n, &ulength);
+      break;
+    default:
+      return Status::Corruption("bad block type");
+  }
+  if (!ok) {
+    return Status::Corruption("corrupted compressed block contents");
+  }
 
-  // Read the block contents as well as the type/crc footer.
-  // See table_builder.cc for the code that built this structure.
-  size_t n = static_cast<size_t>(handle.size());
-  char* buf = new char[n + kBlockTrailerSize];
-  Slice contents;
-  Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
-  if (!s.ok()) {
-    delete[] buf;
-    return s;
+  char* ubuf = new char[ulength];
+  switch (type) {
+    case kSnappyCompression:
+      ok = port::Snappy_Uncompress(data, n, ubuf);
+      break;
+    case kZstdCompression:
+      ok = port::Zstd_Uncompress(dictionary, data, n, ubuf);
+      break;
+    case kLZ4Compression:
+      ok = port::LZ4_Uncompress(data, n, ubuf);
+      break;
   }
+  if (!ok) {
+    delete[] ubuf;
+    return Status::Corruption("corrupted compressed block contents");
+  }
+  result->data = Slice(ubuf, ulength);
+  result->heap_allocated = true;
+  result->cachable = true;
+  return Status::OK();
+}
+
+// Check and uncompress "contents", the block identified by "handle"
+// together with its type/crc footer, which was read into "buf".  Takes
+// ownership of "buf".  See ReadBlock() for "compressed" and
+// "dictionary".
+static Status DecodeBlock(const ReadOptions& options,
+                          const BlockHandle& handle,
+                          const Slice& contents,
+                          char* buf,
+                          BlockContents* result,
+                          std::string* compressed,
+                          const void* dictionary) {
+  const size_t n = static_cast<size_t>(handle.size());
+  Status s;
   if (contents.size() != n + kBlockTrailerSize) {
     delete[] buf;
     return Status::Corruption("truncated block read");
@@ -115,30 +160,91 @@ Status ReadBlock(RandomAccessFile* file,
 
       // Ok
       break;
-    case kSnappyCompression: {
-      size_t ulength = 0;
-      if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
-        delete[] buf;
-        return Status::Corruption("corrupted compressed block contents");
-      }
-      char* ubuf = new char[ulength];
-      if (!port::Snappy_Uncompress(data, n, ubuf)) {
-        delete[] buf;
-        delete[] ubuf;
-        return Status::Corruption("corrupted compressed block contents");
-      }
-      delete[] buf;
-      result->data = Slice(ubuf, ulength);
-      result->heap_allocated = true;
-      result->cachable = true;
-      break;
-    }
     default:
+      s = Uncompress(data, n, data[n], dictionary, result);
+      if (s.ok() && compressed != nullptr) {
+        compressed->assign(data, n + 1);
+      }
       delete[] buf;
-      return Status::Corruption("bad block type");
+      return s;
   }
 
   return Status::OK();
 }
 
+Status ReadBlock(RandomAccessFile* file,
+                 const ReadOptions& options,
+                 const BlockHandle& handle,
+                 BlockContents* result,
+                 std::string* compressed,
+                 const void* dictionary) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+  if (compressed != nullptr) {
+    compressed->clear();
+  }
+
+  // Read the block contents as well as the type/crc footer.
+  // See table_builder.cc for the code that built this structure.
+  size_t n = static_cast<size_t>(handle.size());
+  char* buf = new char[n + kBlockTrailerSize];
+  Slice contents;
+  Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+  if (!s.ok()) {
+    delete[] buf;
+    return s;
+  }
+  return DecodeBlock(options, handle, contents, buf, result, compressed,
+                     dictionary);
+}
+
+void ReadBlocks(RandomAccessFile* file,
+                const ReadOptions& options,
+                const BlockHandle* handles,
+                size_t n,
+                BlockContents* results,
+                Status* statuses,
+                std::string* compressed,
+                const void* dictionary) {
+  std::vector<RandomAccessFile::ReadRequest> reqs(n);
+  for (size_t i = 0; i < n; i++) {
+    results[i].data = Slice();
+    results[i].cachable = false;
+    results[i].heap_allocated = false;
+    if (compressed != nullptr) {
+      compressed[i].clear();
+    }
+    reqs[i].offset = handles[i].offset();
+    reqs[i].n = static_cast<size_t>(handles[i].size()) + kBlockTrailerSize;
+    reqs[i].scratch = new char[reqs[i].n];
+  }
+  if (n > 0) {
+    file->MultiRead(&reqs[0], n);
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (!reqs[i].status.ok()) {
+      delete[] reqs[i].scratch;
+      statuses[i] = reqs[i].status;
+    } else {
+      statuses[i] = DecodeBlock(options, handles[i], reqs[i].result,
+                                reqs[i].scratch, &results[i],
+                                compressed ? &compressed[i] : nullptr,
+                                dictionary);
+    }
+  }
+}
+
+Status UncompressBlock(const Slice& compressed, BlockContents* result,
+                       const void* dictionary) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+  if (compressed.empty()) {
+    return Status::Corruption("bad block type");
+  }
+  const size_t n = compressed.size() - 1;
+  return Uncompress(compressed.data(), n, compressed[n], dictionary, result);
+}
+
 }  // namespace leveldb
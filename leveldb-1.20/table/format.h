@@ -10,6 +10,7 @@
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 #include "leveldb/table_builder.h"
+#include "util/hash.h"
 
 namespace leveldb {
 
@@ -46,7 +47,7 @@ class BlockHandle {
 // end of every table file.
 class Footer {
  public:
-  Footer() { }
+  Footer() : partitioned_index_(false) { }
 
   // The block handle for the metaindex block of the table
   const BlockHandle& metaindex_handle() const { return metaindex_handle_; }
@@ -60,6 +61,13 @@ class Footer {
     index_handle_ = h;
   }
 
+  // True if the index block is the top level of a partitioned index, i.e.
+  // its values point at index partitions rather than at data blocks.
+  // Recorded in the magic number so that readers which do not know about
+  // partitioned indexes reject the table instead of misreading it.
+  bool partitioned_index() const { return partitioned_index_; }
+  void set_partitioned_index(bool p) { partitioned_index_ = p; }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(Slice* input);
 
@@ -73,6 +81,7 @@ class Footer {
  private:
   BlockHandle metaindex_handle_;
   BlockHandle index_handle_;
+  bool partitioned_index_;
 };
 
 // kTableMagicNumber was picked by running
@@ -80,9 +89,31 @@ class Footer {
 // and taking the leading 64 bits.
 static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 
+// Magic number of tables with a partitioned index: kTableMagicNumber
+// with the lowest bit cleared.
+static const uint64_t kPartitionedTableMagicNumber = 0xdb4775248b80fb56ull;
+
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// Set in the restart count of a block that ends with a hash index
+// (see block_builder.cc).
+static const uint32_t kBlockHashIndexFlag = 1u << 31;
+
+// Bucket values of a block hash index that do not name a restart point.
+static const uint8_t kBlockHashNoEntry = 255;    // No key hashes here
+static const uint8_t kBlockHashCollision = 254;  // Keys of several restarts
+
+// Return the part of "key" that the block hash index is keyed on.
+inline Slice BlockHashKey(const Slice& key) {
+  // Strip the 8 byte sequence/type tag of internal keys.
+  return key.size() >= 8 ? Slice(key.data(), key.size() - 8) : key;
+}
+
+inline uint32_t BlockHash(const Slice& hash_key) {
+  return Hash(hash_key.data(), hash_key.size(), 0x7fb2d1c3);
+}
+
 struct BlockContents {
   Slice data;           // Actual contents of data
   bool cachable;        // True iff data can be cached
@@ -90,11 +121,40 @@ struct BlockContents {
 };
 
 // Read the block identified by "handle" from "file".  On failure
-// return non-OK.  On success fill *result and return OK.
+// return non-OK.  On success fill *result and return OK.  If
+// "compressed" is non-null and the block is stored compressed, the
+// stored contents followed by the compression type byte are copied to
+// *compressed, in the form UncompressBlock() takes; otherwise
+// *compressed is left empty.  "dictionary" is the result of
+// port::Zstd_NewDecompressionDictionary() for the zstd dictionary of the
+// table, if it has one, and is needed to uncompress its data blocks.
 Status ReadBlock(RandomAccessFile* file,
                  const ReadOptions& options,
                  const BlockHandle& handle,
-                 BlockContents* result);
+                 BlockContents* result,
+                 std::string* compressed = nullptr,
+                 const void* dictionary = nullptr);
+
+// Read the blocks identified by handles[0,n-1] from "file" with a single
+// RandomAccessFile::MultiRead() call.  statuses[i] is set to what
+// ReadBlock() would have returned for handles[i], and results[i] is
+// filled in if statuses[i] is OK.  If "compressed" is non-null,
+// compressed[i] is set as ReadBlock() sets *compressed.
+void ReadBlocks(RandomAccessFile* file,
+                const ReadOptions& options,
+                const BlockHandle* handles,
+                size_t n,
+                BlockContents* results,
+                Status* statuses,
+                std::string* compressed = nullptr,
+                const void* dictionary = nullptr);
+
+// Uncompress "compressed", the contents of a compressed block followed
+// by its compression type byte, as filled in by ReadBlock().  On success
+// fill *result, whose data is always heap allocated, and return OK.
+// See ReadBlock() for "dictionary".
+Status UncompressBlock(const Slice& compressed, BlockContents* result,
+                       const void* dictionary = nullptr);
 
 // Implementation details follow.  Clients should ignore,
 
@@ -4,6 +4,7 @@
 
 #include "table/merger.h"
 
+#include <algorithm>
 #include "leveldb/comparator.h"
 #include "leveldb/iterator.h"
 #include "table/iterator_wrapper.h"
@@ -22,9 +23,17 @@ class MergingIterator : public Iterator {
     for (int i = 0; i < n; i++) {
       children_[i].Set(children[i]);
     }
+    leaves_ = 1;
+    while (leaves_ < n) {
+      leaves_ *= 2;
+    }
+    tree_ = new int[leaves_];
+    winners_ = new int[leaves_];
   }
 
   virtual ~MergingIterator() {
+    delete[] winners_;
+    delete[] tree_;
     delete[] children_;
   }
 
@@ -36,24 +45,24 @@ class MergingIterator : public Iterator {
     for (int i = 0; i < n_; i++) {
       children_[i].SeekToFirst();
     }
-    FindSmallest();
     direction_ = kForward;
+    BuildTree();
   }
 
   virtual void SeekToLast() {
     for (int i = 0; i < n_; i++) {
       children_[i].SeekToLast();
     }
-    FindLargest();
     direction_ = kReverse;
+    BuildTree();
   }
 
   virtual void Seek(const Slice& target) {
     for (int i = 0; i < n_; i++) {
       children_[i].Seek(target);
     }
-    FindSmallest();
     direction_ = kForward;
+    BuildTree();
   }
 
   virtual void Next() {
@@ -63,7 +72,8 @@ class MergingIterator : public Iterator {
     // If we are moving in the forward direction, it is already
     // true for all of the non-current_ children since current_ is
     // the smallest child and key() == current_->key().  Otherwise,
-    // we explicitly position the non-current_ children.
+    // we explicitly position the non-current_ children and rebuild
+    // the tree for the new direction.
     if (direction_ != kForward) {
       for (int i = 0; i < n_; i++) {
         IteratorWrapper* child = &children_[i];
@@ -76,10 +86,13 @@ class MergingIterator : public Iterator {
         }
       }
       direction_ = kForward;
+      current_->Next();
+      BuildTree();
+      return;
     }
 
     current_->Next();
-    FindSmallest();
+    ReplayFrom(current_ - children_);
   }
 
   virtual void Prev() {
@@ -89,7 +102,8 @@ class MergingIterator : public Iterator {
     // If we are moving in the reverse direction, it is already
     // true for all of the non-current_ children since current_ is
     // the largest child and key() == current_->key().  Otherwise,
-    // we explicitly position the non-current_ children.
+    // we explicitly position the non-current_ children and rebuild
+    // the tree for the new direction.
     if (direction_ != kReverse) {
       for (int i = 0; i < n_; i++) {
         IteratorWrapper* child = &children_[i];
@@ -105,10 +119,13 @@ class MergingIterator : public Iterator {
         }
       }
       direction_ = kReverse;
+      current_->Prev();
+      BuildTree();
+      return;
     }
 
     current_->Prev();
-    FindLargest();
+    ReplayFrom(current_ - children_);
   }
 
   virtual Slice key() const {
@@ -133,15 +150,34 @@ class MergingIterator : public Iterator {
   }
 
  private:
-  void FindSmallest();
-  void FindLargest();
-
-  // We might want to use a heap in case there are lots of children.
-  // For now we use a simple array since we expect a very small number
-  // of children in leveldb.
+  // Return true iff child "a" should be yielded before child "b" in the
+  // current direction.  Exhausted children (and the padding leaves at
+  // index n_ and above) come after all others.  Equal keys are yielded in
+  // child order when moving forward and in reverse child order when
+  // moving backward.
+  bool Precedes(int a, int b) const;
+
+  // Set tree_ and current_ from the positions of all the children.
+  void BuildTree();
+
+  // Update tree_ and current_ after child "i", the previous winner, moved.
+  void ReplayFrom(int i);
+
+  // The children are merged with a tournament (loser) tree, so that
+  // finding the next entry after the winning child moves takes one
+  // comparison per level of the tree, about log2(n) in total, instead of
+  // the n-1 comparisons of a linear scan over the children.
+  //
+  // The leaves are the children padded to a power of two.  Internal node
+  // j (1 <= j < leaves_) has nodes 2j and 2j+1 below it, where node
+  // leaves_+i is the leaf of child i, and tree_[j] holds the child that
+  // lost the match played at node j.  tree_[0] holds the overall winner.
   const Comparator* comparator_;
   IteratorWrapper* children_;
   int n_;
+  int leaves_;
+  int* tree_;
+  int* winners_;  // Scratch space for BuildTree()
   IteratorWrapper* current_;
 
   // Which direction is the iterator moving?
@@ -152,34 +188,47 @@ class MergingIterator : public Iterator {
   Direction direction_;
 };
 
-void MergingIterator::FindSmallest() {
-  IteratorWrapper* smallest = nullptr;
-  for (int i = 0; i < n_; i++) {
-    IteratorWrapper* child = &children_[i];
-    if (child->Valid()) {
-      if (smallest == nullptr) {
-        smallest = child;
-      } else if (comparator_->Compare(child->key(), smallest->key()) < 0) {
-        smallest = child;
-      }
+bool MergingIterator::Precedes(int a, int b) const {
+  if (a >= n_ || !children_[a].Valid()) {
+    return false;
+  } else if (b >= n_ || !children_[b].Valid()) {
+    return true;
+  }
+  const int r = comparator_->Compare(children_[a].key(), children_[b].key());
+  if (direction_ == kForward) {
+    return r < 0 || (r == 0 && a < b);
+  } else {
+    return r > 0 || (r == 0 && a > b);
+  }
+}
+
+void MergingIterator::BuildTree() {
+  // winners_[j] is the winner of the subtree rooted at internal node j.
+  for (int j = leaves_ - 1; j >= 1; j--) {
+    const int left = (2 * j >= leaves_) ? 2 * j - leaves_ : winners_[2 * j];
+    const int right =
+        (2 * j + 1 >= leaves_) ? 2 * j + 1 - leaves_ : winners_[2 * j + 1];
+    if (Precedes(right, left)) {
+      winners_[j] = right;
+      tree_[j] = left;
+    } else {
+      winners_[j] = left;
+      tree_[j] = right;
     }
   }
-  current_ = smallest;
+  tree_[0] = (leaves_ > 1) ? winners_[1] : 0;
+  current_ = children_[tree_[0]].Valid() ? &children_[tree_[0]] : nullptr;
 }
 
-void MergingIterator::FindLargest() {
-  IteratorWrapper* largest = nullptr;
-  for (int i = n_-1; i >= 0; i--) {
-    IteratorWrapper* child = &children_[i];
-    if (child->Valid()) {
-      if (largest == nullptr) {
-        largest = child;
-      } else if (comparator_->Compare(child->key(), largest->key()) > 0) {
-        largest = child;
-      }
+void MergingIterator::ReplayFrom(int i) {
+  int winner = i;
+  for (int j = (leaves_ + i) / 2; j >= 1; j /= 2) {
+    if (Precedes(tree_[j], winner)) {
+      std::swap(tree_[j], winner);
     }
   }
-  current_ = largest;
+  tree_[0] = winner;
+  current_ = children_[winner].Valid() ? &children_[winner] : nullptr;
 }
 }  // namespace
 
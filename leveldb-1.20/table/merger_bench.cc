@@ -0,0 +1,185 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+// Measures how the merging iterator that DB iterators and compactions use
+// to combine the memtables, level-0 files and levels scales with the
+// number of children it merges.  The keys are spread at random over the
+// children, as they are over overlapping level-0 files, and every child
+// is an in-memory sorted list so that only the cost of the merge is
+// measured.
+//
+// For each child count, prints the number of comparator calls and the
+// time per key of a full forward scan and of a full reverse scan.
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/iterator.h"
+#include "leveldb/slice.h"
+#include "table/merger.h"
+#include "util/random.h"
+
+// Comma-separated list of child counts to measure.
+static const char* FLAGS_children = "1,2,4,8,16,32,64";
+
+// Total number of keys, spread over the children.
+static int FLAGS_num = 1000000;
+
+// Number of times each scan is repeated.
+static int FLAGS_reps = 3;
+
+namespace leveldb {
+
+namespace {
+
+// Bytewise comparator that counts the calls to Compare().
+class CountingComparator : public Comparator {
+ public:
+  CountingComparator() : count_(0) { }
+
+  virtual const char* Name() const {
+    return BytewiseComparator()->Name();
+  }
+  virtual int Compare(const Slice& a, const Slice& b) const {
+    count_++;
+    return a.compare(b);
+  }
+  virtual void FindShortestSeparator(std::string* start,
+                                     const Slice& limit) const {
+    BytewiseComparator()->FindShortestSeparator(start, limit);
+  }
+  virtual void FindShortSuccessor(std::string* key) const {
+    BytewiseComparator()->FindShortSuccessor(key);
+  }
+
+  int64_t count() const { return count_; }
+  void Reset() { count_ = 0; }
+
+ private:
+  mutable int64_t count_;
+};
+
+// Iterator over a sorted list of keys, all with an empty value.
+class VectorIterator : public Iterator {
+ public:
+  explicit VectorIterator(const std::vector<std::string>* keys)
+      : keys_(keys), pos_(keys->size()) { }
+
+  virtual bool Valid() const { return pos_ < keys_->size(); }
+  virtual void SeekToFirst() { pos_ = 0; }
+  virtual void SeekToLast() {
+    pos_ = keys_->empty() ? keys_->size() : keys_->size() - 1;
+  }
+  virtual void Seek(const Slice& target) {
+    pos_ = std::lower_bound(keys_->begin(), keys_->end(),
+                            target.ToString()) - keys_->begin();
+  }
+  virtual void Next() { assert(Valid()); pos_++; }
+  virtual void Prev() {
+    assert(Valid());
+    pos_ = (pos_ == 0) ? keys_->size() : pos_ - 1;
+  }
+  virtual Slice key() const { assert(Valid()); return (*keys_)[pos_]; }
+  virtual Slice value() const { assert(Valid()); return Slice(); }
+  virtual Status status() const { return Status::OK(); }
+
+ private:
+  const std::vector<std::string>* keys_;
+  size_t pos_;
+};
+
+void Run(int n) {
+  Env* env = Env::Default();
+  std::vector<std::vector<std::string> > lists(n);
+  Random rnd(301);
+  char key[100];
+  for (int i = 0; i < FLAGS_num; i++) {
+    snprintf(key, sizeof(key), "%016d", i);
+    lists[rnd.Uniform(n)].push_back(key);
+  }
+
+  CountingComparator cmp;
+  std::vector<Iterator*> children(n);
+  for (int i = 0; i < n; i++) {
+    children[i] = new VectorIterator(&lists[i]);
+  }
+  Iterator* iter = NewMergingIterator(&cmp, &children[0], n);
+
+  int64_t keys = 0;
+  int64_t forward_compares = 0;
+  uint64_t forward_micros = 0;
+  for (int r = 0; r < FLAGS_reps; r++) {
+    cmp.Reset();
+    const uint64_t start = env->NowMicros();
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      keys++;
+    }
+    forward_micros += env->NowMicros() - start;
+    forward_compares += cmp.count();
+  }
+
+  int64_t reverse_compares = 0;
+  uint64_t reverse_micros = 0;
+  for (int r = 0; r < FLAGS_reps; r++) {
+    cmp.Reset();
+    const uint64_t start = env->NowMicros();
+    for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+    }
+    reverse_micros += env->NowMicros() - start;
+    reverse_compares += cmp.count();
+  }
+  delete iter;
+
+  const double k = (keys > 0) ? static_cast<double>(keys) : 1;
+  fprintf(stdout,
+          "%3d children : next %6.2f compares/key %7.1f ns/key; "
+          "prev %6.2f compares/key %7.1f ns/key\n",
+          n, forward_compares / k, forward_micros * 1e3 / k,
+          reverse_compares / k, reverse_micros * 1e3 / k);
+  fflush(stdout);
+}
+
+}  // namespace
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    int n;
+    char junk;
+    if (leveldb::Slice(argv[i]).starts_with("--children=")) {
+      FLAGS_children = argv[i] + strlen("--children=");
+    } else if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1 && n > 0) {
+      FLAGS_num = n;
+    } else if (sscanf(argv[i], "--reps=%d%c", &n, &junk) == 1 && n > 0) {
+      FLAGS_reps = n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      exit(1);
+    }
+  }
+
+  fprintf(stdout, "Keys:       %d (16 bytes each)\n", FLAGS_num);
+  fprintf(stdout, "------------------------------------------------\n");
+
+  const char* children = FLAGS_children;
+  while (children != nullptr && *children != '\0') {
+    const int n = atoi(children);
+    if (n > 0) {
+      leveldb::Run(n);
+    }
+    children = strchr(children, ',');
+    if (children != nullptr) {
+      children++;
+    }
+  }
+  return 0;
+}
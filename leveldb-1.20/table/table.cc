@@ -4,11 +4,15 @@
 
 #include "leveldb/table.h"
 
+#include <algorithm>
+#include <vector>
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
+#include "port/port.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -21,18 +25,45 @@ struct Table::Rep {
   ~Rep() {
     delete filter;
     delete [] filter_data;
+    delete full_filter;
+    delete [] full_filter_data;
     delete index_block;
+    if (zstd_dictionary != nullptr) {
+      port::Zstd_DeleteDecompressionDictionary(zstd_dictionary);
+    }
   }
 
   Options options;
   Status status;
   RandomAccessFile* file;
   uint64_t cache_id;
+  uint64_t compressed_cache_id;  // Key prefix in block_cache_compressed
   FilterBlockReader* filter;
   const char* filter_data;
+  FullFilterBlockReader* full_filter;  // Checked before the index
+  const char* full_filter_data;
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
+  BlockHandle index_handle;      // Handle to index_block: saved from footer
+
+  // nullptr if the table has a partitioned index whose top level is read
+  // through the block cache (see Options::pin_top_level_index).
   Block* index_block;
+
+  bool partitioned_index;   // Index values point at index partitions
+  bool partitioned_filter;  // Index values also point at filter partitions
+  bool prefix_filters;      // The filters hold the prefixes of the keys
+
+  // Dictionary that data blocks compressed with zstd may use, from
+  // port::Zstd_NewDecompressionDictionary(), or nullptr.
+  void* zstd_dictionary;
+
+  // Unlike the other meta blocks, the range deletion block is needed for
+  // correct results, so an error reading the metaindex is kept to be
+  // reported by NewRangeDeletionIterator().
+  Status metaindex_status;
+  bool has_range_deletions;
+  BlockHandle range_deletion_handle;
 };
 
 Status Table::Open(const Options& options,
@@ -54,28 +85,42 @@ Status Table::Open(const Options& options,
   s = footer.DecodeFrom(&footer_input);
   if (!s.ok()) return s;
 
-  // Read the index block
-  BlockContents index_block_contents;
-  if (s.ok()) {
+  // Read the index block, unless it is the top level of a partitioned
+  // index that should be read on demand.
+  Block* index_block = nullptr;
+  if (!footer.partitioned_index() || options.pin_top_level_index) {
+    BlockContents index_block_contents;
     ReadOptions opt;
     if (options.paranoid_checks) {
       opt.verify_checksums = true;
     }
     s = ReadBlock(file, opt, footer.index_handle(), &index_block_contents);
+    if (s.ok()) {
+      index_block = new Block(index_block_contents);
+    }
   }
 
   if (s.ok()) {
     // We've successfully read the footer and the index block: we're
     // ready to serve requests.
-    Block* index_block = new Block(index_block_contents);
     Rep* rep = new Table::Rep;
     rep->options = options;
     rep->file = file;
     rep->metaindex_handle = footer.metaindex_handle();
+    rep->index_handle = footer.index_handle();
     rep->index_block = index_block;
+    rep->partitioned_index = footer.partitioned_index();
+    rep->partitioned_filter = false;
+    rep->prefix_filters = false;
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+    rep->compressed_cache_id = (options.block_cache_compressed ?
+                                options.block_cache_compressed->NewId() : 0);
     rep->filter_data = nullptr;
     rep->filter = nullptr;
+    rep->full_filter_data = nullptr;
+    rep->full_filter = nullptr;
+    rep->zstd_dictionary = nullptr;
+    rep->has_range_deletions = false;
     *table = new Table(rep);
     (*table)->ReadMeta(footer);
   }
@@ -84,29 +129,71 @@ Status Table::Open(const Options& options,
 }
 
 void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
+  // An empty block holds just its restart array: one restart point and
+  // the number of restarts.
+  if (footer.metaindex_handle().size() <= 2 * sizeof(uint32_t)) {
+    return;  // No metadata
   }
 
-  // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
-  // it is an empty block.
   ReadOptions opt;
   if (rep_->options.paranoid_checks) {
     opt.verify_checksums = true;
   }
   BlockContents contents;
-  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
-    // Do not propagate errors since meta info is not needed for operation
+  Status s = ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents);
+  if (!s.ok()) {
+    // Do not propagate errors since meta info is not needed for
+    // operation, except to find range deletions
+    rep_->metaindex_status = s;
     return;
   }
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
+  iter->Seek("zstd.dictionary");
+  if (iter->Valid() && iter->key() == Slice("zstd.dictionary")) {
+    ReadDictionary(iter->value());
+  }
+  iter->Seek("rangedel");
+  if (iter->Valid() && iter->key() == Slice("rangedel")) {
+    Slice v = iter->value();
+    if (rep_->range_deletion_handle.DecodeFrom(&v).ok()) {
+      rep_->has_range_deletions = true;
+    } else {
+      rep_->metaindex_status = Status::Corruption("bad range deletion handle");
+    }
+  }
+  if (rep_->options.filter_policy == nullptr) {
+    delete iter;
+    delete meta;
+    return;  // Do not need any filter
+  }
+
+  std::string full_key = "fullfilter.";
+  full_key.append(rep_->options.filter_policy->Name());
+  iter->Seek(full_key);
+  if (iter->Valid() && iter->key() == Slice(full_key)) {
+    ReadFullFilter(iter->value());
+  }
+
+  std::string key =
+      footer.partitioned_index() ? "partitionedfilter." : "filter.";
   key.append(rep_->options.filter_policy->Name());
   iter->Seek(key);
   if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+    if (footer.partitioned_index()) {
+      // Filter partitions are read on demand (see PartitionMayMatch)
+      rep_->partitioned_filter = true;
+    } else {
+      ReadFilter(iter->value());
+    }
+  }
+
+  if (rep_->options.prefix_extractor != nullptr) {
+    std::string prefix_key = "prefix.";
+    prefix_key.append(rep_->options.prefix_extractor->Name());
+    iter->Seek(prefix_key);
+    rep_->prefix_filters = iter->Valid() && iter->key() == Slice(prefix_key);
   }
   delete iter;
   delete meta;
@@ -135,6 +222,51 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
 }
 
+void Table::ReadDictionary(const Slice& dictionary_handle_value) {
+  Slice v = dictionary_handle_value;
+  BlockHandle dictionary_handle;
+  if (!dictionary_handle.DecodeFrom(&v).ok()) {
+    return;
+  }
+
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents block;
+  if (!ReadBlock(rep_->file, opt, dictionary_handle, &block).ok()) {
+    return;
+  }
+  // The digested dictionary keeps a copy of the data it needs.
+  rep_->zstd_dictionary = port::Zstd_NewDecompressionDictionary(
+      block.data.data(), block.data.size());
+  if (block.heap_allocated) {
+    delete[] block.data.data();
+  }
+}
+
+void Table::ReadFullFilter(const Slice& filter_handle_value) {
+  Slice v = filter_handle_value;
+  BlockHandle filter_handle;
+  if (!filter_handle.DecodeFrom(&v).ok()) {
+    return;
+  }
+
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents block;
+  if (!ReadBlock(rep_->file, opt, filter_handle, &block).ok()) {
+    return;
+  }
+  if (block.heap_allocated) {
+    rep_->full_filter_data = block.data.data();     // Will need to delete later
+  }
+  rep_->full_filter = new FullFilterBlockReader(rep_->options.filter_policy,
+                                                block.data);
+}
+
 Table::~Table() {
   delete rep_;
 }
@@ -154,11 +286,112 @@ static void ReleaseBlock(void* arg, void* h) {
   cache->Release(handle);
 }
 
+static void DeleteCachedCompressedBlock(const Slice& key, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
+bool Table::LookupCompressedBlock(const BlockHandle& handle,
+                                  BlockContents* contents,
+                                  Status* s) const {
+  Cache* cache = rep_->options.block_cache_compressed;
+  if (cache == nullptr) {
+    return false;
+  }
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, rep_->compressed_cache_id);
+  EncodeFixed64(cache_key_buffer+8, handle.offset());
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  Cache::Handle* cache_handle = cache->Lookup(key);
+  if (cache_handle == nullptr) {
+    return false;
+  }
+  const std::string* compressed =
+      reinterpret_cast<std::string*>(cache->Value(cache_handle));
+  *s = UncompressBlock(*compressed, contents, rep_->zstd_dictionary);
+  cache->Release(cache_handle);
+  return true;
+}
+
+void Table::InsertCompressedBlock(const ReadOptions& options,
+                                  const BlockHandle& handle,
+                                  std::string* compressed) const {
+  Cache* cache = rep_->options.block_cache_compressed;
+  if (cache == nullptr || compressed->empty() || !options.fill_cache) {
+    return;
+  }
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, rep_->compressed_cache_id);
+  EncodeFixed64(cache_key_buffer+8, handle.offset());
+  Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+  std::string* value = new std::string;
+  value->swap(*compressed);
+  cache->Release(cache->Insert(key, value, value->size(),
+                               &DeleteCachedCompressedBlock));
+}
+
+Status Table::FetchBlock(const ReadOptions& options,
+                         const BlockHandle& handle,
+                         BlockContents* contents) const {
+  if (rep_->options.block_cache_compressed == nullptr) {
+    return ReadBlock(rep_->file, options, handle, contents, nullptr,
+                     rep_->zstd_dictionary);
+  }
+  Status s;
+  if (!LookupCompressedBlock(handle, contents, &s)) {
+    std::string compressed;
+    s = ReadBlock(rep_->file, options, handle, contents, &compressed,
+                  rep_->zstd_dictionary);
+    if (s.ok()) {
+      InsertCompressedBlock(options, handle, &compressed);
+    }
+  }
+  return s;
+}
+
+namespace {
+// A filter partition of a table with a partitioned index, as stored in
+// the block cache.
+struct FilterPartition {
+  FilterPartition(const FilterPolicy* policy, const BlockContents& contents)
+      : data(contents.heap_allocated ? contents.data.data() : nullptr),
+        reader(policy, contents.data) { }
+  ~FilterPartition() { delete[] data; }
+
+  const char* data;  // Owned data of reader, or nullptr if not heap-allocated
+  FilterBlockReader reader;
+};
+}  // namespace
+
+static void DeleteCachedFilterPartition(const Slice& key, void* value) {
+  delete reinterpret_cast<FilterPartition*>(value);
+}
+
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg,
                              const ReadOptions& options,
                              const Slice& index_value) {
+  return BlockReader(arg, options, index_value, false, false);
+}
+
+// Like BlockReader(), for the blocks of a partitioned index.  They are
+// cached with high priority since every lookup in their key range needs
+// them.
+Iterator* Table::IndexBlockReader(void* arg,
+                                  const ReadOptions& options,
+                                  const Slice& index_value) {
+  return BlockReader(arg, options, index_value, false, true);
+}
+
+// If "point_lookup" is true the result is only good for finding the
+// entries of a single key (see Block::NewPointLookupIterator).
+// "index_block" is true for index blocks, which are cached with high
+// priority.
+Iterator* Table::BlockReader(void* arg,
+                             const ReadOptions& options,
+                             const Slice& index_value,
+                             bool point_lookup,
+                             bool index_block) {
   Table* table = reinterpret_cast<Table*>(arg);
   Cache* block_cache = table->rep_->options.block_cache;
   Block* block = nullptr;
@@ -181,17 +414,18 @@ Iterator* Table::BlockReader(void* arg,
       if (cache_handle != nullptr) {
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        s = table->FetchBlock(options, handle, &contents);
         if (s.ok()) {
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
             cache_handle = block_cache->Insert(
-                key, block, block->size(), &DeleteCachedBlock);
+                key, block, block->size(), &DeleteCachedBlock,
+                index_block ? Cache::kHigh : Cache::kLow);
           }
         }
       }
     } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      s = table->FetchBlock(options, handle, &contents);
       if (s.ok()) {
         block = new Block(contents);
       }
@@ -200,7 +434,9 @@ Iterator* Table::BlockReader(void* arg,
 
   Iterator* iter;
   if (block != nullptr) {
-    iter = block->NewIterator(table->rep_->options.comparator);
+    const Comparator* comparator = table->rep_->options.comparator;
+    iter = point_lookup ? block->NewPointLookupIterator(comparator)
+                        : block->NewIterator(comparator);
     if (cache_handle == nullptr) {
       iter->RegisterCleanup(&DeleteBlock, block, nullptr);
     } else {
@@ -212,28 +448,223 @@ Iterator* Table::BlockReader(void* arg,
   return iter;
 }
 
+// Return an iterator over the index block, or over the top level of a
+// partitioned index.
+Iterator* Table::NewTopLevelIndexIterator(const ReadOptions& options) const {
+  if (rep_->index_block != nullptr) {
+    return rep_->index_block->NewIterator(rep_->options.comparator);
+  }
+  std::string handle_encoding;
+  rep_->index_handle.EncodeTo(&handle_encoding);
+  return IndexBlockReader(const_cast<Table*>(this), options,
+                          handle_encoding);
+}
+
+// Return an iterator that maps keys to the handles of data blocks.
+Iterator* Table::NewIndexIterator(const ReadOptions& options) const {
+  Iterator* top = NewTopLevelIndexIterator(options);
+  if (!rep_->partitioned_index) {
+    return top;
+  }
+  return NewTwoLevelIterator(top, &Table::IndexBlockReader,
+                             const_cast<Table*>(this), options,
+                             rep_->options.comparator);
+}
+
+// Return false if the filter partition named by "partition_value", a
+// top-level index value, says that "key" is not in the data block at
+// "block_offset".
+bool Table::PartitionMayMatch(const ReadOptions& options,
+                              const Slice& partition_value,
+                              uint64_t block_offset,
+                              const Slice& key) const {
+  Slice input = partition_value;
+  BlockHandle index_handle, filter_handle;
+  uint64_t filter_base;
+  if (!index_handle.DecodeFrom(&input).ok() ||
+      !filter_handle.DecodeFrom(&input).ok() ||
+      !GetVarint64(&input, &filter_base) ||
+      block_offset < filter_base) {
+    return true;
+  }
+
+  Cache* block_cache = rep_->options.block_cache;
+  Cache::Handle* cache_handle = nullptr;
+  FilterPartition* partition = nullptr;
+  char cache_key_buffer[16];
+  EncodeFixed64(cache_key_buffer, rep_->cache_id);
+  EncodeFixed64(cache_key_buffer+8, filter_handle.offset());
+  Slice cache_key(cache_key_buffer, sizeof(cache_key_buffer));
+  if (block_cache != nullptr) {
+    cache_handle = block_cache->Lookup(cache_key);
+    if (cache_handle != nullptr) {
+      partition = reinterpret_cast<FilterPartition*>(
+          block_cache->Value(cache_handle));
+    }
+  }
+  if (partition == nullptr) {
+    BlockContents contents;
+    if (!FetchBlock(options, filter_handle, &contents).ok()) {
+      return true;  // Errors are reported when the data block is read
+    }
+    partition = new FilterPartition(rep_->options.filter_policy, contents);
+    if (block_cache != nullptr && contents.cachable && options.fill_cache) {
+      cache_handle = block_cache->Insert(cache_key, partition,
+                                         contents.data.size(),
+                                         &DeleteCachedFilterPartition,
+                                         Cache::kHigh);
+    }
+  }
+
+  const bool result =
+      partition->reader.KeyMayMatch(block_offset - filter_base, key);
+  if (cache_handle != nullptr) {
+    block_cache->Release(cache_handle);
+  } else {
+    delete partition;
+  }
+  return result;
+}
+
+namespace {
+struct ReadaheadState {
+  Table* table;
+  int blocks_read;
+  uint64_t next_offset;      // Offset just past the last block read
+  uint64_t readahead_limit;  // End of the range prefetched so far
+};
+}  // namespace
+
+static void DeleteReadaheadState(void* arg, void* ignored) {
+  delete reinterpret_cast<ReadaheadState*>(arg);
+}
+
+Iterator* Table::ReadaheadBlockReader(void* arg,
+                                      const ReadOptions& options,
+                                      const Slice& index_value) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  Slice input = index_value;
+  BlockHandle handle;
+  if (handle.DecodeFrom(&input).ok()) {
+    // Blocks are read in order if each one starts at or shortly after
+    // the end of the previous one.  Index and filter partitions may sit
+    // in between.
+    const uint64_t offset = handle.offset();
+    if (state->blocks_read == 0 || offset < state->next_offset ||
+        offset - state->next_offset >= options.readahead_size) {
+      state->blocks_read = 0;
+      state->readahead_limit = 0;
+    }
+    state->blocks_read++;
+    state->next_offset = offset + handle.size() + kBlockTrailerSize;
+
+    // Wait for a second block in a row so that iterators that only do a
+    // few seeks do not prefetch.  After that, keep the prefetched range
+    // at least half a window ahead of the reader.
+    if (state->blocks_read >= 2 &&
+        state->next_offset + options.readahead_size / 2 >
+            state->readahead_limit) {
+      const uint64_t start = std::max(state->next_offset,
+                                      state->readahead_limit);
+      const uint64_t limit = state->next_offset + options.readahead_size;
+      state->table->rep_->file->Prefetch(start, limit - start);
+      state->readahead_limit = limit;
+    }
+  }
+  return BlockReader(state->table, options, index_value);
+}
+
 Iterator* Table::NewIterator(const ReadOptions& options) const {
+  if (options.readahead_size > 0) {
+    ReadaheadState* state = new ReadaheadState;
+    state->table = const_cast<Table*>(this);
+    state->blocks_read = 0;
+    state->next_offset = 0;
+    state->readahead_limit = 0;
+    Iterator* iter = NewTwoLevelIterator(
+        NewIndexIterator(options), &Table::ReadaheadBlockReader, state,
+        options, rep_->options.comparator);
+    iter->RegisterCleanup(&DeleteReadaheadState, state, nullptr);
+    return iter;
+  }
   return NewTwoLevelIterator(
-      rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+      NewIndexIterator(options),
+      &Table::BlockReader, const_cast<Table*>(this), options,
+      rep_->options.comparator);
+}
+
+Iterator* Table::NewRangeDeletionIterator() const {
+  if (!rep_->metaindex_status.ok()) {
+    return NewErrorIterator(rep_->metaindex_status);
+  }
+  if (!rep_->has_range_deletions) {
+    return nullptr;
+  }
+
+  // The block is read once, when the table is opened, so it is always
+  // checked.
+  ReadOptions opt;
+  opt.verify_checksums = true;
+  BlockContents contents;
+  Status s = ReadBlock(rep_->file, opt, rep_->range_deletion_handle,
+                       &contents);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+  Block* block = new Block(contents);
+  Iterator* iter = block->NewIterator(rep_->options.comparator);
+  iter->RegisterCleanup(&DeleteBlock, block, nullptr);
+  return iter;
+}
+
+bool Table::HasPrefixFilters() const {
+  return rep_->prefix_filters;
+}
+
+bool Table::KeyMayMatch(const Slice& k) const {
+  if (rep_->full_filter != nullptr) {
+    return rep_->full_filter->KeyMayMatch(k);
+  } else if (rep_->filter != nullptr) {
+    return rep_->filter->KeyMayMatchAnyBlock(k);
+  } else {
+    return true;
+  }
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k,
                           void* arg,
                           void (*saver)(void*, const Slice&, const Slice&)) {
+  if (rep_->full_filter != nullptr && !rep_->full_filter->KeyMayMatch(k)) {
+    return Status::OK();  // Not found
+  }
+
   Status s;
-  Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* iiter = NewTopLevelIndexIterator(options);
   iiter->Seek(k);
+  Iterator* top_iter = nullptr;  // Set if iiter is an index partition
+  if (rep_->partitioned_index && iiter->Valid()) {
+    top_iter = iiter;
+    iiter = IndexBlockReader(this, options, top_iter->value());
+    iiter->Seek(k);
+  }
   if (iiter->Valid()) {
     Slice handle_value = iiter->value();
     FilterBlockReader* filter = rep_->filter;
     BlockHandle handle;
-    if (filter != nullptr &&
-        handle.DecodeFrom(&handle_value).ok() &&
-        !filter->KeyMayMatch(handle.offset(), k)) {
+    bool may_match = true;
+    if (handle.DecodeFrom(&handle_value).ok()) {
+      if (filter != nullptr) {
+        may_match = filter->KeyMayMatch(handle.offset(), k);
+      } else if (rep_->partitioned_filter) {
+        may_match = PartitionMayMatch(options, top_iter->value(),
+                                      handle.offset(), k);
+      }
+    }
+    if (!may_match) {
       // Not found
     } else {
-      Iterator* block_iter = BlockReader(this, options, iiter->value());
+      Iterator* block_iter =
+          BlockReader(this, options, iiter->value(), true, false);
       block_iter->Seek(k);
       if (block_iter->Valid()) {
         (*saver)(arg, block_iter->key(), block_iter->value());
@@ -246,13 +677,191 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
     s = iiter->status();
   }
   delete iiter;
+  if (top_iter != nullptr) {
+    if (s.ok()) {
+      s = top_iter->status();
+    }
+    delete top_iter;
+  }
   return s;
 }
 
 
+namespace {
+
+// A data block needed by a Table::InternalMultiGet() batch.
+struct BatchBlock {
+  BlockHandle handle;
+  Block* block;                 // nullptr until the block has been read
+  Cache::Handle* cache_handle;  // Pins "block" if it is in the block cache
+  Status status;
+};
+
+}  // namespace
+
+Status Table::InternalMultiGet(
+    const ReadOptions& options, int n, const Slice* keys, void* const* args,
+    void (*saver)(void*, const Slice&, const Slice&)) {
+  // Find the data block of every key that may be present.  Keys are
+  // sorted, so keys that share a block are adjacent.
+  Status s;
+  std::vector<BatchBlock> blocks;
+  std::vector<int> key_block(n, -1);  // Index into blocks, or -1
+  Iterator* top_iter = NewTopLevelIndexIterator(options);
+  Iterator* partition_iter = nullptr;  // Current index partition, if any
+  std::string partition_value;         // Top-level entry of partition_iter
+  for (int i = 0; i < n && s.ok(); i++) {
+    const Slice& k = keys[i];
+    if (rep_->full_filter != nullptr && !rep_->full_filter->KeyMayMatch(k)) {
+      continue;  // Not found
+    }
+
+    Iterator* iiter = top_iter;
+    iiter->Seek(k);
+    if (!iiter->Valid()) {
+      break;  // This and all later keys are past the end of the table
+    }
+    if (rep_->partitioned_index) {
+      if (partition_iter == nullptr || iiter->value() != partition_value) {
+        delete partition_iter;
+        partition_value = iiter->value().ToString();
+        partition_iter = IndexBlockReader(this, options, partition_value);
+      }
+      iiter = partition_iter;
+      iiter->Seek(k);
+      if (!iiter->Valid()) {
+        s = iiter->status();
+        continue;
+      }
+    }
+
+    Slice handle_value = iiter->value();
+    BlockHandle handle;
+    if (!handle.DecodeFrom(&handle_value).ok()) {
+      s = Status::Corruption("bad block handle");
+      break;
+    }
+    if (rep_->filter != nullptr &&
+        !rep_->filter->KeyMayMatch(handle.offset(), k)) {
+      continue;  // Not found
+    }
+    if (rep_->partitioned_filter &&
+        !PartitionMayMatch(options, partition_value, handle.offset(), k)) {
+      continue;  // Not found
+    }
+
+    if (blocks.empty() || blocks.back().handle.offset() != handle.offset()) {
+      BatchBlock b;
+      b.handle = handle;
+      b.block = nullptr;
+      b.cache_handle = nullptr;
+      blocks.push_back(b);
+    }
+    key_block[i] = static_cast<int>(blocks.size()) - 1;
+  }
+  if (s.ok()) {
+    s = top_iter->status();
+  }
+  delete partition_iter;
+  delete top_iter;
+
+  // Take the blocks that are cached from the block cache or the
+  // compressed block cache, and read all others with one batch of reads.
+  Cache* block_cache = rep_->options.block_cache;
+  std::vector<BlockHandle> missing;
+  std::vector<size_t> missing_index;
+  std::vector<BlockContents> contents(blocks.size());
+  std::vector<bool> fetched(blocks.size(), false);
+  for (size_t b = 0; s.ok() && b < blocks.size(); b++) {
+    if (block_cache != nullptr) {
+      char cache_key_buffer[16];
+      EncodeFixed64(cache_key_buffer, rep_->cache_id);
+      EncodeFixed64(cache_key_buffer+8, blocks[b].handle.offset());
+      Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+      blocks[b].cache_handle = block_cache->Lookup(key);
+      if (blocks[b].cache_handle != nullptr) {
+        blocks[b].block = reinterpret_cast<Block*>(
+            block_cache->Value(blocks[b].cache_handle));
+        continue;
+      }
+    }
+    fetched[b] = true;
+    if (LookupCompressedBlock(blocks[b].handle, &contents[b],
+                              &blocks[b].status)) {
+      continue;
+    }
+    missing.push_back(blocks[b].handle);
+    missing_index.push_back(b);
+  }
+  if (!missing.empty()) {
+    std::vector<BlockContents> missing_contents(missing.size());
+    std::vector<Status> statuses(missing.size());
+    std::vector<std::string> compressed;
+    if (rep_->options.block_cache_compressed != nullptr) {
+      compressed.resize(missing.size());
+    }
+    ReadBlocks(rep_->file, options, &missing[0], missing.size(),
+               &missing_contents[0], &statuses[0],
+               compressed.empty() ? nullptr : &compressed[0],
+               rep_->zstd_dictionary);
+    for (size_t m = 0; m < missing.size(); m++) {
+      const size_t b = missing_index[m];
+      contents[b] = missing_contents[m];
+      blocks[b].status = statuses[m];
+      if (statuses[m].ok() && !compressed.empty()) {
+        InsertCompressedBlock(options, blocks[b].handle, &compressed[m]);
+      }
+    }
+  }
+  for (size_t i = 0; i < blocks.size(); i++) {
+    BatchBlock* b = &blocks[i];
+    if (!fetched[i] || !b->status.ok()) {
+      continue;
+    }
+    b->block = new Block(contents[i]);
+    if (block_cache != nullptr && contents[i].cachable &&
+        options.fill_cache) {
+      char cache_key_buffer[16];
+      EncodeFixed64(cache_key_buffer, rep_->cache_id);
+      EncodeFixed64(cache_key_buffer+8, b->handle.offset());
+      Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+      b->cache_handle = block_cache->Insert(
+          key, b->block, b->block->size(), &DeleteCachedBlock);
+    }
+  }
+
+  // Look the keys up in their blocks.
+  const Comparator* comparator = rep_->options.comparator;
+  for (int i = 0; i < n && s.ok(); i++) {
+    if (key_block[i] < 0) {
+      continue;
+    }
+    const BatchBlock& b = blocks[key_block[i]];
+    if (b.block == nullptr) {
+      s = b.status;
+      break;
+    }
+    Iterator* block_iter = b.block->NewPointLookupIterator(comparator);
+    block_iter->Seek(keys[i]);
+    if (block_iter->Valid()) {
+      (*saver)(args[i], block_iter->key(), block_iter->value());
+    }
+    s = block_iter->status();
+    delete block_iter;
+  }
+
+  for (size_t b = 0; b < blocks.size(); b++) {
+    if (blocks[b].cache_handle != nullptr) {
+      block_cache->Release(blocks[b].cache_handle);
+    } else {
+      delete blocks[b].block;
+    }
+  }
+  return s;
+}
+
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
-  Iterator* index_iter =
-      rep_->index_block->NewIterator(rep_->options.comparator);
+  Iterator* index_iter = NewIndexIterator(ReadOptions());
   index_iter->Seek(key);
   uint64_t result;
   if (index_iter->Valid()) {
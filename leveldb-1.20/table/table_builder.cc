@@ -5,18 +5,176 @@
 #include "leveldb/table_builder.h"
 
 #include <assert.h>
+#include <deque>
+#include <vector>
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/slice_transform.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/mutexlock.h"
+#include "util/thread_pool.h"
 
 namespace leveldb {
 
+// A zstd dictionary of options.zstd_max_dictionary_bytes is trained on
+// this many times as many bytes of data blocks.
+static const size_t kDictionarySampleRatio = 16;
+
+// Store the compression of "raw" with "type" in *compressed, using the
+// zstd dictionary "zstd_dictionary" if it is non-null, and return the
+// compression the block should be stored with.  Returns kNoCompression
+// if the compressed form is not worth storing.
+static CompressionType CompressBlock(CompressionType type, int zstd_level,
+                                     const void* zstd_dictionary,
+                                     const Slice& raw,
+                                     std::string* compressed) {
+  bool ok = false;
+  switch (type) {
+    case kNoCompression:
+      break;
+
+    case kSnappyCompression:
+      ok = port::Snappy_Compress(raw.data(), raw.size(), compressed);
+      break;
+
+    case kZstdCompression:
+      if (zstd_dictionary != nullptr) {
+        ok = port::Zstd_CompressWithDictionary(zstd_dictionary,
+                                               raw.data(), raw.size(),
+                                               compressed);
+      } else {
+        ok = port::Zstd_Compress(zstd_level, raw.data(), raw.size(),
+                                 compressed);
+      }
+      break;
+
+    case kLZ4Compression:
+      ok = port::LZ4_Compress(raw.data(), raw.size(), compressed);
+      break;
+  }
+  if (ok && compressed->size() < raw.size() - (raw.size() / 8u)) {
+    return type;
+  }
+  // Compression not supported, or compressed less than 12.5%, so just
+  // store uncompressed form
+  return kNoCompression;
+}
+
+namespace {
+
+// A data block of a table with parallel compression, from the time it
+// is complete until it is written to the file.
+struct PendingBlock {
+  std::string raw;  // Uncompressed contents
+  CompressionType compression;
+  int zstd_level;
+  const void* zstd_dictionary;
+
+  // Set by the BlockCompressor before "done", which it guards.
+  CompressionType type;     // Compression the block is stored with
+  std::string compressed;   // Stored contents if type != kNoCompression
+  bool done;
+
+  // Key of the index entry of the block, known once the first key of
+  // the next block has been added.  The last block of a table does not
+  // get one; Finish() adds its index entry.
+  bool has_index_key;
+  std::string index_key;
+
+  // Keys of the block, which are added to the filter block only once the
+  // offset of the block is known.
+  std::string filter_keys;
+  std::vector<size_t> filter_key_lengths;
+};
+
+// Compresses the blocks handed to Schedule() on the threads of a pool.
+// Every block comes with a function that the pool runs to compress the
+// oldest block that is still queued, if any, so the functions never wait
+// and the pool can be shared by any number of tables.
+class BlockCompressor {
+ public:
+  explicit BlockCompressor(ThreadPool* pool)
+      : pool_(pool), cv_(&mu_), scheduled_(0) { }
+
+  BlockCompressor(const BlockCompressor&) = delete;
+  void operator=(const BlockCompressor&) = delete;
+
+  // Waits for the functions scheduled on the pool to return.
+  ~BlockCompressor() {
+    MutexLock l(&mu_);
+    while (scheduled_ > 0) {
+      cv_.Wait();
+    }
+  }
+
+  void Schedule(PendingBlock* block) {
+    MutexLock l(&mu_);
+    block->done = false;
+    queue_.push_back(block);
+    scheduled_++;
+    pool_->Schedule(&BlockCompressor::CompressTask, this);
+  }
+
+  bool IsDone(PendingBlock* block) {
+    MutexLock l(&mu_);
+    return block->done;
+  }
+
+  // Wait until "block" has been compressed.  Rather than sleep, the
+  // calling thread compresses scheduled blocks itself while there are
+  // any, which include "block" if no thread has taken it yet.
+  void Wait(PendingBlock* block) {
+    MutexLock l(&mu_);
+    while (!block->done) {
+      if (!queue_.empty()) {
+        CompressNext();
+      } else {
+        cv_.Wait();
+      }
+    }
+  }
+
+ private:
+  static void CompressTask(void* arg) {
+    BlockCompressor* compressor = reinterpret_cast<BlockCompressor*>(arg);
+    MutexLock l(&compressor->mu_);
+    if (!compressor->queue_.empty()) {
+      compressor->CompressNext();
+    }
+    compressor->scheduled_--;
+    compressor->cv_.SignalAll();
+  }
+
+  // Compress the oldest scheduled block.
+  void CompressNext() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    PendingBlock* block = queue_.front();
+    queue_.pop_front();
+    mu_.Unlock();
+    block->type = CompressBlock(block->compression, block->zstd_level,
+                                block->zstd_dictionary, block->raw,
+                                &block->compressed);
+    mu_.Lock();
+    block->done = true;
+    cv_.SignalAll();
+  }
+
+  ThreadPool* const pool_;
+  port::Mutex mu_;
+  port::CondVar cv_ GUARDED_BY(mu_);
+  std::deque<PendingBlock*> queue_ GUARDED_BY(mu_);
+  int scheduled_ GUARDED_BY(mu_);  // CompressTask()s that have not returned
+};
+
+}  // namespace
+
 struct TableBuilder::Rep {
   Options options;
   Options index_block_options;
@@ -25,11 +183,15 @@ struct TableBuilder::Rep {
   Status status;
   BlockBuilder data_block;
   BlockBuilder index_block;
+  BlockBuilder range_deletion_block;
   std::string last_key;
   int64_t num_entries;
   bool closed;          // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
 
+  // Used instead of filter_block if options.whole_table_filter is set
+  FullFilterBlockBuilder* full_filter_block;
+
   // We do not emit the index entry for a block until we have seen the
   // first key for the next data block.  This allows us to use shorter
   // keys in the index block.  For example, consider a block boundary
@@ -42,8 +204,40 @@ struct TableBuilder::Rep {
   bool pending_index_entry;
   BlockHandle pending_handle;  // Handle to add to index block
 
+  // With options.partition_index_and_filters, index_block and filter_block
+  // hold the current partition.  A partition is written out once its
+  // index reaches block_size, and top_index_block maps the last key of
+  // each partition to its location.  Offsets given to filter_block are
+  // relative to filter_base, the offset of the first data block covered
+  // by the current filter partition.
+  const bool partitioned;
+  BlockBuilder top_index_block;
+  uint64_t filter_base;
+
   std::string compressed_output;
 
+  // With kZstdCompression and options.zstd_max_dictionary_bytes, the
+  // contents of the first data blocks are collected in samples until
+  // there are enough of them to train a dictionary on.  Later data blocks
+  // are compressed with zstd_dictionary, the digested form of dictionary.
+  bool collect_samples;
+  std::string samples;
+  std::vector<size_t> sample_lengths;
+  std::string dictionary;
+  void* zstd_dictionary;  // nullptr until a dictionary has been trained
+
+  // With options.parallel_compression_threads, data blocks are handed to
+  // compressor and wait in pending_blocks, oldest first, until they are
+  // written, which Flush() holds up once there are max_pending_blocks.
+  // Meanwhile the keys of data_block are collected in filter_keys.
+  // owned_pool is the pool of compressor unless the caller passed one.
+  BlockCompressor* compressor;
+  ThreadPool* owned_pool;
+  std::deque<PendingBlock*> pending_blocks;
+  size_t max_pending_blocks;
+  std::string filter_keys;
+  std::vector<size_t> filter_key_lengths;
+
   Rep(const Options& opt, WritableFile* f)
       : options(opt),
         index_block_options(opt),
@@ -51,25 +245,65 @@ struct TableBuilder::Rep {
         offset(0),
         data_block(&options),
         index_block(&index_block_options),
+        range_deletion_block(&index_block_options),
         num_entries(0),
         closed(false),
-        filter_block(opt.filter_policy == nullptr ? nullptr
+        filter_block(opt.filter_policy == nullptr || opt.whole_table_filter
+                     ? nullptr
                      : new FilterBlockBuilder(opt.filter_policy)),
-        pending_index_entry(false) {
+        full_filter_block(opt.filter_policy == nullptr ||
+                          !opt.whole_table_filter
+                          ? nullptr
+                          : new FullFilterBlockBuilder(opt.filter_policy)),
+        pending_index_entry(false),
+        partitioned(opt.partition_index_and_filters),
+        top_index_block(&index_block_options),
+        filter_base(0),
+        collect_samples(opt.compression == kZstdCompression &&
+                        opt.zstd_max_dictionary_bytes > 0),
+        zstd_dictionary(nullptr),
+        compressor(nullptr),
+        owned_pool(nullptr),
+        max_pending_blocks(0) {
     index_block_options.block_restart_interval = 1;
+    index_block_options.data_block_hash_index = false;
   }
 };
 
 TableBuilder::TableBuilder(const Options& options, WritableFile* file)
+    : TableBuilder(options, file, nullptr) {
+}
+
+TableBuilder::TableBuilder(const Options& options, WritableFile* file,
+                           ThreadPool* compression_pool)
     : rep_(new Rep(options, file)) {
   if (rep_->filter_block != nullptr) {
     rep_->filter_block->StartBlock(0);
   }
+  const int threads = options.parallel_compression_threads;
+  if (threads > 1 && options.compression != kNoCompression) {
+    if (compression_pool == nullptr) {
+      rep_->owned_pool = new ThreadPool(options.env);
+      compression_pool = rep_->owned_pool;
+    }
+    compression_pool->EnsureThreads(threads);
+    rep_->compressor = new BlockCompressor(compression_pool);
+    rep_->max_pending_blocks = 2 * threads;
+  }
 }
 
 TableBuilder::~TableBuilder() {
   assert(rep_->closed);  // Catch errors where caller forgot to call Finish()
+  delete rep_->compressor;
+  delete rep_->owned_pool;
+  for (size_t i = 0; i < rep_->pending_blocks.size(); i++) {
+    delete rep_->pending_blocks[i];
+  }
   delete rep_->filter_block;
+  delete rep_->full_filter_block;
+  if (rep_->zstd_dictionary != nullptr) {
+    port::Zstd_DeleteCompressionDictionary(rep_->zstd_dictionary);
+  }
   delete rep_;
 }
 
@@ -80,12 +314,21 @@ Status TableBuilder::ChangeOptions(const Options& options) {
   if (options.comparator != rep_->options.comparator) {
     return Status::InvalidArgument("changing comparator while building table");
   }
+  if (options.partition_index_and_filters != rep_->partitioned) {
+    return Status::InvalidArgument(
+        "changing partition_index_and_filters while building table");
+  }
+  if (options.whole_table_filter != rep_->options.whole_table_filter) {
+    return Status::InvalidArgument(
+        "changing whole_table_filter while building table");
+  }
 
   // Note that any live BlockBuilders point to rep_->options and therefore
   // will automatically pick up the updated options.
   rep_->options = options;
   rep_->index_block_options = options;
   rep_->index_block_options.block_restart_interval = 1;
+  rep_->index_block_options.data_block_hash_index = false;
   return Status::OK();
 }
 
@@ -100,15 +343,34 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   if (r->pending_index_entry) {
     assert(r->data_block.empty());
     r->options.comparator->FindShortestSeparator(&r->last_key, key);
-    std::string handle_encoding;
-    r->pending_handle.EncodeTo(&handle_encoding);
-    r->index_block.Add(r->last_key, Slice(handle_encoding));
-    r->pending_index_entry = false;
+    if (r->compressor != nullptr) {
+      // The block may not have been written yet
+      PendingBlock* block = r->pending_blocks.back();
+      block->has_index_key = true;
+      block->index_key = r->last_key;
+      r->pending_index_entry = false;
+      WritePendingBlocks(false);
+    } else {
+      std::string handle_encoding;
+      r->pending_handle.EncodeTo(&handle_encoding);
+      r->index_block.Add(r->last_key, Slice(handle_encoding));
+      r->pending_index_entry = false;
+      if (r->partitioned &&
+          r->index_block.CurrentSizeEstimate() >= r->options.block_size) {
+        WritePartition(r->last_key);
+      }
+    }
   }
 
-  if (r->filter_block != nullptr) {
+  if (r->filter_block != nullptr && r->compressor != nullptr) {
+    r->filter_keys.append(key.data(), key.size());
+    r->filter_key_lengths.push_back(key.size());
+  } else if (r->filter_block != nullptr) {
     r->filter_block->AddKey(key);
   }
+  if (r->full_filter_block != nullptr) {
+    r->full_filter_block->AddKey(key);
+  }
 
   r->last_key.assign(key.data(), key.size());
   r->num_entries++;
@@ -120,19 +382,133 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   }
 }
 
+void TableBuilder::AddRangeDeletion(const Slice& key, const Slice& value) {
+  Rep* r = rep_;
+  assert(!r->closed);
+  if (!ok()) return;
+  r->range_deletion_block.Add(key, value);
+}
+
 void TableBuilder::Flush() {
   Rep* r = rep_;
   assert(!r->closed);
   if (!ok()) return;
   if (r->data_block.empty()) return;
   assert(!r->pending_index_entry);
+  if (r->compressor != nullptr) {
+    ScheduleDataBlock();
+    return;
+  }
   WriteBlock(&r->data_block, &r->pending_handle);
   if (ok()) {
     r->pending_index_entry = true;
     r->status = r->file->Flush();
   }
   if (r->filter_block != nullptr) {
-    r->filter_block->StartBlock(r->offset);
+    r->filter_block->StartBlock(r->offset - r->filter_base);
+  }
+}
+
+// Hand data_block to the compressor, to be written by WritePendingBlocks().
+void TableBuilder::ScheduleDataBlock() {
+  Rep* r = rep_;
+  PendingBlock* block = new PendingBlock;
+  block->raw = r->data_block.Finish().ToString();
+  block->compression = r->options.compression;
+  block->zstd_level = r->options.zstd_compression_level;
+  block->zstd_dictionary = r->zstd_dictionary;
+  block->has_index_key = false;
+  block->filter_keys.swap(r->filter_keys);
+  block->filter_key_lengths.swap(r->filter_key_lengths);
+  if (r->collect_samples) {
+    AddDictionarySample(block->raw);
+  }
+  r->data_block.Reset();
+  r->pending_blocks.push_back(block);
+  r->compressor->Schedule(block);
+  r->pending_index_entry = true;
+  WritePendingBlocks(false);
+}
+
+// Write the pending data blocks at the front of pending_blocks that are
+// compressed and have their index key, or, if "all" (which only Finish()
+// asks for), every pending data block.  Waits for blocks to be compressed
+// if "all" or if there are too many pending blocks.  Does what Flush()
+// and Add() do for a data block when compression is not parallel.
+void TableBuilder::WritePendingBlocks(bool all) {
+  Rep* r = rep_;
+  while (!r->pending_blocks.empty()) {
+    PendingBlock* block = r->pending_blocks.front();
+    if (!all) {
+      if (!block->has_index_key) {
+        break;
+      }
+      if (r->pending_blocks.size() <= r->max_pending_blocks &&
+          !r->compressor->IsDone(block)) {
+        break;
+      }
+    }
+    r->compressor->Wait(block);
+    r->pending_blocks.pop_front();
+
+    if (ok()) {
+      if (r->filter_block != nullptr) {
+        const char* key = block->filter_keys.data();
+        for (size_t i = 0; i < block->filter_key_lengths.size(); i++) {
+          r->filter_block->AddKey(Slice(key, block->filter_key_lengths[i]));
+          key += block->filter_key_lengths[i];
+        }
+      }
+      BlockHandle handle;
+      WriteRawBlock(block->type == kNoCompression ? Slice(block->raw)
+                                                  : Slice(block->compressed),
+                    block->type, &handle);
+      if (ok()) {
+        r->status = r->file->Flush();
+      }
+      if (r->filter_block != nullptr) {
+        r->filter_block->StartBlock(r->offset - r->filter_base);
+      }
+      if (block->has_index_key) {
+        std::string handle_encoding;
+        handle.EncodeTo(&handle_encoding);
+        r->index_block.Add(block->index_key, Slice(handle_encoding));
+        if (r->partitioned &&
+            r->index_block.CurrentSizeEstimate() >= r->options.block_size) {
+          WritePartition(block->index_key);
+        }
+      } else {
+        r->pending_handle = handle;
+      }
+    }
+    delete block;
+  }
+}
+
+// Write out the current index partition, and the filter partition that
+// covers the same data blocks, and point top_index_block at them.  The
+// top-level index value is the index partition handle, followed by the
+// filter partition handle and filter base if there is a filter.
+// "last_key" is the index key of the last data block of the partition.
+void TableBuilder::WritePartition(const Slice& last_key) {
+  Rep* r = rep_;
+  if (!ok()) return;
+  BlockHandle index_handle;
+  WriteBlock(&r->index_block, &index_handle);
+  std::string handle_encoding;
+  index_handle.EncodeTo(&handle_encoding);
+  if (ok() && r->filter_block != nullptr) {
+    BlockHandle filter_handle;
+    WriteRawBlock(r->filter_block->Finish(), kNoCompression, &filter_handle);
+    filter_handle.EncodeTo(&handle_encoding);
+    PutVarint64(&handle_encoding, r->filter_base);
+    delete r->filter_block;
+    r->filter_block = new FilterBlockBuilder(r->options.filter_policy);
+    r->filter_base = r->offset;
+    r->filter_block->StartBlock(0);
+  }
+  if (ok()) {
+    r->top_index_block.Add(last_key, Slice(handle_encoding));
   }
 }
 
@@ -145,31 +521,45 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
   Rep* r = rep_;
   Slice raw = block->Finish();
 
-  Slice block_contents;
-  CompressionType type = r->options.compression;
-  // TODO(postrelease): Support more compression options: zlib?
-  switch (type) {
-    case kNoCompression:
-      block_contents = raw;
-      break;
+  // Only data blocks use the zstd dictionary, so that the index and
+  // metaindex can be read before it.
+  const void* zstd_dictionary =
+      (block == &r->data_block) ? r->zstd_dictionary : nullptr;
+  const CompressionType type = CompressBlock(
+      r->options.compression, r->options.zstd_compression_level,
+      zstd_dictionary, raw, &r->compressed_output);
+  WriteRawBlock(type == kNoCompression ? raw : Slice(r->compressed_output),
+                type, handle);
+  r->compressed_output.clear();
+  if (block == &r->data_block && r->collect_samples) {
+    AddDictionarySample(raw);
+  }
+  block->Reset();
+}
 
-    case kSnappyCompression: {
-      std::string* compressed = &r->compressed_output;
-      if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
-          compressed->size() < raw.size() - (raw.size() / 8u)) {
-        block_contents = *compressed;
-      } else {
-        // Snappy not supported, or compressed less than 12.5%, so just
-        // store uncompressed form
-        block_contents = raw;
-        type = kNoCompression;
-      }
-      break;
+void TableBuilder::AddDictionarySample(const Slice& raw) {
+  Rep* r = rep_;
+  r->samples.append(raw.data(), raw.size());
+  r->sample_lengths.push_back(raw.size());
+  const size_t max_bytes = r->options.zstd_max_dictionary_bytes;
+  if (r->samples.size() < kDictionarySampleRatio * max_bytes) {
+    return;
+  }
+  // A table gets a single try, so that a failure to train (e.g. on
+  // data that is too uniform) does not cost the time again.
+  if (port::Zstd_TrainDictionary(r->samples.data(), &r->sample_lengths[0],
+                                 r->sample_lengths.size(), max_bytes,
+                                 &r->dictionary)) {
+    r->zstd_dictionary = port::Zstd_NewCompressionDictionary(
+        r->dictionary.data(), r->dictionary.size(),
+        r->options.zstd_compression_level);
+    if (r->zstd_dictionary == nullptr) {
+      r->dictionary.clear();
     }
   }
-  WriteRawBlock(block_contents, type, handle);
-  r->compressed_output.clear();
-  block->Reset();
+  r->collect_samples = false;
+  std::string().swap(r->samples);
+  std::vector<size_t>().swap(r->sample_lengths);
 }
 
 void TableBuilder::WriteRawBlock(const Slice& block_contents,
@@ -199,21 +589,64 @@ Status TableBuilder::status() const {
 Status TableBuilder::Finish() {
   Rep* r = rep_;
   Flush();
+  if (r->compressor != nullptr) {
+    WritePendingBlocks(true);
+  }
   assert(!r->closed);
   r->closed = true;
 
   BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle dictionary_handle, range_deletion_handle;
 
-  // Write filter block
-  if (ok() && r->filter_block != nullptr) {
+  if (r->partitioned) {
+    // Write the last index and filter partitions
+    if (ok() && r->pending_index_entry) {
+      r->options.comparator->FindShortSuccessor(&r->last_key);
+      std::string handle_encoding;
+      r->pending_handle.EncodeTo(&handle_encoding);
+      r->index_block.Add(r->last_key, Slice(handle_encoding));
+      r->pending_index_entry = false;
+    }
+    if (!r->index_block.empty()) {
+      WritePartition(r->last_key);
+    }
+  } else if (ok() && r->filter_block != nullptr) {
+    // Write filter block
     WriteRawBlock(r->filter_block->Finish(), kNoCompression,
                   &filter_block_handle);
   }
+  if (ok() && r->full_filter_block != nullptr) {
+    WriteRawBlock(r->full_filter_block->Finish(), kNoCompression,
+                  &filter_block_handle);
+  }
+  if (ok() && !r->dictionary.empty()) {
+    WriteRawBlock(r->dictionary, kNoCompression, &dictionary_handle);
+  }
+  const bool has_range_deletions = !r->range_deletion_block.empty();
+  if (ok() && has_range_deletions) {
+    WriteBlock(&r->range_deletion_block, &range_deletion_handle);
+  }
 
   // Write metaindex block
   if (ok()) {
-    BlockBuilder meta_index_block(&r->options);
-    if (r->filter_block != nullptr) {
+    // The metaindex keys are plain strings, not internal keys.
+    Options meta_index_options = r->index_block_options;
+    meta_index_options.comparator = BytewiseComparator();
+    BlockBuilder meta_index_block(&meta_index_options);
+    if (r->filter_block != nullptr && r->partitioned) {
+      // Filter partitions are found through the top-level index; the
+      // metaindex only records which policy built them.
+      std::string key = "partitionedfilter.";
+      key.append(r->options.filter_policy->Name());
+      meta_index_block.Add(key, Slice());
+    } else if (r->full_filter_block != nullptr) {
+      // Add mapping from "fullfilter.Name" to location of the filter
+      std::string key = "fullfilter.";
+      key.append(r->options.filter_policy->Name());
+      std::string handle_encoding;
+      filter_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(key, handle_encoding);
+    } else if (r->filter_block != nullptr) {
       // Add mapping from "filter.Name" to location of filter data
       std::string key = "filter.";
       key.append(r->options.filter_policy->Name());
@@ -221,13 +654,36 @@ Status TableBuilder::Finish() {
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
+    if (r->options.prefix_extractor != nullptr &&
+        (r->filter_block != nullptr || r->full_filter_block != nullptr)) {
+      // The filter also holds the prefixes of the keys, as taken by the
+      // extractor that "prefix.Name" names
+      std::string key = "prefix.";
+      key.append(r->options.prefix_extractor->Name());
+      meta_index_block.Add(key, Slice());
+    }
+    if (has_range_deletions) {
+      // Add mapping from "rangedel" to the range deletion block
+      std::string handle_encoding;
+      range_deletion_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add("rangedel", handle_encoding);
+    }
+    if (!r->dictionary.empty()) {
+      // Add mapping from "zstd.dictionary" to the dictionary that data
+      // blocks were compressed with
+      std::string handle_encoding;
+      dictionary_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add("zstd.dictionary", handle_encoding);
+    }
 
     // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
   }
 
   // Write index block
-  if (ok()) {
+  if (ok() && r->partitioned) {
+    WriteBlock(&r->top_index_block, &index_block_handle);
+  } else if (ok()) {
     if (r->pending_index_entry) {
       r->options.comparator->FindShortSuccessor(&r->last_key);
       std::string handle_encoding;
@@ -243,6 +699,7 @@ Status TableBuilder::Finish() {
     Footer footer;
     footer.set_metaindex_handle(metaindex_block_handle);
     footer.set_index_handle(index_block_handle);
+    footer.set_partitioned_index(r->partitioned);
     std::string footer_encoding;
     footer.EncodeTo(&footer_encoding);
     r->status = r->file->Append(footer_encoding);
@@ -9,13 +9,19 @@
 #include "db/dbformat.h"
 #include "db/memtable.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/cache.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
+#include "leveldb/memtable_factory.h"
 #include "leveldb/table_builder.h"
 #include "table/block.h"
 #include "table/block_builder.h"
 #include "table/format.h"
+#include "table/merger.h"
+#include "util/hash.h"
+#include "util/logging.h"
 #include "util/random.h"
 #include "util/testharness.h"
 #include "util/testutil.h"
@@ -110,7 +116,10 @@ class StringSink: public WritableFile {
 class StringSource: public RandomAccessFile {
  public:
   StringSource(const Slice& contents)
-      : contents_(contents.data(), contents.size()) {
+      : contents_(contents.data(), contents.size()),
+        read_calls_(0),
+        prefetch_calls_(0),
+        prefetched_bytes_(0) {
   }
 
   virtual ~StringSource() { }
@@ -125,13 +134,30 @@ class StringSource: public RandomAccessFile {
     if (offset + n > contents_.size()) {
       n = contents_.size() - offset;
     }
+    read_calls_++;
     memcpy(scratch, &contents_[offset], n);
     *result = Slice(scratch, n);
     return Status::OK();
   }
 
+  virtual void Prefetch(uint64_t offset, size_t n) const {
+    prefetch_calls_++;
+    prefetched_bytes_ += n;
+  }
+
+  int read_calls() const { return read_calls_; }
+  int prefetch_calls() const { return prefetch_calls_; }
+  uint64_t prefetched_bytes() const { return prefetched_bytes_; }
+  void ResetPrefetchStats() {
+    prefetch_calls_ = 0;
+    prefetched_bytes_ = 0;
+  }
+
  private:
   std::string contents_;
+  mutable int read_calls_;
+  mutable int prefetch_calls_;
+  mutable uint64_t prefetched_bytes_;
 };
 
 typedef std::map<std::string, std::string, STLLessThan> KVMap;
@@ -218,6 +244,56 @@ class BlockConstructor: public Constructor {
   BlockConstructor();
 };
 
+// Spreads the data over several blocks and merges them back together.
+class MergerConstructor: public Constructor {
+ public:
+  explicit MergerConstructor(const Comparator* cmp)
+      : Constructor(cmp),
+        comparator_(cmp) {
+    for (int i = 0; i < kNumChildren; i++) {
+      children_[i] = new BlockConstructor(cmp);
+    }
+  }
+  ~MergerConstructor() {
+    for (int i = 0; i < kNumChildren; i++) {
+      delete children_[i];
+    }
+  }
+  virtual Status FinishImpl(const Options& options, const KVMap& data) {
+    std::vector<KVMap> parts(kNumChildren, KVMap(STLLessThan(comparator_)));
+    for (KVMap::const_iterator it = data.begin();
+         it != data.end();
+         ++it) {
+      const uint32_t h = Hash(it->first.data(), it->first.size(), 0);
+      parts[h % kNumChildren][it->first] = it->second;
+    }
+    for (int i = 0; i < kNumChildren; i++) {
+      Status s = children_[i]->FinishImpl(options, parts[i]);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    return Status::OK();
+  }
+  virtual Iterator* NewIterator() const {
+    Iterator* list[kNumChildren];
+    for (int i = 0; i < kNumChildren; i++) {
+      list[i] = children_[i]->NewIterator();
+    }
+    return NewMergingIterator(comparator_, list, kNumChildren);
+  }
+
+ private:
+  // Not a power of two, so that the merge has children of its own that
+  // never hold any data.
+  enum { kNumChildren = 5 };
+
+  const Comparator* comparator_;
+  BlockConstructor* children_[kNumChildren];
+
+  MergerConstructor();
+};
+
 class TableConstructor: public Constructor {
  public:
   TableConstructor(const Comparator* cmp)
@@ -254,10 +330,16 @@ class TableConstructor: public Constructor {
     return table_->NewIterator(ReadOptions());
   }
 
+  Iterator* NewIterator(const ReadOptions& options) const {
+    return table_->NewIterator(options);
+  }
+
   uint64_t ApproximateOffsetOf(const Slice& key) const {
     return table_->ApproximateOffsetOf(key);
   }
 
+  StringSource* source() const { return source_; }
+
  private:
   void Reset() {
     delete table_;
@@ -315,18 +397,21 @@ class KeyConvertingIterator: public Iterator {
 
 class MemTableConstructor: public Constructor {
  public:
-  explicit MemTableConstructor(const Comparator* cmp)
+  // Takes ownership of "factory", which may be null.
+  MemTableConstructor(const Comparator* cmp, const MemTableFactory* factory)
       : Constructor(cmp),
-        internal_comparator_(cmp) {
-    memtable_ = new MemTable(internal_comparator_);
+        internal_comparator_(cmp),
+        factory_(factory) {
+    memtable_ = new MemTable(internal_comparator_, factory_);
     memtable_->Ref();
   }
   ~MemTableConstructor() {
     memtable_->Unref();
+    delete factory_;
   }
   virtual Status FinishImpl(const Options& options, const KVMap& data) {
     memtable_->Unref();
-    memtable_ = new MemTable(internal_comparator_);
+    memtable_ = new MemTable(internal_comparator_, factory_);
     memtable_->Ref();
     int seq = 1;
     for (KVMap::const_iterator it = data.begin();
@@ -343,6 +428,7 @@ class MemTableConstructor: public Constructor {
 
  private:
   InternalKeyComparator internal_comparator_;
+  const MemTableFactory* factory_;
   MemTable* memtable_;
 };
 
@@ -399,7 +485,9 @@ class DBConstructor: public Constructor {
 enum TestType {
   TABLE_TEST,
   BLOCK_TEST,
+  MERGER_TEST,
   MEMTABLE_TEST,
+  HASH_MEMTABLE_TEST,
   DB_TEST
 };
 
@@ -407,30 +495,45 @@ struct TestArgs {
   TestType type;
   bool reverse_compare;
   int restart_interval;
+  bool data_block_hash_index;
+  bool partition_index_and_filters;
 };
 
 static const TestArgs kTestArgList[] = {
-  { TABLE_TEST, false, 16 },
-  { TABLE_TEST, false, 1 },
-  { TABLE_TEST, false, 1024 },
-  { TABLE_TEST, true, 16 },
-  { TABLE_TEST, true, 1 },
-  { TABLE_TEST, true, 1024 },
-
-  { BLOCK_TEST, false, 16 },
-  { BLOCK_TEST, false, 1 },
-  { BLOCK_TEST, false, 1024 },
-  { BLOCK_TEST, true, 16 },
-  { BLOCK_TEST, true, 1 },
-  { BLOCK_TEST, true, 1024 },
+  { TABLE_TEST, false, 16, false, false },
+  { TABLE_TEST, false, 1, false, false },
+  { TABLE_TEST, false, 1024, false, false },
+  { TABLE_TEST, true, 16, false, false },
+  { TABLE_TEST, true, 1, false, false },
+  { TABLE_TEST, true, 1024, false, false },
+  { TABLE_TEST, false, 16, true, false },
+  { TABLE_TEST, true, 16, true, false },
+  { TABLE_TEST, false, 16, false, true },
+  { TABLE_TEST, true, 1, false, true },
+  { TABLE_TEST, false, 16, true, true },
+
+  { BLOCK_TEST, false, 16, false, false },
+  { BLOCK_TEST, false, 1, false, false },
+  { BLOCK_TEST, false, 1024, false, false },
+  { BLOCK_TEST, true, 16, false, false },
+  { BLOCK_TEST, true, 1, false, false },
+  { BLOCK_TEST, true, 1024, false, false },
+  { BLOCK_TEST, false, 16, true, false },
+  { BLOCK_TEST, false, 1, true, false },
+
+  { MERGER_TEST, false, 16, false, false },
+  { MERGER_TEST, false, 1, false, false },
+  { MERGER_TEST, true, 16, false, false },
 
   // Restart interval does not matter for memtables
-  { MEMTABLE_TEST, false, 16 },
-  { MEMTABLE_TEST, true, 16 },
+  { MEMTABLE_TEST, false, 16, false, false },
+  { MEMTABLE_TEST, true, 16, false, false },
+  { HASH_MEMTABLE_TEST, false, 16, false, false },
+  { HASH_MEMTABLE_TEST, true, 16, false, false },
 
   // Do not bother with restart interval variations for DB
-  { DB_TEST, false, 16 },
-  { DB_TEST, true, 16 },
+  { DB_TEST, false, 16, false, false },
+  { DB_TEST, true, 16, false, false },
 };
 static const int kNumTestArgs = sizeof(kTestArgList) / sizeof(kTestArgList[0]);
 
@@ -444,6 +547,8 @@ class Harness {
     options_ = Options();
 
     options_.block_restart_interval = args.restart_interval;
+    options_.data_block_hash_index = args.data_block_hash_index;
+    options_.partition_index_and_filters = args.partition_index_and_filters;
     // Use shorter block size for tests to exercise block boundary
     // conditions more.
     options_.block_size = 256;
@@ -457,8 +562,16 @@ class Harness {
       case BLOCK_TEST:
         constructor_ = new BlockConstructor(options_.comparator);
         break;
+      case MERGER_TEST:
+        constructor_ = new MergerConstructor(options_.comparator);
+        break;
       case MEMTABLE_TEST:
-        constructor_ = new MemTableConstructor(options_.comparator);
+        constructor_ = new MemTableConstructor(options_.comparator, nullptr);
+        break;
+      case HASH_MEMTABLE_TEST:
+        // Few buckets, so that most buckets hold several user keys.
+        constructor_ = new MemTableConstructor(options_.comparator,
+                                               NewHashMemTableFactory(7));
         break;
       case DB_TEST:
         constructor_ = new DBConstructor(options_.comparator);
@@ -735,7 +848,7 @@ TEST(Harness, Randomized) {
 
 TEST(Harness, RandomizedLongDB) {
   Random rnd(test::RandomSeed());
-  TestArgs args = { DB_TEST, false, 16 };
+  TestArgs args = { DB_TEST, false, 16, false, false };
   Init(args);
   int num_entries = 100000;
   for (int e = 0; e < num_entries; e++) {
@@ -757,6 +870,110 @@ TEST(Harness, RandomizedLongDB) {
   ASSERT_GT(files, 0);
 }
 
+class BlockHashIndexTest { };
+
+// Build a block of internal keys, several versions per user key, and
+// check that point lookups through the hash index find the same entry
+// as a regular Seek() whenever the user key is present.
+static void CheckBlockHashIndex(int num_user_keys, int restart_interval) {
+  InternalKeyComparator icmp(BytewiseComparator());
+  Options options;
+  options.comparator = &icmp;
+  options.block_restart_interval = restart_interval;
+  options.data_block_hash_index = true;
+
+  BlockBuilder builder(&options);
+  Random rnd(301);
+  for (int i = 0; i < num_user_keys; i++) {
+    char user_key[20];
+    snprintf(user_key, sizeof(user_key), "key%06d", 2 * i);
+    const int versions = 1 + rnd.Uniform(3);
+    for (int v = versions; v > 0; v--) {
+      std::string ikey;
+      AppendInternalKey(&ikey,
+                        ParsedInternalKey(user_key, 10 * v, kTypeValue));
+      builder.Add(ikey, test::RandomKey(&rnd, 8));
+    }
+  }
+  std::string data = builder.Finish().ToString();
+  BlockContents contents;
+  contents.data = data;
+  contents.cachable = false;
+  contents.heap_allocated = false;
+  Block block(contents);
+
+  Iterator* plain = block.NewIterator(&icmp);
+  Iterator* lookup = block.NewPointLookupIterator(&icmp);
+  for (int i = 0; i < 2 * num_user_keys; i++) {
+    char user_key[20];
+    snprintf(user_key, sizeof(user_key), "key%06d", i);
+    for (SequenceNumber seq = 5; seq <= 45; seq += 10) {
+      std::string target;
+      AppendInternalKey(&target,
+                        ParsedInternalKey(user_key, seq, kValueTypeForSeek));
+      plain->Seek(target);
+      lookup->Seek(target);
+      if (plain->Valid() && ExtractUserKey(plain->key()) == user_key) {
+        ASSERT_TRUE(lookup->Valid());
+        ASSERT_EQ(plain->key().ToString(), lookup->key().ToString());
+        ASSERT_EQ(plain->value().ToString(), lookup->value().ToString());
+      } else if (lookup->Valid()) {
+        // The user key is not in the block, so a lookup must not claim it.
+        ASSERT_TRUE(ExtractUserKey(lookup->key()) != user_key);
+      }
+      ASSERT_OK(lookup->status());
+    }
+  }
+  delete plain;
+  delete lookup;
+}
+
+TEST(BlockHashIndexTest, PointLookup) {
+  CheckBlockHashIndex(100, 16);
+  CheckBlockHashIndex(100, 4);
+  CheckBlockHashIndex(1, 16);
+}
+
+TEST(BlockHashIndexTest, TooManyRestarts) {
+  // Restart indexes do not fit in a bucket, so the block has no index.
+  CheckBlockHashIndex(400, 1);
+}
+
+TEST(BlockHashIndexTest, BlocksWithoutIndex) {
+  // Blocks written without the option must still serve point lookups.
+  InternalKeyComparator icmp(BytewiseComparator());
+  Options options;
+  options.comparator = &icmp;
+  BlockBuilder plain_builder(&options);
+  options.data_block_hash_index = true;
+  BlockBuilder hash_builder(&options);
+  for (int i = 0; i < 50; i++) {
+    std::string ikey;
+    AppendInternalKey(&ikey, ParsedInternalKey("k" + NumberToString(100 + i),
+                                               1, kTypeValue));
+    plain_builder.Add(ikey, "v");
+    hash_builder.Add(ikey, "v");
+  }
+  ASSERT_GT(hash_builder.CurrentSizeEstimate(),
+            plain_builder.CurrentSizeEstimate());
+  std::string data = plain_builder.Finish().ToString();
+  ASSERT_GT(hash_builder.Finish().size(), data.size());
+
+  BlockContents contents;
+  contents.data = data;
+  contents.cachable = false;
+  contents.heap_allocated = false;
+  Block block(contents);
+  Iterator* iter = block.NewPointLookupIterator(&icmp);
+  for (int i = 0; i < 50; i++) {
+    std::string user_key = "k" + NumberToString(100 + i);
+    iter->Seek(LookupKey(user_key, 5).internal_key());
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(user_key, ExtractUserKey(iter->key()).ToString());
+  }
+  delete iter;
+}
+
 class MemTableTest { };
 
 TEST(MemTableTest, Simple) {
@@ -827,14 +1044,37 @@ TEST(TableTest, ApproximateOffsetOfPlain) {
 
 }
 
-static bool SnappyCompressionSupported() {
-  std::string out;
-  Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
-  return port::Snappy_Compress(in.data(), in.size(), &out);
+TEST(TableTest, ApproximateOffsetOfPartitioned) {
+  TableConstructor c(BytewiseComparator());
+  c.Add("k01", "hello");
+  c.Add("k02", "hello2");
+  c.Add("k03", std::string(10000, 'x'));
+  c.Add("k04", std::string(200000, 'x'));
+  c.Add("k05", std::string(300000, 'x'));
+  c.Add("k06", "hello3");
+  c.Add("k07", std::string(100000, 'x'));
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 16;  // One entry per block and index partition
+  options.compression = kNoCompression;
+  options.partition_index_and_filters = true;
+  c.Finish(options, &keys, &kvmap);
+
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("abc"),       0,      0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k01"),       0,      0));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k02"),       1,    100));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k03"),       1,    200));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k04"),   10000,  11000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k04a"), 210000, 211000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k05"),  210000, 211000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k06"),  510000, 511000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("k07"),  510000, 511000));
+  ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"),  610000, 612000));
 }
 
 TEST(TableTest, ApproximateOffsetOfCompressed) {
-  if (!SnappyCompressionSupported()) {
+  if (!test::SnappyCompressionSupported()) {
     fprintf(stderr, "skipping compression tests\n");
     return;
   }
@@ -869,6 +1109,235 @@ TEST(TableTest, ApproximateOffsetOfCompressed) {
   ASSERT_TRUE(Between(c.ApproximateOffsetOf("xyz"), 2 * min_z, 2 * max_z));
 }
 
+// Check that a table built from "kvmap" with "options" holds exactly the
+// entries of "kvmap", and return the size of its data.
+static uint64_t CheckTable(const Options& options, const KVMap& kvmap) {
+  TableConstructor c(BytewiseComparator());
+  for (KVMap::const_iterator it = kvmap.begin(); it != kvmap.end(); ++it) {
+    c.Add(it->first, it->second);
+  }
+  std::vector<std::string> keys;
+  KVMap data;
+  c.Finish(options, &keys, &data);
+
+  Iterator* iter = c.NewIterator();
+  iter->SeekToFirst();
+  for (KVMap::const_iterator it = kvmap.begin(); it != kvmap.end(); ++it) {
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(it->first, iter->key().ToString());
+    ASSERT_EQ(it->second, iter->value().ToString());
+    iter->Next();
+  }
+  ASSERT_TRUE(!iter->Valid());
+  ASSERT_OK(iter->status());
+  delete iter;
+  return c.ApproximateOffsetOf("\xff");
+}
+
+TEST(TableTest, ZstdAndLZ4Compression) {
+  Random rnd(301);
+  KVMap kvmap;
+  std::string tmp;
+  for (int i = 0; i < 100; i++) {
+    char key[10];
+    snprintf(key, sizeof(key), "k%03d", i);
+    kvmap[key] = test::CompressibleString(&rnd, 0.25, 1000, &tmp).ToString();
+  }
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  const uint64_t plain_size = CheckTable(options, kvmap);
+
+  const CompressionType types[] = { kZstdCompression, kLZ4Compression };
+  const bool supported[] = { test::ZstdCompressionSupported(),
+                             test::LZ4CompressionSupported() };
+  for (int t = 0; t < 2; t++) {
+    options.compression = types[t];
+    const uint64_t size = CheckTable(options, kvmap);
+    if (supported[t]) {
+      ASSERT_LT(size, plain_size / 2);
+    } else {
+      // Blocks are stored uncompressed
+      ASSERT_EQ(size, plain_size);
+    }
+  }
+}
+
+TEST(TableTest, ZstdDictionary) {
+  if (!test::ZstdCompressionSupported()) {
+    fprintf(stderr, "skipping compression tests\n");
+    return;
+  }
+
+  // Small records that share most of their text with each other, but
+  // little with the other records of their block.
+  Random rnd(301);
+  KVMap kvmap;
+  for (int i = 0; i < 4000; i++) {
+    char key[20];
+    char value[200];
+    snprintf(key, sizeof(key), "user%06d", i);
+    snprintf(value, sizeof(value),
+             "{\"name\":\"%s\",\"email\":\"%s@example.com\","
+             "\"age\":%d,\"active\":%s,\"plan\":\"%s\"}",
+             key, key, 18 + static_cast<int>(rnd.Uniform(60)),
+             rnd.OneIn(2) ? "true" : "false",
+             rnd.OneIn(3) ? "premium" : "basic");
+    kvmap[key] = value;
+  }
+  Options options;
+  options.block_size = 256;
+  options.compression = kZstdCompression;
+  const uint64_t size = CheckTable(options, kvmap);
+  options.zstd_max_dictionary_bytes = 4096;
+  const uint64_t dictionary_size = CheckTable(options, kvmap);
+  ASSERT_LT(dictionary_size, size * 3 / 4);
+}
+
+static std::string BuildTableContents(const Options& options,
+                                      const KVMap& kvmap) {
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  for (KVMap::const_iterator it = kvmap.begin(); it != kvmap.end(); ++it) {
+    builder.Add(it->first, it->second);
+  }
+  ASSERT_OK(builder.Finish());
+  return sink.contents();
+}
+
+TEST(TableTest, ParallelCompression) {
+  Random rnd(301);
+  KVMap kvmap;
+  std::string tmp;
+  for (int i = 0; i < 5000; i++) {
+    char key[20];
+    snprintf(key, sizeof(key), "key%06d", i);
+    kvmap[key] = test::CompressibleString(&rnd, 0.5, 100, &tmp).ToString();
+  }
+  const FilterPolicy* filter_policy = NewBloomFilterPolicy(10);
+  const CompressionType types[] = {
+    kSnappyCompression, kZstdCompression, kLZ4Compression
+  };
+  for (int t = 0; t < 3; t++) {
+    for (int layout = 0; layout < 4; layout++) {
+      Options options;
+      options.block_size = 512;
+      options.compression = types[t];
+      options.zstd_max_dictionary_bytes = 1024;
+      if (layout >= 1) {
+        options.filter_policy = filter_policy;
+      }
+      options.partition_index_and_filters = (layout == 2);
+      options.whole_table_filter = (layout == 3);
+      const std::string serial = BuildTableContents(options, kvmap);
+      for (int threads = 2; threads <= 8; threads *= 2) {
+        options.parallel_compression_threads = threads;
+        // The table comes out the same, byte for byte.
+        ASSERT_TRUE(BuildTableContents(options, kvmap) == serial)
+            << "compression " << types[t] << " layout " << layout
+            << " threads " << threads;
+      }
+    }
+  }
+  delete filter_policy;
+}
+
+static int ScanTable(Iterator* iter) {
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  delete iter;
+  return count;
+}
+
+TEST(TableTest, CompressedBlockCache) {
+  if (!test::SnappyCompressionSupported()) {
+    fprintf(stderr, "skipping compression tests\n");
+    return;
+  }
+  KVMap kvmap;
+  for (int i = 0; i < 100; i++) {
+    char key[10];
+    snprintf(key, sizeof(key), "k%03d", i);
+    kvmap[key] = std::string(1000, 'a' + i % 26);
+  }
+  Options options;
+  options.block_size = 1024;  // Two entries per block
+
+  for (int compressed = 0; compressed < 2; compressed++) {
+    options.compression = compressed ? kSnappyCompression : kNoCompression;
+    const std::string contents = BuildTableContents(options, kvmap);
+    StringSource source(contents);
+    Options table_options;
+    table_options.block_cache = NewLRUCache(0);  // Every block misses it
+    table_options.block_cache_compressed = NewLRUCache(1 << 20);
+    Table* table;
+    ASSERT_OK(Table::Open(table_options, &source, contents.size(), &table));
+
+    // The first scan reads every block from the file.  If the blocks are
+    // compressed, they stay in the compressed cache for the second scan.
+    const int before = source.read_calls();
+    ASSERT_EQ(100, ScanTable(table->NewIterator(ReadOptions())));
+    ASSERT_GE(source.read_calls() - before, 50);
+    const int middle = source.read_calls();
+    ASSERT_EQ(100, ScanTable(table->NewIterator(ReadOptions())));
+    const size_t charge = table_options.block_cache_compressed->TotalCharge();
+    if (compressed) {
+      ASSERT_EQ(middle, source.read_calls());
+      ASSERT_GT(charge, 0);
+      ASSERT_LT(charge, 100 * 1000 / 4);
+    } else {
+      ASSERT_GE(source.read_calls() - middle, 50);
+      ASSERT_EQ(0, charge);
+    }
+
+    delete table;
+    delete table_options.block_cache;
+    delete table_options.block_cache_compressed;
+  }
+}
+
+TEST(TableTest, Readahead) {
+  TableConstructor c(BytewiseComparator());
+  for (int i = 0; i < 100; i++) {
+    char key[10];
+    snprintf(key, sizeof(key), "k%03d", i);
+    c.Add(key, std::string(1000, 'x'));
+  }
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;  // One entry per block
+  options.compression = kNoCompression;
+  c.Finish(options, &keys, &kvmap);
+  StringSource* source = c.source();
+
+  // Nothing is prefetched unless asked for.
+  ReadOptions read_options;
+  ASSERT_EQ(100, ScanTable(c.NewIterator(read_options)));
+  ASSERT_EQ(0, source->prefetch_calls());
+
+  // Seeks that jump around the table do not prefetch.
+  read_options.readahead_size = 8192;
+  Iterator* iter = c.NewIterator(read_options);
+  iter->Seek("k050");
+  iter->Seek("k010");
+  iter->Seek("k090");
+  iter->Seek("k030");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("k030", iter->key().ToString());
+  delete iter;
+  ASSERT_EQ(0, source->prefetch_calls());
+
+  // A scan prefetches everything after its first two blocks, about half
+  // a window at a time.
+  ASSERT_EQ(100, ScanTable(c.NewIterator(read_options)));
+  ASSERT_GE(source->prefetched_bytes(), 98 * 1000);
+  ASSERT_GE(source->prefetch_calls(), 100 * 1000 / 8192);
+  ASSERT_LE(source->prefetch_calls(), 100 * 1100 / 4096 + 2);
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
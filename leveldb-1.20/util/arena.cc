@@ -4,6 +4,9 @@
 
 #include "util/arena.h"
 #include <assert.h>
+#include <functional>
+#include <thread>
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -57,8 +60,37 @@ char* Arena::AllocateAligned(size_t bytes) {
   return result;
 }
 
+char* Arena::AllocateConcurrently(size_t bytes) {
+  const int align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+  if (bytes > kBlockSize / 4) {
+    // Large objects get a block of their own, as in AllocateFallback().
+    return AllocateNewBlock(bytes);
+  }
+
+  const size_t hash = std::hash<std::thread::id>()(std::this_thread::get_id());
+  Shard* shard = &shards_[hash % kNumShards];
+  MutexLock l(&shard->mu);
+  size_t current_mod =
+      reinterpret_cast<uintptr_t>(shard->alloc_ptr) & (align-1);
+  size_t slop = (current_mod == 0 ? 0 : align - current_mod);
+  size_t needed = bytes + slop;
+  if (needed > shard->alloc_bytes_remaining) {
+    // We waste the remaining space in the shard's current block.
+    shard->alloc_ptr = AllocateNewBlock(kBlockSize);
+    shard->alloc_bytes_remaining = kBlockSize;
+    slop = 0;
+    needed = bytes;
+  }
+  char* result = shard->alloc_ptr + slop;
+  shard->alloc_ptr += needed;
+  shard->alloc_bytes_remaining -= needed;
+  assert((reinterpret_cast<uintptr_t>(result) & (align-1)) == 0);
+  return result;
+}
+
 char* Arena::AllocateNewBlock(size_t block_bytes) {
   char* result = new char[block_bytes];
+  MutexLock l(&blocks_mu_);
   blocks_.push_back(result);
   memory_usage_.NoBarrier_Store(
       reinterpret_cast<void*>(MemoryUsage() + block_bytes + sizeof(char*)));
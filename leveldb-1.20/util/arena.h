@@ -24,6 +24,12 @@ class Arena {
   // Allocate memory with the normal alignment guarantees provided by malloc
   char* AllocateAligned(size_t bytes);
 
+  // Like AllocateAligned(), but may be called from several threads at
+  // once.  Each thread carves its allocations out of a block of its own
+  // shard, so threads rarely contend.  Must not be called concurrently
+  // with Allocate() or AllocateAligned().
+  char* AllocateConcurrently(size_t bytes);
+
   // Returns an estimate of the total memory usage of data allocated
   // by the arena.
   size_t MemoryUsage() const {
@@ -38,6 +44,20 @@ class Arena {
   char* alloc_ptr_;
   size_t alloc_bytes_remaining_;
 
+  // Allocation state used by AllocateConcurrently()
+  enum { kNumShards = 8 };
+  struct Shard {
+    port::Mutex mu;
+    char* alloc_ptr GUARDED_BY(mu);
+    size_t alloc_bytes_remaining GUARDED_BY(mu);
+
+    Shard() : alloc_ptr(nullptr), alloc_bytes_remaining(0) { }
+  };
+  Shard shards_[kNumShards];
+
+  // Protects blocks_ against concurrent AllocateNewBlock() calls
+  port::Mutex blocks_mu_;
+
   // Array of new[] allocated memory blocks
   std::vector<char*> blocks_;
 
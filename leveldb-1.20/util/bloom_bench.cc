@@ -0,0 +1,111 @@
+// Copyright (c) 2012 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+// Compares the false positive rate and lookup cost of the bloom filter
+// policies on a filter that is larger than most processor caches.  The
+// lookups are for keys that were not added, in an order that defeats the
+// cache, as the lookups of a DB for missing keys are.
+//
+// For each number of bits per key, prints the false positive rate, the
+// time per lookup and the filter size of each policy.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+
+// Comma-separated list of the numbers of bits per key to measure.
+static const char* FLAGS_bits_per_key = "6,10,14";
+
+// Number of keys added to each filter.
+static int FLAGS_num_keys = 1000000;
+
+// Number of lookups of keys that were not added.
+static int FLAGS_lookups = 1000000;
+
+namespace leveldb {
+
+namespace {
+
+Slice Key(int i, char* buffer) {
+  EncodeFixed32(buffer, i);
+  return Slice(buffer, sizeof(uint32_t));
+}
+
+void Run(const char* name, const FilterPolicy* policy) {
+  char buffer[sizeof(int)];
+  std::vector<std::string> keys;
+  keys.reserve(FLAGS_num_keys);
+  for (int i = 0; i < FLAGS_num_keys; i++) {
+    keys.push_back(Key(i, buffer).ToString());
+  }
+  std::vector<Slice> key_slices(keys.begin(), keys.end());
+  std::string filter;
+  policy->CreateFilter(&key_slices[0], FLAGS_num_keys, &filter);
+
+  int matches = 0;
+  const uint64_t start = Env::Default()->NowMicros();
+  for (int i = 0; i < FLAGS_lookups; i++) {
+    const int k = 1000000000 + static_cast<int>((i * 2654435761u) % 100000000);
+    if (policy->KeyMayMatch(Key(k, buffer), filter)) {
+      matches++;
+    }
+  }
+  const uint64_t elapsed = Env::Default()->NowMicros() - start;
+  fprintf(stdout, "%-14s: %5.2f%% false positives; %6.1f ns/lookup; "
+          "%d bytes\n", name, matches * 100.0 / FLAGS_lookups,
+          elapsed * 1000.0 / FLAGS_lookups, static_cast<int>(filter.size()));
+  fflush(stdout);
+}
+
+}  // namespace
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    int n;
+    char junk;
+    if (leveldb::Slice(argv[i]).starts_with("--bits_per_key=")) {
+      FLAGS_bits_per_key = argv[i] + strlen("--bits_per_key=");
+    } else if (sscanf(argv[i], "--num_keys=%d%c", &n, &junk) == 1 && n > 0) {
+      FLAGS_num_keys = n;
+    } else if (sscanf(argv[i], "--lookups=%d%c", &n, &junk) == 1 && n > 0) {
+      FLAGS_lookups = n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      exit(1);
+    }
+  }
+
+  fprintf(stdout, "Keys:       %d added, %d looked up\n",
+          FLAGS_num_keys, FLAGS_lookups);
+  fprintf(stdout, "------------------------------------------------\n");
+
+  const char* bits = FLAGS_bits_per_key;
+  while (bits != nullptr && *bits != '\0') {
+    const int bits_per_key = atoi(bits);
+    if (bits_per_key > 0) {
+      fprintf(stdout, "%d bits per key\n", bits_per_key);
+      const leveldb::FilterPolicy* bloom =
+          leveldb::NewBloomFilterPolicy(bits_per_key);
+      const leveldb::FilterPolicy* blocked =
+          leveldb::NewBlockedBloomFilterPolicy(bits_per_key);
+      leveldb::Run("bloom", bloom);
+      leveldb::Run("blocked bloom", blocked);
+      delete bloom;
+      delete blocked;
+    }
+    bits = strchr(bits, ',');
+    if (bits != nullptr) {
+      bits++;
+    }
+  }
+  return 0;
+}
@@ -17,6 +17,12 @@ namespace leveldb {
 Cache::~Cache() {
 }
 
+Cache::Handle* Cache::Insert(const Slice& key, void* value, size_t charge,
+                             void (*deleter)(const Slice& key, void* value),
+                             Priority priority) {
+  return Insert(key, value, charge, deleter);
+}
+
 namespace {
 
 // LRU cache implementation
@@ -37,6 +43,15 @@ namespace {
 // Elements are moved between these lists by the Ref() and Unref() methods,
 // when they detect an element in the cache acquiring or losing its only
 // external reference.
+//
+// The newest part of the LRU list, up to high_pri_pool_ratio of the
+// capacity, is the high priority pool.  Items inserted with high priority
+// and items that were looked up since they were inserted go to the head
+// of the list when they lose their last external reference; all others
+// go to the head of the low priority pool, the midpoint of the list.
+// When the high priority pool grows too large, its oldest items move to
+// the low priority pool.  With a ratio of zero the high priority pool is
+// always empty, and the list is in plain LRU order.
 
 // An entry is a variable length heap-allocated structure.  Entries
 // are kept in a circular doubly linked list ordered by access time.
@@ -49,6 +64,9 @@ struct LRUHandle {
   size_t charge;      // TODO(opt): Only allow uint32_t?
   size_t key_length;
   bool in_cache;      // Whether entry is in the cache.
+  bool is_high_pri;   // Whether entry was inserted with high priority.
+  bool in_high_pri_pool;  // Whether entry is in the high priority pool.
+  bool hit;           // Whether entry was looked up since it was inserted.
   uint32_t refs;      // References, including cache reference, if present.
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
   char key_data[1];   // Beginning of key
@@ -155,12 +173,18 @@ class LRUCache {
   ~LRUCache();
 
   // Separate from constructor so caller can easily make an array of LRUCache
-  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+  void SetCapacity(size_t capacity, double high_pri_pool_ratio) {
+    capacity_ = capacity;
+    high_pri_pool_ratio_ = high_pri_pool_ratio;
+    high_pri_pool_capacity_ =
+        static_cast<size_t>(capacity * high_pri_pool_ratio);
+  }
 
   // Like Cache methods, but with an extra "hash" parameter.
   Cache::Handle* Insert(const Slice& key, uint32_t hash,
                         void* value, size_t charge,
-                        void (*deleter)(const Slice& key, void* value));
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
   Cache::Handle* Lookup(const Slice& key, uint32_t hash);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
@@ -173,12 +197,16 @@ class LRUCache {
  private:
   void LRU_Remove(LRUHandle* e);
   void LRU_Append(LRUHandle*list, LRUHandle* e);
+  void LRU_Insert(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  void MaintainPoolSize() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void Ref(LRUHandle* e);
   void Unref(LRUHandle* e);
   bool FinishErase(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   // Initialized before use.
   size_t capacity_;
+  double high_pri_pool_ratio_;
+  size_t high_pri_pool_capacity_;
 
   // mutex_ protects the following state.
   mutable port::Mutex mutex_;
@@ -189,6 +217,13 @@ class LRUCache {
   // Entries have refs==1 and in_cache==true.
   LRUHandle lru_ GUARDED_BY(mutex_);
 
+  // Newest entry of the low priority pool, or &lru_ if it is empty.
+  // The entries after it are the high priority pool.
+  LRUHandle* lru_low_pri_ GUARDED_BY(mutex_);
+
+  // Combined charge of the entries in the high priority pool.
+  size_t high_pri_pool_usage_ GUARDED_BY(mutex_);
+
   // Dummy head of in-use list.
   // Entries are in use by clients, and have refs >= 2 and in_cache==true.
   LRUHandle in_use_ GUARDED_BY(mutex_);
@@ -197,10 +232,15 @@ class LRUCache {
 };
 
 LRUCache::LRUCache()
-    : usage_(0) {
+    : capacity_(0),
+      high_pri_pool_ratio_(0),
+      high_pri_pool_capacity_(0),
+      usage_(0),
+      high_pri_pool_usage_(0) {
   // Make empty circular linked lists.
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  lru_low_pri_ = &lru_;
   in_use_.next = &in_use_;
   in_use_.prev = &in_use_;
 }
@@ -235,15 +275,48 @@ void LRUCache::Unref(LRUHandle* e) {
   } else if (e->in_cache && e->refs == 1) {
     // No longer in use; move to lru_ list.
     LRU_Remove(e);
-    LRU_Append(&lru_, e);
+    LRU_Insert(e);
   }
 }
 
 void LRUCache::LRU_Remove(LRUHandle* e) {
+  if (e == lru_low_pri_) {
+    lru_low_pri_ = e->prev;
+  }
+  if (e->in_high_pri_pool) {
+    assert(high_pri_pool_usage_ >= e->charge);
+    high_pri_pool_usage_ -= e->charge;
+    e->in_high_pri_pool = false;
+  }
   e->next->prev = e->prev;
   e->prev->next = e->next;
 }
 
+void LRUCache::LRU_Insert(LRUHandle* e) {
+  if (high_pri_pool_ratio_ > 0 && (e->is_high_pri || e->hit)) {
+    // Newest entry of the whole list, in the high priority pool.
+    LRU_Append(&lru_, e);
+    e->in_high_pri_pool = true;
+    high_pri_pool_usage_ += e->charge;
+    MaintainPoolSize();
+  } else {
+    // Newest entry of the low priority pool.
+    LRU_Append(lru_low_pri_->next, e);
+    lru_low_pri_ = e;
+  }
+}
+
+void LRUCache::MaintainPoolSize() {
+  while (high_pri_pool_usage_ > high_pri_pool_capacity_) {
+    // Move the oldest entry of the high priority pool to the low one.
+    lru_low_pri_ = lru_low_pri_->next;
+    assert(lru_low_pri_ != &lru_);
+    assert(lru_low_pri_->in_high_pri_pool);
+    lru_low_pri_->in_high_pri_pool = false;
+    high_pri_pool_usage_ -= lru_low_pri_->charge;
+  }
+}
+
 void LRUCache::LRU_Append(LRUHandle* list, LRUHandle* e) {
   // Make "e" newest entry by inserting just before *list
   e->next = list;
@@ -256,6 +329,7 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash) {
   MutexLock l(&mutex_);
   LRUHandle* e = table_.Lookup(key, hash);
   if (e != nullptr) {
+    e->hit = true;
     Ref(e);
   }
   return reinterpret_cast<Cache::Handle*>(e);
@@ -268,7 +342,8 @@ void LRUCache::Release(Cache::Handle* handle) {
 
 Cache::Handle* LRUCache::Insert(
     const Slice& key, uint32_t hash, void* value, size_t charge,
-    void (*deleter)(const Slice& key, void* value)) {
+    void (*deleter)(const Slice& key, void* value),
+    Cache::Priority priority) {
   MutexLock l(&mutex_);
 
   LRUHandle* e = reinterpret_cast<LRUHandle*>(
@@ -279,6 +354,9 @@ Cache::Handle* LRUCache::Insert(
   e->key_length = key.size();
   e->hash = hash;
   e->in_cache = false;
+  e->is_high_pri = (priority == Cache::kHigh);
+  e->in_high_pri_pool = false;
+  e->hit = false;
   e->refs = 1;  // for the returned handle.
   memcpy(e->key_data, key.data(), key.size());
 
@@ -352,18 +430,24 @@ class ShardedLRUCache : public Cache {
   }
 
  public:
-  explicit ShardedLRUCache(size_t capacity)
+  ShardedLRUCache(size_t capacity, double high_pri_pool_ratio)
       : last_id_(0) {
     const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
     for (int s = 0; s < kNumShards; s++) {
-      shard_[s].SetCapacity(per_shard);
+      shard_[s].SetCapacity(per_shard, high_pri_pool_ratio);
     }
   }
   virtual ~ShardedLRUCache() { }
   virtual Handle* Insert(const Slice& key, void* value, size_t charge,
                          void (*deleter)(const Slice& key, void* value)) {
+    return Insert(key, value, charge, deleter, kLow);
+  }
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority) {
     const uint32_t hash = HashSlice(key);
-    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                      priority);
   }
   virtual Handle* Lookup(const Slice& key) {
     const uint32_t hash = HashSlice(key);
@@ -401,7 +485,16 @@ class ShardedLRUCache : public Cache {
 }  // end anonymous namespace
 
 Cache* NewLRUCache(size_t capacity) {
-  return new ShardedLRUCache(capacity);
+  return new ShardedLRUCache(capacity, 0);
+}
+
+Cache* NewLRUCache(size_t capacity, double high_pri_pool_ratio) {
+  if (high_pri_pool_ratio < 0) {
+    high_pri_pool_ratio = 0;
+  } else if (high_pri_pool_ratio > 1) {
+    high_pri_pool_ratio = 1;
+  }
+  return new ShardedLRUCache(capacity, high_pri_pool_ratio);
 }
 
 }  // namespace leveldb
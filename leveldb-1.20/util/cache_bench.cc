@@ -0,0 +1,239 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+// Measures how Cache lookups scale with the number of threads that share
+// a cache, the way the readers of a DB share its block cache.  Every
+// operation looks up a random key and inserts it if it is missing, as a
+// table does with the blocks it reads.
+//
+// For each cache type and each thread count, prints the combined number
+// of operations per second and the fraction of lookups that hit.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "leveldb/cache.h"
+#include "leveldb/env.h"
+#include "leveldb/slice.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/coding.h"
+#include "util/mutexlock.h"
+#include "util/random.h"
+
+// Comma-separated list of cache types to measure:
+//      lru    -- NewLRUCache()
+//      clock  -- NewClockCache()
+static const char* FLAGS_cache_type = "lru,clock";
+
+// Comma-separated list of thread counts to measure each cache type with.
+static const char* FLAGS_threads = "1,2,4,8,16,32,48";
+
+// Capacity of the cache, in bytes.
+static int FLAGS_cache_size = 8 << 20;
+
+// Charge of every entry, in bytes.
+static int FLAGS_value_size = 4096;
+
+// Number of distinct keys.  With the defaults, a quarter of them fit in
+// the cache.
+static int FLAGS_num_keys = 8192;
+
+// Percentage of operations that pick one of the first 10% of the keys.
+static int FLAGS_hot_percent = 90;
+
+// Number of operations each thread performs.
+static int FLAGS_ops_per_thread = 1000000;
+
+// Number of bits of the shard index (negative means the default).
+static int FLAGS_num_shard_bits = -1;
+
+namespace leveldb {
+
+namespace {
+
+void DeleteValue(const Slice& key, void* value) {
+}
+
+Cache* NewCache(const std::string& type) {
+  if (type == "lru") {
+    return NewLRUCache(FLAGS_cache_size);
+  } else if (type == "clock") {
+    return NewClockCache(FLAGS_cache_size, FLAGS_value_size,
+                         FLAGS_num_shard_bits);
+  }
+  return nullptr;
+}
+
+struct SharedState {
+  port::Mutex mu;
+  port::CondVar cv GUARDED_BY(mu);
+  Cache* cache;
+  int total GUARDED_BY(mu);
+  int num_initialized GUARDED_BY(mu);
+  int num_done GUARDED_BY(mu);
+  bool start GUARDED_BY(mu);
+  int64_t hits GUARDED_BY(mu);
+  int64_t lookups GUARDED_BY(mu);
+
+  SharedState() : cv(&mu), cache(nullptr), total(0), num_initialized(0),
+                  num_done(0), start(false), hits(0), lookups(0) { }
+};
+
+struct ThreadState {
+  int tid;
+  SharedState* shared;
+};
+
+void ThreadBody(void* v) {
+  ThreadState* thread = reinterpret_cast<ThreadState*>(v);
+  SharedState* shared = thread->shared;
+  Cache* cache = shared->cache;
+  Random rnd(1000 + thread->tid);
+  const int hot_keys = FLAGS_num_keys / 10 + 1;
+  {
+    MutexLock l(&shared->mu);
+    shared->num_initialized++;
+    if (shared->num_initialized >= shared->total) {
+      shared->cv.SignalAll();
+    }
+    while (!shared->start) {
+      shared->cv.Wait();
+    }
+  }
+
+  int64_t hits = 0;
+  char key[8];
+  for (int i = 0; i < FLAGS_ops_per_thread; i++) {
+    const uint32_t k = (rnd.Uniform(100) < FLAGS_hot_percent) ?
+        rnd.Uniform(hot_keys) : rnd.Uniform(FLAGS_num_keys);
+    EncodeFixed64(key, k);
+    Cache::Handle* h = cache->Lookup(Slice(key, sizeof(key)));
+    if (h != nullptr) {
+      hits++;
+    } else {
+      h = cache->Insert(Slice(key, sizeof(key)), nullptr, FLAGS_value_size,
+                        &DeleteValue);
+    }
+    cache->Release(h);
+  }
+
+  MutexLock l(&shared->mu);
+  shared->hits += hits;
+  shared->lookups += FLAGS_ops_per_thread;
+  shared->num_done++;
+  if (shared->num_done >= shared->total) {
+    shared->cv.SignalAll();
+  }
+}
+
+void Run(const std::string& type, int n) {
+  Env* env = Env::Default();
+  SharedState shared;
+  shared.cache = NewCache(type);
+  shared.total = n;
+
+  // Warm the cache up before the threads start.
+  char key[8];
+  for (int k = 0; k < FLAGS_num_keys; k++) {
+    EncodeFixed64(key, k);
+    shared.cache->Release(shared.cache->Insert(
+        Slice(key, sizeof(key)), nullptr, FLAGS_value_size, &DeleteValue));
+  }
+
+  ThreadState* threads = new ThreadState[n];
+  for (int i = 0; i < n; i++) {
+    threads[i].tid = i;
+    threads[i].shared = &shared;
+    env->StartThread(ThreadBody, &threads[i]);
+  }
+
+  shared.mu.Lock();
+  while (shared.num_initialized < n) {
+    shared.cv.Wait();
+  }
+  const uint64_t start = env->NowMicros();
+  shared.start = true;
+  shared.cv.SignalAll();
+  while (shared.num_done < n) {
+    shared.cv.Wait();
+  }
+  const uint64_t elapsed = env->NowMicros() - start;
+  const double ops = static_cast<double>(shared.lookups);
+  const double hit_rate = shared.lookups > 0 ?
+      static_cast<double>(shared.hits) / shared.lookups : 0;
+  shared.mu.Unlock();
+
+  fprintf(stdout, "%-6s %3d threads : %12.0f ops/sec; %5.1f%% hits\n",
+          type.c_str(), n, ops * 1e6 / (elapsed > 0 ? elapsed : 1),
+          hit_rate * 100.0);
+  fflush(stdout);
+
+  delete[] threads;
+  delete shared.cache;
+}
+
+}  // namespace
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    int n;
+    char junk;
+    if (leveldb::Slice(argv[i]).starts_with("--cache_type=")) {
+      FLAGS_cache_type = argv[i] + strlen("--cache_type=");
+    } else if (leveldb::Slice(argv[i]).starts_with("--threads=")) {
+      FLAGS_threads = argv[i] + strlen("--threads=");
+    } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
+      FLAGS_cache_size = n;
+    } else if (sscanf(argv[i], "--value_size=%d%c", &n, &junk) == 1) {
+      FLAGS_value_size = n;
+    } else if (sscanf(argv[i], "--num_keys=%d%c", &n, &junk) == 1 && n > 0) {
+      FLAGS_num_keys = n;
+    } else if (sscanf(argv[i], "--hot_percent=%d%c", &n, &junk) == 1) {
+      FLAGS_hot_percent = n;
+    } else if (sscanf(argv[i], "--ops_per_thread=%d%c", &n, &junk) == 1) {
+      FLAGS_ops_per_thread = n;
+    } else if (sscanf(argv[i], "--num_shard_bits=%d%c", &n, &junk) == 1) {
+      FLAGS_num_shard_bits = n;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      exit(1);
+    }
+  }
+
+  fprintf(stdout, "Keys:       %d (%d bytes each, %d%% of reads to 10%%)\n",
+          FLAGS_num_keys, FLAGS_value_size, FLAGS_hot_percent);
+  fprintf(stdout, "Cache:      %d bytes\n", FLAGS_cache_size);
+  fprintf(stdout, "------------------------------------------------\n");
+
+  const char* types = FLAGS_cache_type;
+  while (types != nullptr && *types != '\0') {
+    const char* sep = strchr(types, ',');
+    std::string type = (sep == nullptr) ? std::string(types) :
+        std::string(types, sep - types);
+    types = (sep == nullptr) ? nullptr : sep + 1;
+    leveldb::Cache* cache = leveldb::NewCache(type);
+    if (cache == nullptr) {
+      fprintf(stderr, "unknown cache type '%s'\n", type.c_str());
+      continue;
+    }
+    delete cache;
+
+    const char* threads = FLAGS_threads;
+    while (threads != nullptr && *threads != '\0') {
+      const int n = atoi(threads);
+      if (n > 0) {
+        leveldb::Run(type, n);
+      }
+      threads = strchr(threads, ',');
+      if (threads != nullptr) {
+        threads++;
+      }
+    }
+  }
+  return 0;
+}
@@ -5,7 +5,12 @@
 #include "leveldb/cache.h"
 
 #include <vector>
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "util/coding.h"
+#include "util/mutexlock.h"
+#include "util/random.h"
 #include "util/testharness.h"
 
 namespace leveldb {
@@ -32,12 +37,20 @@ class CacheTest {
     current_->deleted_values_.push_back(DecodeValue(v));
   }
 
+  // The cache types that the tests of both types run against.
+  enum CacheType {
+    kLRUCache,
+    kClockCache,
+    kNumCacheTypes
+  };
+
   static const int kCacheSize = 1000;
   std::vector<int> deleted_keys_;
   std::vector<int> deleted_values_;
+  int cache_type_;
   Cache* cache_;
 
-  CacheTest() : cache_(NewLRUCache(kCacheSize)) {
+  CacheTest() : cache_type_(kLRUCache), cache_(NewCache(kCacheSize)) {
     current_ = this;
   }
 
@@ -45,6 +58,29 @@ class CacheTest {
     delete cache_;
   }
 
+  // Return a new cache of the current type.
+  Cache* NewCache(size_t capacity) {
+    switch (cache_type_) {
+      case kClockCache:
+        return NewClockCache(capacity, 1, -1);
+      default:
+        return NewLRUCache(capacity);
+    }
+  }
+
+  // Switch to an empty cache of the next type.  Returns false after the
+  // last type has been tested.
+  bool ChangeCacheType() {
+    if (++cache_type_ >= kNumCacheTypes) {
+      return false;
+    }
+    delete cache_;
+    cache_ = NewCache(kCacheSize);
+    deleted_keys_.clear();
+    deleted_values_.clear();
+    return true;
+  }
+
   int Lookup(int key) {
     Cache::Handle* handle = cache_->Lookup(EncodeKey(key));
     const int r = (handle == nullptr) ? -1 : DecodeValue(cache_->Value(handle));
@@ -59,6 +95,11 @@ class CacheTest {
                                    &CacheTest::Deleter));
   }
 
+  void InsertWithPriority(int key, int value, Cache::Priority priority) {
+    cache_->Release(cache_->Insert(EncodeKey(key), EncodeValue(value), 1,
+                                   &CacheTest::Deleter, priority));
+  }
+
   Cache::Handle* InsertAndReturnHandle(int key, int value, int charge = 1) {
     return cache_->Insert(EncodeKey(key), EncodeValue(value), charge,
                           &CacheTest::Deleter);
@@ -71,160 +112,409 @@ class CacheTest {
 CacheTest* CacheTest::current_;
 
 TEST(CacheTest, HitAndMiss) {
-  ASSERT_EQ(-1, Lookup(100));
+  do {
+    ASSERT_EQ(-1, Lookup(100));
 
-  Insert(100, 101);
-  ASSERT_EQ(101, Lookup(100));
-  ASSERT_EQ(-1,  Lookup(200));
-  ASSERT_EQ(-1,  Lookup(300));
+    Insert(100, 101);
+    ASSERT_EQ(101, Lookup(100));
+    ASSERT_EQ(-1,  Lookup(200));
+    ASSERT_EQ(-1,  Lookup(300));
 
-  Insert(200, 201);
-  ASSERT_EQ(101, Lookup(100));
-  ASSERT_EQ(201, Lookup(200));
-  ASSERT_EQ(-1,  Lookup(300));
+    Insert(200, 201);
+    ASSERT_EQ(101, Lookup(100));
+    ASSERT_EQ(201, Lookup(200));
+    ASSERT_EQ(-1,  Lookup(300));
+
+    Insert(100, 102);
+    ASSERT_EQ(102, Lookup(100));
+    ASSERT_EQ(201, Lookup(200));
+    ASSERT_EQ(-1,  Lookup(300));
+
+    ASSERT_EQ(1, deleted_keys_.size());
+    ASSERT_EQ(100, deleted_keys_[0]);
+    ASSERT_EQ(101, deleted_values_[0]);
+  } while (ChangeCacheType());
+}
 
-  Insert(100, 102);
-  ASSERT_EQ(102, Lookup(100));
-  ASSERT_EQ(201, Lookup(200));
-  ASSERT_EQ(-1,  Lookup(300));
+TEST(CacheTest, Erase) {
+  do {
+    Erase(200);
+    ASSERT_EQ(0, deleted_keys_.size());
+
+    Insert(100, 101);
+    Insert(200, 201);
+    Erase(100);
+    ASSERT_EQ(-1,  Lookup(100));
+    ASSERT_EQ(201, Lookup(200));
+    ASSERT_EQ(1, deleted_keys_.size());
+    ASSERT_EQ(100, deleted_keys_[0]);
+    ASSERT_EQ(101, deleted_values_[0]);
+
+    Erase(100);
+    ASSERT_EQ(-1,  Lookup(100));
+    ASSERT_EQ(201, Lookup(200));
+    ASSERT_EQ(1, deleted_keys_.size());
+  } while (ChangeCacheType());
+}
 
-  ASSERT_EQ(1, deleted_keys_.size());
-  ASSERT_EQ(100, deleted_keys_[0]);
-  ASSERT_EQ(101, deleted_values_[0]);
+TEST(CacheTest, EntriesArePinned) {
+  do {
+    Insert(100, 101);
+    Cache::Handle* h1 = cache_->Lookup(EncodeKey(100));
+    ASSERT_EQ(101, DecodeValue(cache_->Value(h1)));
+
+    Insert(100, 102);
+    Cache::Handle* h2 = cache_->Lookup(EncodeKey(100));
+    ASSERT_EQ(102, DecodeValue(cache_->Value(h2)));
+    ASSERT_EQ(0, deleted_keys_.size());
+
+    cache_->Release(h1);
+    ASSERT_EQ(1, deleted_keys_.size());
+    ASSERT_EQ(100, deleted_keys_[0]);
+    ASSERT_EQ(101, deleted_values_[0]);
+
+    Erase(100);
+    ASSERT_EQ(-1, Lookup(100));
+    ASSERT_EQ(1, deleted_keys_.size());
+
+    cache_->Release(h2);
+    ASSERT_EQ(2, deleted_keys_.size());
+    ASSERT_EQ(100, deleted_keys_[1]);
+    ASSERT_EQ(102, deleted_values_[1]);
+  } while (ChangeCacheType());
 }
 
-TEST(CacheTest, Erase) {
-  Erase(200);
-  ASSERT_EQ(0, deleted_keys_.size());
+TEST(CacheTest, EvictionPolicy) {
+  do {
+    Insert(100, 101);
+    Insert(200, 201);
+    Insert(300, 301);
+    Cache::Handle* h = cache_->Lookup(EncodeKey(300));
+
+    // Frequently used entry must be kept around,
+    // as must things that are still in use.
+    for (int i = 0; i < kCacheSize + 100; i++) {
+      Insert(1000+i, 2000+i);
+      ASSERT_EQ(2000+i, Lookup(1000+i));
+      ASSERT_EQ(101, Lookup(100));
+    }
+    ASSERT_EQ(101, Lookup(100));
+    ASSERT_EQ(-1, Lookup(200));
+    ASSERT_EQ(301, Lookup(300));
+    cache_->Release(h);
+  } while (ChangeCacheType());
+}
+
+TEST(CacheTest, UseExceedsCacheSize) {
+  do {
+    // Overfill the cache, keeping handles on all inserted entries.
+    std::vector<Cache::Handle*> h;
+    for (int i = 0; i < kCacheSize + 100; i++) {
+      h.push_back(InsertAndReturnHandle(1000+i, 2000+i));
+    }
 
-  Insert(100, 101);
-  Insert(200, 201);
-  Erase(100);
-  ASSERT_EQ(-1,  Lookup(100));
-  ASSERT_EQ(201, Lookup(200));
-  ASSERT_EQ(1, deleted_keys_.size());
-  ASSERT_EQ(100, deleted_keys_[0]);
-  ASSERT_EQ(101, deleted_values_[0]);
+    // Check that all the entries can be found in the cache.
+    for (int i = 0; i < h.size(); i++) {
+      ASSERT_EQ(2000+i, Lookup(1000+i));
+    }
 
-  Erase(100);
-  ASSERT_EQ(-1,  Lookup(100));
-  ASSERT_EQ(201, Lookup(200));
-  ASSERT_EQ(1, deleted_keys_.size());
+    for (int i = 0; i < h.size(); i++) {
+      cache_->Release(h[i]);
+    }
+  } while (ChangeCacheType());
 }
 
-TEST(CacheTest, EntriesArePinned) {
-  Insert(100, 101);
-  Cache::Handle* h1 = cache_->Lookup(EncodeKey(100));
-  ASSERT_EQ(101, DecodeValue(cache_->Value(h1)));
+TEST(CacheTest, HeavyEntries) {
+  do {
+    // Add a bunch of light and heavy entries and then count the combined
+    // size of items still in the cache, which must be approximately the
+    // same as the total capacity.
+    const int kLight = 1;
+    const int kHeavy = 10;
+    int added = 0;
+    int index = 0;
+    while (added < 2*kCacheSize) {
+      const int weight = (index & 1) ? kLight : kHeavy;
+      Insert(index, 1000+index, weight);
+      added += weight;
+      index++;
+    }
+
+    int cached_weight = 0;
+    for (int i = 0; i < index; i++) {
+      const int weight = (i & 1 ? kLight : kHeavy);
+      int r = Lookup(i);
+      if (r >= 0) {
+        cached_weight += weight;
+        ASSERT_EQ(1000+i, r);
+      }
+    }
+    ASSERT_LE(cached_weight, kCacheSize + kCacheSize/10);
+    ASSERT_EQ(cached_weight, cache_->TotalCharge());
+  } while (ChangeCacheType());
+}
 
-  Insert(100, 102);
-  Cache::Handle* h2 = cache_->Lookup(EncodeKey(100));
-  ASSERT_EQ(102, DecodeValue(cache_->Value(h2)));
-  ASSERT_EQ(0, deleted_keys_.size());
+TEST(CacheTest, NewId) {
+  do {
+    uint64_t a = cache_->NewId();
+    uint64_t b = cache_->NewId();
+    ASSERT_NE(a, b);
+  } while (ChangeCacheType());
+}
 
-  cache_->Release(h1);
-  ASSERT_EQ(1, deleted_keys_.size());
-  ASSERT_EQ(100, deleted_keys_[0]);
-  ASSERT_EQ(101, deleted_values_[0]);
+TEST(CacheTest, Prune) {
+  do {
+    Insert(1, 100);
+    Insert(2, 200);
+
+    Cache::Handle* handle = cache_->Lookup(EncodeKey(1));
+    ASSERT_TRUE(handle);
+    cache_->Prune();
+    cache_->Release(handle);
+
+    ASSERT_EQ(100, Lookup(1));
+    ASSERT_EQ(-1, Lookup(2));
+    ASSERT_EQ(1, cache_->TotalCharge());
+  } while (ChangeCacheType());
+}
 
-  Erase(100);
-  ASSERT_EQ(-1, Lookup(100));
-  ASSERT_EQ(1, deleted_keys_.size());
+TEST(CacheTest, ZeroSizeCache) {
+  do {
+    delete cache_;
+    cache_ = NewCache(0);
 
-  cache_->Release(h2);
-  ASSERT_EQ(2, deleted_keys_.size());
-  ASSERT_EQ(100, deleted_keys_[1]);
-  ASSERT_EQ(102, deleted_values_[1]);
+    Insert(1, 100);
+    ASSERT_EQ(-1, Lookup(1));
+    ASSERT_EQ(1, deleted_keys_.size());
+  } while (ChangeCacheType());
 }
 
-TEST(CacheTest, EvictionPolicy) {
-  Insert(100, 101);
-  Insert(200, 201);
-  Insert(300, 301);
-  Cache::Handle* h = cache_->Lookup(EncodeKey(300));
-
-  // Frequently used entry must be kept around,
-  // as must things that are still in use.
-  for (int i = 0; i < kCacheSize + 100; i++) {
+TEST(CacheTest, HighPriorityEntriesSurviveScan) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0.5);
+
+  for (int i = 0; i < 10; i++) {
+    InsertWithPriority(i, 100+i, Cache::kHigh);
+  }
+  // A scan that reads each entry once only evicts other such entries.
+  for (int i = 0; i < 2*kCacheSize; i++) {
     Insert(1000+i, 2000+i);
-    ASSERT_EQ(2000+i, Lookup(1000+i));
-    ASSERT_EQ(101, Lookup(100));
   }
-  ASSERT_EQ(101, Lookup(100));
-  ASSERT_EQ(-1, Lookup(200));
-  ASSERT_EQ(301, Lookup(300));
-  cache_->Release(h);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(100+i, Lookup(i));
+  }
+  ASSERT_EQ(-1, Lookup(1000));
 }
 
-TEST(CacheTest, UseExceedsCacheSize) {
-  // Overfill the cache, keeping handles on all inserted entries.
-  std::vector<Cache::Handle*> h;
-  for (int i = 0; i < kCacheSize + 100; i++) {
-    h.push_back(InsertAndReturnHandle(1000+i, 2000+i));
-  }
+TEST(CacheTest, EntriesLookedUpAgainSurviveScan) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0.5);
 
-  // Check that all the entries can be found in the cache.
-  for (int i = 0; i < h.size(); i++) {
-    ASSERT_EQ(2000+i, Lookup(1000+i));
+  for (int i = 0; i < 10; i++) {
+    Insert(i, 100+i);
+    ASSERT_EQ(100+i, Lookup(i));
   }
+  Insert(10, 110);
+  for (int i = 0; i < 2*kCacheSize; i++) {
+    Insert(1000+i, 2000+i);
+  }
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(100+i, Lookup(i));
+  }
+  ASSERT_EQ(-1, Lookup(10));
+}
 
-  for (int i = 0; i < h.size(); i++) {
-    cache_->Release(h[i]);
+TEST(CacheTest, ZeroHighPriorityPoolIsLRU) {
+  delete cache_;
+  cache_ = NewLRUCache(kCacheSize, 0);
+
+  InsertWithPriority(1, 101, Cache::kHigh);
+  Insert(2, 102);
+  ASSERT_EQ(102, Lookup(2));
+  for (int i = 0; i < 2*kCacheSize; i++) {
+    Insert(1000+i, 2000+i);
   }
+  ASSERT_EQ(-1, Lookup(1));
+  ASSERT_EQ(-1, Lookup(2));
 }
 
-TEST(CacheTest, HeavyEntries) {
-  // Add a bunch of light and heavy entries and then count the combined
-  // size of items still in the cache, which must be approximately the
-  // same as the total capacity.
-  const int kLight = 1;
-  const int kHeavy = 10;
-  int added = 0;
-  int index = 0;
-  while (added < 2*kCacheSize) {
-    const int weight = (index & 1) ? kLight : kHeavy;
-    Insert(index, 1000+index, weight);
-    added += weight;
-    index++;
-  }
-
-  int cached_weight = 0;
-  for (int i = 0; i < index; i++) {
-    const int weight = (i & 1 ? kLight : kHeavy);
-    int r = Lookup(i);
-    if (r >= 0) {
-      cached_weight += weight;
-      ASSERT_EQ(1000+i, r);
+// Runs a trace in which a small set of hot keys is read twice between
+// scans over many keys that are never read again, inserting every key
+// that misses.  Returns the fraction of hot key reads that hit.
+static double HotHitRate(Cache* cache) {
+  const int kHotKeys = 200;
+  const int kScanKeys = 2000;
+  const int kRounds = 20;
+  int scan_key = 1000000;
+  int hits = 0;
+  int reads = 0;
+  for (int round = 0; round < kRounds; round++) {
+    for (int pass = 0; pass < 2; pass++) {
+      for (int k = 0; k < kHotKeys; k++) {
+        Cache::Handle* h = cache->Lookup(EncodeKey(k));
+        if (h != nullptr) {
+          hits++;
+        } else {
+          h = cache->Insert(EncodeKey(k), EncodeValue(k), 1,
+                            &CacheTest::Deleter);
+        }
+        cache->Release(h);
+        reads++;
+      }
+    }
+    for (int i = 0; i < kScanKeys; i++) {
+      std::string key = EncodeKey(scan_key++);
+      Cache::Handle* h = cache->Lookup(key);
+      if (h == nullptr) {
+        h = cache->Insert(key, EncodeValue(0), 1, &CacheTest::Deleter);
+      }
+      cache->Release(h);
     }
   }
-  ASSERT_LE(cached_weight, kCacheSize + kCacheSize/10);
+  return static_cast<double>(hits) / reads;
 }
 
-TEST(CacheTest, NewId) {
-  uint64_t a = cache_->NewId();
-  uint64_t b = cache_->NewId();
-  ASSERT_NE(a, b);
+TEST(CacheTest, ScanResistantHitRate) {
+  Cache* lru = NewLRUCache(1024);
+  Cache* midpoint = NewLRUCache(1024, 0.5);
+  const double lru_rate = HotHitRate(lru);
+  const double midpoint_rate = HotHitRate(midpoint);
+
+  // Plain LRU loses the hot keys to every scan and only hits on the
+  // second pass; the high priority pool keeps them across scans.
+  ASSERT_LE(lru_rate, 0.51);
+  ASSERT_GE(midpoint_rate, 0.9);
+  delete lru;
+  delete midpoint;
 }
 
-TEST(CacheTest, Prune) {
-  Insert(1, 100);
-  Insert(2, 200);
+class ClockCacheTest : public CacheTest {
+ public:
+  ClockCacheTest() {
+    cache_type_ = kClockCache;
+    delete cache_;
+    cache_ = NewCache(kCacheSize);
+  }
+};
 
-  Cache::Handle* handle = cache_->Lookup(EncodeKey(1));
-  ASSERT_TRUE(handle);
-  cache_->Prune();
-  cache_->Release(handle);
+TEST(ClockCacheTest, ClockTableFull) {
+  // A single shard whose table holds at most 15 entries, although their
+  // charge stays far below the capacity.
+  delete cache_;
+  cache_ = NewClockCache(kCacheSize, 100, 0);
 
-  ASSERT_EQ(100, Lookup(1));
-  ASSERT_EQ(-1, Lookup(2));
+  std::vector<Cache::Handle*> h;
+  for (int i = 0; i < 20; i++) {
+    h.push_back(InsertAndReturnHandle(i, 100+i));
+  }
+  for (int i = 0; i < h.size(); i++) {
+    ASSERT_EQ(100+i, DecodeValue(cache_->Value(h[i])));
+  }
+  for (int i = 0; i < h.size(); i++) {
+    cache_->Release(h[i]);
+  }
+  // The entries that did not fit were freed on release.
+  ASSERT_EQ(5, deleted_keys_.size());
+  ASSERT_EQ(-1, Lookup(19));
+  ASSERT_EQ(100, Lookup(0));
+
+  for (int i = 20; i < 100; i++) {
+    Insert(i, 100+i);
+  }
+  ASSERT_EQ(100 - 15, deleted_keys_.size());
+  ASSERT_EQ(15, cache_->TotalCharge());
 }
 
-TEST(CacheTest, ZeroSizeCache) {
-  delete cache_;
-  cache_ = NewLRUCache(0);
+struct ClockCacheThreadState {
+  Cache* cache;
+  port::Mutex mu;
+  int seed GUARDED_BY(mu);
+  int num_running GUARDED_BY(mu);
+  bool ok GUARDED_BY(mu);
+};
 
-  Insert(1, 100);
-  ASSERT_EQ(-1, Lookup(1));
+static port::Mutex deleted_mu;
+static int deleted_count GUARDED_BY(deleted_mu) = 0;
+
+static void CountingDeleter(const Slice& key, void* v) {
+  MutexLock l(&deleted_mu);
+  if (DecodeKey(key) == DecodeValue(v)) {
+    deleted_count++;
+  }
+}
+
+static void ClockCacheThreadBody(void* arg) {
+  ClockCacheThreadState* state = reinterpret_cast<ClockCacheThreadState*>(arg);
+  int seed;
+  {
+    MutexLock l(&state->mu);
+    seed = state->seed++;
+  }
+  Random rnd(seed);
+  bool ok = true;
+  for (int i = 0; i < 100000; i++) {
+    const int k = rnd.Uniform(400);
+    const std::string key = EncodeKey(k);
+    switch (rnd.Uniform(8)) {
+      case 0:
+        state->cache->Release(state->cache->Insert(
+            key, EncodeValue(k), 1 + rnd.Uniform(4), &CountingDeleter));
+        break;
+      case 1:
+        state->cache->Erase(key);
+        break;
+      default: {
+        Cache::Handle* h = state->cache->Lookup(key);
+        if (h != nullptr) {
+          ok = ok && (DecodeValue(state->cache->Value(h)) == k);
+          state->cache->Release(h);
+        }
+        break;
+      }
+    }
+  }
+  MutexLock l(&state->mu);
+  state->ok = state->ok && ok;
+  state->num_running--;
+}
+
+TEST(ClockCacheTest, ClockConcurrentAccess) {
+  // Readers, writers and erasers race on a cache that is much smaller
+  // than the set of keys.  Every lookup must return the value stored
+  // under its key, and every inserted value must be deleted exactly once.
+  static const int kNumThreads = 4;
+  ClockCacheThreadState state;
+  state.cache = NewClockCache(200, 2, 2);
+  {
+    MutexLock l(&state.mu);
+    state.seed = test::RandomSeed();
+    state.num_running = kNumThreads;
+    state.ok = true;
+  }
+  {
+    MutexLock l(&deleted_mu);
+    deleted_count = 0;
+  }
+  for (int i = 0; i < kNumThreads; i++) {
+    Env::Default()->StartThread(&ClockCacheThreadBody, &state);
+  }
+  while (true) {
+    state.mu.Lock();
+    int num = state.num_running;
+    state.mu.Unlock();
+    if (num == 0) {
+      break;
+    }
+    Env::Default()->SleepForMicroseconds(10000);
+  }
+  ASSERT_LE(state.cache->TotalCharge(), 200);
+  delete state.cache;
+
+  MutexLock l(&state.mu);
+  ASSERT_TRUE(state.ok);
+  // Each thread inserts about one eighth of its operations.
+  MutexLock d(&deleted_mu);
+  ASSERT_GT(deleted_count, kNumThreads * 100000 / 16);
 }
 
 }  // namespace leveldb
@@ -0,0 +1,452 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#include "leveldb/cache.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+namespace {
+
+// CLOCK cache implementation
+//
+// Each shard keeps its entries in a fixed size open addressing hash table
+// whose slots are never freed while the cache exists.  Lookup() and
+// Release() do not take the shard's mutex: they only use atomic
+// operations on the slots.  Insert() and the eviction it triggers hold
+// the mutex, so that only one thread at a time claims empty slots.
+//
+// The state of a slot and the number of references to its entry are
+// packed into a single word, "meta":
+//
+// - kEmpty: the slot holds no entry.
+// - kConstruction: one thread owns the slot and is filling or clearing it.
+// - kVisible: the entry can be found by Lookup().
+// - kInvisible: the entry was erased or replaced, but is still referenced.
+//
+// Lookup() adds a reference to a slot before it compares the slot's key,
+// and an entry is only cleared by the thread that moves its slot from
+// kVisible or kInvisible with no references to kConstruction.  So a key
+// cannot change while it is being compared.  A reference that Lookup()
+// adds to a slot in any other state is simply overwritten by the owner
+// of the slot when it stores the slot's next state.
+//
+// Lookup() also sets the entry's reference bit.  Eviction sweeps a clock
+// hand over the table; an unreferenced entry whose bit is set gets the
+// bit cleared and a second chance, one whose bit is clear is evicted.
+//
+// Keys are placed by double hashing.  Every slot counts the entries that
+// passed over it on the way to their own slot, so that the search for a
+// missing key can stop at the first slot that no entry passed.
+//
+// Besides the charge of its entries, a shard limits the number of its
+// entries to a fraction of the table size.  The table is sized from an
+// estimate of the average charge of an entry.
+
+enum SlotState {
+  kEmpty = 0,
+  kConstruction = 1,
+  kVisible = 2,
+  kInvisible = 3
+};
+
+static const int kStateShift = 62;
+static const uint64_t kRefsMask = (static_cast<uint64_t>(1) << 32) - 1;
+
+static inline uint64_t MakeMeta(SlotState state, uint64_t refs) {
+  return (static_cast<uint64_t>(state) << kStateShift) | refs;
+}
+static inline SlotState StateOf(uint64_t meta) {
+  return static_cast<SlotState>(meta >> kStateShift);
+}
+static inline uint64_t RefsOf(uint64_t meta) {
+  return meta & kRefsMask;
+}
+
+struct ClockHandle {
+  std::atomic<uint64_t> meta;
+  std::atomic<uint32_t> hash;           // Hash of key()
+  std::atomic<uint32_t> displacements;  // Entries that probed past this slot
+  uint32_t key_length;
+  std::atomic<uint8_t> clock;           // Reference bit
+  bool detached;                        // Not in a table; see Insert()
+  size_t charge;
+  char* key_data;
+  void* value;
+  void (*deleter)(const Slice&, void* value);
+
+  Slice key() const { return Slice(key_data, key_length); }
+};
+
+// Step between the slots probed for "hash".  Odd, so that probing visits
+// every slot of a power-of-two table.
+static inline uint32_t ProbeIncrement(uint32_t hash) {
+  return ((hash >> 13) | (hash << 19)) | 1;
+}
+
+// A single shard of sharded cache.
+class ClockCacheShard {
+ public:
+  ClockCacheShard();
+  ~ClockCacheShard();
+
+  // Separate from constructor so caller can easily make an array of shards
+  void Init(size_t capacity, size_t estimated_entry_charge);
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  Cache::Handle* Insert(const Slice& key, uint32_t hash,
+                        void* value, size_t charge,
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Priority priority);
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+  void Prune();
+  size_t TotalCharge() const {
+    return usage_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  ClockHandle* Find(const Slice& key, uint32_t hash);
+  void Unref(ClockHandle* h);
+  void Free(ClockHandle* h);
+  bool EvictOne() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Initialized before use.
+  size_t capacity_;
+  size_t occupancy_limit_;
+  uint32_t mask_;
+  ClockHandle* table_;
+
+  std::atomic<size_t> usage_;      // Combined charge of the table's entries
+  std::atomic<size_t> occupancy_;  // Slots that are not kEmpty
+
+  port::Mutex mutex_;
+  uint32_t clock_hand_ GUARDED_BY(mutex_);
+};
+
+ClockCacheShard::ClockCacheShard()
+    : capacity_(0),
+      occupancy_limit_(0),
+      mask_(0),
+      table_(nullptr),
+      usage_(0),
+      occupancy_(0),
+      clock_hand_(0) {
+}
+
+ClockCacheShard::~ClockCacheShard() {
+  for (uint32_t i = 0; table_ != nullptr && i <= mask_; i++) {
+    ClockHandle* h = &table_[i];
+    const uint64_t meta = h->meta.load(std::memory_order_relaxed);
+    if (StateOf(meta) != kEmpty) {
+      // Error if caller has an unreleased handle
+      assert(StateOf(meta) == kVisible && RefsOf(meta) == 0);
+      (*h->deleter)(h->key(), h->value);
+      free(h->key_data);
+    }
+  }
+  delete[] table_;
+}
+
+void ClockCacheShard::Init(size_t capacity, size_t estimated_entry_charge) {
+  assert(table_ == nullptr);
+  if (estimated_entry_charge == 0) {
+    estimated_entry_charge = 1;
+  }
+  // Keep the table at most 70% full with entries of the estimated charge,
+  // and never more than 90% full.
+  const size_t entries = capacity / estimated_entry_charge + 1;
+  uint32_t size = 16;
+  while (size < entries * 10 / 7 && size < (1u << 30)) {
+    size *= 2;
+  }
+  capacity_ = capacity;
+  occupancy_limit_ = size - size / 10;
+  mask_ = size - 1;
+  table_ = new ClockHandle[size];
+  for (uint32_t i = 0; i < size; i++) {
+    table_[i].meta.store(MakeMeta(kEmpty, 0), std::memory_order_relaxed);
+    table_[i].hash.store(0, std::memory_order_relaxed);
+    table_[i].displacements.store(0, std::memory_order_relaxed);
+    table_[i].clock.store(0, std::memory_order_relaxed);
+    table_[i].detached = false;
+  }
+}
+
+ClockHandle* ClockCacheShard::Find(const Slice& key, uint32_t hash) {
+  const uint32_t increment = ProbeIncrement(hash);
+  uint32_t i = hash & mask_;
+  for (uint32_t probes = 0; probes <= mask_; probes++) {
+    ClockHandle* h = &table_[i];
+    if (StateOf(h->meta.load(std::memory_order_acquire)) == kVisible &&
+        h->hash.load(std::memory_order_relaxed) == hash) {
+      const uint64_t old = h->meta.fetch_add(1, std::memory_order_acquire);
+      const SlotState state = StateOf(old);
+      if (state == kVisible && h->key() == key) {
+        return h;
+      } else if (state == kVisible || state == kInvisible) {
+        Unref(h);
+      }
+    }
+    if (h->displacements.load(std::memory_order_acquire) == 0) {
+      break;
+    }
+    i = (i + increment) & mask_;
+  }
+  return nullptr;
+}
+
+Cache::Handle* ClockCacheShard::Lookup(const Slice& key, uint32_t hash) {
+  ClockHandle* h = Find(key, hash);
+  if (h != nullptr && h->clock.load(std::memory_order_relaxed) == 0) {
+    h->clock.store(1, std::memory_order_relaxed);
+  }
+  return reinterpret_cast<Cache::Handle*>(h);
+}
+
+void ClockCacheShard::Unref(ClockHandle* h) {
+  const uint64_t old = h->meta.fetch_sub(1, std::memory_order_acq_rel);
+  assert(RefsOf(old) > 0);
+  if (StateOf(old) == kInvisible && RefsOf(old) == 1) {
+    // Last reference to an entry that is no longer in the cache.  Another
+    // thread may have added a reference since; if so, it frees the entry.
+    uint64_t expected = MakeMeta(kInvisible, 0);
+    if (h->meta.compare_exchange_strong(expected,
+                                        MakeMeta(kConstruction, 0),
+                                        std::memory_order_acq_rel)) {
+      Free(h);
+    }
+  }
+}
+
+void ClockCacheShard::Release(Cache::Handle* handle) {
+  Unref(reinterpret_cast<ClockHandle*>(handle));
+}
+
+// REQUIRES: the caller moved h to kConstruction.
+void ClockCacheShard::Free(ClockHandle* h) {
+  (*h->deleter)(h->key(), h->value);
+  free(h->key_data);
+  if (h->detached) {
+    delete h;
+    return;
+  }
+  usage_.fetch_sub(h->charge, std::memory_order_relaxed);
+
+  // Undo the displacements that the entry added on its way to this slot.
+  const uint32_t hash = h->hash.load(std::memory_order_relaxed);
+  const uint32_t increment = ProbeIncrement(hash);
+  for (uint32_t i = hash & mask_; &table_[i] != h;
+       i = (i + increment) & mask_) {
+    table_[i].displacements.fetch_sub(1, std::memory_order_relaxed);
+  }
+  h->meta.store(MakeMeta(kEmpty, 0), std::memory_order_release);
+  occupancy_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool ClockCacheShard::EvictOne() {
+  // Two turns of the hand clear every reference bit on the way.
+  for (uint32_t n = 0; n <= 2 * mask_ + 1; n++) {
+    ClockHandle* h = &table_[clock_hand_];
+    clock_hand_ = (clock_hand_ + 1) & mask_;
+    uint64_t meta = h->meta.load(std::memory_order_acquire);
+    if (StateOf(meta) != kVisible || RefsOf(meta) != 0) {
+      continue;
+    }
+    if (h->clock.load(std::memory_order_relaxed) != 0) {
+      h->clock.store(0, std::memory_order_relaxed);
+      continue;
+    }
+    if (h->meta.compare_exchange_strong(meta, MakeMeta(kConstruction, 0),
+                                        std::memory_order_acq_rel)) {
+      Free(h);
+      return true;
+    }
+  }
+  return false;
+}
+
+Cache::Handle* ClockCacheShard::Insert(
+    const Slice& key, uint32_t hash, void* value, size_t charge,
+    void (*deleter)(const Slice& key, void* value),
+    Cache::Priority priority) {
+  MutexLock l(&mutex_);
+
+  // Replace any existing entry for key.
+  ClockHandle* old = Find(key, hash);
+  if (old != nullptr) {
+    old->meta.fetch_or(MakeMeta(kInvisible, 0), std::memory_order_acq_rel);
+    Unref(old);
+  }
+
+  while (usage_.load(std::memory_order_relaxed) + charge > capacity_ ||
+         occupancy_.load(std::memory_order_relaxed) >= occupancy_limit_) {
+    if (!EvictOne()) {
+      // Every entry is in use.  The charge may exceed the capacity until
+      // some are released, but the table cannot take more entries.
+      break;
+    }
+  }
+
+  ClockHandle* h;
+  if (capacity_ == 0 ||
+      occupancy_.load(std::memory_order_relaxed) >= occupancy_limit_) {
+    // Turned off caching, or the table is full: hand out an entry that is
+    // freed on its last Release().
+    h = new ClockHandle;
+    h->detached = true;
+    h->displacements.store(0, std::memory_order_relaxed);
+  } else {
+    // occupancy_ counts every slot that is not kEmpty, so there is an
+    // empty slot on the probe sequence, and only this thread claims them.
+    const uint32_t increment = ProbeIncrement(hash);
+    uint32_t i = hash & mask_;
+    for (;;) {
+      h = &table_[i];
+      uint64_t meta = h->meta.load(std::memory_order_relaxed);
+      if (StateOf(meta) == kEmpty &&
+          h->meta.compare_exchange_strong(meta, MakeMeta(kConstruction, 0),
+                                          std::memory_order_acq_rel)) {
+        break;
+      }
+      h->displacements.fetch_add(1, std::memory_order_relaxed);
+      i = (i + increment) & mask_;
+    }
+    occupancy_.fetch_add(1, std::memory_order_relaxed);
+    usage_.fetch_add(charge, std::memory_order_relaxed);
+  }
+
+  h->hash.store(hash, std::memory_order_relaxed);
+  h->key_length = key.size();
+  h->clock.store(priority == Cache::kHigh ? 1 : 0, std::memory_order_relaxed);
+  h->charge = charge;
+  h->key_data = reinterpret_cast<char*>(malloc(key.size()));
+  memcpy(h->key_data, key.data(), key.size());
+  h->value = value;
+  h->deleter = deleter;
+  // One reference for the returned handle.
+  h->meta.store(MakeMeta(h->detached ? kInvisible : kVisible, 1),
+                std::memory_order_release);
+  return reinterpret_cast<Cache::Handle*>(h);
+}
+
+void ClockCacheShard::Erase(const Slice& key, uint32_t hash) {
+  ClockHandle* h = Find(key, hash);
+  if (h != nullptr) {
+    h->meta.fetch_or(MakeMeta(kInvisible, 0), std::memory_order_acq_rel);
+    Unref(h);
+  }
+}
+
+void ClockCacheShard::Prune() {
+  MutexLock l(&mutex_);
+  for (uint32_t i = 0; i <= mask_; i++) {
+    ClockHandle* h = &table_[i];
+    uint64_t meta = h->meta.load(std::memory_order_acquire);
+    if (StateOf(meta) == kVisible && RefsOf(meta) == 0 &&
+        h->meta.compare_exchange_strong(meta, MakeMeta(kConstruction, 0),
+                                        std::memory_order_acq_rel)) {
+      Free(h);
+    }
+  }
+}
+
+static const int kDefaultNumShardBits = 4;
+
+class ClockCache : public Cache {
+ private:
+  const int num_shard_bits_;
+  ClockCacheShard* shard_;
+  port::Mutex id_mutex_;
+  uint64_t last_id_;
+
+  static inline uint32_t HashSlice(const Slice& s) {
+    return Hash(s.data(), s.size(), 0);
+  }
+
+  uint32_t Shard(uint32_t hash) const {
+    return num_shard_bits_ == 0 ? 0 : hash >> (32 - num_shard_bits_);
+  }
+
+ public:
+  ClockCache(size_t capacity, int num_shard_bits,
+             size_t estimated_entry_charge)
+      : num_shard_bits_(num_shard_bits),
+        shard_(new ClockCacheShard[1 << num_shard_bits]),
+        last_id_(0) {
+    const int num_shards = 1 << num_shard_bits_;
+    const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
+    for (int s = 0; s < num_shards; s++) {
+      shard_[s].Init(per_shard, estimated_entry_charge);
+    }
+  }
+  virtual ~ClockCache() {
+    delete[] shard_;
+  }
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value)) {
+    return Insert(key, value, charge, deleter, kLow);
+  }
+  virtual Handle* Insert(const Slice& key, void* value, size_t charge,
+                         void (*deleter)(const Slice& key, void* value),
+                         Priority priority) {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter,
+                                      priority);
+  }
+  virtual Handle* Lookup(const Slice& key) {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Lookup(key, hash);
+  }
+  virtual void Release(Handle* handle) {
+    ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+    shard_[Shard(h->hash.load(std::memory_order_relaxed))].Release(handle);
+  }
+  virtual void Erase(const Slice& key) {
+    const uint32_t hash = HashSlice(key);
+    shard_[Shard(hash)].Erase(key, hash);
+  }
+  virtual void* Value(Handle* handle) {
+    return reinterpret_cast<ClockHandle*>(handle)->value;
+  }
+  virtual uint64_t NewId() {
+    MutexLock l(&id_mutex_);
+    return ++(last_id_);
+  }
+  virtual void Prune() {
+    for (int s = 0; s < (1 << num_shard_bits_); s++) {
+      shard_[s].Prune();
+    }
+  }
+  virtual size_t TotalCharge() const {
+    size_t total = 0;
+    for (int s = 0; s < (1 << num_shard_bits_); s++) {
+      total += shard_[s].TotalCharge();
+    }
+    return total;
+  }
+};
+
+}  // end anonymous namespace
+
+Cache* NewClockCache(size_t capacity, size_t estimated_entry_charge,
+                     int num_shard_bits) {
+  if (num_shard_bits < 0) {
+    num_shard_bits = kDefaultNumShardBits;
+  } else if (num_shard_bits > 16) {
+    num_shard_bits = 16;
+  }
+  return new ClockCache(capacity, num_shard_bits, estimated_entry_charge);
+}
+
+}  // namespace leveldb
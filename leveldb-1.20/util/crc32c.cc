@@ -2,7 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 //
-// A portable implementation of crc32c.
+// A portable implementation of crc32c, with interleaved implementations for
+// processors with SSE4.2 and PCLMUL or ARMv8 CRC32 and PMULL instructions.
 
 #include "util/crc32c.h"
 
@@ -12,6 +13,16 @@
 #include "port/port.h"
 #include "util/coding.h"
 
+#if HAVE_SSE42
+#include <immintrin.h>
+#endif  // HAVE_SSE42
+
+#if HAVE_ARM64_CRC32C
+#include <arm_acle.h>
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#endif  // HAVE_ARM64_CRC32C
+
 namespace leveldb {
 namespace crc32c {
 
@@ -250,6 +261,11 @@ inline uint32_t ReadUint32LE(const uint8_t* buffer) {
   return DecodeFixed32(reinterpret_cast<const char*>(buffer));
 }
 
+// Reads a little-endian 64-bit integer from a 64-bit-aligned buffer.
+inline uint64_t ReadUint64LE(const uint8_t* buffer) {
+  return DecodeFixed64(reinterpret_cast<const char*>(buffer));
+}
+
 // Returns the smallest address >= the given address that is aligned to N bytes.
 //
 // N must be a power of two.
@@ -260,6 +276,130 @@ constexpr inline const uint8_t* RoundUp(const uint8_t* pointer) {
       & ~static_cast<uintptr_t>(N - 1));
 }
 
+#if HAVE_SSE42 || HAVE_ARM64_CRC32C
+// The hardware implementations below split the input into rounds of three
+// consecutive lanes of kLaneLength[i] bytes each, and feed the lanes to
+// three independent chains of crc32 instructions so that the latency of one
+// instruction is hidden behind the other two.  The crc of a round is then
+// crc(lane2) ^ shift(crc(lane1), n) ^ shift(crc(lane0), 2 * n), where
+// shift(c, n) extends c by n zero bytes.  shift(c, n) is computed as
+// crc32(0, clmul(c, x^(8 * n - 33) mod P)): the carry-less product gains a
+// factor of x and the crc32 of a 64-bit word another x^32.
+//
+// Shorter lanes cost relatively more for the final shifts, so the longest
+// lanes that fit are used first.
+static const int kNumLaneLengths = 3;
+static const size_t kLaneLength[kNumLaneLengths] = { 8192, 1024, 128 };
+
+// (x^(8 * n - 33) mod P) and (x^(16 * n - 33) mod P), bit-reflected, for
+// every lane length n.
+static const uint32_t kShiftOneLane[kNumLaneLengths] = {
+    0x54a86326, 0x170076fa, 0x0d3b6092 };
+static const uint32_t kShiftTwoLanes[kNumLaneLengths] = {
+    0x1dc403cc, 0xa51b6135, 0xb9e02b86 };
+#endif  // HAVE_SSE42 || HAVE_ARM64_CRC32C
+
+#if HAVE_SSE42
+__attribute__((target("sse4.2,pclmul")))
+inline uint64_t MultiplySSE42(uint32_t a, uint32_t b) {
+  return _mm_cvtsi128_si64(_mm_clmulepi64_si128(
+      _mm_cvtsi32_si128(static_cast<int>(a)),
+      _mm_cvtsi32_si128(static_cast<int>(b)), 0));
+}
+
+__attribute__((target("sse4.2,pclmul")))
+uint32_t ExtendSSE42(uint32_t crc, const char* buf, size_t size) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(buf);
+  const uint8_t* e = p + size;
+  uint32_t l = crc ^ kCRC32Xor;
+
+  while (p != e && p != RoundUp<8>(p)) {
+    l = _mm_crc32_u8(l, *p++);
+  }
+  for (int i = 0; i < kNumLaneLengths; i++) {
+    const size_t n = kLaneLength[i];
+    while (static_cast<size_t>(e - p) >= 3 * n) {
+      uint64_t crc0 = l;
+      uint64_t crc1 = 0;
+      uint64_t crc2 = 0;
+      const uint8_t* end = p + n;
+      do {
+        crc0 = _mm_crc32_u64(crc0, ReadUint64LE(p));
+        crc1 = _mm_crc32_u64(crc1, ReadUint64LE(p + n));
+        crc2 = _mm_crc32_u64(crc2, ReadUint64LE(p + 2 * n));
+        p += 8;
+      } while (p != end);
+      p += 2 * n;
+      l = static_cast<uint32_t>(crc2 ^ _mm_crc32_u64(
+          0, MultiplySSE42(static_cast<uint32_t>(crc0), kShiftTwoLanes[i]) ^
+             MultiplySSE42(static_cast<uint32_t>(crc1), kShiftOneLane[i])));
+    }
+  }
+  while ((e - p) >= 8) {
+    l = static_cast<uint32_t>(_mm_crc32_u64(l, ReadUint64LE(p)));
+    p += 8;
+  }
+  while (p != e) {
+    l = _mm_crc32_u8(l, *p++);
+  }
+  return l ^ kCRC32Xor;
+}
+
+bool CanUseSSE42() {
+  return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+}
+#endif  // HAVE_SSE42
+
+#if HAVE_ARM64_CRC32C
+__attribute__((target("arch=armv8-a+crc+crypto")))
+inline uint64_t MultiplyARM64(uint32_t a, uint32_t b) {
+  return vgetq_lane_u64(vreinterpretq_u64_p128(
+      vmull_p64(static_cast<poly64_t>(a), static_cast<poly64_t>(b))), 0);
+}
+
+__attribute__((target("arch=armv8-a+crc+crypto")))
+uint32_t ExtendARM64(uint32_t crc, const char* buf, size_t size) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(buf);
+  const uint8_t* e = p + size;
+  uint32_t l = crc ^ kCRC32Xor;
+
+  while (p != e && p != RoundUp<8>(p)) {
+    l = __crc32cb(l, *p++);
+  }
+  for (int i = 0; i < kNumLaneLengths; i++) {
+    const size_t n = kLaneLength[i];
+    while (static_cast<size_t>(e - p) >= 3 * n) {
+      uint32_t crc0 = l;
+      uint32_t crc1 = 0;
+      uint32_t crc2 = 0;
+      const uint8_t* end = p + n;
+      do {
+        crc0 = __crc32cd(crc0, ReadUint64LE(p));
+        crc1 = __crc32cd(crc1, ReadUint64LE(p + n));
+        crc2 = __crc32cd(crc2, ReadUint64LE(p + 2 * n));
+        p += 8;
+      } while (p != end);
+      p += 2 * n;
+      l = crc2 ^ __crc32cd(0, MultiplyARM64(crc0, kShiftTwoLanes[i]) ^
+                              MultiplyARM64(crc1, kShiftOneLane[i]));
+    }
+  }
+  while ((e - p) >= 8) {
+    l = __crc32cd(l, ReadUint64LE(p));
+    p += 8;
+  }
+  while (p != e) {
+    l = __crc32cb(l, *p++);
+  }
+  return l ^ kCRC32Xor;
+}
+
+bool CanUseARM64() {
+  const unsigned long hwcap = getauxval(AT_HWCAP);
+  return (hwcap & HWCAP_CRC32) != 0 && (hwcap & HWCAP_PMULL) != 0;
+}
+#endif  // HAVE_ARM64_CRC32C
+
 }  // namespace
 
 // Determine if the CPU running this program can accelerate the CRC32C
@@ -274,6 +414,19 @@ static bool CanAccelerateCRC32C() {
 }
 
 uint32_t Extend(uint32_t crc, const char* buf, size_t size) {
+#if HAVE_SSE42
+  static bool sse42 = CanUseSSE42();
+  if (sse42) {
+    return ExtendSSE42(crc, buf, size);
+  }
+#endif  // HAVE_SSE42
+#if HAVE_ARM64_CRC32C
+  static bool arm64 = CanUseARM64();
+  if (arm64) {
+    return ExtendARM64(crc, buf, size);
+  }
+#endif  // HAVE_ARM64_CRC32C
+
   static bool accelerate = CanAccelerateCRC32C();
   if (accelerate) {
     return port::AcceleratedCRC32C(crc, buf, size);
@@ -3,6 +3,7 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "util/crc32c.h"
+#include "util/random.h"
 #include "util/testharness.h"
 
 namespace leveldb {
@@ -56,6 +57,46 @@ TEST(CRC, Extend) {
             Extend(Value("hello ", 6), "world", 5));
 }
 
+// Computes the crc32c of data[0,n-1] one bit at a time.
+static uint32_t BitwiseValue(const char* data, size_t n) {
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < n; i++) {
+    crc ^= static_cast<uint8_t>(data[i]);
+    for (int j = 0; j < 8; j++) {
+      crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78u : 0);
+    }
+  }
+  return crc ^ 0xffffffffu;
+}
+
+TEST(CRC, MatchesBitwise) {
+  // Cover every alignment and lengths around the boundaries of the rounds
+  // that the hardware implementations use.
+  Random rnd(301);
+  std::string data(3 * 8192 * 2 + 1024, '\0');
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = static_cast<char>(rnd.Uniform(256));
+  }
+  static const size_t kLengths[] = {
+    0, 1, 7, 8, 9, 63, 64, 383, 384, 385, 400, 3071, 3072, 3073, 3455,
+    3456, 3457, 4096, 24575, 24576, 24577, 32768, 3 * 8192 * 2,
+  };
+  for (size_t offset = 0; offset < 8; offset++) {
+    for (size_t i = 0; i < sizeof(kLengths) / sizeof(kLengths[0]); i++) {
+      const char* p = data.data() + offset;
+      const size_t n = kLengths[i];
+      ASSERT_EQ(BitwiseValue(p, n), Value(p, n)) << offset << " " << n;
+    }
+  }
+  for (int i = 0; i < 200; i++) {
+    const size_t n = rnd.Uniform(data.size());
+    const size_t split = rnd.Uniform(n + 1);
+    ASSERT_EQ(BitwiseValue(data.data(), n),
+              Extend(Value(data.data(), split), data.data() + split,
+                     n - split)) << n << " " << split;
+  }
+}
+
 TEST(CRC, Mask) {
   uint32_t crc = Value("foo", 3);
   ASSERT_NE(crc, Mask(crc));
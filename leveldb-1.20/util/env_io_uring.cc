@@ -0,0 +1,393 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/io_uring_env.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+#include "util/posix_error.h"
+#include "util/posix_fd_limit.h"
+
+#if HAVE_IO_URING
+#include <linux/io_uring.h>
+#define LEVELDB_IO_URING 1
+#else
+#define LEVELDB_IO_URING 0
+#endif
+
+namespace leveldb {
+
+namespace {
+
+// Read req->n bytes into req->scratch, of which the first "done" are
+// already there, with pread().  Stops early at the end of the file.
+static void PreadRest(int fd, const std::string& fname,
+                      RandomAccessFile::ReadRequest* req, size_t done) {
+  req->status = Status::OK();
+  while (done < req->n) {
+    ssize_t r = pread(fd, req->scratch + done, req->n - done,
+                      static_cast<off_t>(req->offset + done));
+    if (r < 0) {
+      if (errno == EINTR) {
+        continue;  // Retry
+      }
+      req->status = PosixError(fname, errno);
+      break;
+    }
+    if (r == 0) {
+      break;  // End of file
+    }
+    done += r;
+  }
+  req->result = Slice(req->scratch, req->status.ok() ? done : 0);
+}
+
+#if LEVELDB_IO_URING
+
+// An io_uring instance, driven through the raw system calls so that
+// liburing is not needed.  A Ring is used by one thread at a time.
+class Ring {
+ public:
+  // Returns nullptr if the kernel does not provide io_uring, or does not
+  // allow this process to use it.
+  static Ring* Create() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, kEntries, &params);
+    if (fd < 0) {
+      return nullptr;
+    }
+    Ring* ring = new Ring(fd);
+    if (!ring->Map(params)) {
+      delete ring;
+      return nullptr;
+    }
+    return ring;
+  }
+
+  ~Ring() {
+    if (sqes_ != nullptr) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != nullptr) {
+      munmap(sq_ring_, sq_ring_size_);
+    }
+    close(fd_);
+  }
+
+  // Perform reqs[0,n-1] against "fd", submitting up to a ring's worth of
+  // reads with each io_uring_enter() call.  Reads that io_uring fails or
+  // cuts short are finished with pread(), which also covers kernels that
+  // lack IORING_OP_READ.  If io_uring_enter() stops taking reads after it
+  // took some of a batch, the rest of the batch fails with its error.
+  void Read(int fd, const std::string& fname,
+            RandomAccessFile::ReadRequest* reqs, size_t n) {
+    for (size_t start = 0; start < n; start += sq_entries_) {
+      const size_t batch = std::min<size_t>(n - start, sq_entries_);
+      int err_number = 0;
+      const size_t submitted = Submit(fd, reqs + start, batch, &err_number);
+      if (submitted == 0) {
+        for (size_t i = start; i < start + batch; i++) {
+          PreadRest(fd, fname, &reqs[i], 0);
+        }
+        continue;
+      }
+      Reap(fd, fname, reqs + start, submitted);
+      for (size_t i = start + submitted; i < start + batch; i++) {
+        reqs[i].result = Slice(reqs[i].scratch, 0);
+        reqs[i].status = PosixError(fname, err_number);
+      }
+    }
+  }
+
+ private:
+  static const unsigned kEntries = 64;
+
+  explicit Ring(int fd)
+      : fd_(fd),
+        sq_ring_(nullptr),
+        cq_ring_(nullptr),
+        sqes_(nullptr) {
+  }
+
+  bool Map(const struct io_uring_params& params) {
+    sq_entries_ = params.sq_entries;
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes +
+                    params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = MapRegion(sq_ring_size_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == nullptr) {
+      return false;
+    }
+    cq_ring_ = single_mmap ? sq_ring_
+                           : MapRegion(cq_ring_size_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == nullptr) {
+      return false;
+    }
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = reinterpret_cast<struct io_uring_sqe*>(
+        MapRegion(sqes_size_, IORING_OFF_SQES));
+    if (sqes_ == nullptr) {
+      return false;
+    }
+
+    char* sq = reinterpret_cast<char*>(sq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = reinterpret_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+  }
+
+  void* MapRegion(size_t size, off_t offset) {
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd_, offset);
+    return (p == MAP_FAILED) ? nullptr : p;
+  }
+
+  // Queue a read for each of reqs[0,n-1] and hand them to the kernel.
+  // Returns the number of reads the kernel took, which are always the
+  // first ones.  The others are taken back out of the queue, and
+  // *err_number is set to the error that io_uring_enter() returned.
+  size_t Submit(int fd, RandomAccessFile::ReadRequest* reqs, size_t n,
+                int* err_number) {
+    unsigned tail = *sq_tail_;  // Only this thread moves the tail
+    for (size_t i = 0; i < n; i++) {
+      const unsigned index = tail & sq_mask_;
+      struct io_uring_sqe* sqe = &sqes_[index];
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_READ;
+      sqe->fd = fd;
+      sqe->addr = reinterpret_cast<uintptr_t>(reqs[i].scratch);
+      sqe->len = static_cast<uint32_t>(reqs[i].n);
+      sqe->off = reqs[i].offset;
+      sqe->user_data = i;
+      sq_array_[index] = index;
+      tail++;
+    }
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+    size_t submitted = 0;
+    while (submitted < n) {
+      int r = syscall(__NR_io_uring_enter, fd_, n - submitted, 0, 0,
+                      nullptr, 0);
+      if (r < 0 && errno == EINTR) {
+        continue;  // Retry
+      }
+      if (r <= 0) {
+        // The kernel takes entries from the head of the queue, so the
+        // ones it has not taken are the last ones.
+        *err_number = (r < 0) ? errno : EAGAIN;
+        const unsigned unsubmitted = static_cast<unsigned>(n - submitted);
+        __atomic_store_n(sq_tail_, tail - unsubmitted, __ATOMIC_RELEASE);
+        break;
+      }
+      submitted += r;
+    }
+    return submitted;
+  }
+
+  // Wait for the n reads that the last Submit() handed to the kernel and
+  // finish them.
+  void Reap(int fd, const std::string& fname,
+            RandomAccessFile::ReadRequest* reqs, size_t n) {
+    size_t completed = 0;
+    while (completed < n) {
+      unsigned head = *cq_head_;  // Only this thread moves the head
+      const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      if (head == tail) {
+        // Errors leave us polling the completion queue, which still
+        // makes progress.
+        syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS,
+                nullptr, 0);
+        continue;
+      }
+      for (; head != tail; head++) {
+        const struct io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+        RandomAccessFile::ReadRequest* req = &reqs[cqe->user_data];
+        const int res = cqe->res;
+        if (res == static_cast<int>(req->n)) {
+          req->result = Slice(req->scratch, req->n);
+          req->status = Status::OK();
+        } else {
+          PreadRest(fd, fname, req, res > 0 ? res : 0);
+        }
+        completed++;
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+  }
+
+  const int fd_;
+  unsigned sq_entries_;
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  struct io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  struct io_uring_cqe* cqes_;
+
+  // No copying allowed
+  Ring(const Ring&);
+  void operator=(const Ring&);
+};
+
+#else  // !LEVELDB_IO_URING
+
+class Ring {
+ public:
+  static Ring* Create() { return nullptr; }
+  void Read(int fd, const std::string& fname,
+            RandomAccessFile::ReadRequest* reqs, size_t n) { }
+};
+
+#endif  // !LEVELDB_IO_URING
+
+class IoUringEnv;
+
+// Wraps a file that the base Env opened, which serves everything but
+// the MultiRead() batches.  Those are read through "fd", a descriptor of
+// the same file, since the base file may well be memory mapped.  "fd" is
+// counted against the read-only file limit of Env::Default().
+class IoUringRandomAccessFile : public RandomAccessFile {
+ public:
+  IoUringRandomAccessFile(IoUringEnv* env, const std::string& fname,
+                          RandomAccessFile* base, int fd)
+      : env_(env), filename_(fname), base_(base), fd_(fd) { }
+
+  virtual ~IoUringRandomAccessFile() {
+    close(fd_);
+    ReleaseReadOnlyFD();
+    delete base_;
+  }
+
+  virtual Status Read(uint64_t offset, size_t n, Slice* result,
+                      char* scratch) const {
+    return base_->Read(offset, n, result, scratch);
+  }
+
+  virtual void Prefetch(uint64_t offset, size_t n) const {
+    base_->Prefetch(offset, n);
+  }
+
+  virtual void MultiRead(ReadRequest* reqs, size_t n) const;
+
+ private:
+  IoUringEnv* const env_;
+  const std::string filename_;
+  RandomAccessFile* const base_;
+  const int fd_;
+};
+
+class IoUringEnv : public EnvWrapper {
+ public:
+  explicit IoUringEnv(Env* base_env) : EnvWrapper(base_env) {
+    // Find out once whether io_uring works here.
+    Ring* ring = Ring::Create();
+    supported_ = (ring != nullptr);
+    if (supported_) {
+      free_rings_.push_back(ring);
+    }
+  }
+
+  virtual ~IoUringEnv() {
+    for (size_t i = 0; i < free_rings_.size(); i++) {
+      delete free_rings_[i];
+    }
+  }
+
+  virtual Status NewRandomAccessFile(const std::string& fname,
+                                     RandomAccessFile** result) {
+    Status s = target()->NewRandomAccessFile(fname, result);
+    if (!s.ok() || !supported_) {
+      return s;
+    }
+    // If the process has used up its read-only file descriptors, or the
+    // base Env does not keep the file where open() can find it, as with
+    // an in-memory Env, MultiRead() is left to the base file.
+    if (!AcquireReadOnlyFD()) {
+      return s;
+    }
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd >= 0) {
+      *result = new IoUringRandomAccessFile(this, fname, *result, fd);
+    } else {
+      ReleaseReadOnlyFD();
+    }
+    return s;
+  }
+
+  // Return a ring for the exclusive use of the caller, or nullptr if none
+  // can be set up.
+  Ring* AcquireRing() {
+    {
+      MutexLock l(&mu_);
+      if (!free_rings_.empty()) {
+        Ring* ring = free_rings_.back();
+        free_rings_.pop_back();
+        return ring;
+      }
+    }
+    return Ring::Create();
+  }
+
+  void ReleaseRing(Ring* ring) {
+    MutexLock l(&mu_);
+    free_rings_.push_back(ring);
+  }
+
+ private:
+  bool supported_;
+  port::Mutex mu_;
+  // Rings that are not in use.  There are as many rings as there have
+  // been concurrent MultiRead() calls.
+  std::vector<Ring*> free_rings_ GUARDED_BY(mu_);
+};
+
+void IoUringRandomAccessFile::MultiRead(ReadRequest* reqs, size_t n) const {
+  Ring* ring = (n > 1) ? env_->AcquireRing() : nullptr;
+  if (ring == nullptr) {
+    base_->MultiRead(reqs, n);
+    return;
+  }
+  ring->Read(fd_, filename_, reqs, n);
+  env_->ReleaseRing(ring);
+}
+
+}  // namespace
+
+Env* NewIoUringEnv(Env* base_env) {
+  return new IoUringEnv(base_env);
+}
+
+}  // namespace leveldb
@@ -25,6 +25,7 @@
 #include "port/thread_annotations.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/posix_error.h"
 #include "util/posix_logger.h"
 #include "util/env_posix_test_helper.h"
 
@@ -43,12 +44,19 @@ static int mmap_limit = -1;
 
 static const size_t kBufSize = 65536;
 
-static Status PosixError(const std::string& context, int err_number) {
-  if (err_number == ENOENT) {
-    return Status::NotFound(context, strerror(err_number));
-  } else {
-    return Status::IOError(context, strerror(err_number));
-  }
+// open() flag for I/O that bypasses the page cache, if there is one.
+#if defined(O_DIRECT)
+static const int kDirectIOFlag = O_DIRECT;
+#else
+static const int kDirectIOFlag = 0;
+#endif
+
+// File offsets, lengths and buffer addresses of direct I/O must be
+// multiples of this.
+static const size_t kDirectIOAlignment = 4096;
+
+static size_t RoundUpToDirectIOAlignment(size_t n) {
+  return (n + kDirectIOAlignment - 1) & ~(kDirectIOAlignment - 1);
 }
 
 // Helper class to limit resource usage to avoid exhaustion.
@@ -143,10 +151,12 @@ class PosixRandomAccessFile: public RandomAccessFile {
   bool temporary_fd_;  // If true, fd_ is -1 and we open on every read.
   int fd_;
   Limiter* limiter_;
+  const bool direct_;  // If true, fd_ was opened with kDirectIOFlag.
 
  public:
-  PosixRandomAccessFile(const std::string& fname, int fd, Limiter* limiter)
-      : filename_(fname), fd_(fd), limiter_(limiter) {
+  PosixRandomAccessFile(const std::string& fname, int fd, Limiter* limiter,
+                        bool direct = false)
+      : filename_(fname), fd_(fd), limiter_(limiter), direct_(direct) {
     temporary_fd_ = !limiter->Acquire();
     if (temporary_fd_) {
       // Open file on every access.
@@ -166,14 +176,15 @@ class PosixRandomAccessFile: public RandomAccessFile {
                       char* scratch) const {
     int fd = fd_;
     if (temporary_fd_) {
-      fd = open(filename_.c_str(), O_RDONLY);
+      fd = open(filename_.c_str(), O_RDONLY | (direct_ ? kDirectIOFlag : 0));
       if (fd < 0) {
         return PosixError(filename_, errno);
       }
     }
 
     Status s;
-    ssize_t r = pread(fd, scratch, n, static_cast<off_t>(offset));
+    ssize_t r = direct_ ? DirectRead(fd, offset, n, scratch)
+                        : pread(fd, scratch, n, static_cast<off_t>(offset));
     *result = Slice(scratch, (r < 0) ? 0 : r);
     if (r < 0) {
       // An error: return a non-ok status
@@ -185,6 +196,42 @@ class PosixRandomAccessFile: public RandomAccessFile {
     }
     return s;
   }
+
+  virtual void Prefetch(uint64_t offset, size_t n) const {
+#if defined(POSIX_FADV_WILLNEED)
+    // Without a permanent descriptor there is nothing to attach the
+    // readahead to, and direct reads do not use the page cache.
+    if (!temporary_fd_ && !direct_) {
+      posix_fadvise(fd_, static_cast<off_t>(offset), static_cast<off_t>(n),
+                    POSIX_FADV_WILLNEED);
+    }
+#endif
+  }
+
+ private:
+  // Direct reads must cover whole aligned blocks of the file, so read
+  // those into an aligned buffer and copy out the requested range.
+  static ssize_t DirectRead(int fd, uint64_t offset, size_t n,
+                            char* scratch) {
+    const uint64_t aligned_offset = offset & ~(kDirectIOAlignment - 1);
+    const size_t skip = offset - aligned_offset;
+    const size_t aligned_n = RoundUpToDirectIOAlignment(skip + n);
+    void* buf;
+    if (posix_memalign(&buf, kDirectIOAlignment, aligned_n) != 0) {
+      errno = ENOMEM;
+      return -1;
+    }
+    ssize_t r = pread(fd, buf, aligned_n, static_cast<off_t>(aligned_offset));
+    const int saved_errno = errno;
+    if (r >= 0) {
+      // The file may end before offset + n.
+      r = (static_cast<size_t>(r) > skip) ? std::min(r - skip, n) : 0;
+      memcpy(scratch, reinterpret_cast<char*>(buf) + skip, r);
+    }
+    free(buf);
+    errno = saved_errno;
+    return r;
+  }
 };
 
 // mmap() based random-access
@@ -219,6 +266,21 @@ class PosixMmapReadableFile: public RandomAccessFile {
     }
     return s;
   }
+
+  virtual void Prefetch(uint64_t offset, size_t n) const {
+    if (offset >= length_) {
+      return;
+    }
+    if (n > length_ - offset) {
+      n = length_ - offset;
+    }
+    // madvise() wants a page-aligned start address.
+    static const uintptr_t page_size = getpagesize();
+    uintptr_t start = reinterpret_cast<uintptr_t>(mmapped_region_) + offset;
+    uintptr_t aligned_start = start & ~(page_size - 1);
+    madvise(reinterpret_cast<void*>(aligned_start), n + (start - aligned_start),
+            MADV_WILLNEED);
+  }
 };
 
 class PosixWritableFile : public WritableFile {
@@ -348,6 +410,116 @@ class PosixWritableFile : public WritableFile {
   }
 };
 
+// Writes that bypass the page cache.  Data is gathered in an aligned
+// buffer and written in whole multiples of kDirectIOAlignment.  Sync() and
+// Close() also write the partial block at the end of the data, padded
+// with zeroes, but keep it in the buffer so that later appends rewrite it
+// in full.  The padding is truncated away again.
+class PosixDirectWritableFile : public WritableFile {
+ private:
+  // buf_[0, pos_-1] contains data that is not yet on disk in full; it
+  // belongs at buf_offset_ in the file, which is aligned.
+  std::string filename_;
+  int fd_;
+  char* buf_;  // kBufSize bytes, aligned to kDirectIOAlignment
+  size_t pos_;
+  uint64_t buf_offset_;
+
+ public:
+  // Takes ownership of "buf", which must have been allocated with
+  // posix_memalign().
+  PosixDirectWritableFile(const std::string& fname, int fd, char* buf)
+      : filename_(fname), fd_(fd), buf_(buf), pos_(0), buf_offset_(0) { }
+
+  ~PosixDirectWritableFile() {
+    if (fd_ >= 0) {
+      // Ignoring any potential errors
+      Close();
+    }
+    free(buf_);
+  }
+
+  virtual Status Append(const Slice& data) {
+    size_t n = data.size();
+    const char* p = data.data();
+    while (n > 0) {
+      size_t copy = std::min(n, kBufSize - pos_);
+      memcpy(buf_ + pos_, p, copy);
+      p += copy;
+      n -= copy;
+      pos_ += copy;
+      if (pos_ == kBufSize) {
+        Status s = WriteBuffered();
+        if (!s.ok()) {
+          return s;
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+  virtual Status Close() {
+    Status result = WriteBuffered();
+    if (result.ok() && ftruncate(fd_, buf_offset_ + pos_) != 0) {
+      result = PosixError(filename_, errno);
+    }
+    const int r = close(fd_);
+    if (r < 0 && result.ok()) {
+      result = PosixError(filename_, errno);
+    }
+    fd_ = -1;
+    return result;
+  }
+
+  virtual Status Flush() {
+    // Partial blocks would have to be written again later, so wait for
+    // the buffer to fill up.
+    return Status::OK();
+  }
+
+  virtual Status Sync() {
+    Status s = WriteBuffered();
+    if (s.ok() && ftruncate(fd_, buf_offset_ + pos_) != 0) {
+      s = PosixError(filename_, errno);
+    }
+    if (s.ok() && fdatasync(fd_) != 0) {
+      s = PosixError(filename_, errno);
+    }
+    return s;
+  }
+
+ private:
+  // Write out buf_[0, pos_-1] padded to whole blocks, and drop the blocks
+  // that were full from the buffer.
+  Status WriteBuffered() {
+    if (pos_ == 0) {
+      return Status::OK();
+    }
+    const size_t padded = RoundUpToDirectIOAlignment(pos_);
+    memset(buf_ + pos_, 0, padded - pos_);
+    const char* p = buf_;
+    size_t n = padded;
+    uint64_t offset = buf_offset_;
+    while (n > 0) {
+      ssize_t r = pwrite(fd_, p, n, static_cast<off_t>(offset));
+      if (r < 0) {
+        if (errno == EINTR) {
+          continue;  // Retry
+        }
+        return PosixError(filename_, errno);
+      }
+      p += r;
+      n -= r;
+      offset += r;
+    }
+    const size_t full = pos_ & ~(kDirectIOAlignment - 1);
+    memmove(buf_, buf_ + full, pos_ - full);
+    buf_offset_ += full;
+    pos_ -= full;
+    return Status::OK();
+  }
+};
+
 static int LockOrUnlock(int fd, bool lock) {
   errno = 0;
   struct flock f;
@@ -458,6 +630,50 @@ class PosixEnv : public Env {
     return s;
   }
 
+  virtual Status NewDirectRandomAccessFile(const std::string& fname,
+                                           RandomAccessFile** result) {
+    if (kDirectIOFlag == 0) {
+      return NewRandomAccessFile(fname, result);
+    }
+    int fd = open(fname.c_str(), O_RDONLY | kDirectIOFlag);
+    if (fd < 0) {
+      if (errno == EINVAL) {
+        // The file system does not support direct I/O.
+        return NewRandomAccessFile(fname, result);
+      }
+      *result = nullptr;
+      return PosixError(fname, errno);
+    }
+    *result = new PosixRandomAccessFile(fname, fd, &fd_limit_, true);
+    return Status::OK();
+  }
+
+  virtual Status NewDirectWritableFile(const std::string& fname,
+                                       WritableFile** result) {
+    if (kDirectIOFlag == 0) {
+      return NewWritableFile(fname, result);
+    }
+    int fd = open(fname.c_str(), O_TRUNC | O_WRONLY | O_CREAT | kDirectIOFlag,
+                  0644);
+    if (fd < 0) {
+      if (errno == EINVAL) {
+        // The file system does not support direct I/O.
+        return NewWritableFile(fname, result);
+      }
+      *result = nullptr;
+      return PosixError(fname, errno);
+    }
+    void* buf;
+    if (posix_memalign(&buf, kDirectIOAlignment, kBufSize) != 0) {
+      close(fd);
+      *result = nullptr;
+      return PosixError(fname, ENOMEM);
+    }
+    *result = new PosixDirectWritableFile(fname, fd,
+                                          reinterpret_cast<char*>(buf));
+    return Status::OK();
+  }
+
   virtual bool FileExists(const std::string& fname) {
     return access(fname.c_str(), F_OK) == 0;
   }
@@ -601,6 +817,10 @@ class PosixEnv : public Env {
     usleep(micros);
   }
 
+  // See util/posix_fd_limit.h.
+  bool AcquireReadOnlyFD() { return fd_limit_.Acquire(); }
+  void ReleaseReadOnlyFD() { fd_limit_.Release(); }
+
  private:
   void PthreadCall(const char* label, int result) {
     if (result != 0) {
@@ -752,4 +972,12 @@ Env* Env::Default() {
   return default_env;
 }
 
+bool AcquireReadOnlyFD() {
+  return static_cast<PosixEnv*>(Env::Default())->AcquireReadOnlyFD();
+}
+
+void ReleaseReadOnlyFD() {
+  static_cast<PosixEnv*>(Env::Default())->ReleaseReadOnlyFD();
+}
+
 }  // namespace leveldb
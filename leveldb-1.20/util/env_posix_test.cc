@@ -4,8 +4,11 @@
 
 #include "leveldb/env.h"
 
+#include "leveldb/io_uring_env.h"
 #include "port/port.h"
+#include "util/random.h"
 #include "util/testharness.h"
+#include "util/testutil.h"
 #include "util/env_posix_test_helper.h"
 
 namespace leveldb {
@@ -47,6 +50,8 @@ TEST(EnvPosixTest, TestOpenOnRead) {
   char scratch;
   Slice read_result;
   for (int i = 0; i < kNumFiles; i++) {
+    // Prefetch hints past the end of the file are ignored.
+    files[i]->Prefetch(i, 100);
     ASSERT_OK(files[i]->Read(i, 1, &read_result, &scratch));
     ASSERT_EQ(kFileData[i], read_result[0]);
   }
@@ -56,6 +61,101 @@ TEST(EnvPosixTest, TestOpenOnRead) {
   ASSERT_OK(env_->DeleteFile(test_file));
 }
 
+TEST(EnvPosixTest, IoUringOpenOnRead) {
+  std::string test_dir;
+  ASSERT_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/io_uring_open_on_read.txt";
+  const char kFileData[] = "abcdefghijklmnopqrstuvwxyz";
+  ASSERT_OK(WriteStringToFile(env_, kFileData, test_file));
+
+  // The descriptors that an IoUringEnv holds for MultiRead() count
+  // against the read-only file limit, so past it the files read as the
+  // files of the base Env do.
+  Env* env = NewIoUringEnv(env_);
+  const int kNumFiles = kReadOnlyFileLimit + kMMapLimit + 5;
+  RandomAccessFile* files[kNumFiles] = {0};
+  for (int i = 0; i < kNumFiles; i++) {
+    ASSERT_OK(env->NewRandomAccessFile(test_file, &files[i]));
+  }
+  for (int i = 0; i < kNumFiles; i++) {
+    char scratch[2];
+    RandomAccessFile::ReadRequest reqs[2];
+    for (int j = 0; j < 2; j++) {
+      reqs[j].offset = i + j;
+      reqs[j].n = 1;
+      reqs[j].scratch = &scratch[j];
+    }
+    files[i]->MultiRead(reqs, 2);
+    for (int j = 0; j < 2; j++) {
+      ASSERT_OK(reqs[j].status);
+      ASSERT_EQ(1, reqs[j].result.size());
+      ASSERT_EQ(kFileData[i + j], reqs[j].result[0]);
+    }
+  }
+  for (int i = 0; i < kNumFiles; i++) {
+    delete files[i];
+  }
+  delete env;
+  ASSERT_OK(env_->DeleteFile(test_file));
+}
+
+TEST(EnvPosixTest, DirectIO) {
+  std::string test_dir;
+  ASSERT_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/direct_io.txt";
+
+  // Write pieces that straddle the alignment and buffer boundaries, with
+  // a Sync() of a partial block in between.
+  Random rnd(301);
+  std::string data;
+  WritableFile* writable_file;
+  ASSERT_OK(env_->NewDirectWritableFile(test_file, &writable_file));
+  static const int kSizes[] = { 1, 4095, 5000, 100, 70000, 3, 200000, 17 };
+  for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+    std::string piece;
+    test::RandomString(&rnd, kSizes[i], &piece);
+    ASSERT_OK(writable_file->Append(piece));
+    ASSERT_OK(writable_file->Flush());
+    data += piece;
+    if (i == 2) {
+      ASSERT_OK(writable_file->Sync());
+    }
+  }
+  ASSERT_OK(writable_file->Close());
+  delete writable_file;
+
+  uint64_t size;
+  ASSERT_OK(env_->GetFileSize(test_file, &size));
+  ASSERT_EQ(data.size(), size);
+  std::string contents;
+  ASSERT_OK(ReadFileToString(env_, test_file, &contents));
+  ASSERT_TRUE(contents == data);
+
+  // Open more files than the descriptor limit so that the last one opens
+  // the file on every read, and read unaligned ranges, some of them
+  // running past the end of the file.
+  const int kNumFiles = kReadOnlyFileLimit + 1;
+  RandomAccessFile* files[kNumFiles];
+  for (int i = 0; i < kNumFiles; i++) {
+    ASSERT_OK(env_->NewDirectRandomAccessFile(test_file, &files[i]));
+  }
+  std::string scratch(10000, ' ');
+  for (int i = 0; i < 100; i++) {
+    RandomAccessFile* file = files[i % kNumFiles];
+    const uint64_t offset = rnd.Uniform(data.size());
+    const size_t n = rnd.Uniform(scratch.size());
+    Slice result;
+    ASSERT_OK(file->Read(offset, n, &result, &scratch[0]));
+    const size_t expected = std::min<size_t>(n, data.size() - offset);
+    ASSERT_EQ(expected, result.size());
+    ASSERT_TRUE(result == Slice(data.data() + offset, expected));
+  }
+  for (int i = 0; i < kNumFiles; i++) {
+    delete files[i];
+  }
+  ASSERT_OK(env_->DeleteFile(test_file));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -5,7 +5,9 @@
 #include "leveldb/env.h"
 
 #include <algorithm>
+#include <vector>
 
+#include "leveldb/io_uring_env.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
 #include "util/mutexlock.h"
@@ -216,6 +218,143 @@ TEST(EnvTest, ReopenAppendableFile) {
   env_->DeleteFile(test_file_name);
 }
 
+// Write "size" random bytes to a new file in the test directory.  Sets
+// *fname to its name and *data to its contents.
+static void WriteMultiReadFile(Env* env, size_t size, std::string* fname,
+                               std::string* data) {
+  Random rnd(test::RandomSeed());
+  std::string test_dir;
+  ASSERT_OK(env->GetTestDirectory(&test_dir));
+  *fname = test_dir + "/multi_read.txt";
+  test::RandomString(&rnd, static_cast<int>(size), data);
+  ASSERT_OK(WriteStringToFile(env, *data, *fname));
+}
+
+// Issue batches of random reads against "fname", whose contents are
+// "data", and check the results.  Reads may overlap each other.
+static void CheckMultiRead(Env* env, const std::string& fname,
+                           const std::string& data, int seed) {
+  RandomAccessFile* file;
+  ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+  Random rnd(seed);
+  for (int batch = 0; batch < 20; batch++) {
+    // More requests than an io_uring instance has entries.
+    const size_t n = 1 + rnd.Uniform(150);
+    std::vector<RandomAccessFile::ReadRequest> reqs(n);
+    std::vector<std::string> scratch(n);
+    for (size_t i = 0; i < n; i++) {
+      reqs[i].offset = rnd.Uniform(data.size());
+      reqs[i].n = std::min<size_t>(1 + rnd.Skewed(16),
+                                   data.size() - reqs[i].offset);
+      scratch[i].resize(reqs[i].n);
+      reqs[i].scratch = &scratch[i][0];
+    }
+    file->MultiRead(&reqs[0], n);
+    for (size_t i = 0; i < n; i++) {
+      ASSERT_OK(reqs[i].status);
+      ASSERT_EQ(data.substr(reqs[i].offset, reqs[i].n),
+                reqs[i].result.ToString());
+    }
+  }
+
+  // An empty batch is fine.
+  file->MultiRead(nullptr, 0);
+  delete file;
+}
+
+TEST(EnvTest, MultiRead) {
+  std::string fname, data;
+  WriteMultiReadFile(env_, 1 << 20, &fname, &data);
+  CheckMultiRead(env_, fname, data, test::RandomSeed());
+  env_->DeleteFile(fname);
+}
+
+TEST(EnvTest, IoUringMultiRead) {
+  Env* env = NewIoUringEnv(env_);
+  std::string fname, data;
+  WriteMultiReadFile(env, 1 << 20, &fname, &data);
+  CheckMultiRead(env, fname, data, test::RandomSeed());
+
+  // Reads that run past the end of the file come back short, like pread().
+  RandomAccessFile* file;
+  ASSERT_OK(env->NewRandomAccessFile(fname, &file));
+  char scratch[3][100];
+  RandomAccessFile::ReadRequest reqs[3];
+  reqs[0].offset = data.size() - 10;
+  reqs[1].offset = data.size() + 10;
+  reqs[2].offset = 0;
+  for (int i = 0; i < 3; i++) {
+    reqs[i].n = sizeof(scratch[i]);
+    reqs[i].scratch = scratch[i];
+  }
+  file->MultiRead(reqs, 3);
+  for (int i = 0; i < 3; i++) {
+    ASSERT_OK(reqs[i].status);
+  }
+  ASSERT_EQ(data.substr(data.size() - 10), reqs[0].result.ToString());
+  ASSERT_EQ(0, reqs[1].result.size());
+  ASSERT_EQ(data.substr(0, 100), reqs[2].result.ToString());
+
+  // Plain reads go through the file of the base Env.
+  Slice result;
+  ASSERT_OK(file->Read(data.size() - 100, 100, &result, scratch[0]));
+  ASSERT_EQ(data.substr(data.size() - 100), result.ToString());
+  delete file;
+
+  ASSERT_TRUE(env->NewRandomAccessFile(fname + ".missing", &file)
+                  .IsNotFound());
+  env->DeleteFile(fname);
+  delete env;
+}
+
+struct MultiReadThreadState {
+  Env* env;
+  std::string fname;
+  std::string data;
+  port::Mutex mu;
+  int seed GUARDED_BY(mu);
+  int num_running GUARDED_BY(mu);
+};
+
+static void MultiReadThreadBody(void* arg) {
+  MultiReadThreadState* state = reinterpret_cast<MultiReadThreadState*>(arg);
+  int seed;
+  {
+    MutexLock l(&state->mu);
+    seed = state->seed++;
+  }
+  CheckMultiRead(state->env, state->fname, state->data, seed);
+  MutexLock l(&state->mu);
+  state->num_running--;
+}
+
+TEST(EnvTest, IoUringConcurrentMultiRead) {
+  // Each thread needs a ring of its own while its batch is in flight.
+  MultiReadThreadState state;
+  state.env = NewIoUringEnv(env_);
+  WriteMultiReadFile(state.env, 1 << 20, &state.fname, &state.data);
+  static const int kNumThreads = 4;
+  {
+    MutexLock l(&state.mu);
+    state.seed = test::RandomSeed();
+    state.num_running = kNumThreads;
+  }
+  for (int i = 0; i < kNumThreads; i++) {
+    env_->StartThread(&MultiReadThreadBody, &state);
+  }
+  while (true) {
+    state.mu.Lock();
+    int num = state.num_running;
+    state.mu.Unlock();
+    if (num == 0) {
+      break;
+    }
+    env_->SleepForMicroseconds(kDelayMicros / 10);
+  }
+  env_->DeleteFile(state.fname);
+  delete state.env;
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
@@ -19,12 +19,29 @@ Options::Options()
       write_buffer_size(4<<20),
       max_open_files(1000),
       block_cache(nullptr),
+      block_cache_compressed(nullptr),
       block_size(4096),
       block_restart_interval(16),
       max_file_size(2<<20),
       compression(kSnappyCompression),
+      zstd_compression_level(3),
+      zstd_max_dictionary_bytes(0),
+      parallel_compression_threads(1),
       reuse_logs(false),
-      filter_policy(nullptr) {
+      filter_policy(nullptr),
+      whole_table_filter(false),
+      prefix_extractor(nullptr),
+      data_block_hash_index(false),
+      partition_index_and_filters(false),
+      pin_top_level_index(false),
+      max_subcompactions(1),
+      max_background_compactions(1),
+      enable_pipelined_write(false),
+      allow_concurrent_memtable_write(false),
+      memtable_factory(nullptr),
+      use_direct_reads(false),
+      use_direct_io_for_flush_and_compaction(false),
+      rate_limiter(nullptr) {
 }
 
 }  // namespace leveldb
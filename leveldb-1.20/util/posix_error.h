@@ -0,0 +1,30 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Conversion of errno values to a Status, shared by all environments
+// where enough posix functionality is available.
+
+#ifndef STORAGE_LEVELDB_UTIL_POSIX_ERROR_H_
+#define STORAGE_LEVELDB_UTIL_POSIX_ERROR_H_
+
+#include <errno.h>
+#include <string.h>
+#include <string>
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+// Return the status for the failure "err_number" of an operation on
+// "context", usually a file name.
+inline Status PosixError(const std::string& context, int err_number) {
+  if (err_number == ENOENT) {
+    return Status::NotFound(context, strerror(err_number));
+  } else {
+    return Status::IOError(context, strerror(err_number));
+  }
+}
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_POSIX_ERROR_H_
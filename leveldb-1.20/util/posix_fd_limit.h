@@ -0,0 +1,24 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// The budget of read-only file descriptors that Env::Default() keeps open,
+// shared with the environments that hold descriptors of their own, since
+// descriptors are a resource of the whole process.
+
+#ifndef STORAGE_LEVELDB_UTIL_POSIX_FD_LIMIT_H_
+#define STORAGE_LEVELDB_UTIL_POSIX_FD_LIMIT_H_
+
+namespace leveldb {
+
+// If another read-only file may be kept open, count it and return true.
+// Else return false.
+bool AcquireReadOnlyFD();
+
+// Release a descriptor counted by a previous call to AcquireReadOnlyFD()
+// that returned true.
+void ReleaseReadOnlyFD();
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_POSIX_FD_LIMIT_H_
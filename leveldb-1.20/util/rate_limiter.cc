@@ -0,0 +1,199 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/rate_limiter.h"
+
+#include <algorithm>
+#include <deque>
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+RateLimiter::~RateLimiter() { }
+
+namespace {
+
+// A token bucket that holds at most one refill worth of bytes.  Requests
+// that do not fit wait in a FIFO queue per priority.  One of the waiting
+// threads, the leader, sleeps until the next refill and then grants as
+// many queued requests as fit, high priority first; the others wait on
+// a condition variable.
+class TokenBucketRateLimiter : public RateLimiter {
+ public:
+  TokenBucketRateLimiter(int64_t bytes_per_second,
+                         int64_t refill_period_micros, Env* env)
+      : env_(env),
+        bytes_per_second_(std::max<int64_t>(bytes_per_second, 1)),
+        refill_period_micros_(std::max<int64_t>(refill_period_micros, 1)),
+        refill_bytes_(std::max<int64_t>(
+            bytes_per_second_ * refill_period_micros_ / 1000000, 1)),
+        cv_(&mu_),
+        available_bytes_(refill_bytes_),
+        next_refill_micros_(env->NowMicros() + refill_period_micros_),
+        leader_waiting_(false) {
+    for (int i = 0; i < kNumPriorities; i++) {
+      total_bytes_[i] = 0;
+      total_requests_[i] = 0;
+      total_wait_micros_[i] = 0;
+    }
+  }
+
+  virtual void Request(size_t bytes, Priority pri) {
+    MutexLock l(&mu_);
+    total_requests_[pri]++;
+    // Requests larger than the bucket are granted one bucket at a time.
+    int64_t left = static_cast<int64_t>(bytes);
+    while (left > 0) {
+      const int64_t chunk = std::min(left, refill_bytes_);
+      RequestChunk(chunk, pri);
+      left -= chunk;
+    }
+  }
+
+  virtual int64_t GetBytesPerSecond() const { return bytes_per_second_; }
+
+  virtual int64_t GetTotalBytesThrough(Priority pri) const {
+    MutexLock l(&mu_);
+    return total_bytes_[pri];
+  }
+
+  virtual int64_t GetTotalRequests(Priority pri) const {
+    MutexLock l(&mu_);
+    return total_requests_[pri];
+  }
+
+  virtual int64_t GetTotalWaitMicros(Priority pri) const {
+    MutexLock l(&mu_);
+    return total_wait_micros_[pri];
+  }
+
+ private:
+  struct Waiter {
+    int64_t bytes;
+    bool granted;
+  };
+
+  void RequestChunk(int64_t bytes, Priority pri)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (queue_[kHigh].empty() && queue_[kLow].empty()) {
+      MaybeRefill(env_->NowMicros());
+      if (available_bytes_ >= bytes) {
+        available_bytes_ -= bytes;
+        total_bytes_[pri] += bytes;
+        return;
+      }
+    }
+
+    const uint64_t start_micros = env_->NowMicros();
+    Waiter w;
+    w.bytes = bytes;
+    w.granted = false;
+    queue_[pri].push_back(&w);
+    while (!w.granted) {
+      if (leader_waiting_) {
+        cv_.Wait();
+        continue;
+      }
+      leader_waiting_ = true;
+      uint64_t now = env_->NowMicros();
+      if (now < next_refill_micros_) {
+        const uint64_t wait = next_refill_micros_ - now;
+        mu_.Unlock();
+        env_->SleepForMicroseconds(static_cast<int>(wait));
+        mu_.Lock();
+        now = env_->NowMicros();
+      }
+      MaybeRefill(now);
+      GrantWaiters();
+      leader_waiting_ = false;
+      // Wake the granted waiters, and let one of the others lead.
+      cv_.SignalAll();
+    }
+    total_bytes_[pri] += bytes;
+    total_wait_micros_[pri] += env_->NowMicros() - start_micros;
+  }
+
+  void MaybeRefill(uint64_t now) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (now >= next_refill_micros_) {
+      // Unused bytes do not carry over, so bursts stay within one refill.
+      available_bytes_ = refill_bytes_;
+      next_refill_micros_ = now + refill_period_micros_;
+    }
+  }
+
+  void GrantWaiters() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    for (int pri = kNumPriorities - 1; pri >= 0; pri--) {
+      std::deque<Waiter*>* queue = &queue_[pri];
+      while (!queue->empty() && queue->front()->bytes <= available_bytes_) {
+        Waiter* w = queue->front();
+        queue->pop_front();
+        available_bytes_ -= w->bytes;
+        w->granted = true;
+      }
+      if (!queue->empty()) {
+        return;  // Lower priorities wait until this queue drains
+      }
+    }
+  }
+
+  Env* const env_;
+  const int64_t bytes_per_second_;
+  const int64_t refill_period_micros_;
+  const int64_t refill_bytes_;
+
+  mutable port::Mutex mu_;
+  port::CondVar cv_ GUARDED_BY(mu_);
+  int64_t available_bytes_ GUARDED_BY(mu_);
+  uint64_t next_refill_micros_ GUARDED_BY(mu_);
+  bool leader_waiting_ GUARDED_BY(mu_);
+  std::deque<Waiter*> queue_[kNumPriorities] GUARDED_BY(mu_);
+  int64_t total_bytes_[kNumPriorities] GUARDED_BY(mu_);
+  int64_t total_requests_[kNumPriorities] GUARDED_BY(mu_);
+  int64_t total_wait_micros_[kNumPriorities] GUARDED_BY(mu_);
+};
+
+class RateLimitedWritableFile : public WritableFile {
+ public:
+  RateLimitedWritableFile(WritableFile* base, RateLimiter* limiter,
+                          RateLimiter::Priority pri)
+      : base_(base), limiter_(limiter), pri_(pri) { }
+
+  virtual ~RateLimitedWritableFile() { delete base_; }
+
+  virtual Status Append(const Slice& data) {
+    limiter_->Request(data.size(), pri_);
+    return base_->Append(data);
+  }
+  virtual Status Close() { return base_->Close(); }
+  virtual Status Flush() { return base_->Flush(); }
+  virtual Status Sync() { return base_->Sync(); }
+
+ private:
+  WritableFile* const base_;
+  RateLimiter* const limiter_;
+  const RateLimiter::Priority pri_;
+};
+
+}  // namespace
+
+RateLimiter* NewRateLimiter(int64_t bytes_per_second,
+                            int64_t refill_period_micros, Env* env) {
+  return new TokenBucketRateLimiter(bytes_per_second, refill_period_micros,
+                                    env);
+}
+
+RateLimiter* NewRateLimiter(int64_t bytes_per_second) {
+  return NewRateLimiter(bytes_per_second, 100000, Env::Default());
+}
+
+WritableFile* NewRateLimitedWritableFile(WritableFile* base,
+                                         RateLimiter* limiter,
+                                         RateLimiter::Priority pri) {
+  return new RateLimitedWritableFile(base, limiter, pri);
+}
+
+}  // namespace leveldb
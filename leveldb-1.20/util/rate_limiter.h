@@ -0,0 +1,29 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_RATE_LIMITER_H_
+#define STORAGE_LEVELDB_UTIL_RATE_LIMITER_H_
+
+#include <stdint.h>
+#include "leveldb/rate_limiter.h"
+
+namespace leveldb {
+
+class Env;
+class WritableFile;
+
+// Like NewRateLimiter(bytes_per_second), but the bucket is refilled every
+// "refill_period_micros", and "env" provides the clock and the sleeps.
+RateLimiter* NewRateLimiter(int64_t bytes_per_second,
+                            int64_t refill_period_micros, Env* env);
+
+// Return a file that asks "limiter" for permission at priority "pri"
+// before passing each Append() on to "base".  The result owns "base".
+WritableFile* NewRateLimitedWritableFile(WritableFile* base,
+                                         RateLimiter* limiter,
+                                         RateLimiter::Priority pri);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_RATE_LIMITER_H_
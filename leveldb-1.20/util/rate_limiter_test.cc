@@ -0,0 +1,194 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/rate_limiter.h"
+
+#include <string>
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+static const int64_t kRefillMicros = 100000;
+
+// An Env with a clock of its own.  If "auto_advance" is true, sleeping
+// moves the clock forward; otherwise sleepers wait for Advance().
+class FakeClockEnv : public EnvWrapper {
+ public:
+  explicit FakeClockEnv(bool auto_advance)
+      : EnvWrapper(Env::Default()),
+        auto_advance_(auto_advance),
+        cv_(&mu_),
+        now_micros_(0) { }
+
+  virtual uint64_t NowMicros() {
+    MutexLock l(&mu_);
+    return now_micros_;
+  }
+
+  virtual void SleepForMicroseconds(int micros) {
+    MutexLock l(&mu_);
+    const uint64_t target = now_micros_ + micros;
+    if (auto_advance_) {
+      now_micros_ = target;
+      return;
+    }
+    while (now_micros_ < target) {
+      cv_.Wait();
+    }
+  }
+
+  void Advance(uint64_t micros) {
+    MutexLock l(&mu_);
+    now_micros_ += micros;
+    cv_.SignalAll();
+  }
+
+ private:
+  const bool auto_advance_;
+  port::Mutex mu_;
+  port::CondVar cv_ GUARDED_BY(mu_);
+  uint64_t now_micros_ GUARDED_BY(mu_);
+};
+
+class RateLimiterTest { };
+
+TEST(RateLimiterTest, Rate) {
+  FakeClockEnv env(true);
+  RateLimiter* limiter = NewRateLimiter(1000000, kRefillMicros, &env);
+  ASSERT_EQ(1000000, limiter->GetBytesPerSecond());
+
+  // The first refill is available right away, and each later one lets
+  // ten more requests through.
+  for (int i = 0; i < 100; i++) {
+    limiter->Request(10000, RateLimiter::kLow);
+  }
+  ASSERT_EQ(9 * kRefillMicros, env.NowMicros());
+  ASSERT_EQ(1000000, limiter->GetTotalBytesThrough(RateLimiter::kLow));
+  ASSERT_EQ(100, limiter->GetTotalRequests(RateLimiter::kLow));
+  ASSERT_EQ(9 * kRefillMicros,
+            limiter->GetTotalWaitMicros(RateLimiter::kLow));
+  ASSERT_EQ(0, limiter->GetTotalBytesThrough(RateLimiter::kHigh));
+  ASSERT_EQ(0, limiter->GetTotalRequests(RateLimiter::kHigh));
+  delete limiter;
+}
+
+TEST(RateLimiterTest, LargeRequest) {
+  FakeClockEnv env(true);
+  RateLimiter* limiter = NewRateLimiter(1000000, kRefillMicros, &env);
+
+  // Larger than a refill, so it is granted in three parts.
+  limiter->Request(250000, RateLimiter::kHigh);
+  ASSERT_EQ(2 * kRefillMicros, env.NowMicros());
+  ASSERT_EQ(250000, limiter->GetTotalBytesThrough(RateLimiter::kHigh));
+  ASSERT_EQ(1, limiter->GetTotalRequests(RateLimiter::kHigh));
+  delete limiter;
+}
+
+struct RequestState {
+  RateLimiter* limiter;
+  RateLimiter::Priority pri;
+  size_t bytes;
+  port::AtomicPointer done;
+};
+
+static void RequestThread(void* arg) {
+  RequestState* state = reinterpret_cast<RequestState*>(arg);
+  state->limiter->Request(state->bytes, state->pri);
+  state->done.Release_Store(state);
+}
+
+// Wait for at most a few seconds until "n" requests at priority "pri"
+// have been made.  Returns true if they have.
+static bool WaitForRequests(RateLimiter* limiter, RateLimiter::Priority pri,
+                            int64_t n) {
+  for (int i = 0; i < 5000 && limiter->GetTotalRequests(pri) < n; i++) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  return limiter->GetTotalRequests(pri) == n;
+}
+
+// Wait for at most a few seconds until the request of "state" returns.
+// Returns true if it has.
+static bool WaitForDone(RequestState* state) {
+  for (int i = 0; i < 5000 && state->done.Acquire_Load() == nullptr; i++) {
+    Env::Default()->SleepForMicroseconds(1000);
+  }
+  return state->done.Acquire_Load() != nullptr;
+}
+
+TEST(RateLimiterTest, HighPriorityFirst) {
+  FakeClockEnv env(false);
+  RateLimiter* limiter = NewRateLimiter(1000000, kRefillMicros, &env);
+
+  // Empty the bucket, then queue a low and a high priority request that
+  // only fit one per refill.
+  limiter->Request(100000, RateLimiter::kLow);
+  RequestState low, high;
+  low.limiter = high.limiter = limiter;
+  low.pri = RateLimiter::kLow;
+  high.pri = RateLimiter::kHigh;
+  low.bytes = high.bytes = 75000;
+  low.done.Release_Store(nullptr);
+  high.done.Release_Store(nullptr);
+
+  env.StartThread(&RequestThread, &low);
+  ASSERT_TRUE(WaitForRequests(limiter, RateLimiter::kLow, 2));
+  env.StartThread(&RequestThread, &high);
+  ASSERT_TRUE(WaitForRequests(limiter, RateLimiter::kHigh, 1));
+
+  // The high priority request was queued last but is granted first.
+  env.Advance(kRefillMicros);
+  ASSERT_TRUE(WaitForDone(&high));
+  ASSERT_TRUE(low.done.Acquire_Load() == nullptr);
+
+  env.Advance(kRefillMicros);
+  ASSERT_TRUE(WaitForDone(&low));
+  ASSERT_EQ(75000, limiter->GetTotalBytesThrough(RateLimiter::kHigh));
+  ASSERT_EQ(175000, limiter->GetTotalBytesThrough(RateLimiter::kLow));
+  delete limiter;
+}
+
+// Keeps everything that was appended to it.
+class StringFile : public WritableFile {
+ public:
+  explicit StringFile(std::string* contents) : contents_(contents) { }
+  virtual Status Append(const Slice& data) {
+    contents_->append(data.data(), data.size());
+    return Status::OK();
+  }
+  virtual Status Close() { return Status::OK(); }
+  virtual Status Flush() { return Status::OK(); }
+  virtual Status Sync() { return Status::OK(); }
+
+ private:
+  std::string* contents_;
+};
+
+TEST(RateLimiterTest, RateLimitedWritableFile) {
+  FakeClockEnv env(true);
+  RateLimiter* limiter = NewRateLimiter(1000000, kRefillMicros, &env);
+  std::string contents;
+  WritableFile* file = NewRateLimitedWritableFile(
+      new StringFile(&contents), limiter, RateLimiter::kHigh);
+  ASSERT_OK(file->Append("hello"));
+  ASSERT_OK(file->Append(std::string(150000, 'x')));
+  ASSERT_OK(file->Sync());
+  ASSERT_OK(file->Close());
+  delete file;
+  ASSERT_EQ("hello" + std::string(150000, 'x'), contents);
+  ASSERT_EQ(150005, limiter->GetTotalBytesThrough(RateLimiter::kHigh));
+  ASSERT_EQ(2, limiter->GetTotalRequests(RateLimiter::kHigh));
+  ASSERT_EQ(2 * kRefillMicros, env.NowMicros());
+  delete limiter;
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}
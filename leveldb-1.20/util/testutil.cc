@@ -4,6 +4,7 @@
 
 #include "util/testutil.h"
 
+#include "port/port.h"
 #include "util/random.h"
 
 namespace leveldb {
@@ -47,5 +48,23 @@ Slice CompressibleString(Random* rnd, double compressed_fraction,
   return Slice(*dst);
 }
 
+bool SnappyCompressionSupported() {
+  std::string out;
+  Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+  return port::Snappy_Compress(in.data(), in.size(), &out);
+}
+
+bool ZstdCompressionSupported() {
+  std::string out;
+  Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+  return port::Zstd_Compress(1, in.data(), in.size(), &out);
+}
+
+bool LZ4CompressionSupported() {
+  std::string out;
+  Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+  return port::LZ4_Compress(in.data(), in.size(), &out);
+}
+
 }  // namespace test
 }  // namespace leveldb
@@ -26,6 +26,11 @@ std::string RandomKey(Random* rnd, int len);
 Slice CompressibleString(Random* rnd, double compressed_fraction,
                          size_t len, std::string* dst);
 
+// Return true iff the build has the library of the compression type.
+bool SnappyCompressionSupported();
+bool ZstdCompressionSupported();
+bool LZ4CompressionSupported();
+
 // A wrapper that allows injection of errors.
 class ErrorEnv : public EnvWrapper {
  public:
@@ -0,0 +1,67 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/thread_pool.h"
+
+#include <assert.h>
+#include "leveldb/env.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+ThreadPool::ThreadPool(Env* env)
+    : env_(env),
+      cv_(&mu_),
+      num_threads_(0),
+      shutting_down_(false) {
+}
+
+ThreadPool::~ThreadPool() {
+  MutexLock l(&mu_);
+  shutting_down_ = true;
+  cv_.SignalAll();
+  while (num_threads_ > 0) {
+    cv_.Wait();
+  }
+}
+
+void ThreadPool::EnsureThreads(int n) {
+  MutexLock l(&mu_);
+  while (num_threads_ < n) {
+    num_threads_++;
+    env_->StartThread(&ThreadPool::ThreadBody, this);
+  }
+}
+
+void ThreadPool::Schedule(void (*function)(void*), void* arg) {
+  MutexLock l(&mu_);
+  assert(num_threads_ > 0);
+  Work work;
+  work.function = function;
+  work.arg = arg;
+  queue_.push_back(work);
+  cv_.Signal();
+}
+
+void ThreadPool::ThreadBody(void* arg) {
+  ThreadPool* pool = reinterpret_cast<ThreadPool*>(arg);
+  MutexLock l(&pool->mu_);
+  while (true) {
+    if (!pool->queue_.empty()) {
+      Work work = pool->queue_.front();
+      pool->queue_.pop_front();
+      pool->mu_.Unlock();
+      (*work.function)(work.arg);
+      pool->mu_.Lock();
+    } else if (pool->shutting_down_) {
+      break;
+    } else {
+      pool->cv_.Wait();
+    }
+  }
+  pool->num_threads_--;
+  pool->cv_.SignalAll();
+}
+
+}  // namespace leveldb
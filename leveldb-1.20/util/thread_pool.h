@@ -0,0 +1,63 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_THREAD_POOL_H_
+#define STORAGE_LEVELDB_UTIL_THREAD_POOL_H_
+
+#include <deque>
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
+namespace leveldb {
+
+class Env;
+
+// A set of threads, started through an Env when first needed, that run
+// the functions handed to Schedule() in the order they were scheduled.
+// Unlike the background thread behind Env::Schedule(), which runs the
+// compactions themselves, a pool is meant for the pieces that a single
+// operation splits its work into and then waits for.
+//
+// A scheduled function must not wait for another function scheduled on
+// the same pool, since all of the threads may be busy with such waiters.
+//
+// Safe for concurrent use by multiple threads.
+class ThreadPool {
+ public:
+  // Create a pool without any threads.
+  explicit ThreadPool(Env* env);
+
+  ThreadPool(const ThreadPool&) = delete;
+  void operator=(const ThreadPool&) = delete;
+
+  // Runs the functions that are still scheduled, then waits for the
+  // threads to exit.
+  ~ThreadPool();
+
+  // Start more threads if the pool has fewer than "n".
+  void EnsureThreads(int n);
+
+  // Arrange to run "(*function)(arg)" on one of the threads.
+  // REQUIRES: EnsureThreads() has been called with n > 0
+  void Schedule(void (*function)(void* arg), void* arg);
+
+ private:
+  struct Work {
+    void (*function)(void*);
+    void* arg;
+  };
+
+  static void ThreadBody(void* arg);
+
+  Env* const env_;
+  port::Mutex mu_;
+  port::CondVar cv_ GUARDED_BY(mu_);
+  std::deque<Work> queue_ GUARDED_BY(mu_);
+  int num_threads_ GUARDED_BY(mu_);  // Threads that have not exited
+  bool shutting_down_ GUARDED_BY(mu_);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_THREAD_POOL_H_
@@ -0,0 +1,94 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/thread_pool.h"
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+#include "util/testharness.h"
+
+namespace leveldb {
+
+// Counts the threads that start and the functions that run.
+class CountingEnv : public EnvWrapper {
+ public:
+  CountingEnv() : EnvWrapper(Env::Default()), started_(0) { }
+
+  virtual void StartThread(void (*function)(void*), void* arg) {
+    MutexLock l(&mu_);
+    started_++;
+    target()->StartThread(function, arg);
+  }
+
+  int started() {
+    MutexLock l(&mu_);
+    return started_;
+  }
+
+ private:
+  port::Mutex mu_;
+  int started_ GUARDED_BY(mu_);
+};
+
+struct Counter {
+  port::Mutex mu;
+  port::CondVar cv;
+  int runs GUARDED_BY(mu);
+
+  Counter() : cv(&mu), runs(0) { }
+};
+
+static void Increment(void* arg) {
+  Counter* counter = reinterpret_cast<Counter*>(arg);
+  Env::Default()->SleepForMicroseconds(1000);
+  MutexLock l(&counter->mu);
+  counter->runs++;
+  counter->cv.SignalAll();
+}
+
+class ThreadPoolTest { };
+
+TEST(ThreadPoolTest, RunsScheduledFunctions) {
+  CountingEnv env;
+  Counter counter;
+  ThreadPool pool(&env);
+  ASSERT_EQ(0, env.started());
+  pool.EnsureThreads(3);
+  pool.EnsureThreads(2);
+  ASSERT_EQ(3, env.started());
+
+  for (int i = 0; i < 100; i++) {
+    pool.Schedule(&Increment, &counter);
+  }
+  MutexLock l(&counter.mu);
+  while (counter.runs < 100) {
+    counter.cv.Wait();
+  }
+  ASSERT_EQ(100, counter.runs);
+}
+
+TEST(ThreadPoolTest, DestructorRunsRemainingWork) {
+  CountingEnv env;
+  Counter counter;
+  {
+    ThreadPool pool(&env);
+    pool.EnsureThreads(1);
+    // Each function sleeps, so most of them are still queued when the
+    // pool is deleted.
+    for (int i = 0; i < 10; i++) {
+      pool.Schedule(&Increment, &counter);
+    }
+  }
+  MutexLock l(&counter.mu);
+  ASSERT_EQ(10, counter.runs);
+  ASSERT_EQ(1, env.started());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  return leveldb::test::RunAllTests();
+}